@@ -0,0 +1,434 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+  This is a reference server for the OpenOCD jtag_vpi interface driver,
+  speaking both the per-command protocol and the batched protocol. Instead
+  of a simulated design, it serves a software model of a single TAP with a
+  4 bit IR, an IDCODE register (IR 0x1, selected at reset), a 32 bit
+  scratch register (IR 0x2) and BYPASS (any other IR). It is meant to test
+  the driver, and to measure the effect of batching on a link where each
+  message costs a simulator round-trip (see the -l option).
+
+  To compile run:
+  gcc -Wall -std=c99 -O2 -o jtag_vpi_server jtag_vpi_server.c
+
+  Usage example:
+  ./jtag_vpi_server -p 5555 -l 100
+
+  Then run:
+  openocd -c "adapter driver jtag_vpi; jtag_vpi set_port 5555" \
+	  -c "jtag newtap sim tap -irlen 4 -expected-id 0x10000c01" \
+	  -c "init; irscan sim.tap 2; drscan sim.tap 32 0x12345678; drscan sim.tap 32 0; shutdown"
+
+  Options:
+  -p port	TCP port to listen on (default 5555)
+  -i idcode	IDCODE of the TAP (default 0x10000c01)
+  -l usec	delay added to each message received, to model the simulator
+  -b		do not support the batched protocol, as older servers
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define XFERT_MAX_SIZE		512
+#define VPI_CMD_SIZE		(4 + 2 * XFERT_MAX_SIZE + 4 + 4)
+#define VPI_BUFFER_OUT		4
+#define VPI_BUFFER_IN		(4 + XFERT_MAX_SIZE)
+#define VPI_LENGTH		(4 + 2 * XFERT_MAX_SIZE)
+#define VPI_NB_BITS		(VPI_LENGTH + 4)
+
+#define CMD_RESET		0
+#define CMD_TMS_SEQ		1
+#define CMD_SCAN_CHAIN		2
+#define CMD_SCAN_CHAIN_FLIP_TMS	3
+#define CMD_STOP_SIMU		4
+#define CMD_BATCH_QUERY		5
+#define CMD_BATCH		6
+
+#define BATCH_VERSION		1
+#define BATCH_HEADER_SIZE	12
+#define BATCH_OP_HEADER_SIZE	5
+#define BATCH_NO_TDO		0x80
+#define BATCH_MAX_SIZE		(64 * 1024)
+
+#define IR_LENGTH		4
+#define IR_IDCODE		0x1
+#define IR_SCRATCH		0x2
+
+enum tap_state {
+	TLR, RTI,
+	SELECT_DR, CAPTURE_DR, SHIFT_DR, EXIT1_DR, PAUSE_DR, EXIT2_DR, UPDATE_DR,
+	SELECT_IR, CAPTURE_IR, SHIFT_IR, EXIT1_IR, PAUSE_IR, EXIT2_IR, UPDATE_IR,
+};
+
+/* next state, for TMS = 0 and TMS = 1 */
+static const enum tap_state tap_next[][2] = {
+	[TLR]        = { RTI,        TLR },
+	[RTI]        = { RTI,        SELECT_DR },
+	[SELECT_DR]  = { CAPTURE_DR, SELECT_IR },
+	[CAPTURE_DR] = { SHIFT_DR,   EXIT1_DR },
+	[SHIFT_DR]   = { SHIFT_DR,   EXIT1_DR },
+	[EXIT1_DR]   = { PAUSE_DR,   UPDATE_DR },
+	[PAUSE_DR]   = { PAUSE_DR,   EXIT2_DR },
+	[EXIT2_DR]   = { SHIFT_DR,   UPDATE_DR },
+	[UPDATE_DR]  = { RTI,        SELECT_DR },
+	[SELECT_IR]  = { CAPTURE_IR, TLR },
+	[CAPTURE_IR] = { SHIFT_IR,   EXIT1_IR },
+	[SHIFT_IR]   = { SHIFT_IR,   EXIT1_IR },
+	[EXIT1_IR]   = { PAUSE_IR,   UPDATE_IR },
+	[PAUSE_IR]   = { PAUSE_IR,   EXIT2_IR },
+	[EXIT2_IR]   = { SHIFT_IR,   UPDATE_IR },
+	[UPDATE_IR]  = { RTI,        SELECT_DR },
+};
+
+static struct {
+	enum tap_state state;
+	uint32_t ir, ir_shift;
+	uint32_t dr_shift;
+	unsigned int dr_length;
+	uint32_t idcode;
+	uint32_t scratch;
+} tap;
+
+static unsigned int latency_us;
+static bool batch_supported = true;
+
+static unsigned long nb_messages, nb_ops;
+
+static uint32_t le_to_u32(const uint8_t *buf)
+{
+	return buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24;
+}
+
+static void u32_to_le(uint8_t *buf, uint32_t val)
+{
+	buf[0] = val;
+	buf[1] = val >> 8;
+	buf[2] = val >> 16;
+	buf[3] = val >> 24;
+}
+
+static void tap_reset(void)
+{
+	tap.state = TLR;
+	tap.ir = IR_IDCODE;
+}
+
+/* one TCK cycle, returns TDO */
+static int tap_clock(int tms, int tdi)
+{
+	int tdo = 0;
+
+	switch (tap.state) {
+	case TLR:
+		tap.ir = IR_IDCODE;
+		break;
+	case CAPTURE_IR:
+		tap.ir_shift = 0x1;
+		break;
+	case SHIFT_IR:
+		tdo = tap.ir_shift & 1;
+		tap.ir_shift = (tap.ir_shift >> 1) | (tdi << (IR_LENGTH - 1));
+		break;
+	case UPDATE_IR:
+		tap.ir = tap.ir_shift;
+		break;
+	case CAPTURE_DR:
+		if (tap.ir == IR_IDCODE) {
+			tap.dr_shift = tap.idcode;
+			tap.dr_length = 32;
+		} else if (tap.ir == IR_SCRATCH) {
+			tap.dr_shift = tap.scratch;
+			tap.dr_length = 32;
+		} else {
+			tap.dr_shift = 0;
+			tap.dr_length = 1;
+		}
+		break;
+	case SHIFT_DR:
+		tdo = tap.dr_shift & 1;
+		tap.dr_shift = (tap.dr_shift >> 1) | ((uint32_t)tdi << (tap.dr_length - 1));
+		break;
+	case UPDATE_DR:
+		if (tap.ir == IR_SCRATCH)
+			tap.scratch = tap.dr_shift;
+		break;
+	default:
+		break;
+	}
+
+	tap.state = tap_next[tap.state][tms ? 1 : 0];
+	return tdo;
+}
+
+static void tms_seq(const uint8_t *bits, uint32_t nb_bits)
+{
+	for (uint32_t i = 0; i < nb_bits; i++)
+		tap_clock((bits[i / 8] >> (i % 8)) & 1, 0);
+}
+
+/* TDO is discarded if tdo is NULL */
+static void scan(const uint8_t *tdi, uint8_t *tdo, uint32_t nb_bits, bool flip_tms)
+{
+	if (tdo)
+		memset(tdo, 0, (nb_bits + 7) / 8);
+
+	for (uint32_t i = 0; i < nb_bits; i++) {
+		int tms = flip_tms && i == nb_bits - 1;
+		if (tap_clock(tms, (tdi[i / 8] >> (i % 8)) & 1) && tdo)
+			tdo[i / 8] |= 1 << (i % 8);
+	}
+}
+
+static bool read_all(int fd, void *buf, size_t size)
+{
+	size_t done = 0;
+
+	while (done < size) {
+		ssize_t n = read(fd, (uint8_t *)buf + done, size - done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		done += n;
+	}
+
+	return true;
+}
+
+static bool write_all(int fd, const void *buf, size_t size)
+{
+	size_t done = 0;
+
+	while (done < size) {
+		ssize_t n = write(fd, (const uint8_t *)buf + done, size - done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		done += n;
+	}
+
+	return true;
+}
+
+/* per-command protocol, the command word has already been read */
+static bool handle_cmd(int fd, uint8_t *vpi, bool *stop)
+{
+	if (!read_all(fd, vpi + 4, VPI_CMD_SIZE - 4))
+		return false;
+
+	uint32_t cmd = le_to_u32(vpi);
+	uint32_t nb_bits = le_to_u32(vpi + VPI_NB_BITS);
+
+	/* CMD_BATCH_QUERY carries the client's largest message in nb_bits */
+	if (cmd != CMD_BATCH_QUERY && nb_bits > XFERT_MAX_SIZE * 8) {
+		fprintf(stderr, "command %u with too many bits (%u)\n", cmd, nb_bits);
+		return false;
+	}
+
+	nb_ops++;
+
+	switch (cmd) {
+	case CMD_RESET:
+		tap_reset();
+		return true;
+	case CMD_TMS_SEQ:
+		tms_seq(vpi + VPI_BUFFER_OUT, nb_bits);
+		return true;
+	case CMD_SCAN_CHAIN:
+	case CMD_SCAN_CHAIN_FLIP_TMS:
+		scan(vpi + VPI_BUFFER_OUT, vpi + VPI_BUFFER_IN, nb_bits, cmd == CMD_SCAN_CHAIN_FLIP_TMS);
+		return write_all(fd, vpi, VPI_CMD_SIZE);
+	case CMD_STOP_SIMU:
+		*stop = true;
+		return true;
+	case CMD_BATCH_QUERY:
+		/* older servers do not answer */
+		if (!batch_supported)
+			return true;
+		u32_to_le(vpi + VPI_LENGTH, BATCH_VERSION);
+		u32_to_le(vpi + VPI_NB_BITS, BATCH_MAX_SIZE);
+		return write_all(fd, vpi, VPI_CMD_SIZE);
+	default:
+		fprintf(stderr, "unknown command %u\n", cmd);
+		return true;
+	}
+}
+
+/* batched protocol, the command word has already been read */
+static bool handle_batch(int fd, uint8_t *msg, uint8_t *reply)
+{
+	if (!read_all(fd, msg + 4, BATCH_HEADER_SIZE - 4))
+		return false;
+
+	uint32_t length = le_to_u32(msg + 4);
+	uint32_t count = le_to_u32(msg + 8);
+
+	if (length > BATCH_MAX_SIZE - BATCH_HEADER_SIZE) {
+		fprintf(stderr, "batch too large (%u bytes)\n", length);
+		return false;
+	}
+
+	if (!read_all(fd, msg + BATCH_HEADER_SIZE, length))
+		return false;
+
+	const uint8_t *p = msg + BATCH_HEADER_SIZE;
+	const uint8_t *end = p + length;
+	uint8_t *tdo = reply + BATCH_HEADER_SIZE;
+
+	for (uint32_t i = 0; i < count; i++) {
+		if (end - p < BATCH_OP_HEADER_SIZE)
+			goto malformed;
+
+		uint8_t cmd = p[0];
+		uint32_t nb_bits = le_to_u32(p + 1);
+		uint32_t nb_bytes = (nb_bits + 7) / 8;
+		const uint8_t *bits = p + BATCH_OP_HEADER_SIZE;
+
+		if ((size_t)(end - bits) < nb_bytes)
+			goto malformed;
+
+		switch (cmd & ~BATCH_NO_TDO) {
+		case CMD_RESET:
+			tap_reset();
+			break;
+		case CMD_TMS_SEQ:
+			tms_seq(bits, nb_bits);
+			break;
+		case CMD_SCAN_CHAIN:
+		case CMD_SCAN_CHAIN_FLIP_TMS:
+			/* TDO never exceeds the size of the operations */
+			if (cmd & BATCH_NO_TDO) {
+				scan(bits, NULL, nb_bits, (cmd & ~BATCH_NO_TDO) == CMD_SCAN_CHAIN_FLIP_TMS);
+			} else {
+				scan(bits, tdo, nb_bits, cmd == CMD_SCAN_CHAIN_FLIP_TMS);
+				tdo += nb_bytes;
+			}
+			break;
+		default:
+			fprintf(stderr, "unknown batched command %u\n", cmd);
+			goto malformed;
+		}
+
+		p = bits + nb_bytes;
+		nb_ops++;
+	}
+
+	u32_to_le(reply, CMD_BATCH);
+	u32_to_le(reply + 4, tdo - (reply + BATCH_HEADER_SIZE));
+	u32_to_le(reply + 8, count);
+	return write_all(fd, reply, tdo - reply);
+
+malformed:
+	fprintf(stderr, "malformed batch\n");
+	return false;
+}
+
+static bool serve(int fd)
+{
+	static uint8_t msg[BATCH_MAX_SIZE], reply[BATCH_MAX_SIZE];
+	bool stop = false;
+
+	tap_reset();
+	nb_messages = 0;
+	nb_ops = 0;
+
+	while (!stop) {
+		if (!read_all(fd, msg, 4))
+			break;
+
+		nb_messages++;
+		if (latency_us)
+			usleep(latency_us);
+
+		bool ok;
+		if (batch_supported && le_to_u32(msg) == CMD_BATCH)
+			ok = handle_batch(fd, msg, reply);
+		else
+			ok = handle_cmd(fd, msg, &stop);
+		if (!ok)
+			break;
+	}
+
+	printf("connection closed: %lu messages, %lu operations\n", nb_messages, nb_ops);
+	return stop;
+}
+
+int main(int argc, char **argv)
+{
+	int port = 5555;
+	int opt;
+
+	tap.idcode = 0x10000c01;
+
+	while ((opt = getopt(argc, argv, "p:i:l:b")) != -1) {
+		switch (opt) {
+		case 'p':
+			port = atoi(optarg);
+			break;
+		case 'i':
+			tap.idcode = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			latency_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			batch_supported = false;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-p port] [-i idcode] [-l latency_us] [-b]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	int server = socket(AF_INET, SOCK_STREAM, 0);
+	int one = 1;
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+
+	setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (server < 0 || bind(server, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+			listen(server, 1) < 0) {
+		perror("jtag_vpi_server");
+		return EXIT_FAILURE;
+	}
+
+	printf("listening on port %d\n", port);
+
+	for (;;) {
+		int fd = accept(server, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("accept");
+			return EXIT_FAILURE;
+		}
+
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		bool stop = serve(fd);
+		close(fd);
+
+		if (stop) {
+			printf("stop simulation requested\n");
+			break;
+		}
+	}
+
+	close(server);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,751 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+  This is a reference server for the OpenOCD remote_bitbang interface
+  driver, speaking both the ASCII protocol and the binary frames (see
+  doc/manual/jtag/drivers/remote_bitbang.txt). Instead of real pins, it
+  serves software models of:
+  - a single TAP with a 4 bit IR, an IDCODE register (IR 0x1, selected at
+    reset), a 32 bit scratch register (IR 0x2) and BYPASS (any other IR);
+  - an SWD debug port with DPIDR, CTRL/STAT (power-up requests are
+    acknowledged), SELECT and RDBUFF, and the registers of AP 0 as plain
+    storage, read through RDBUFF as posted reads.
+  The SWD model decodes the pin level protocol of the ASCII characters and
+  of the frame sequences: it needs a line reset before its first request,
+  and goes back to lockout on a malformed request, as a real target does.
+  It always answers OK.
+
+  It is meant to test the driver, and to measure the effect of the frames
+  on a link where each message costs a round-trip (see the -l option).
+
+  To compile run:
+  gcc -Wall -std=c99 -O2 -o remote_bitbang_server remote_bitbang_server.c
+
+  Usage example:
+  ./remote_bitbang_server -p 7777 -l 100
+
+  Then run, for JTAG:
+  openocd -c "adapter driver remote_bitbang; remote_bitbang port 7777; remote_bitbang use_frames on" \
+	  -c "transport select jtag; jtag newtap sim tap -irlen 4 -expected-id 0x10000c01" \
+	  -c "init; irscan sim.tap 2; drscan sim.tap 32 0x12345678; drscan sim.tap 32 0; shutdown"
+
+  or for SWD:
+  openocd -c "adapter driver remote_bitbang; remote_bitbang port 7777; remote_bitbang use_frames on" \
+	  -c "transport select swd; swd newdap sim cpu -expected-id 0x0bc11477" \
+	  -c "dap create sim.dap -chain-position sim.cpu" \
+	  -c "init; sim.dap apreg 0 0x4 0x12345678; sim.dap apreg 0 0x4; shutdown"
+
+  Options:
+  -p port	TCP port to listen on (default 7777)
+  -i idcode	IDCODE of the TAP (default 0x10000c01)
+  -d dpidr	DPIDR of the SWD debug port (default 0x0bc11477)
+  -l usec	delay added before each answer, to model the link
+  -a		do not answer the frame query, as older servers
+  -f msec	delay the answer to the frame query, as a slow server
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define RB_FRAME_QUERY		'F'
+#define RB_FRAME_START		'X'
+#define RB_FRAME_VERSION	1
+#define RB_FRAME_HEADER_SIZE	5
+#define RB_FRAME_MAX_SIZE	(64 * 1024)
+
+#define RB_OP_SHIFT		0x01
+#define RB_OP_SWD_SEQ		0x02
+#define RB_OP_SWD_XFER		0x03
+
+#define RB_SHIFT_TDO		0x01
+#define RB_SHIFT_TDI		0x02
+#define RB_SHIFT_TMS		0x04
+#define RB_SHIFT_TMS_HIGH	0x08
+#define RB_SHIFT_EXIT		0x10
+
+#define RB_SWD_XFER_SIZE	(1 + 4 + 4)
+#define RB_SWD_RESULT_SIZE	(1 + 4 + 1)
+
+#define IR_LENGTH		4
+#define IR_IDCODE		0x1
+#define IR_SCRATCH		0x2
+
+#define SWD_CMD_START		0x01
+#define SWD_CMD_APNDP		0x02
+#define SWD_CMD_RNW		0x04
+#define SWD_CMD_A32		0x18
+#define SWD_CMD_PARITY		0x20
+#define SWD_CMD_STOP		0x40
+#define SWD_CMD_PARK		0x80
+
+#define SWD_ACK_OK		0x1
+#define SWD_ACK_NONE		0x7
+#define SWD_LINE_RESET_BITS	50
+
+#define CSYSPWRUPREQ		(1u << 30)
+#define CDBGPWRUPREQ		(1u << 28)
+
+enum tap_state {
+	TLR, RTI,
+	SELECT_DR, CAPTURE_DR, SHIFT_DR, EXIT1_DR, PAUSE_DR, EXIT2_DR, UPDATE_DR,
+	SELECT_IR, CAPTURE_IR, SHIFT_IR, EXIT1_IR, PAUSE_IR, EXIT2_IR, UPDATE_IR,
+};
+
+/* next state, for TMS = 0 and TMS = 1 */
+static const enum tap_state tap_next[][2] = {
+	[TLR]        = { RTI,        TLR },
+	[RTI]        = { RTI,        SELECT_DR },
+	[SELECT_DR]  = { CAPTURE_DR, SELECT_IR },
+	[CAPTURE_DR] = { SHIFT_DR,   EXIT1_DR },
+	[SHIFT_DR]   = { SHIFT_DR,   EXIT1_DR },
+	[EXIT1_DR]   = { PAUSE_DR,   UPDATE_DR },
+	[PAUSE_DR]   = { PAUSE_DR,   EXIT2_DR },
+	[EXIT2_DR]   = { SHIFT_DR,   UPDATE_DR },
+	[UPDATE_DR]  = { RTI,        SELECT_DR },
+	[SELECT_IR]  = { CAPTURE_IR, TLR },
+	[CAPTURE_IR] = { SHIFT_IR,   EXIT1_IR },
+	[SHIFT_IR]   = { SHIFT_IR,   EXIT1_IR },
+	[EXIT1_IR]   = { PAUSE_IR,   UPDATE_IR },
+	[PAUSE_IR]   = { PAUSE_IR,   EXIT2_IR },
+	[EXIT2_IR]   = { SHIFT_IR,   UPDATE_IR },
+	[UPDATE_IR]  = { RTI,        SELECT_DR },
+};
+
+static struct {
+	enum tap_state state;
+	uint32_t ir, ir_shift;
+	uint32_t dr_shift;
+	unsigned int dr_length;
+	uint32_t idcode;
+	uint32_t scratch;
+	int tck;
+} tap;
+
+enum swd_line_state {
+	SWD_LOCKOUT,	/* waiting for a line reset */
+	SWD_RESET,	/* line reset seen, waiting for an idle cycle */
+	SWD_IDLE,
+	SWD_REQUEST,
+	SWD_TRANSFER,
+};
+
+static struct {
+	enum swd_line_state state;
+	unsigned int ones;	/* consecutive ones driven by the host */
+	unsigned int nb_bits;	/* bits of the request, or cycles of the transfer */
+	uint8_t request;
+	uint32_t data;
+	bool host_drives;
+	int swclk;
+} swd;
+
+static struct {
+	uint32_t dpidr;
+	uint32_t ctrl_stat;
+	uint32_t select;
+	uint32_t rdbuff;
+	uint32_t ap[64];
+} dp;
+
+static unsigned int latency_us;
+static unsigned int query_delay_ms;
+static bool frames_supported = true;
+
+static unsigned long nb_messages, nb_ops;
+
+static uint32_t le_to_u32(const uint8_t *buf)
+{
+	return buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24;
+}
+
+static void u32_to_le(uint8_t *buf, uint32_t val)
+{
+	buf[0] = val;
+	buf[1] = val >> 8;
+	buf[2] = val >> 16;
+	buf[3] = val >> 24;
+}
+
+static int parity_u32(uint32_t x)
+{
+	return __builtin_parity(x);
+}
+
+static void tap_reset(void)
+{
+	tap.state = TLR;
+	tap.ir = IR_IDCODE;
+}
+
+/* TDO during the current TCK cycle */
+static int tap_tdo(void)
+{
+	if (tap.state == SHIFT_IR)
+		return tap.ir_shift & 1;
+	if (tap.state == SHIFT_DR)
+		return tap.dr_shift & 1;
+	return 0;
+}
+
+/* one TCK cycle, returns TDO */
+static int tap_clock(int tms, int tdi)
+{
+	int tdo = tap_tdo();
+
+	switch (tap.state) {
+	case TLR:
+		tap.ir = IR_IDCODE;
+		break;
+	case CAPTURE_IR:
+		tap.ir_shift = 0x1;
+		break;
+	case SHIFT_IR:
+		tap.ir_shift = (tap.ir_shift >> 1) | (tdi << (IR_LENGTH - 1));
+		break;
+	case UPDATE_IR:
+		tap.ir = tap.ir_shift;
+		break;
+	case CAPTURE_DR:
+		if (tap.ir == IR_IDCODE) {
+			tap.dr_shift = tap.idcode;
+			tap.dr_length = 32;
+		} else if (tap.ir == IR_SCRATCH) {
+			tap.dr_shift = tap.scratch;
+			tap.dr_length = 32;
+		} else {
+			tap.dr_shift = 0;
+			tap.dr_length = 1;
+		}
+		break;
+	case SHIFT_DR:
+		tap.dr_shift = (tap.dr_shift >> 1) | ((uint32_t)tdi << (tap.dr_length - 1));
+		break;
+	case UPDATE_DR:
+		if (tap.ir == IR_SCRATCH)
+			tap.scratch = tap.dr_shift;
+		break;
+	default:
+		break;
+	}
+
+	tap.state = tap_next[tap.state][tms ? 1 : 0];
+	return tdo;
+}
+
+/* DP and AP accesses, returns the data read */
+static uint32_t dp_access(uint8_t request, uint32_t data)
+{
+	unsigned int addr = (request & SWD_CMD_A32) >> 1;
+
+	nb_ops++;
+
+	if (request & SWD_CMD_APNDP) {
+		unsigned int reg = (dp.select & 0xf0) | addr;
+		bool ap0 = (dp.select >> 24) == 0;
+
+		if (request & SWD_CMD_RNW) {
+			uint32_t posted = dp.rdbuff;
+			dp.rdbuff = ap0 ? dp.ap[reg / 4] : 0;
+			return posted;
+		}
+		if (ap0)
+			dp.ap[reg / 4] = data;
+		return 0;
+	}
+
+	if (request & SWD_CMD_RNW) {
+		switch (addr) {
+		case 0x0:
+			return dp.dpidr;
+		case 0x4:
+			/* acknowledge the power-up requests */
+			return dp.ctrl_stat | (dp.ctrl_stat & (CSYSPWRUPREQ | CDBGPWRUPREQ)) << 1;
+		default:
+			return dp.rdbuff;
+		}
+	}
+
+	if (addr == 0x4)
+		dp.ctrl_stat = data & ~((CSYSPWRUPREQ | CDBGPWRUPREQ) << 1);
+	else if (addr == 0x8)
+		dp.select = data;
+	return 0;
+}
+
+static bool swd_request_valid(uint8_t request)
+{
+	return (request & (SWD_CMD_START | SWD_CMD_STOP | SWD_CMD_PARK)) ==
+			(SWD_CMD_START | SWD_CMD_PARK) &&
+		!!(request & SWD_CMD_PARITY) == parity_u32(request & 0x1e);
+}
+
+/*
+ * SWDIO driven by the target during the current SWCLK cycle, 1 (pull-up)
+ * when not driven. A transfer is a turnaround, the ack, then either the
+ * data and parity read followed by a turnaround, or a turnaround followed
+ * by the data and parity written.
+ */
+static int swd_output(void)
+{
+	if (swd.state != SWD_TRANSFER)
+		return 1;
+
+	unsigned int cycle = swd.nb_bits;
+
+	if (cycle >= 1 && cycle <= 3)
+		return (SWD_ACK_OK >> (cycle - 1)) & 1;
+	if (!(swd.request & SWD_CMD_RNW))
+		return 1;
+	if (cycle >= 4 && cycle < 36)
+		return (swd.data >> (cycle - 4)) & 1;
+	if (cycle == 36)
+		return parity_u32(swd.data);
+	return 1;
+}
+
+/* one SWCLK cycle */
+static void swd_clock(bool driven, int swdio)
+{
+	swd.ones = driven && swdio ? swd.ones + 1 : 0;
+	if (swd.ones >= SWD_LINE_RESET_BITS) {
+		swd.state = SWD_RESET;
+		return;
+	}
+
+	switch (swd.state) {
+	case SWD_LOCKOUT:
+		break;
+	case SWD_RESET:
+		if (driven && !swdio)
+			swd.state = SWD_IDLE;
+		break;
+	case SWD_IDLE:
+		if (driven && swdio) {
+			swd.request = SWD_CMD_START;
+			swd.nb_bits = 1;
+			swd.state = SWD_REQUEST;
+		}
+		break;
+	case SWD_REQUEST:
+		if (driven && swdio)
+			swd.request |= 1 << swd.nb_bits;
+		if (++swd.nb_bits < 8)
+			break;
+		if (!swd_request_valid(swd.request)) {
+			swd.state = SWD_LOCKOUT;
+			break;
+		}
+		swd.state = SWD_TRANSFER;
+		swd.nb_bits = 0;
+		swd.data = 0;
+		if (swd.request & SWD_CMD_RNW)
+			swd.data = dp_access(swd.request, 0);
+		break;
+	case SWD_TRANSFER: {
+		unsigned int cycle = swd.nb_bits++;
+
+		if (swd.request & SWD_CMD_RNW) {
+			if (cycle == 37)
+				swd.state = SWD_IDLE;
+			break;
+		}
+		if (cycle >= 5 && cycle < 37) {
+			swd.data |= (uint32_t)(driven && swdio) << (cycle - 5);
+		} else if (cycle == 37) {
+			/* a write with a parity error is dropped */
+			if ((driven && swdio) == parity_u32(swd.data))
+				dp_access(swd.request, swd.data);
+			swd.state = SWD_IDLE;
+		}
+		break;
+	}
+	}
+}
+
+/* buffered socket I/O, the answers are sent before waiting for more input */
+
+static int sock_fd;
+static uint8_t in_buf[4096], out_buf[4096];
+static size_t in_pos, in_len, out_len;
+
+static bool write_all(const void *buf, size_t size)
+{
+	size_t done = 0;
+
+	while (done < size) {
+		ssize_t n = write(sock_fd, (const uint8_t *)buf + done, size - done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		done += n;
+	}
+
+	return true;
+}
+
+static bool flush_out(void)
+{
+	if (!out_len)
+		return true;
+
+	if (latency_us)
+		usleep(latency_us);
+
+	bool ok = write_all(out_buf, out_len);
+	out_len = 0;
+	return ok;
+}
+
+static bool put_byte(uint8_t c)
+{
+	if (out_len == sizeof(out_buf) && !flush_out())
+		return false;
+	out_buf[out_len++] = c;
+	return true;
+}
+
+static bool read_all(void *buf, size_t size)
+{
+	uint8_t *p = buf;
+
+	while (size) {
+		if (in_pos == in_len) {
+			if (!flush_out())
+				return false;
+
+			ssize_t n = read(sock_fd, in_buf, sizeof(in_buf));
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				return false;
+			in_pos = 0;
+			in_len = n;
+			nb_messages++;
+		}
+
+		size_t chunk = in_len - in_pos < size ? in_len - in_pos : size;
+		memcpy(p, in_buf + in_pos, chunk);
+		in_pos += chunk;
+		p += chunk;
+		size -= chunk;
+	}
+
+	return true;
+}
+
+/* frame, the start character has already been read */
+static bool handle_frame(uint8_t *msg, uint8_t *reply)
+{
+	uint8_t header[RB_FRAME_HEADER_SIZE - 1];
+
+	if (!read_all(header, sizeof(header)))
+		return false;
+
+	uint32_t length = le_to_u32(header);
+
+	if (length > RB_FRAME_MAX_SIZE) {
+		fprintf(stderr, "frame too large (%u bytes)\n", length);
+		return false;
+	}
+
+	if (!read_all(msg, length))
+		return false;
+
+	const uint8_t *p = msg;
+	const uint8_t *end = msg + length;
+	uint8_t *results = reply + RB_FRAME_HEADER_SIZE;
+	const uint8_t *results_end = reply + RB_FRAME_HEADER_SIZE + RB_FRAME_MAX_SIZE;
+
+	while (p < end) {
+		uint8_t op = *p++;
+
+		switch (op) {
+		case RB_OP_SHIFT: {
+			if (end - p < 5)
+				goto malformed;
+
+			uint32_t nb_bits = le_to_u32(p);
+			uint8_t flags = p[4];
+			uint32_t nb_bytes = (nb_bits + 7) / 8;
+			const uint8_t *tms = NULL, *tdi = NULL;
+			uint8_t *tdo = NULL;
+			p += 5;
+
+			if (flags & RB_SHIFT_TMS) {
+				if ((size_t)(end - p) < nb_bytes)
+					goto malformed;
+				tms = p;
+				p += nb_bytes;
+			}
+			if (flags & RB_SHIFT_TDI) {
+				if ((size_t)(end - p) < nb_bytes)
+					goto malformed;
+				tdi = p;
+				p += nb_bytes;
+			}
+			if (flags & RB_SHIFT_TDO) {
+				if ((size_t)(results_end - results) < nb_bytes)
+					goto malformed;
+				tdo = results;
+				memset(tdo, 0, nb_bytes);
+				results += nb_bytes;
+			}
+
+			for (uint32_t i = 0; i < nb_bits; i++) {
+				int tms_bit = tms ? (tms[i / 8] >> (i % 8)) & 1 : !!(flags & RB_SHIFT_TMS_HIGH);
+				int tdi_bit = tdi ? (tdi[i / 8] >> (i % 8)) & 1 : 0;
+
+				if ((flags & RB_SHIFT_EXIT) && i == nb_bits - 1)
+					tms_bit = 1;
+				if (tap_clock(tms_bit, tdi_bit) && tdo)
+					tdo[i / 8] |= 1 << (i % 8);
+			}
+			nb_ops++;
+			break;
+		}
+		case RB_OP_SWD_SEQ: {
+			if (end - p < 4)
+				goto malformed;
+
+			uint32_t nb_bits = le_to_u32(p);
+			uint32_t nb_bytes = (nb_bits + 7) / 8;
+			p += 4;
+
+			if ((size_t)(end - p) < nb_bytes)
+				goto malformed;
+
+			for (uint32_t i = 0; i < nb_bits; i++)
+				swd_clock(true, (p[i / 8] >> (i % 8)) & 1);
+			p += nb_bytes;
+			break;
+		}
+		case RB_OP_SWD_XFER: {
+			if (end - p < RB_SWD_XFER_SIZE ||
+					results_end - results < RB_SWD_RESULT_SIZE)
+				goto malformed;
+
+			uint8_t request = p[0];
+			uint32_t data = le_to_u32(p + 1);
+			uint8_t ack = SWD_ACK_NONE;
+			p += RB_SWD_XFER_SIZE;
+
+			/* the idle cycles after the transfer leave the model idle */
+			if (swd.state == SWD_IDLE && swd_request_valid(request)) {
+				ack = SWD_ACK_OK;
+				data = dp_access(request, data);
+			} else {
+				swd.state = SWD_LOCKOUT;
+				data = 0;
+			}
+			if (!(request & SWD_CMD_RNW))
+				data = 0;
+
+			results[0] = ack;
+			u32_to_le(results + 1, data);
+			results[5] = parity_u32(data);
+			results += RB_SWD_RESULT_SIZE;
+			break;
+		}
+		default:
+			fprintf(stderr, "unknown frame operation %u\n", op);
+			goto malformed;
+		}
+	}
+
+	reply[0] = RB_FRAME_START;
+	u32_to_le(reply + 1, results - (reply + RB_FRAME_HEADER_SIZE));
+	for (const uint8_t *r = reply; r < results; r++)
+		if (!put_byte(*r))
+			return false;
+	return true;
+
+malformed:
+	fprintf(stderr, "malformed frame\n");
+	return false;
+}
+
+static bool handle_query(void)
+{
+	/* older servers do not answer */
+	if (!frames_supported)
+		return true;
+
+	if (query_delay_ms) {
+		if (!flush_out())
+			return false;
+		usleep(query_delay_ms * 1000);
+	}
+
+	return put_byte(RB_FRAME_QUERY) && put_byte(RB_FRAME_VERSION);
+}
+
+/* ASCII protocol, one character */
+static bool handle_char(uint8_t c, bool *quit)
+{
+	if (c >= '0' && c <= '7') {
+		/* write tck tms tdi, TCK rising edge clocks the TAP */
+		int tck = (c - '0') >> 2;
+		if (tck && !tap.tck)
+			tap_clock((c - '0') & 2, (c - '0') & 1);
+		tap.tck = tck;
+		return true;
+	}
+
+	if (c >= 'r' && c <= 'u') {
+		/* reset trst srst */
+		if ((c - 'r') & 2)
+			tap_reset();
+		return true;
+	}
+
+	if (c >= 'd' && c <= 'g') {
+		/* swd write swclk swdio, SWCLK rising edge clocks the SWD model */
+		int swclk = (c - 'd') >> 1;
+		if (swclk && !swd.swclk)
+			swd_clock(swd.host_drives, (c - 'd') & 1);
+		swd.swclk = swclk;
+		return true;
+	}
+
+	switch (c) {
+	case 'B':
+	case 'b':
+		return true;
+	case 'R':
+		return put_byte('0' + tap_tdo());
+	case 'Q':
+		*quit = true;
+		return true;
+	case 'O':
+	case 'o':
+		swd.host_drives = c == 'O';
+		return true;
+	case 'c':
+		return put_byte('0' + swd_output());
+	case RB_FRAME_QUERY:
+		return handle_query();
+	case '\n':
+	case '\r':
+		return true;
+	default:
+		fprintf(stderr, "unknown character 0x%02x\n", c);
+		return true;
+	}
+}
+
+static void serve(int fd)
+{
+	static uint8_t msg[RB_FRAME_MAX_SIZE], reply[RB_FRAME_HEADER_SIZE + RB_FRAME_MAX_SIZE];
+	bool quit = false;
+	uint8_t c;
+
+	sock_fd = fd;
+	in_pos = 0;
+	in_len = 0;
+	out_len = 0;
+
+	tap_reset();
+	memset(&swd, 0, sizeof(swd));
+	swd.state = SWD_LOCKOUT;
+	swd.host_drives = true;
+	dp.ctrl_stat = 0;
+	dp.select = 0;
+	dp.rdbuff = 0;
+	nb_messages = 0;
+	nb_ops = 0;
+
+	while (!quit && read_all(&c, 1)) {
+		bool ok;
+		if (frames_supported && c == RB_FRAME_START)
+			ok = handle_frame(msg, reply);
+		else
+			ok = handle_char(c, &quit);
+		if (!ok)
+			break;
+	}
+
+	flush_out();
+	printf("connection closed: %lu messages, %lu operations\n", nb_messages, nb_ops);
+}
+
+int main(int argc, char **argv)
+{
+	int port = 7777;
+	int opt;
+
+	tap.idcode = 0x10000c01;
+	dp.dpidr = 0x0bc11477;
+
+	while ((opt = getopt(argc, argv, "p:i:d:l:af:")) != -1) {
+		switch (opt) {
+		case 'p':
+			port = atoi(optarg);
+			break;
+		case 'i':
+			tap.idcode = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			dp.dpidr = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			latency_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'a':
+			frames_supported = false;
+			break;
+		case 'f':
+			query_delay_ms = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-p port] [-i idcode] [-d dpidr] [-l latency_us] [-a] [-f query_delay_ms]\n",
+				argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	int server = socket(AF_INET, SOCK_STREAM, 0);
+	int one = 1;
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+
+	setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (server < 0 || bind(server, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+			listen(server, 1) < 0) {
+		perror("remote_bitbang_server");
+		return EXIT_FAILURE;
+	}
+
+	printf("listening on port %d\n", port);
+
+	for (;;) {
+		int fd = accept(server, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("accept");
+			return EXIT_FAILURE;
+		}
+
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		serve(fd);
+		close(fd);
+	}
+
+	close(server);
+	return EXIT_SUCCESS;
+}
@@ -13,6 +13,7 @@
 
 #include "core.h"
 #include "arm_io.h"
+#include <helper/align.h>
 #include <helper/binarybuffer.h>
 #include <target/arm.h>
 #include <target/armv7m.h>
@@ -286,3 +287,260 @@ int arm_nandread(struct arm_nand_data *nand, uint8_t *data, uint32_t size)
 
 	return retval;
 }
+
+/* parameter block of contrib/loaders/flash/arm_nand/arm_nand.S */
+enum arm_nand_pages_params {
+	ARM_NAND_PARAM_CMD_REG,
+	ARM_NAND_PARAM_ADDR_REG,
+	ARM_NAND_PARAM_DATA_REG,
+	ARM_NAND_PARAM_ADDR_OR,
+	ARM_NAND_PARAM_FLAGS,
+	ARM_NAND_PARAM_PAGE,
+	ARM_NAND_PARAM_COUNT,
+	ARM_NAND_PARAM_DATA_BYTES,
+	ARM_NAND_PARAM_OOB_BYTES,
+	ARM_NAND_PARAM_COL_CYCLES,
+	ARM_NAND_PARAM_ROW_CYCLES,
+	ARM_NAND_PARAM_BUFFER,
+	ARM_NAND_PARAM_STATUS,
+	ARM_NAND_PARAM_TIMEOUT,
+	ARM_NAND_PARAM_NUM,
+};
+
+#define ARM_NAND_FLAG_ADDR32		1
+#define ARM_NAND_FLAG_READSTART		2
+
+#define ARM_NAND_STATUS_TIMEOUT		0x100
+
+/* loader entry points, relative to the loader address */
+#define ARM_NAND_ENTRY_WRITE		0
+#define ARM_NAND_ENTRY_READ			4
+#define ARM_NAND_EXIT				8
+
+/* maximum number of pages per algorithm run */
+#define ARM_NAND_PAGES_MAX			64
+
+static const uint8_t arm_nand_pages_code_arm[] = {
+#include "../../../contrib/loaders/flash/arm_nand/arm_nand_arm.inc"
+};
+
+static const uint8_t arm_nand_pages_code_thumb[] = {
+#include "../../../contrib/loaders/flash/arm_nand/arm_nand_thumb.inc"
+};
+
+/**
+ * Allocates the pages area and uploads the multi-page loader, if not done
+ * yet or if the area was sized for smaller pages. The page buffer is sized
+ * for as many pages as the working area allows, up to ARM_NAND_PAGES_MAX.
+ */
+static int arm_nand_pages_setup(struct arm_nand_data *nand, const uint8_t *code,
+	uint32_t code_size, uint32_t page_bytes)
+{
+	struct target *target = nand->target;
+	uint32_t header = ALIGN_UP(code_size, 4) + 4 * ARM_NAND_PARAM_NUM;
+	int retval;
+
+	if (nand->pages_area) {
+		if (page_bytes <= nand->pages_bytes)
+			return ERROR_OK;
+		target_free_working_area(target, nand->pages_area);
+		nand->pages_area = NULL;
+	}
+
+	for (nand->pages_max = ARM_NAND_PAGES_MAX; nand->pages_max > 0; nand->pages_max /= 2) {
+		uint32_t size = header + nand->pages_max * (4 + page_bytes);
+
+		retval = target_alloc_working_area_try(target, size, &nand->pages_area);
+		if (retval == ERROR_OK)
+			break;
+	}
+
+	if (!nand->pages_area) {
+		LOG_DEBUG("%s: no buffer for a %" PRIu32 " byte page", __func__, page_bytes);
+		return ERROR_NAND_NO_BUFFER;
+	}
+
+	retval = target_write_buffer(target, nand->pages_area->address, code_size, code);
+	if (retval != ERROR_OK) {
+		target_free_working_area(target, nand->pages_area);
+		nand->pages_area = NULL;
+		return retval;
+	}
+
+	nand->pages_bytes = page_bytes;
+
+	return ERROR_OK;
+}
+
+/**
+ * Transfers up to pages_max pages with one run of the multi-page loader:
+ * the loader issues the command and address cycles itself, moves the data
+ * and OOB bytes of each page and polls the NAND status, so the host only
+ * sees one bulk transfer and one algorithm run per batch of pages.
+ */
+static int arm_nand_pages_run(struct arm_nand_data *nand, struct nand_device *device,
+	bool write, uint32_t page, uint32_t count, uint8_t *pages,
+	uint32_t data_size, uint32_t oob_size)
+{
+	struct target *target = nand->target;
+	struct arm_algorithm armv4_5_algo;
+	struct armv7m_algorithm armv7m_algo;
+	void *arm_algo;
+	struct arm *arm = target->arch_info;
+	struct reg_param reg_params[1];
+	const uint8_t *code;
+	uint32_t code_size;
+	uint32_t page_bytes = data_size + oob_size;
+	uint32_t params[ARM_NAND_PARAM_NUM];
+	uint8_t params_buf[sizeof(params)];
+	uint32_t exit_var = 0;
+	int retval;
+
+	/* 8-bit chips only, and only if the controller provides its latches */
+	if (!nand->cmd || (device->device->options & NAND_BUSWIDTH_16)
+			|| !data_size || !target->working_area_size)
+		return ERROR_NAND_NO_BUFFER;
+
+	if (is_armv7m(target_to_armv7m(target))) {  /* armv7m target */
+		armv7m_algo.common_magic = ARMV7M_COMMON_MAGIC;
+		armv7m_algo.core_mode = ARM_MODE_THREAD;
+		arm_algo = &armv7m_algo;
+		code = arm_nand_pages_code_thumb;
+		code_size = sizeof(arm_nand_pages_code_thumb);
+	} else {
+		armv4_5_algo.common_magic = ARM_COMMON_MAGIC;
+		armv4_5_algo.core_mode = ARM_MODE_SVC;
+		armv4_5_algo.core_state = ARM_STATE_ARM;
+		arm_algo = &armv4_5_algo;
+		code = arm_nand_pages_code_arm;
+		code_size = sizeof(arm_nand_pages_code_arm);
+	}
+
+	retval = arm_nand_pages_setup(nand, code, code_size, page_bytes);
+	if (retval != ERROR_OK)
+		return retval;
+
+	target_addr_t base = nand->pages_area->address;
+	target_addr_t params_addr = base + ALIGN_UP(code_size, 4);
+	target_addr_t status_addr = params_addr + sizeof(params);
+	target_addr_t buffer_addr = status_addr + 4 * nand->pages_max;
+
+	/* small page devices have a single column cycle and no read start */
+	uint32_t col_cycles = (device->page_size <= 512) ? 1 : 2;
+
+	params[ARM_NAND_PARAM_CMD_REG] = nand->cmd;
+	params[ARM_NAND_PARAM_ADDR_REG] = nand->addr;
+	params[ARM_NAND_PARAM_DATA_REG] = nand->data;
+	params[ARM_NAND_PARAM_ADDR_OR] = nand->addr_or;
+	params[ARM_NAND_PARAM_FLAGS] = (nand->addr32 ? ARM_NAND_FLAG_ADDR32 : 0)
+		| ((col_cycles == 2) ? ARM_NAND_FLAG_READSTART : 0);
+	params[ARM_NAND_PARAM_DATA_BYTES] = data_size;
+	params[ARM_NAND_PARAM_OOB_BYTES] = oob_size;
+	params[ARM_NAND_PARAM_COL_CYCLES] = col_cycles;
+	params[ARM_NAND_PARAM_ROW_CYCLES] = device->address_cycles - col_cycles;
+	params[ARM_NAND_PARAM_BUFFER] = buffer_addr;
+	params[ARM_NAND_PARAM_STATUS] = status_addr;
+	params[ARM_NAND_PARAM_TIMEOUT] = 0x100000;
+
+	/* armv4 must exit using a hardware breakpoint */
+	if (arm->arch == ARM_ARCH_V4)
+		exit_var = base + ARM_NAND_EXIT;
+
+	init_reg_param(&reg_params[0], "r0", 32, PARAM_IN_OUT);
+
+	while (count > 0) {
+		uint32_t chunk = MIN(count, nand->pages_max);
+		uint32_t status[ARM_NAND_PAGES_MAX];
+		uint8_t status_buf[sizeof(status)];
+
+		params[ARM_NAND_PARAM_PAGE] = page;
+		params[ARM_NAND_PARAM_COUNT] = chunk;
+		target_buffer_set_u32_array(target, params_buf, ARM_NAND_PARAM_NUM, params);
+
+		retval = target_write_buffer(target, params_addr, sizeof(params_buf), params_buf);
+		if (retval == ERROR_OK && write)
+			retval = target_write_buffer(target, buffer_addr, chunk * page_bytes, pages);
+		if (retval != ERROR_OK)
+			break;
+
+		buf_set_u32(reg_params[0].value, 0, 32, params_addr);
+
+		retval = target_run_algorithm(target, 0, NULL, 1, reg_params,
+				base + (write ? ARM_NAND_ENTRY_WRITE : ARM_NAND_ENTRY_READ), exit_var,
+				1000 + 10 * chunk, arm_algo);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("error executing hosted NAND %s", write ? "write" : "read");
+			break;
+		}
+
+		uint32_t done = buf_get_u32(reg_params[0].value, 0, 32);
+
+		if (!write) {
+			retval = target_read_buffer(target, buffer_addr, MIN(done, chunk) * page_bytes, pages);
+			if (retval != ERROR_OK)
+				break;
+		}
+
+		if (done < chunk) {
+			retval = target_read_buffer(target, status_addr, 4 * (done + 1), status_buf);
+			if (retval != ERROR_OK)
+				break;
+			target_buffer_get_u32_array(target, status_buf, done + 1, status);
+
+			if (status[done] & ARM_NAND_STATUS_TIMEOUT) {
+				LOG_ERROR("timeout waiting for NAND page %" PRIu32, page + done);
+				retval = ERROR_NAND_OPERATION_TIMEOUT;
+			} else if (write) {
+				LOG_ERROR("write of NAND page %" PRIu32 " didn't pass, status: 0x%2.2" PRIx32,
+						page + done, status[done]);
+				retval = ERROR_NAND_OPERATION_FAILED;
+			} else {
+				LOG_ERROR("read of NAND page %" PRIu32 " failed, status: 0x%2.2" PRIx32,
+						page + done, status[done]);
+				retval = ERROR_NAND_OPERATION_FAILED;
+			}
+			break;
+		}
+
+		page += chunk;
+		pages += chunk * page_bytes;
+		count -= chunk;
+	}
+
+	destroy_reg_param(&reg_params[0]);
+
+	return retval;
+}
+
+/**
+ * Programs consecutive pages of an 8-bit NAND using an on-chip loader.
+ * Each page in the host buffer is made of data_size bytes of data followed
+ * by oob_size bytes of OOB, as sent to the chip.
+ *
+ * @param nand Pointer to the arm_nand_data struct that defines the I/O
+ * @param device The NAND device, for its geometry
+ * @param page First page to program
+ * @param count Number of pages to program
+ * @param pages Host buffer holding the pages
+ * @param data_size Size of the data of each page
+ * @param oob_size Size of the OOB of each page, possibly 0
+ * @return Success or failure of the operation, ERROR_NAND_NO_BUFFER if
+ * the pages have to be transferred one by one
+ */
+int arm_nand_write_pages(struct arm_nand_data *nand, struct nand_device *device,
+	uint32_t page, uint32_t count, uint8_t *pages,
+	uint32_t data_size, uint32_t oob_size)
+{
+	return arm_nand_pages_run(nand, device, true, page, count, pages, data_size, oob_size);
+}
+
+/**
+ * Reads consecutive pages of an 8-bit NAND using an on-chip loader, with
+ * the same buffer layout as arm_nand_write_pages().
+ */
+int arm_nand_read_pages(struct arm_nand_data *nand, struct nand_device *device,
+	uint32_t page, uint32_t count, uint8_t *pages,
+	uint32_t data_size, uint32_t oob_size)
+{
+	return arm_nand_pages_run(nand, device, false, page, count, pages, data_size, oob_size);
+}
@@ -35,10 +35,40 @@ struct arm_nand_data {
 	/** Last operation executed using this struct. */
 	enum arm_nand_op op;
 
+	/** Command latch address, for multi-page transfers (0 if unsupported). */
+	uint32_t cmd;
+
+	/** Address latch address, for multi-page transfers. */
+	uint32_t addr;
+
+	/** Value ORed into each address cycle. */
+	uint32_t addr_or;
+
+	/** Address cycles are written as 32-bit words instead of bytes. */
+	bool addr32;
+
+	/** The pages area holds the multi-page loader and its page buffer. */
+	struct working_area *pages_area;
+
+	/** Number of pages the page buffer can hold. */
+	uint32_t pages_max;
+
+	/** Page size, data and OOB, the page buffer was sized for. */
+	uint32_t pages_bytes;
+
 	/* currently implicit:  data width == 8 bits (not 16) */
 };
 
+struct nand_device;
+
 int arm_nandwrite(struct arm_nand_data *nand, uint8_t *data, int size);
 int arm_nandread(struct arm_nand_data *nand, uint8_t *data, uint32_t size);
 
+int arm_nand_write_pages(struct arm_nand_data *nand, struct nand_device *device,
+		uint32_t page, uint32_t count, uint8_t *pages,
+		uint32_t data_size, uint32_t oob_size);
+int arm_nand_read_pages(struct arm_nand_data *nand, struct nand_device *device,
+		uint32_t page, uint32_t count, uint8_t *pages,
+		uint32_t data_size, uint32_t oob_size);
+
 #endif /* OPENOCD_FLASH_NAND_ARM_IO_H */
@@ -690,6 +690,92 @@ int nand_read_page(struct nand_device *nand, uint32_t page,
 		return nand->controller->read_page(nand, page, data, data_size, oob, oob_size);
 }
 
+/* the batched hooks transfer full raw pages, without controller ECC */
+static bool nand_use_pages_hook(struct nand_device *nand, bool write,
+	uint32_t data_size, uint32_t oob_size)
+{
+	if (write ? !nand->controller->write_pages : !nand->controller->read_pages)
+		return false;
+
+	if (!nand->use_raw && (write ? nand->controller->write_page : nand->controller->read_page))
+		return false;
+
+	return data_size == (uint32_t)nand->page_size || oob_size == 0;
+}
+
+/**
+ * Writes @a count consecutive pages. Each page in @a pages is made of
+ * @a data_size bytes of data followed by @a oob_size bytes of OOB. The
+ * controller's write_pages hook is used if possible, else the pages are
+ * written one at a time.
+ */
+int nand_write_pages(struct nand_device *nand, uint32_t page, uint32_t count,
+	uint8_t *pages, uint32_t data_size, uint32_t oob_size)
+{
+	uint32_t page_bytes = data_size + oob_size;
+	uint32_t pages_per_block;
+	int retval;
+
+	if (!nand->device)
+		return ERROR_NAND_DEVICE_NOT_PROBED;
+
+	if (!count)
+		return ERROR_OK;
+
+	pages_per_block = nand->erase_size / nand->page_size;
+	for (uint32_t i = page / pages_per_block; i <= (page + count - 1) / pages_per_block; i++)
+		if (nand->blocks[i].is_erased == 1)
+			nand->blocks[i].is_erased = 0;
+
+	if (nand_use_pages_hook(nand, true, data_size, oob_size)) {
+		retval = nand->controller->write_pages(nand, page, count, pages, data_size, oob_size);
+		if (retval != ERROR_NAND_NO_BUFFER)
+			return retval;
+	}
+
+	for (uint32_t i = 0; i < count; i++, pages += page_bytes) {
+		retval = nand_write_page(nand, page + i, pages, data_size,
+				oob_size ? pages + data_size : NULL, oob_size);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("write of NAND page %" PRIu32 " failed", page + i);
+			return retval;
+		}
+	}
+
+	return ERROR_OK;
+}
+
+/**
+ * Reads @a count consecutive pages, with the same buffer layout as
+ * nand_write_pages().
+ */
+int nand_read_pages(struct nand_device *nand, uint32_t page, uint32_t count,
+	uint8_t *pages, uint32_t data_size, uint32_t oob_size)
+{
+	uint32_t page_bytes = data_size + oob_size;
+	int retval;
+
+	if (!nand->device)
+		return ERROR_NAND_DEVICE_NOT_PROBED;
+
+	if (nand_use_pages_hook(nand, false, data_size, oob_size)) {
+		retval = nand->controller->read_pages(nand, page, count, pages, data_size, oob_size);
+		if (retval != ERROR_NAND_NO_BUFFER)
+			return retval;
+	}
+
+	for (uint32_t i = 0; i < count; i++, pages += page_bytes) {
+		retval = nand_read_page(nand, page + i, pages, data_size,
+				oob_size ? pages + data_size : NULL, oob_size);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("read of NAND page %" PRIu32 " failed", page + i);
+			return retval;
+		}
+	}
+
+	return ERROR_OK;
+}
+
 int nand_page_command(struct nand_device *nand, uint32_t page,
 	uint8_t cmd, bool oob_only)
 {
@@ -203,6 +203,13 @@ int nand_calculate_ecc(struct nand_device *nand,
 int nand_calculate_ecc_kw(struct nand_device *nand,
 			  const uint8_t *dat, uint8_t *ecc_code);
 
+int nand_calculate_ecc_blocks(struct nand_device *nand, const uint8_t *dat,
+		unsigned int blocks, uint8_t *ecc_code);
+int nand_correct_data_blocks(struct nand_device *nand, uint8_t *dat,
+		unsigned int blocks, uint8_t *read_ecc, uint8_t *calc_ecc);
+int nand_calculate_ecc_kw_blocks(struct nand_device *nand, const uint8_t *dat,
+		unsigned int blocks, uint8_t *ecc_code);
+
 int nand_register_commands(struct command_context *cmd_ctx);
 
 /** helper for parsing a nand device command argument string */
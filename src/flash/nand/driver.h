@@ -64,6 +64,19 @@ struct nand_flash_controller {
 	int (*read_page)(struct nand_device *nand, uint32_t page, uint8_t *data, uint32_t data_size,
 			 uint8_t *oob, uint32_t oob_size);
 
+	/**
+	 * Write consecutive pages to the NAND device. Each page in @a pages
+	 * is made of @a data_size bytes of data followed by @a oob_size bytes
+	 * of OOB. Returns ERROR_NAND_NO_BUFFER if the pages have to be
+	 * written one at a time.
+	 */
+	int (*write_pages)(struct nand_device *nand, uint32_t page, uint32_t count,
+			uint8_t *pages, uint32_t data_size, uint32_t oob_size);
+
+	/** Read consecutive pages from the NAND device, see write_pages. */
+	int (*read_pages)(struct nand_device *nand, uint32_t page, uint32_t count,
+			uint8_t *pages, uint32_t data_size, uint32_t oob_size);
+
 	/** Check if the NAND device is ready for more instructions with timeout. */
 	int (*nand_ready)(struct nand_device *nand, int timeout);
 };
@@ -19,6 +19,7 @@
 #endif
 
 #include "core.h"
+#include <helper/types.h>
 
 /*
  * Pre-calculated 256-way 1 byte column parity
@@ -43,28 +44,12 @@ static const uint8_t nand_ecc_precalc_table[] = {
 };
 
 /*
- * nand_calculate_ecc - Calculate 3-byte ECC for 256-byte block
+ * Packs the column parity and the line parities of a 256-byte block into
+ * the 3-byte ECC code
  */
-int nand_calculate_ecc(struct nand_device *nand, const uint8_t *dat, uint8_t *ecc_code)
+static void nand_ecc_encode(uint8_t reg1, uint8_t reg2, uint8_t reg3, uint8_t *ecc_code)
 {
-	uint8_t idx, reg1, reg2, reg3, tmp1, tmp2;
-	int i;
-
-	/* Initialize variables */
-	reg1 = reg2 = reg3 = 0;
-
-	/* Build up column parity */
-	for (i = 0; i < 256; i++) {
-		/* Get CP0 - CP5 from table */
-		idx = nand_ecc_precalc_table[*dat++];
-		reg1 ^= (idx & 0x3f);
-
-		/* All bit XOR = 1 ? */
-		if (idx & 0x40) {
-			reg3 ^= (uint8_t) i;
-			reg2 ^= ~((uint8_t) i);
-		}
-	}
+	uint8_t tmp1, tmp2;
 
 	/* Create non-inverted ECC code from line parity */
 	tmp1  = (reg3 & 0x80) >> 0; /* B7 -> B7 */
@@ -94,6 +79,90 @@ int nand_calculate_ecc(struct nand_device *nand, const uint8_t *dat, uint8_t *ec
 	ecc_code[1] = ~tmp2;
 #endif
 	ecc_code[2] = ((~reg1) << 2) | 0x03;
+}
+
+/*
+ * nand_calculate_ecc - Calculate 3-byte ECC for 256-byte block
+ */
+int nand_calculate_ecc(struct nand_device *nand, const uint8_t *dat, uint8_t *ecc_code)
+{
+	uint8_t idx, reg1, reg2, reg3;
+	int i;
+
+	/* Initialize variables */
+	reg1 = reg2 = reg3 = 0;
+
+	/* Build up column parity */
+	for (i = 0; i < 256; i++) {
+		/* Get CP0 - CP5 from table */
+		idx = nand_ecc_precalc_table[*dat++];
+		reg1 ^= (idx & 0x3f);
+
+		/* All bit XOR = 1 ? */
+		if (idx & 0x40) {
+			reg3 ^= (uint8_t) i;
+			reg2 ^= ~((uint8_t) i);
+		}
+	}
+
+	nand_ecc_encode(reg1, reg2, reg3, ecc_code);
+
+	return 0;
+}
+
+/* parity of a 64-bit word, in bit 6 like nand_ecc_precalc_table */
+static inline uint8_t nand_ecc_parity64(uint64_t x)
+{
+	x ^= x >> 32;
+	x ^= x >> 16;
+	x ^= x >> 8;
+	return nand_ecc_precalc_table[x & 0xff] & 0x40;
+}
+
+/*
+ * Same code as nand_calculate_ecc(), computed 64 bits at a time. The
+ * column parity is linear, so it is looked up once for the XOR of the
+ * whole block. Line parity bits 7..3 select the word, they toggle with
+ * the parity of each word; bits 2..0 select the byte within the word,
+ * they come from the parity of each byte lane of the XOR of all words.
+ */
+static void nand_calculate_ecc_wide(const uint8_t *dat, uint8_t *ecc_code)
+{
+	uint64_t lanes = 0;
+	uint8_t idx, reg2, reg3 = 0;
+
+	for (unsigned int j = 0; j < 256 / 8; j++) {
+		uint64_t word = le_to_h_u64(dat + 8 * j);
+
+		lanes ^= word;
+		if (nand_ecc_parity64(word))
+			reg3 ^= j << 3;
+	}
+
+	for (unsigned int b = 0; b < 8; b++)
+		if (nand_ecc_precalc_table[(lanes >> (8 * b)) & 0xff] & 0x40)
+			reg3 ^= b;
+
+	lanes ^= lanes >> 32;
+	lanes ^= lanes >> 16;
+	lanes ^= lanes >> 8;
+	idx = nand_ecc_precalc_table[lanes & 0xff];
+
+	/* reg2 is the XOR of the inverted indexes of the odd parity bytes */
+	reg2 = (idx & 0x40) ? ~reg3 : reg3;
+
+	nand_ecc_encode(idx & 0x3f, reg2, reg3, ecc_code);
+}
+
+/**
+ * Calculates the 3-byte ECC codes of @a blocks consecutive 256-byte
+ * blocks, as nand_calculate_ecc() would one block at a time.
+ */
+int nand_calculate_ecc_blocks(struct nand_device *nand, const uint8_t *dat,
+		unsigned int blocks, uint8_t *ecc_code)
+{
+	for (unsigned int i = 0; i < blocks; i++)
+		nand_calculate_ecc_wide(dat + 256 * i, ecc_code + 3 * i);
 
 	return 0;
 }
@@ -158,3 +227,30 @@ int nand_correct_data(struct nand_device *nand, u_char *dat,
 
 	return -1;
 }
+
+/**
+ * Checks @a blocks consecutive 256-byte blocks against their ECC codes
+ * and corrects single bit errors in place.
+ *
+ * @returns the number of corrected blocks, or -1 if any block has an
+ * uncorrectable error.
+ */
+int nand_correct_data_blocks(struct nand_device *nand, uint8_t *dat,
+		unsigned int blocks, uint8_t *read_ecc, uint8_t *calc_ecc)
+{
+	int corrected = 0;
+
+	for (unsigned int i = 0; i < blocks; i++) {
+		/* the common case, no error at all */
+		if (!memcmp(read_ecc + 3 * i, calc_ecc + 3 * i, 3))
+			continue;
+
+		int retval = nand_correct_data(nand, dat + 256 * i,
+				read_ecc + 3 * i, calc_ecc + 3 * i);
+		if (retval < 0)
+			return retval;
+		corrected += retval;
+	}
+
+	return corrected;
+}
@@ -161,3 +161,94 @@ int nand_calculate_ecc_kw(struct nand_device *nand, const uint8_t *data, uint8_t
 
 	return 0;
 }
+
+/*
+ * Products of each possible r7 by the eight generator coefficients, packed
+ * in 16-bit lanes in the same order as the r0..r7 remainder registers:
+ * r0..r3 in gf_gen_lo, r4..r7 in gf_gen_hi. One step of the division then
+ * costs two table loads instead of eight log/exp lookups and a branch.
+ */
+static uint64_t gf_gen_lo[1024];
+static uint64_t gf_gen_hi[1024];
+
+static void gf_build_gen_table(void)
+{
+	static const uint16_t gen[8] = {
+		0x024, 0x237, 0x193, 0x197, 0x25f, 0x18e, 0x181, 0x21c
+	};
+
+	for (unsigned int v = 1; v < 1024; v++) {
+		const uint16_t *t = gf_exp + gf_log[v];
+
+		gf_gen_lo[v] = 0;
+		gf_gen_hi[v] = 0;
+		for (unsigned int k = 0; k < 4; k++) {
+			gf_gen_lo[v] |= (uint64_t)t[gen[k]] << (16 * k);
+			gf_gen_hi[v] |= (uint64_t)t[gen[k + 4]] << (16 * k);
+		}
+	}
+}
+
+/*
+ * Same code as nand_calculate_ecc_kw(), with the remainder held in two
+ * 64-bit words. Shifting in a data symbol moves every register up by one
+ * lane, the symbol leaving r7 selects the packed products to subtract.
+ */
+static void nand_calculate_ecc_kw_wide(const uint8_t *data, uint8_t *ecc)
+{
+	uint64_t lo = 0, hi = 0;
+	unsigned int r[8];
+
+	/* load bytes 504..511 of the data into r */
+	for (unsigned int k = 0; k < 4; k++) {
+		lo |= (uint64_t)data[504 + k] << (16 * k);
+		hi |= (uint64_t)data[508 + k] << (16 * k);
+	}
+
+	for (int i = 503; i >= -8; i--) {
+		unsigned int r7 = hi >> 48;
+		uint64_t d = (i >= 0) ? data[i] : 0;
+
+		hi = (hi << 16) | (lo >> 48);
+		lo = (lo << 16) | d;
+		hi ^= gf_gen_hi[r7];
+		lo ^= gf_gen_lo[r7];
+	}
+
+	for (unsigned int k = 0; k < 4; k++) {
+		r[k] = (lo >> (16 * k)) & 0xffff;
+		r[k + 4] = (hi >> (16 * k)) & 0xffff;
+	}
+
+	ecc[0] = r[0];
+	ecc[1] = (r[0] >> 8) | (r[1] << 2);
+	ecc[2] = (r[1] >> 6) | (r[2] << 4);
+	ecc[3] = (r[2] >> 4) | (r[3] << 6);
+	ecc[4] = (r[3] >> 2);
+	ecc[5] = r[4];
+	ecc[6] = (r[4] >> 8) | (r[5] << 2);
+	ecc[7] = (r[5] >> 6) | (r[6] << 4);
+	ecc[8] = (r[6] >> 4) | (r[7] << 6);
+	ecc[9] = (r[7] >> 2);
+}
+
+/**
+ * Calculates the 10-byte ECC codes of @a blocks consecutive 512-byte
+ * blocks, as nand_calculate_ecc_kw() would one block at a time.
+ */
+int nand_calculate_ecc_kw_blocks(struct nand_device *nand, const uint8_t *data,
+		unsigned int blocks, uint8_t *ecc)
+{
+	static bool tables_initialized;
+
+	if (!tables_initialized) {
+		gf_build_log_exp_table();
+		gf_build_gen_table();
+		tables_initialized = true;
+	}
+
+	for (unsigned int i = 0; i < blocks; i++)
+		nand_calculate_ecc_kw_wide(data + 512 * i, ecc + 10 * i);
+
+	return 0;
+}
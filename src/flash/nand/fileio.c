@@ -181,14 +181,13 @@ int nand_fileio_read(struct nand_device *nand, struct nand_fileio_state *s)
 	}
 
 	if (s->oob_format & NAND_OOB_SW_ECC) {
-		uint8_t ecc[3];
+		uint8_t ecc[ARRAY_SIZE(nand_oob_64.eccpos)];
+		unsigned int blocks = MIN(s->page_size / 256, ARRAY_SIZE(ecc) / 3);
+
 		memset(s->oob, 0xff, s->oob_size);
-		for (uint32_t i = 0, j = 0; i < s->page_size; i += 256) {
-			nand_calculate_ecc(nand, s->page + i, ecc);
-			s->oob[s->eccpos[j++]] = ecc[0];
-			s->oob[s->eccpos[j++]] = ecc[1];
-			s->oob[s->eccpos[j++]] = ecc[2];
-		}
+		nand_calculate_ecc_blocks(nand, s->page, blocks, ecc);
+		for (unsigned int j = 0; j < 3 * blocks; j++)
+			s->oob[s->eccpos[j]] = ecc[j];
 	} else if (s->oob_format & NAND_OOB_SW_ECC_KW)   {
 		/*
 		 * In this case eccpos is not used as
@@ -198,10 +197,7 @@ int nand_fileio_read(struct nand_device *nand, struct nand_fileio_state *s)
 		 */
 		uint8_t *ecc = s->oob + s->oob_size - s->page_size / 512 * 10;
 		memset(s->oob, 0xff, s->oob_size);
-		for (uint32_t i = 0; i < s->page_size; i += 512) {
-			nand_calculate_ecc_kw(nand, s->page + i, ecc);
-			ecc += 10;
-		}
+		nand_calculate_ecc_kw_blocks(nand, s->page, s->page_size / 512, ecc);
 	} else if (s->oob)   {
 		fileio_read(s->fileio, s->oob_size, s->oob, &one_read);
 		if (one_read < s->oob_size)
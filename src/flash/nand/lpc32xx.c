@@ -24,8 +24,6 @@
 static int lpc32xx_reset(struct nand_device *nand);
 static int lpc32xx_controller_ready(struct nand_device *nand, int timeout);
 static int lpc32xx_tc_ready(struct nand_device *nand, int timeout);
-extern int nand_correct_data(struct nand_device *nand, u_char *dat,
-		u_char *read_ecc, u_char *calc_ecc);
 
 /* These are offset with the working area in IRAM when using DMA to
  * read/write data to the SLC controller.
@@ -1541,22 +1539,15 @@ static int lpc32xx_read_page_slc(struct nand_device *nand,
 	for (i = 0; i < ecc_count * 3; i++)
 		fecc[i] = foob[layout[i]];
 	/* Compare ECC and possibly correct data */
-	for (i = 0; i < ecc_count; i++) {
-		retval = nand_correct_data(nand, data + 256*i, &fecc[i * 3],
-				&ecc[i * 3]);
-		if (retval > 0)
-			LOG_WARNING("error detected and corrected: %" PRIu32 "/%d",
-				page, i);
-		if (retval < 0)
-			break;
-	}
-	if (i == ecc_count)
-		retval = ERROR_OK;
-	else {
-		LOG_ERROR("uncorrectable error detected: %" PRIu32 "/%d", page, i);
-		retval = ERROR_NAND_OPERATION_FAILED;
+	retval = nand_correct_data_blocks(nand, data, ecc_count, fecc, ecc);
+	if (retval < 0) {
+		LOG_ERROR("uncorrectable error detected: %" PRIu32, page);
+		return ERROR_NAND_OPERATION_FAILED;
 	}
-	return retval;
+	if (retval > 0)
+		LOG_WARNING("error detected and corrected in %d blocks: %" PRIu32,
+			retval, page);
+	return ERROR_OK;
 }
 
 static int lpc32xx_read_page(struct nand_device *nand, uint32_t page,
@@ -134,6 +134,34 @@ static int nuc910_nand_write_block_data(struct nand_device *nand,
 	return ERROR_OK;
 }
 
+static int nuc910_nand_write_pages(struct nand_device *nand, uint32_t page,
+		uint32_t count, uint8_t *pages, uint32_t data_size, uint32_t oob_size)
+{
+	struct nuc910_nand_controller *nuc910_nand = nand->controller_priv;
+	int result;
+
+	result = validate_target_state(nand);
+	if (result != ERROR_OK)
+		return result;
+
+	return arm_nand_write_pages(&nuc910_nand->io, nand, page, count, pages,
+			data_size, oob_size);
+}
+
+static int nuc910_nand_read_pages(struct nand_device *nand, uint32_t page,
+		uint32_t count, uint8_t *pages, uint32_t data_size, uint32_t oob_size)
+{
+	struct nuc910_nand_controller *nuc910_nand = nand->controller_priv;
+	int result;
+
+	result = validate_target_state(nand);
+	if (result != ERROR_OK)
+		return result;
+
+	return arm_nand_read_pages(&nuc910_nand->io, nand, page, count, pages,
+			data_size, oob_size);
+}
+
 static int nuc910_nand_reset(struct nand_device *nand)
 {
 	return nuc910_nand_command(nand, NAND_CMD_RESET);
@@ -191,6 +219,10 @@ static int nuc910_nand_init(struct nand_device *nand)
 	nuc910_nand->io.target = target;
 	nuc910_nand->io.data = NUC910_SMDATA;
 	nuc910_nand->io.op = ARM_NAND_NONE;
+	nuc910_nand->io.cmd = NUC910_SMCMD;
+	nuc910_nand->io.addr = NUC910_SMADDR;
+	nuc910_nand->io.addr_or = NUC910_SMADDR_EOA;
+	nuc910_nand->io.addr32 = true;
 
 	/* configure nand controller */
 	target_write_u32(target, NUC910_FMICSR, NUC910_FMICSR_SM_EN);
@@ -209,6 +241,8 @@ struct nand_flash_controller nuc910_nand_controller = {
 	.write_data	= nuc910_nand_write,
 	.write_block_data = nuc910_nand_write_block_data,
 	.read_block_data = nuc910_nand_read_block_data,
+	.write_pages = nuc910_nand_write_pages,
+	.read_pages = nuc910_nand_read_pages,
 	.nand_ready = nuc910_nand_ready,
 	.reset = nuc910_nand_reset,
 	.nand_device_command = nuc910_nand_device_command,
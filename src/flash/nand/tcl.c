@@ -229,6 +229,24 @@ COMMAND_HANDLER(handle_nand_check_bad_blocks_command)
 	return retval;
 }
 
+/* pages handed at once to the controller's batched read and write hooks */
+#define NAND_BATCH_PAGES	32
+
+/*
+ * Batch buffer of a file transfer, holding the data and OOB of each page
+ * back to back. OOB only transfers go page by page, without a buffer.
+ */
+static uint8_t *nand_batch_alloc(struct nand_fileio_state *s, uint32_t *batch)
+{
+	uint8_t *pages = NULL;
+
+	if (s->page)
+		pages = malloc(NAND_BATCH_PAGES * (s->page_size + s->oob_size));
+
+	*batch = pages ? NAND_BATCH_PAGES : 1;
+	return pages;
+}
+
 COMMAND_HANDLER(handle_nand_write_command)
 {
 	struct nand_device *nand = NULL;
@@ -238,28 +256,52 @@ COMMAND_HANDLER(handle_nand_write_command)
 	if (retval != ERROR_OK)
 		return retval;
 
+	uint32_t batch;
+	uint8_t *pages = nand_batch_alloc(&s, &batch);
+	uint32_t oob_size = s.oob ? s.oob_size : 0;
+	uint32_t page_bytes = s.page_size + oob_size;
+
 	uint32_t total_bytes = s.size;
 	while (s.size > 0) {
-		int bytes_read = nand_fileio_read(nand, &s);
-		if (bytes_read <= 0) {
-			command_print(CMD, "error while reading file");
-			nand_fileio_cleanup(&s);
-			return ERROR_FAIL;
+		uint32_t first = s.address / nand->page_size;
+		uint32_t count = 0;
+
+		while (s.size > 0 && count < batch) {
+			int bytes_read = nand_fileio_read(nand, &s);
+			if (bytes_read <= 0) {
+				command_print(CMD, "error while reading file");
+				free(pages);
+				nand_fileio_cleanup(&s);
+				return ERROR_FAIL;
+			}
+			s.size -= bytes_read;
+
+			if (pages) {
+				memcpy(pages + count * page_bytes, s.page, s.page_size);
+				if (oob_size)
+					memcpy(pages + count * page_bytes + s.page_size, s.oob, oob_size);
+			}
+			count++;
 		}
-		s.size -= bytes_read;
 
-		retval = nand_write_page(nand, s.address / nand->page_size,
-				s.page, s.page_size, s.oob, s.oob_size);
+		if (pages)
+			retval = nand_write_pages(nand, first, count, pages, s.page_size, oob_size);
+		else
+			retval = nand_write_page(nand, first,
+					s.page, s.page_size, s.oob, s.oob_size);
 		if (retval != ERROR_OK) {
 			command_print(CMD, "failed writing file %s "
 				"to NAND flash %s at offset 0x%8.8" PRIx32,
 				CMD_ARGV[1], CMD_ARGV[0], s.address);
+			free(pages);
 			nand_fileio_cleanup(&s);
 			return retval;
 		}
-		s.address += s.page_size;
+		s.address += count * s.page_size;
 	}
 
+	free(pages);
+
 	if (nand_fileio_finish(&s) == ERROR_OK) {
 		command_print(CMD, "wrote file %s to NAND flash %s up to "
 			"offset 0x%8.8" PRIx32 " in %fs (%0.3f KiB/s)",
@@ -287,37 +329,64 @@ COMMAND_HANDLER(handle_nand_verify_command)
 	if (retval != ERROR_OK)
 		return retval;
 
+	uint32_t batch;
+	uint8_t *pages = nand_batch_alloc(&dev, &batch);
+	uint32_t oob_size = dev.oob ? dev.oob_size : 0;
+	uint32_t page_bytes = dev.page_size + oob_size;
+
 	while (file.size > 0) {
-		retval = nand_read_page(nand, dev.address / dev.page_size,
-				dev.page, dev.page_size, dev.oob, dev.oob_size);
+		uint32_t count = 1;
+
+		if (pages) {
+			/* the file may end before the page does */
+			count = MIN(batch, DIV_ROUND_UP(file.size, page_bytes));
+			retval = nand_read_pages(nand, dev.address / dev.page_size, count,
+					pages, dev.page_size, oob_size);
+		} else {
+			retval = nand_read_page(nand, dev.address / dev.page_size,
+					dev.page, dev.page_size, dev.oob, dev.oob_size);
+		}
 		if (retval != ERROR_OK) {
 			command_print(CMD, "reading NAND flash page failed");
+			free(pages);
 			nand_fileio_cleanup(&dev);
 			nand_fileio_cleanup(&file);
 			return retval;
 		}
 
-		int bytes_read = nand_fileio_read(nand, &file);
-		if (bytes_read <= 0) {
-			command_print(CMD, "error while reading file");
-			nand_fileio_cleanup(&dev);
-			nand_fileio_cleanup(&file);
-			return ERROR_FAIL;
+		for (uint32_t i = 0; i < count && file.size > 0; i++) {
+			if (pages) {
+				memcpy(dev.page, pages + i * page_bytes, dev.page_size);
+				if (oob_size)
+					memcpy(dev.oob, pages + i * page_bytes + dev.page_size, oob_size);
+			}
+
+			int bytes_read = nand_fileio_read(nand, &file);
+			if (bytes_read <= 0) {
+				command_print(CMD, "error while reading file");
+				free(pages);
+				nand_fileio_cleanup(&dev);
+				nand_fileio_cleanup(&file);
+				return ERROR_FAIL;
+			}
+
+			if ((dev.page && memcmp(dev.page, file.page, dev.page_size)) ||
+					(dev.oob && memcmp(dev.oob, file.oob, dev.oob_size))) {
+				command_print(CMD, "NAND flash contents differ "
+					"at 0x%8.8" PRIx32, dev.address);
+				free(pages);
+				nand_fileio_cleanup(&dev);
+				nand_fileio_cleanup(&file);
+				return ERROR_FAIL;
+			}
+
+			file.size -= bytes_read;
+			dev.address += nand->page_size;
 		}
-
-		if ((dev.page && memcmp(dev.page, file.page, dev.page_size)) ||
-				(dev.oob && memcmp(dev.oob, file.oob, dev.oob_size))) {
-			command_print(CMD, "NAND flash contents differ "
-				"at 0x%8.8" PRIx32, dev.address);
-			nand_fileio_cleanup(&dev);
-			nand_fileio_cleanup(&file);
-			return ERROR_FAIL;
-		}
-
-		file.size -= bytes_read;
-		dev.address += nand->page_size;
 	}
 
+	free(pages);
+
 	if (nand_fileio_finish(&file) == ERROR_OK) {
 		command_print(CMD, "verified file %s in NAND flash %s "
 			"up to offset 0x%8.8" PRIx32 " in %fs (%0.3f KiB/s)",
@@ -338,26 +407,44 @@ COMMAND_HANDLER(handle_nand_dump_command)
 	if (retval != ERROR_OK)
 		return retval;
 
+	uint32_t batch;
+	uint8_t *pages = nand_batch_alloc(&s, &batch);
+	uint32_t oob_size = s.oob ? s.oob_size : 0;
+	uint32_t page_bytes = s.page_size + oob_size;
+
 	while (s.size > 0) {
 		size_t size_written;
-		retval = nand_read_page(nand, s.address / nand->page_size,
-				s.page, s.page_size, s.oob, s.oob_size);
+		uint32_t count = MIN(batch, s.size / nand->page_size);
+
+		if (pages)
+			retval = nand_read_pages(nand, s.address / nand->page_size, count,
+					pages, s.page_size, oob_size);
+		else
+			retval = nand_read_page(nand, s.address / nand->page_size,
+					s.page, s.page_size, s.oob, s.oob_size);
 		if (retval != ERROR_OK) {
 			command_print(CMD, "reading NAND flash page failed");
+			free(pages);
 			nand_fileio_cleanup(&s);
 			return retval;
 		}
 
-		if (s.page)
-			fileio_write(s.fileio, s.page_size, s.page, &size_written);
+		if (pages) {
+			fileio_write(s.fileio, count * page_bytes, pages, &size_written);
+		} else {
+			if (s.page)
+				fileio_write(s.fileio, s.page_size, s.page, &size_written);
 
-		if (s.oob)
-			fileio_write(s.fileio, s.oob_size, s.oob, &size_written);
+			if (s.oob)
+				fileio_write(s.fileio, s.oob_size, s.oob, &size_written);
+		}
 
-		s.size -= nand->page_size;
-		s.address += nand->page_size;
+		s.size -= count * nand->page_size;
+		s.address += count * nand->page_size;
 	}
 
+	free(pages);
+
 	retval = fileio_size(s.fileio, &filesize);
 	if (retval != ERROR_OK)
 		return retval;
@@ -575,6 +662,86 @@ COMMAND_HANDLER(handle_nand_device_command)
 	return CALL_COMMAND_HANDLER(create_nand_device, bank_name, controller);
 }
 
+/* runs one ECC function over the whole buffer and prints its throughput */
+static int nand_ecc_benchmark_run(struct command_invocation *cmd, const char *name,
+	const uint8_t *data, uint32_t size, uint32_t block_size, uint8_t *ecc, uint32_t ecc_size,
+	int (*per_block)(struct nand_device *, const uint8_t *, uint8_t *),
+	int (*blocks)(struct nand_device *, const uint8_t *, unsigned int, uint8_t *))
+{
+	struct duration bench;
+
+	duration_start(&bench);
+	if (per_block) {
+		for (uint32_t i = 0; i < size / block_size; i++)
+			per_block(NULL, data + i * block_size, ecc + i * ecc_size);
+	} else {
+		blocks(NULL, data, size / block_size, ecc);
+	}
+	if (duration_measure(&bench) != ERROR_OK)
+		return ERROR_FAIL;
+
+	command_print(cmd, "%-24s %fs (%0.3f KiB/s)", name,
+		duration_elapsed(&bench), duration_kbps(&bench, size));
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_nand_ecc_benchmark_command)
+{
+	uint32_t size_kib = 4096;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], size_kib);
+	if (size_kib == 0 || size_kib > 1024 * 1024)
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+
+	uint32_t size = size_kib * 1024;
+	uint8_t *data = malloc(size);
+	uint8_t *ecc = malloc(size / 256 * 3);
+	uint8_t *ecc_blocks = malloc(size / 256 * 3);
+	if (!data || !ecc || !ecc_blocks) {
+		LOG_ERROR("Out of memory");
+		free(data);
+		free(ecc);
+		free(ecc_blocks);
+		return ERROR_FAIL;
+	}
+
+	/* deterministic, non trivial contents */
+	uint32_t x = 0x12345678;
+	for (uint32_t i = 0; i < size; i++) {
+		x = x * 1103515245 + 12345;
+		data[i] = x >> 16;
+	}
+
+	int retval = nand_ecc_benchmark_run(CMD, "hamming, per block", data, size,
+			256, ecc, 3, nand_calculate_ecc, NULL);
+	if (retval == ERROR_OK)
+		retval = nand_ecc_benchmark_run(CMD, "hamming, blocks", data, size,
+				256, ecc_blocks, 3, NULL, nand_calculate_ecc_blocks);
+	if (retval == ERROR_OK && memcmp(ecc, ecc_blocks, size / 256 * 3)) {
+		command_print(CMD, "hamming ECC mismatch");
+		retval = ERROR_FAIL;
+	}
+
+	if (retval == ERROR_OK)
+		retval = nand_ecc_benchmark_run(CMD, "reed-solomon, per block", data, size,
+				512, ecc, 10, nand_calculate_ecc_kw, NULL);
+	if (retval == ERROR_OK)
+		retval = nand_ecc_benchmark_run(CMD, "reed-solomon, blocks", data, size,
+				512, ecc_blocks, 10, NULL, nand_calculate_ecc_kw_blocks);
+	if (retval == ERROR_OK && memcmp(ecc, ecc_blocks, size / 512 * 10)) {
+		command_print(CMD, "reed-solomon ECC mismatch");
+		retval = ERROR_FAIL;
+	}
+
+	free(data);
+	free(ecc);
+	free(ecc_blocks);
+	return retval;
+}
+
 static const struct command_registration nand_config_command_handlers[] = {
 	{
 		.name = "device",
@@ -597,6 +764,14 @@ static const struct command_registration nand_config_command_handlers[] = {
 		.help = "initialize NAND devices",
 		.usage = ""
 	},
+	{
+		.name = "ecc_benchmark",
+		.handler = &handle_nand_ecc_benchmark_command,
+		.mode = COMMAND_ANY,
+		.help = "compare the throughput of the per block and batched "
+			"software ECC functions",
+		.usage = "[size_kib]",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
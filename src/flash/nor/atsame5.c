@@ -15,6 +15,7 @@
 
 #include "imp.h"
 #include "helper/binarybuffer.h"
+#include <helper/memscan.h>
 
 #include <helper/time_support.h>
 #include <jtag/jtag.h>
@@ -503,20 +504,14 @@ static int same5_modify_user_row_masked(struct target *target,
 	if (res != ERROR_OK)
 		return res;
 
-	/* Modify buffer and check if really changed */
-	bool changed = false;
-	uint32_t i;
-	for (i = 0; i < count; i++) {
-		uint8_t old_b = buf[offset+i];
-		uint8_t new_b = (old_b & ~mask[i]) | (data[i] & mask[i]);
-		buf[offset+i] = new_b;
-		if (old_b != new_b)
-			changed = true;
-	}
-
-	if (!changed)
+	/* Nothing to do if the user row already holds the bits to change */
+	if (memscan_first_mismatch_masked(buf + offset, data, mask, count) == count)
 		return ERROR_OK;
 
+	uint32_t i;
+	for (i = 0; i < count; i++)
+		buf[offset + i] = (buf[offset + i] & ~mask[i]) | (data[i] & mask[i]);
+
 	res = same5_pre_write_check(target);
 	if (res != ERROR_OK)
 		return res;
@@ -539,7 +534,20 @@ static int same5_modify_user_row_masked(struct target *target,
 			return res;
 	}
 
-	return res;
+	/* Verify the bits written, the others may be read-only */
+	res = target_read_memory(target, SAMD_USER_ROW, 4, page_size / 4, buf);
+	if (res != ERROR_OK)
+		return res;
+
+	size_t bad = memscan_first_mismatch_masked(buf + offset, data, mask, count);
+	if (bad != count) {
+		LOG_ERROR("User row verify failed at offset %" PRIu32 ": 0x%02" PRIx8
+			" instead of 0x%02" PRIx8 " (mask 0x%02" PRIx8 ")",
+			offset + (uint32_t)bad, buf[offset + bad], data[bad], mask[bad]);
+		return ERROR_FLASH_OPERATION_FAILED;
+	}
+
+	return ERROR_OK;
 }
 
 /**
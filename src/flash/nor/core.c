@@ -15,6 +15,7 @@
 #include <flash/common.h>
 #include <flash/nor/core.h>
 #include <flash/nor/imp.h>
+#include <helper/memscan.h>
 #include <target/image.h>
 
 /**
@@ -26,6 +27,10 @@
 
 static struct flash_bank *flash_banks;
 
+/* Amount of image data staged in host memory per erase/write/verify step of
+ * flash_write_unlock_verify(). Windows are extended to sector boundaries. */
+#define FLASH_WRITE_WINDOW_SIZE	(256 * 1024)
+
 int flash_driver_erase(struct flash_bank *bank, unsigned int first,
 		unsigned int last)
 {
@@ -333,8 +338,9 @@ int get_flash_bank_by_addr(struct target *target,
 static int default_flash_mem_blank_check(struct flash_bank *bank)
 {
 	struct target *target = bank->target;
-	const int buffer_size = 1024;
-	uint32_t n_bytes;
+	/* large enough to let the adapter queue full-size transfers;
+	 * the DAP layer splits it on TAR auto-increment boundaries */
+	const uint32_t buffer_size = 32 * 1024;
 	int retval = ERROR_OK;
 
 	if (bank->target->state != TARGET_HALTED) {
@@ -343,6 +349,10 @@ static int default_flash_mem_blank_check(struct flash_bank *bank)
 	}
 
 	uint8_t *buffer = malloc(buffer_size);
+	if (!buffer) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
 
 	for (unsigned int i = 0; i < bank->num_sectors; i++) {
 		uint32_t j;
@@ -362,11 +372,10 @@ static int default_flash_mem_blank_check(struct flash_bank *bank)
 			if (retval != ERROR_OK)
 				goto done;
 
-			for (n_bytes = 0; n_bytes < chunk; n_bytes++) {
-				if (buffer[n_bytes] != bank->erased_value) {
-					bank->sectors[i].is_erased = 0;
-					break;
-				}
+			if (!memscan_all_equal(buffer, bank->erased_value, chunk)) {
+				/* no need to read the rest of the sector */
+				bank->sectors[i].is_erased = 0;
+				break;
 			}
 		}
 	}
@@ -727,6 +736,39 @@ static bool flash_write_check_gap(struct flash_bank *bank,
 }
 
 
+/**
+ * Compute the size of the next streaming window of a flash run.
+ * The window is at least FLASH_WRITE_WINDOW_SIZE long (or the rest of the run)
+ * and is extended to the end of the sector containing its last byte,
+ * honouring the bank write end alignment. This keeps the erase, write and
+ * verify of consecutive windows on sector boundaries.
+ */
+static uint32_t flash_write_window_size(struct flash_bank *bank,
+				target_addr_t addr, uint32_t remaining)
+{
+	if (remaining <= FLASH_WRITE_WINDOW_SIZE)
+		return remaining;
+
+	target_addr_t window_end = addr + FLASH_WRITE_WINDOW_SIZE - 1;
+	uint32_t end_offset = window_end - bank->base;
+
+	for (unsigned int sect = 0; sect < bank->num_sectors; sect++) {
+		struct flash_sector *f = &bank->sectors[sect];
+		if (end_offset < f->offset + f->size) {
+			window_end = bank->base + f->offset + f->size - 1;
+			break;
+		}
+	}
+
+	if (bank->write_end_alignment)
+		window_end = flash_write_align_end(bank, window_end);
+
+	if (window_end - addr + 1 >= remaining)
+		return remaining;
+
+	return window_end - addr + 1;
+}
+
 int flash_write_unlock_verify(struct target *target, struct image *image,
 	uint32_t *written, bool erase, bool unlock, bool write, bool verify)
 {
@@ -736,6 +778,8 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 	uint32_t section_offset;
 	struct flash_bank *c;
 	int *padding;
+	uint8_t *buffer = NULL;
+	uint32_t buffer_size = 0;
 
 	section = 0;
 	section_offset = 0;
@@ -767,7 +811,6 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 	/* loop until we reach end of the image */
 	while (section < image->num_sections) {
 		uint32_t buffer_idx;
-		uint8_t *buffer;
 		unsigned int section_last;
 		target_addr_t run_address = sections[section]->base_address + section_offset;
 		uint32_t run_size = sections[section]->size - section_offset;
@@ -894,99 +937,117 @@ int flash_write_unlock_verify(struct target *target, struct image *image,
 			run_size += delta;
 		}
 
-		/* allocate buffer */
-		buffer = malloc(run_size);
-		if (!buffer) {
-			LOG_ERROR("Out of memory for flash bank buffer");
-			retval = ERROR_FAIL;
-			goto done;
-		}
-
-		if (padding_at_start)
-			memset(buffer, c->default_padded_value, padding_at_start);
-
-		buffer_idx = padding_at_start;
-
-		/* read sections to the buffer */
-		while (buffer_idx < run_size) {
-			size_t size_read;
-
-			size_read = run_size - buffer_idx;
-			if (size_read > sections[section]->size - section_offset)
-				size_read = sections[section]->size - section_offset;
+		retval = ERROR_OK;
 
-			/* KLUDGE!
-			 *
-			 * #¤%#"%¤% we have to figure out the section # from the sorted
-			 * list of pointers to sections to invoke image_read_section()...
-			 */
-			intptr_t diff = (intptr_t)sections[section] - (intptr_t)image->sections;
-			int t_section_num = diff / sizeof(struct imagesection);
-
-			LOG_DEBUG("image_read_section: section = %d, t_section_num = %d, "
-					"section_offset = %"PRIu32", buffer_idx = %"PRIu32", size_read = %zu",
-				section, t_section_num, section_offset,
-				buffer_idx, size_read);
-			retval = image_read_section(image, t_section_num, section_offset,
-					size_read, buffer + buffer_idx, &size_read);
-			if (retval != ERROR_OK || size_read == 0) {
-				free(buffer);
+		if (unlock) {
+			retval = flash_unlock_address_range(target, run_address, run_size);
+			if (retval != ERROR_OK)
 				goto done;
-			}
-
-			buffer_idx += size_read;
-			section_offset += size_read;
+		}
 
-			/* see if we need to pad the section */
-			if (padding[section]) {
-				memset(buffer + buffer_idx, c->default_padded_value, padding[section]);
-				buffer_idx += padding[section];
+		/* stream the run through the window buffer; padding at the start
+		 * of the run is emitted before the first section data */
+		uint32_t pad_pending = padding_at_start;
+		uint32_t run_offset = 0;
+
+		while (run_offset < run_size) {
+			target_addr_t window_address = run_address + run_offset;
+			uint32_t window_size = flash_write_window_size(c, window_address,
+					run_size - run_offset);
+
+			if (window_size > buffer_size) {
+				uint8_t *new_buffer = realloc(buffer, window_size);
+				if (!new_buffer) {
+					LOG_ERROR("Out of memory for flash bank buffer");
+					retval = ERROR_FAIL;
+					goto done;
+				}
+				buffer = new_buffer;
+				buffer_size = window_size;
 			}
 
-			if (section_offset >= sections[section]->size) {
-				section++;
-				section_offset = 0;
-			}
-		}
+			/* read sections to the buffer */
+			buffer_idx = 0;
+			while (buffer_idx < window_size) {
+				size_t size_read;
+
+				if (pad_pending) {
+					uint32_t pad_size = MIN(pad_pending, window_size - buffer_idx);
+					memset(buffer + buffer_idx, c->default_padded_value, pad_size);
+					buffer_idx += pad_size;
+					pad_pending -= pad_size;
+					continue;
+				}
 
-		retval = ERROR_OK;
+				size_read = window_size - buffer_idx;
+				if (size_read > sections[section]->size - section_offset)
+					size_read = sections[section]->size - section_offset;
+
+				/* KLUDGE!
+				 *
+				 * #¤%#"%¤% we have to figure out the section # from the sorted
+				 * list of pointers to sections to invoke image_read_section()...
+				 */
+				intptr_t diff = (intptr_t)sections[section] - (intptr_t)image->sections;
+				int t_section_num = diff / sizeof(struct imagesection);
+
+				LOG_DEBUG("image_read_section: section = %d, t_section_num = %d, "
+						"section_offset = %"PRIu32", buffer_idx = %"PRIu32", size_read = %zu",
+					section, t_section_num, section_offset,
+					buffer_idx, size_read);
+				retval = image_read_section(image, t_section_num, section_offset,
+						size_read, buffer + buffer_idx, &size_read);
+				if (retval != ERROR_OK || size_read == 0)
+					goto done;
+
+				buffer_idx += size_read;
+				section_offset += size_read;
+
+				/* see if we need to pad the section */
+				if (section_offset >= sections[section]->size) {
+					pad_pending = padding[section];
+					section++;
+					section_offset = 0;
+				}
+			}
 
-		if (unlock)
-			retval = flash_unlock_address_range(target, run_address, run_size);
-		if (retval == ERROR_OK) {
 			if (erase) {
-				/* calculate and erase sectors */
+				/* calculate and erase sectors of this window only, windows
+				 * end on sector boundaries so no sector is erased twice */
 				retval = flash_erase_address_range(target,
-						true, run_address, run_size);
+						true, window_address, window_size);
 			}
-		}
 
-		if (retval == ERROR_OK) {
-			if (write) {
-				/* write flash sectors */
-				retval = flash_driver_write(c, buffer, run_address - c->base, run_size);
+			if (retval == ERROR_OK) {
+				if (write) {
+					/* write flash sectors */
+					retval = flash_driver_write(c, buffer,
+							window_address - c->base, window_size);
+				}
 			}
-		}
 
-		if (retval == ERROR_OK) {
-			if (verify) {
-				/* verify flash sectors */
-				retval = flash_driver_verify(c, buffer, run_address - c->base, run_size);
+			if (retval == ERROR_OK) {
+				if (verify) {
+					/* verify flash sectors */
+					retval = flash_driver_verify(c, buffer,
+							window_address - c->base, window_size);
+				}
 			}
-		}
 
-		free(buffer);
+			if (retval != ERROR_OK) {
+				/* abort operation on the first bad window */
+				goto done;
+			}
 
-		if (retval != ERROR_OK) {
-			/* abort operation */
-			goto done;
-		}
+			run_offset += window_size;
 
-		if (written)
-			*written += run_size;	/* add run size to total written counter */
+			if (written)
+				*written += window_size;	/* add window size to total written counter */
+		}
 	}
 
 done:
+	free(buffer);
 	free(sections);
 	free(padding);
 
@@ -24,8 +24,11 @@
 
 #include "imp.h"
 #include "numicro_dap.h"
+#include <helper/align.h>
 #include <helper/binarybuffer.h>
 #include <helper/bits.h>
+#include <helper/crc32.h>
+#include <helper/time_support.h>
 #include <target/algorithm.h>
 #include <target/armv7m.h>
 
@@ -94,7 +97,9 @@
 #define ISPCTL_LDUEN		BIT(5)
 #define ISPCTL_ISPFF		BIT(6)
 #define FMC_MPSTS_MPBUSY	BIT(0)
+#define ISPCMD_READ_CKS		0x0DU
 #define ISPCMD_ERASE		0x22U
+#define ISPCMD_RUN_CKS		0x2DU
 #define ISPTRG_ISPGO		BIT(0)
 
 #define DHCSR_S_SDE			BIT(20)
@@ -1757,6 +1762,157 @@ static int numicro_dap_write(struct flash_bank *bank, const uint8_t *buffer, uin
 	return result;
 }
 
+/* Timeout of a single FMC checksum command, computed at flash read speed */
+#define NUMICRO_CKS_TIMEOUT_MS	1000
+
+static int numicro_dap_wait_isp(struct target *target, uint32_t fmc_isp_base, uint32_t reg_isp_busy)
+{
+	uint32_t status;
+	int64_t then = timeval_ms();
+
+	for (;;) {
+		int result = target_read_u32(target, fmc_isp_base + reg_isp_busy, &status);
+		if (result != ERROR_OK)
+			return result;
+
+		if ((status & FMC_MPSTS_MPBUSY) == 0)
+			break;
+
+		if (timeval_ms() - then > NUMICRO_CKS_TIMEOUT_MS) {
+			LOG_DEBUG("timed out waiting for flash");
+			return ERROR_FAIL;
+		}
+	}
+
+	/* check for failure, e.g. the ISP command is not implemented */
+	int result = target_read_u32(target, fmc_isp_base + NUMICRO_FLASH_ISPCTL, &status);
+	if (result != ERROR_OK)
+		return result;
+
+	if ((status & ISPCTL_ISPFF) != 0) {
+		LOG_DEBUG("failure: 0x%" PRIx32 "", status);
+		/* if bit is set, then must write to it to clear it. */
+		target_write_u32(target, fmc_isp_base + NUMICRO_FLASH_ISPCTL, (status | ISPCTL_ISPFF));
+		return ERROR_FLASH_OPERATION_FAILED;
+	}
+
+	return ERROR_OK;
+}
+
+/* Let the FMC compute the CRC32 of a page aligned flash range */
+static int numicro_dap_run_checksum(struct flash_bank *bank, uint32_t fmc_isp_base,
+		uint32_t reg_isp_busy, uint32_t address, uint32_t count, uint32_t *checksum)
+{
+	struct target *target = bank->target;
+
+	int result = numicro_init_isp(target, bank, fmc_isp_base);
+	if (result != ERROR_OK)
+		return result;
+
+	result = target_write_u32(target, fmc_isp_base + NUMICRO_FLASH_ISPCMD, ISPCMD_RUN_CKS);
+	if (result != ERROR_OK)
+		return result;
+	result = target_write_u32(target, fmc_isp_base + NUMICRO_FLASH_ISPADR, address);
+	if (result != ERROR_OK)
+		return result;
+	result = target_write_u32(target, fmc_isp_base + NUMICRO_FLASH_ISPDAT, count);
+	if (result != ERROR_OK)
+		return result;
+	result = target_write_u32(target, fmc_isp_base + NUMICRO_FLASH_ISPTRG, ISPTRG_ISPGO);
+	if (result != ERROR_OK)
+		return result;
+
+	result = numicro_dap_wait_isp(target, fmc_isp_base, reg_isp_busy);
+	if (result != ERROR_OK)
+		return result;
+
+	result = target_write_u32(target, fmc_isp_base + NUMICRO_FLASH_ISPCMD, ISPCMD_READ_CKS);
+	if (result != ERROR_OK)
+		return result;
+	result = target_write_u32(target, fmc_isp_base + NUMICRO_FLASH_ISPADR, address);
+	if (result != ERROR_OK)
+		return result;
+	result = target_write_u32(target, fmc_isp_base + NUMICRO_FLASH_ISPTRG, ISPTRG_ISPGO);
+	if (result != ERROR_OK)
+		return result;
+
+	result = numicro_dap_wait_isp(target, fmc_isp_base, reg_isp_busy);
+	if (result != ERROR_OK)
+		return result;
+
+	return target_read_u32(target, fmc_isp_base + NUMICRO_FLASH_ISPDAT, checksum);
+}
+
+static int numicro_dap_verify(struct flash_bank *bank, const uint8_t *buffer, uint32_t offset, uint32_t count)
+{
+	struct numicro_dap_flash_bank *flash_bank_info = bank->driver_priv;
+	uint32_t fmc_isp_base;
+	uint32_t reg_isp_busy;
+
+	/* only the FMC of these families implements the ISP checksum commands
+	 * through registers, the others use the generic on-target CRC routine */
+	switch (flash_bank_info->cpu->flash_type) {
+	case FLASH_TYPE_M4:
+	case FLASH_TYPE_M23:
+		fmc_isp_base = NUMICRO_FMC_BASE4;
+		reg_isp_busy = NUMICRO_FLASH_MPSTS;
+		break;
+	case FLASH_TYPE_M23_AHB5:
+		fmc_isp_base = NUMICRO_FMC_BASE;
+		reg_isp_busy = NUMICRO_FLASH_ISPTRG;
+		break;
+	case FLASH_TYPE_M55:
+		if (!flash_bank_info->secure_debug)
+			return default_flash_verify(bank, buffer, offset, count);
+		fmc_isp_base = NUMICRO_M55_FMC_BASE;
+		reg_isp_busy = NUMICRO_FLASH_ISPSTS;
+		break;
+	default:
+		return default_flash_verify(bank, buffer, offset, count);
+	}
+
+	/* the checksum engine works on whole pages, verify the unaligned
+	 * head and tail of the range with the generic method */
+	uint32_t page_size = flash_bank_info->cpu->page_size;
+	uint32_t cks_start = ALIGN_UP(offset, page_size);
+	uint32_t cks_end = ALIGN_DOWN(offset + count, page_size);
+	if (!page_size || cks_end <= cks_start)
+		return default_flash_verify(bank, buffer, offset, count);
+
+	int result;
+	if (cks_start > offset) {
+		result = default_flash_verify(bank, buffer, offset, cks_start - offset);
+		if (result != ERROR_OK)
+			return result;
+	}
+	if (offset + count > cks_end) {
+		result = default_flash_verify(bank, buffer + (cks_end - offset), cks_end,
+				offset + count - cks_end);
+		if (result != ERROR_OK)
+			return result;
+	}
+
+	const uint8_t *cks_buffer = buffer + (cks_start - offset);
+	uint32_t cks_count = cks_end - cks_start;
+	uint32_t target_crc;
+
+	result = numicro_dap_run_checksum(bank, fmc_isp_base, reg_isp_busy,
+			bank->base + cks_start, cks_count, &target_crc);
+	if (result == ERROR_OK) {
+		uint32_t image_crc = ~crc32_le(CRC32_POLY_LE, 0xffffffff, cks_buffer, cks_count);
+
+		LOG_DEBUG("addr " TARGET_ADDR_FMT ", len 0x%08" PRIx32 ", crc 0x%08" PRIx32 " 0x%08" PRIx32,
+			bank->base + cks_start, cks_count, image_crc, target_crc);
+		if (image_crc == target_crc)
+			return ERROR_OK;
+	}
+
+	/* a mismatch or a part without the command is confirmed by the
+	 * generic method, so that it is never reported as a false failure */
+	LOG_DEBUG("FMC checksum not usable, falling back to default verify");
+	return default_flash_verify(bank, cks_buffer, cks_start, cks_count);
+}
+
 static int numicro_dap_get_cpu_type(struct target *target, const struct numicro_dap_cpu_type **cpu, uint32_t part_id)
 {
 	/* search part numbers */
@@ -1905,6 +2061,7 @@ const struct flash_driver numicro_dap_flash = {
 	.protect				= numicro_dap_protect,
 	.write					= numicro_dap_write,
 	.read					= default_flash_read,
+	.verify					= numicro_dap_verify,
 	.probe					= numicro_dap_probe,
 	.auto_probe				= numicro_dap_auto_probe,
 	.erase_check			= numicro_dap_erase_check,
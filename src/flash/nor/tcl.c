@@ -11,6 +11,7 @@
 #include "config.h"
 #endif
 #include "imp.h"
+#include <helper/memscan.h>
 #include <helper/time_support.h>
 #include <target/image.h>
 
@@ -1024,11 +1025,9 @@ COMMAND_HANDLER(handle_flash_verify_bank_command)
 	differ = memcmp(buffer_file, buffer_flash, length);
 	command_print(CMD, "contents %s", differ ? "differ" : "match");
 	if (differ) {
-		uint32_t t;
+		uint32_t t = 0;
 		int diffs = 0;
-		for (t = 0; t < length; t++) {
-			if (buffer_flash[t] == buffer_file[t])
-				continue;
+		while ((t += memscan_first_mismatch(buffer_flash + t, buffer_file + t, length - t)) < length) {
 			command_print(CMD, "diff %d address 0x%08" PRIx32 ". Was 0x%02x instead of 0x%02x",
 					diffs, t + offset, buffer_flash[t], buffer_file[t]);
 			if (diffs++ >= 127) {
@@ -1036,6 +1035,7 @@ COMMAND_HANDLER(handle_flash_verify_bank_command)
 				break;
 			}
 			keep_alive();
+			t++;
 		}
 	}
 	free(buffer_flash);
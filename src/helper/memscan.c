@@ -0,0 +1,324 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "log.h"
+#include "memscan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define MEMSCAN_X86	1
+#include <immintrin.h>
+#else
+#define MEMSCAN_X86	0
+#endif
+
+#if defined(__GNUC__) && defined(__aarch64__) && defined(__ARM_NEON)
+#define MEMSCAN_NEON	1
+#include <arm_neon.h>
+#else
+#define MEMSCAN_NEON	0
+#endif
+
+struct memscan_ops {
+	const char *name;
+	size_t (*first_not_equal)(const uint8_t *buf, uint8_t value, size_t len);
+	size_t (*first_mismatch)(const uint8_t *a, const uint8_t *b, size_t len);
+	size_t (*first_mismatch_masked)(const uint8_t *a, const uint8_t *b,
+			const uint8_t *mask, size_t len);
+};
+
+/*
+ * Scalar kernels, comparing one machine word at a time and locating the
+ * differing byte inside the word with a byte loop. They are also used by
+ * the vector kernels to handle the tail of the buffers.
+ */
+
+static size_t scalar_first_not_equal(const uint8_t *buf, uint8_t value, size_t len)
+{
+	size_t pattern;
+	size_t i = 0;
+
+	memset(&pattern, value, sizeof(pattern));
+
+	for (; i + sizeof(size_t) <= len; i += sizeof(size_t)) {
+		size_t word;
+		memcpy(&word, buf + i, sizeof(word));
+		if (word != pattern)
+			break;
+	}
+
+	for (; i < len; i++)
+		if (buf[i] != value)
+			return i;
+
+	return len;
+}
+
+static size_t scalar_first_mismatch(const uint8_t *a, const uint8_t *b, size_t len)
+{
+	size_t i = 0;
+
+	for (; i + sizeof(size_t) <= len; i += sizeof(size_t)) {
+		size_t wa, wb;
+		memcpy(&wa, a + i, sizeof(wa));
+		memcpy(&wb, b + i, sizeof(wb));
+		if (wa != wb)
+			break;
+	}
+
+	for (; i < len; i++)
+		if (a[i] != b[i])
+			return i;
+
+	return len;
+}
+
+static size_t scalar_first_mismatch_masked(const uint8_t *a, const uint8_t *b,
+		const uint8_t *mask, size_t len)
+{
+	size_t i = 0;
+
+	for (; i + sizeof(size_t) <= len; i += sizeof(size_t)) {
+		size_t wa, wb, wm;
+		memcpy(&wa, a + i, sizeof(wa));
+		memcpy(&wb, b + i, sizeof(wb));
+		memcpy(&wm, mask + i, sizeof(wm));
+		if ((wa ^ wb) & wm)
+			break;
+	}
+
+	for (; i < len; i++)
+		if ((a[i] ^ b[i]) & mask[i])
+			return i;
+
+	return len;
+}
+
+#if !MEMSCAN_X86 && !MEMSCAN_NEON
+static const struct memscan_ops memscan_scalar_ops = {
+	.name = "scalar",
+	.first_not_equal = scalar_first_not_equal,
+	.first_mismatch = scalar_first_mismatch,
+	.first_mismatch_masked = scalar_first_mismatch_masked,
+};
+#endif
+
+#if MEMSCAN_X86
+/* SSE2 is part of the baseline of every x86 build defining __SSE2__ */
+
+static size_t sse2_first_not_equal(const uint8_t *buf, uint8_t value, size_t len)
+{
+	const __m128i pattern = _mm_set1_epi8((char)value);
+	size_t i = 0;
+
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(buf + i));
+		unsigned int eq = _mm_movemask_epi8(_mm_cmpeq_epi8(v, pattern));
+		if (eq != 0xffff)
+			return i + __builtin_ctz(~eq);
+	}
+
+	return i + scalar_first_not_equal(buf + i, value, len - i);
+}
+
+static size_t sse2_first_mismatch(const uint8_t *a, const uint8_t *b, size_t len)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= len; i += 16) {
+		__m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+		unsigned int eq = _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb));
+		if (eq != 0xffff)
+			return i + __builtin_ctz(~eq);
+	}
+
+	return i + scalar_first_mismatch(a + i, b + i, len - i);
+}
+
+static size_t sse2_first_mismatch_masked(const uint8_t *a, const uint8_t *b,
+		const uint8_t *mask, size_t len)
+{
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+
+	for (; i + 16 <= len; i += 16) {
+		__m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+		__m128i vm = _mm_loadu_si128((const __m128i *)(mask + i));
+		__m128i diff = _mm_and_si128(_mm_xor_si128(va, vb), vm);
+		unsigned int eq = _mm_movemask_epi8(_mm_cmpeq_epi8(diff, zero));
+		if (eq != 0xffff)
+			return i + __builtin_ctz(~eq);
+	}
+
+	return i + scalar_first_mismatch_masked(a + i, b + i, mask + i, len - i);
+}
+
+static const struct memscan_ops memscan_sse2_ops = {
+	.name = "sse2",
+	.first_not_equal = sse2_first_not_equal,
+	.first_mismatch = sse2_first_mismatch,
+	.first_mismatch_masked = sse2_first_mismatch_masked,
+};
+
+/* AVX2 kernels are built for the host and only used if the CPU has AVX2 */
+
+__attribute__((target("avx2")))
+static size_t avx2_first_not_equal(const uint8_t *buf, uint8_t value, size_t len)
+{
+	const __m256i pattern = _mm256_set1_epi8((char)value);
+	size_t i = 0;
+
+	for (; i + 32 <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(buf + i));
+		uint32_t eq = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, pattern));
+		if (eq != 0xffffffff)
+			return i + __builtin_ctz(~eq);
+	}
+
+	return i + sse2_first_not_equal(buf + i, value, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_first_mismatch(const uint8_t *a, const uint8_t *b, size_t len)
+{
+	size_t i = 0;
+
+	for (; i + 32 <= len; i += 32) {
+		__m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+		__m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+		uint32_t eq = _mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb));
+		if (eq != 0xffffffff)
+			return i + __builtin_ctz(~eq);
+	}
+
+	return i + sse2_first_mismatch(a + i, b + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_first_mismatch_masked(const uint8_t *a, const uint8_t *b,
+		const uint8_t *mask, size_t len)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	size_t i = 0;
+
+	for (; i + 32 <= len; i += 32) {
+		__m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+		__m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+		__m256i vm = _mm256_loadu_si256((const __m256i *)(mask + i));
+		__m256i diff = _mm256_and_si256(_mm256_xor_si256(va, vb), vm);
+		uint32_t eq = _mm256_movemask_epi8(_mm256_cmpeq_epi8(diff, zero));
+		if (eq != 0xffffffff)
+			return i + __builtin_ctz(~eq);
+	}
+
+	return i + sse2_first_mismatch_masked(a + i, b + i, mask + i, len - i);
+}
+
+static const struct memscan_ops memscan_avx2_ops = {
+	.name = "avx2",
+	.first_not_equal = avx2_first_not_equal,
+	.first_mismatch = avx2_first_mismatch,
+	.first_mismatch_masked = avx2_first_mismatch_masked,
+};
+#endif /* MEMSCAN_X86 */
+
+#if MEMSCAN_NEON
+/* NEON is mandatory on AArch64; a block with a difference is rescanned
+ * by the scalar kernel to find the exact offset */
+
+static size_t neon_first_not_equal(const uint8_t *buf, uint8_t value, size_t len)
+{
+	const uint8x16_t pattern = vdupq_n_u8(value);
+	size_t i = 0;
+
+	for (; i + 16 <= len; i += 16) {
+		uint8x16_t eq = vceqq_u8(vld1q_u8(buf + i), pattern);
+		if (vminvq_u8(eq) != 0xff)
+			break;
+	}
+
+	return i + scalar_first_not_equal(buf + i, value, len - i);
+}
+
+static size_t neon_first_mismatch(const uint8_t *a, const uint8_t *b, size_t len)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= len; i += 16) {
+		uint8x16_t eq = vceqq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+		if (vminvq_u8(eq) != 0xff)
+			break;
+	}
+
+	return i + scalar_first_mismatch(a + i, b + i, len - i);
+}
+
+static size_t neon_first_mismatch_masked(const uint8_t *a, const uint8_t *b,
+		const uint8_t *mask, size_t len)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= len; i += 16) {
+		uint8x16_t diff = vandq_u8(veorq_u8(vld1q_u8(a + i), vld1q_u8(b + i)),
+				vld1q_u8(mask + i));
+		if (vmaxvq_u8(diff) != 0)
+			break;
+	}
+
+	return i + scalar_first_mismatch_masked(a + i, b + i, mask + i, len - i);
+}
+
+static const struct memscan_ops memscan_neon_ops = {
+	.name = "neon",
+	.first_not_equal = neon_first_not_equal,
+	.first_mismatch = neon_first_mismatch,
+	.first_mismatch_masked = neon_first_mismatch_masked,
+};
+#endif /* MEMSCAN_NEON */
+
+static const struct memscan_ops *memscan_ops;
+
+static const struct memscan_ops *memscan_get_ops(void)
+{
+	/* selection is idempotent, a concurrent first call is harmless */
+	if (memscan_ops)
+		return memscan_ops;
+
+#if MEMSCAN_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		memscan_ops = &memscan_avx2_ops;
+	else
+		memscan_ops = &memscan_sse2_ops;
+#elif MEMSCAN_NEON
+	memscan_ops = &memscan_neon_ops;
+#else
+	memscan_ops = &memscan_scalar_ops;
+#endif
+
+	LOG_DEBUG("memscan: using the %s compare kernels", memscan_ops->name);
+
+	return memscan_ops;
+}
+
+size_t memscan_first_not_equal(const void *buf, uint8_t value, size_t len)
+{
+	return memscan_get_ops()->first_not_equal(buf, value, len);
+}
+
+size_t memscan_first_mismatch(const void *a, const void *b, size_t len)
+{
+	return memscan_get_ops()->first_mismatch(a, b, len);
+}
+
+size_t memscan_first_mismatch_masked(const void *a, const void *b,
+		const void *mask, size_t len)
+{
+	return memscan_get_ops()->first_mismatch_masked(a, b, mask, len);
+}
@@ -0,0 +1,51 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_HELPER_MEMSCAN_H
+#define OPENOCD_HELPER_MEMSCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file
+ * Host side memory compare kernels.
+ *
+ * Blank check and image verify compare large buffers read back from the
+ * target. These helpers locate the first differing byte using the widest
+ * vector unit the host CPU provides (AVX2, SSE2 or NEON, selected at
+ * runtime) and fall back to a word-wide scalar loop otherwise.
+ */
+
+/**
+ * Find the first byte of a buffer which differs from a given value.
+ * @param buf The buffer to scan
+ * @param value The expected value of every byte
+ * @param len The length of @p buf in bytes
+ * @return The offset of the first byte not equal to @p value,
+ *         or @p len if all bytes are equal to @p value
+ */
+size_t memscan_first_not_equal(const void *buf, uint8_t value, size_t len);
+
+/**
+ * Find the first byte where two buffers differ.
+ * @return The offset of the first differing byte, or @p len if the
+ *         buffers are identical
+ */
+size_t memscan_first_mismatch(const void *a, const void *b, size_t len);
+
+/**
+ * Find the first byte where two buffers differ in a bit set in @p mask.
+ * Bits cleared in @p mask are ignored in the comparison.
+ * @return The offset of the first differing byte, or @p len if the
+ *         buffers are identical under the mask
+ */
+size_t memscan_first_mismatch_masked(const void *a, const void *b,
+		const void *mask, size_t len);
+
+/** @returns true if all @p len bytes of @p buf are equal to @p value */
+static inline bool memscan_all_equal(const void *buf, uint8_t value, size_t len)
+{
+	return memscan_first_not_equal(buf, value, len) == len;
+}
+
+#endif /* OPENOCD_HELPER_MEMSCAN_H */
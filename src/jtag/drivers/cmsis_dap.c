@@ -1943,6 +1943,16 @@ static bool calculate_swo_prescaler(unsigned int traceclkin_freq,
 	return true;
 }
 
+/* Stops reading the streaming trace endpoint, if it was used */
+static void cmsis_dap_swo_stream_stop(void)
+{
+	if (!cmsis_dap_handle->swo_streaming)
+		return;
+
+	cmsis_dap_handle->backend->swo_stop(cmsis_dap_handle);
+	cmsis_dap_handle->swo_streaming = false;
+}
+
 /**
  * @see adapter_driver::config_trace
  */
@@ -1964,6 +1974,7 @@ static int cmsis_dap_config_trace(
 				return retval;
 			}
 		}
+		cmsis_dap_swo_stream_stop();
 		cmsis_dap_handle->trace_enabled = false;
 		LOG_INFO("SWO-trace disabled.");
 		return ERROR_OK;
@@ -1996,15 +2007,32 @@ static int cmsis_dap_config_trace(
 	if (retval != ERROR_OK)
 		return retval;
 
+	cmsis_dap_swo_stream_stop();
 	cmsis_dap_handle->trace_enabled = false;
 
 	retval = cmsis_dap_get_swo_buf_sz(&cmsis_dap_handle->swo_buf_sz);
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = cmsis_dap_cmd_dap_swo_transport(DAP_SWO_TRANSPORT_DATA);
-	if (retval != ERROR_OK)
-		return retval;
+	/* Prefer the dedicated trace endpoint, which doesn't compete with
+	 * debug commands, over DAP_SWO_Data polling */
+	if ((cmsis_dap_handle->caps & INFO_CAPS_SWO_STREAMING_TRACE) &&
+			cmsis_dap_handle->backend->swo_start &&
+			cmsis_dap_handle->backend->swo_start(cmsis_dap_handle) == ERROR_OK) {
+		retval = cmsis_dap_cmd_dap_swo_transport(DAP_SWO_TRANSPORT_WINUSB);
+		if (retval == ERROR_OK) {
+			cmsis_dap_handle->swo_streaming = true;
+			LOG_INFO("CMSIS-DAP: SWO streaming trace endpoint used");
+		} else {
+			cmsis_dap_handle->backend->swo_stop(cmsis_dap_handle);
+		}
+	}
+
+	if (!cmsis_dap_handle->swo_streaming) {
+		retval = cmsis_dap_cmd_dap_swo_transport(DAP_SWO_TRANSPORT_DATA);
+		if (retval != ERROR_OK)
+			return retval;
+	}
 
 	retval = cmsis_dap_cmd_dap_swo_mode(swo_mode);
 	if (retval != ERROR_OK)
@@ -2046,6 +2074,19 @@ static int cmsis_dap_poll_trace(uint8_t *buf, size_t *size)
 		return ERROR_OK;
 	}
 
+	if (cmsis_dap_handle->swo_streaming) {
+		int retval = cmsis_dap_handle->backend->swo_read(cmsis_dap_handle, buf, size);
+		if (retval == ERROR_OK)
+			return ERROR_OK;
+
+		/* the stream is broken for good, don't report it on every poll */
+		LOG_ERROR("SWO-trace stopped, configure it again to restart");
+		cmsis_dap_cmd_dap_swo_control(DAP_SWO_CONTROL_STOP);
+		cmsis_dap_swo_stream_stop();
+		cmsis_dap_handle->trace_enabled = false;
+		return retval;
+	}
+
 	int retval = cmsis_dap_cmd_dap_swo_status(&trace_status, &trace_count);
 	if (retval != ERROR_OK)
 		return retval;
@@ -3,6 +3,7 @@
 #ifndef OPENOCD_JTAG_DRIVERS_CMSIS_DAP_H
 #define OPENOCD_JTAG_DRIVERS_CMSIS_DAP_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 struct cmsis_dap_backend;
@@ -55,6 +56,8 @@ struct cmsis_dap {
 	uint8_t mode;
 	uint32_t swo_buf_sz;
 	bool trace_enabled;
+	/* SWO data comes from the backend's streaming endpoint */
+	bool swo_streaming;
 };
 
 struct cmsis_dap_backend {
@@ -64,6 +67,10 @@ struct cmsis_dap_backend {
 	int (*read)(struct cmsis_dap *dap, int timeout_ms);
 	int (*write)(struct cmsis_dap *dap, int len, int timeout_ms);
 	int (*packet_buffer_alloc)(struct cmsis_dap *dap, unsigned int pkt_sz);
+	/* optional SWO streaming trace, not provided by all backends */
+	int (*swo_start)(struct cmsis_dap *dap);
+	void (*swo_stop)(struct cmsis_dap *dap);
+	int (*swo_read)(struct cmsis_dap *dap, uint8_t *buf, size_t *size);
 };
 
 extern const struct cmsis_dap_backend cmsis_dap_hid_backend;
@@ -31,17 +31,40 @@
 
 #include "cmsis_dap.h"
 
+#ifndef LIBUSB_CALL
+#define LIBUSB_CALL
+#endif
+
+/* SWO streaming: bulk IN transfers kept queued on the trace endpoint */
+#define CMSIS_DAP_SWO_TRANSFERS			4
+#define CMSIS_DAP_SWO_TRANSFER_SIZE		(16 * 1024)
+#define CMSIS_DAP_SWO_RING_SIZE			(1024 * 1024)
+
 struct cmsis_dap_backend_data {
 	struct libusb_context *usb_ctx;
 	struct libusb_device_handle *dev_handle;
 	unsigned int ep_out;
 	unsigned int ep_in;
 	int interface;
+
+	/* optional SWO streaming trace endpoint, 0 if none */
+	unsigned int ep_swo;
+	bool swo_streaming;
+	bool swo_error;
+	unsigned int swo_active;
+	struct libusb_transfer *swo_transfers[CMSIS_DAP_SWO_TRANSFERS];
+	bool swo_busy[CMSIS_DAP_SWO_TRANSFERS];
+	/* trace data received but not yet polled */
+	uint8_t *swo_ring;
+	size_t swo_head;
+	size_t swo_count;
+	size_t swo_dropped;
 };
 
 static int cmsis_dap_usb_interface = -1;
 
 static void cmsis_dap_usb_close(struct cmsis_dap *dap);
+static void cmsis_dap_usb_swo_stop(struct cmsis_dap *dap);
 static int cmsis_dap_usb_alloc(struct cmsis_dap *dap, unsigned int pkt_sz);
 
 static int cmsis_dap_usb_open(struct cmsis_dap *dap, uint16_t vids[], uint16_t pids[], const char *serial)
@@ -313,6 +336,13 @@ static int cmsis_dap_usb_open(struct cmsis_dap *dap, uint16_t vids[], uint16_t p
 			int packet_size = intf_desc_found->endpoint[0].wMaxPacketSize;
 			int ep_out = intf_desc_found->endpoint[0].bEndpointAddress;
 			int ep_in = intf_desc_found->endpoint[1].bEndpointAddress;
+			int ep_swo = 0;
+
+			/* the optional third endpoint streams SWO trace */
+			if (intf_desc_found->bNumEndpoints >= 3 &&
+					(intf_desc_found->endpoint[2].bmAttributes & 3) == LIBUSB_TRANSFER_TYPE_BULK &&
+					(intf_desc_found->endpoint[2].bEndpointAddress & 0x80) == LIBUSB_ENDPOINT_IN)
+				ep_swo = intf_desc_found->endpoint[2].bEndpointAddress;
 
 			libusb_free_config_descriptor(config_desc);
 			libusb_free_device_list(device_list, true);
@@ -343,7 +373,7 @@ static int cmsis_dap_usb_open(struct cmsis_dap *dap, uint16_t vids[], uint16_t p
 			if (err)
 				LOG_WARNING("could not claim interface: %s", libusb_strerror(err));
 
-			dap->bdata = malloc(sizeof(struct cmsis_dap_backend_data));
+			dap->bdata = calloc(1, sizeof(struct cmsis_dap_backend_data));
 			if (!dap->bdata) {
 				LOG_ERROR("unable to allocate memory");
 				libusb_release_interface(dev_handle, interface_num);
@@ -357,6 +387,9 @@ static int cmsis_dap_usb_open(struct cmsis_dap *dap, uint16_t vids[], uint16_t p
 			dap->bdata->ep_out = ep_out;
 			dap->bdata->ep_in = ep_in;
 			dap->bdata->interface = interface_num;
+			dap->bdata->ep_swo = ep_swo;
+			if (ep_swo)
+				LOG_DEBUG("SWO streaming endpoint 0x%02x", ep_swo);
 
 			err = cmsis_dap_usb_alloc(dap, packet_size);
 			if (err != ERROR_OK)
@@ -376,6 +409,7 @@ static int cmsis_dap_usb_open(struct cmsis_dap *dap, uint16_t vids[], uint16_t p
 
 static void cmsis_dap_usb_close(struct cmsis_dap *dap)
 {
+	cmsis_dap_usb_swo_stop(dap);
 	libusb_release_interface(dap->bdata->dev_handle, dap->bdata->interface);
 	libusb_close(dap->bdata->dev_handle);
 	libusb_exit(dap->bdata->usb_ctx);
@@ -446,6 +480,183 @@ static int cmsis_dap_usb_alloc(struct cmsis_dap *dap, unsigned int pkt_sz)
 	return ERROR_OK;
 }
 
+/* Appends the data of a completed trace transfer to the ring buffer,
+ * then queues the transfer again. Runs from libusb event handling, i.e.
+ * also while the command endpoint is busy with debug traffic. */
+static void LIBUSB_CALL cmsis_dap_usb_swo_callback(struct libusb_transfer *transfer)
+{
+	struct cmsis_dap_backend_data *bdata = transfer->user_data;
+	unsigned int index = 0;
+
+	while (index < CMSIS_DAP_SWO_TRANSFERS && bdata->swo_transfers[index] != transfer)
+		index++;
+
+	/* a transfer given up by cmsis_dap_usb_swo_stop(), its data is dropped */
+	if (index == CMSIS_DAP_SWO_TRANSFERS) {
+		libusb_free_transfer(transfer);
+		return;
+	}
+
+	if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
+		size_t len = transfer->actual_length;
+		size_t space = CMSIS_DAP_SWO_RING_SIZE - bdata->swo_count;
+
+		if (len > space) {
+			bdata->swo_dropped += len - space;
+			len = space;
+		}
+
+		for (size_t i = 0; i < len; ) {
+			size_t pos = (bdata->swo_head + bdata->swo_count) % CMSIS_DAP_SWO_RING_SIZE;
+			size_t chunk = MIN(len - i, CMSIS_DAP_SWO_RING_SIZE - pos);
+
+			memcpy(&bdata->swo_ring[pos], &transfer->buffer[i], chunk);
+			bdata->swo_count += chunk;
+			i += chunk;
+		}
+	} else if (transfer->status != LIBUSB_TRANSFER_CANCELLED) {
+		bdata->swo_error = true;
+	}
+
+	if (bdata->swo_streaming && !bdata->swo_error) {
+		if (libusb_submit_transfer(transfer) == LIBUSB_SUCCESS)
+			return;
+		bdata->swo_error = true;
+	}
+
+	bdata->swo_busy[index] = false;
+	bdata->swo_active--;
+}
+
+static int cmsis_dap_usb_swo_start(struct cmsis_dap *dap)
+{
+	struct cmsis_dap_backend_data *bdata = dap->bdata;
+
+	if (!bdata->ep_swo)
+		return ERROR_NOT_IMPLEMENTED;
+
+	if (bdata->swo_streaming) {
+		if (!bdata->swo_error)
+			return ERROR_OK;
+		/* restart after a failed transfer */
+		cmsis_dap_usb_swo_stop(dap);
+	}
+
+	bdata->swo_ring = malloc(CMSIS_DAP_SWO_RING_SIZE);
+	if (!bdata->swo_ring) {
+		LOG_ERROR("unable to allocate SWO trace buffer");
+		return ERROR_FAIL;
+	}
+
+	bdata->swo_head = 0;
+	bdata->swo_count = 0;
+	bdata->swo_dropped = 0;
+	bdata->swo_error = false;
+	bdata->swo_streaming = true;
+
+	for (unsigned int i = 0; i < CMSIS_DAP_SWO_TRANSFERS; i++) {
+		struct libusb_transfer *transfer = libusb_alloc_transfer(0);
+		uint8_t *buf = malloc(CMSIS_DAP_SWO_TRANSFER_SIZE);
+
+		if (!transfer || !buf) {
+			LOG_ERROR("unable to allocate SWO transfer");
+			libusb_free_transfer(transfer);
+			free(buf);
+			cmsis_dap_usb_swo_stop(dap);
+			return ERROR_FAIL;
+		}
+
+		libusb_fill_bulk_transfer(transfer, bdata->dev_handle, bdata->ep_swo,
+				buf, CMSIS_DAP_SWO_TRANSFER_SIZE, cmsis_dap_usb_swo_callback, bdata, 0);
+		transfer->flags = LIBUSB_TRANSFER_FREE_BUFFER;
+		bdata->swo_transfers[i] = transfer;
+
+		int err = libusb_submit_transfer(transfer);
+		if (err) {
+			LOG_ERROR("could not queue SWO transfer: %s", libusb_strerror(err));
+			cmsis_dap_usb_swo_stop(dap);
+			return ERROR_FAIL;
+		}
+		bdata->swo_busy[i] = true;
+		bdata->swo_active++;
+	}
+
+	return ERROR_OK;
+}
+
+static void cmsis_dap_usb_swo_stop(struct cmsis_dap *dap)
+{
+	struct cmsis_dap_backend_data *bdata = dap->bdata;
+
+	if (!bdata || !bdata->swo_streaming)
+		return;
+
+	bdata->swo_streaming = false;
+
+	for (unsigned int i = 0; i < CMSIS_DAP_SWO_TRANSFERS; i++)
+		if (bdata->swo_transfers[i])
+			libusb_cancel_transfer(bdata->swo_transfers[i]);
+
+	/* wait for the callbacks of the cancelled transfers */
+	for (unsigned int tries = 0; bdata->swo_active && tries < 10; tries++) {
+		struct timeval tv = { .tv_sec = 0, .tv_usec = 100000 };
+		libusb_handle_events_timeout_completed(bdata->usb_ctx, &tv, NULL);
+	}
+
+	/* the transfers still in flight are no longer owned: their callback
+	 * frees them without touching the ring buffer */
+	if (bdata->swo_active)
+		LOG_WARNING("%u SWO transfers not cancelled", bdata->swo_active);
+
+	for (unsigned int i = 0; i < CMSIS_DAP_SWO_TRANSFERS; i++) {
+		struct libusb_transfer *transfer = bdata->swo_transfers[i];
+
+		bdata->swo_transfers[i] = NULL;
+		if (transfer && !bdata->swo_busy[i])
+			libusb_free_transfer(transfer);
+		bdata->swo_busy[i] = false;
+	}
+
+	bdata->swo_active = 0;
+	free(bdata->swo_ring);
+	bdata->swo_ring = NULL;
+	bdata->swo_count = 0;
+}
+
+static int cmsis_dap_usb_swo_read(struct cmsis_dap *dap, uint8_t *buf, size_t *size)
+{
+	struct cmsis_dap_backend_data *bdata = dap->bdata;
+	struct timeval tv = { .tv_sec = 0, .tv_usec = 0 };
+
+	/* collect the transfers completed since the last poll */
+	libusb_handle_events_timeout_completed(bdata->usb_ctx, &tv, NULL);
+
+	/* hand out the data received before the failure, then report it */
+	if (bdata->swo_error && !bdata->swo_count) {
+		LOG_ERROR("SWO streaming transfer failed");
+		*size = 0;
+		return ERROR_FAIL;
+	}
+
+	if (bdata->swo_dropped) {
+		LOG_WARNING("SWO trace buffer overrun, %zu bytes dropped", bdata->swo_dropped);
+		bdata->swo_dropped = 0;
+	}
+
+	size_t len = MIN(*size, bdata->swo_count);
+	for (size_t i = 0; i < len; ) {
+		size_t chunk = MIN(len - i, CMSIS_DAP_SWO_RING_SIZE - bdata->swo_head);
+
+		memcpy(&buf[i], &bdata->swo_ring[bdata->swo_head], chunk);
+		bdata->swo_head = (bdata->swo_head + chunk) % CMSIS_DAP_SWO_RING_SIZE;
+		bdata->swo_count -= chunk;
+		i += chunk;
+	}
+
+	*size = len;
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(cmsis_dap_handle_usb_interface_command)
 {
 	if (CMD_ARGC == 1)
@@ -474,4 +685,7 @@ const struct cmsis_dap_backend cmsis_dap_usb_backend = {
 	.read = cmsis_dap_usb_read,
 	.write = cmsis_dap_usb_write,
 	.packet_buffer_alloc = cmsis_dap_usb_alloc,
+	.swo_start = cmsis_dap_usb_swo_start,
+	.swo_stop = cmsis_dap_usb_swo_stop,
+	.swo_read = cmsis_dap_usb_swo_read,
 };
@@ -0,0 +1,532 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * DAP replay adapter: serves back a recording made with "<dap> record",
+ * without any hardware. Read values, results and reconnect requests come
+ * from the recording; the transactions issued by OpenOCD are checked
+ * against it and the replay fails at the first divergence.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/types.h>
+#include <helper/system.h>
+#include <helper/time_support.h>
+#include <jtag/interface.h>
+#include <target/arm_adi_v5.h>
+#include <target/adi_v5_record.h>
+#include <transport/transport.h>
+
+static char *dap_replay_filename;
+static bool dap_replay_latency;
+
+/* the whole recording, loaded at connect */
+static uint8_t *dap_replay_buf;
+static size_t dap_replay_size;
+static size_t dap_replay_pos;
+static bool dap_replay_failed;
+static uint64_t dap_replay_records;
+
+struct dap_replay_record {
+	uint8_t type;
+	uint16_t reg;
+	uint64_t ap_num;
+	uint32_t value;
+	int retval;
+	uint8_t flags;
+	uint32_t duration_us;
+};
+
+static const char *dap_replay_type_name(uint8_t type)
+{
+	static const char * const names[] = {
+		[DAP_RECORD_DP_READ] = "DP read",
+		[DAP_RECORD_DP_WRITE] = "DP write",
+		[DAP_RECORD_AP_READ] = "AP read",
+		[DAP_RECORD_AP_WRITE] = "AP write",
+		[DAP_RECORD_ABORT] = "abort",
+		[DAP_RECORD_RUN] = "run",
+		[DAP_RECORD_SYNC] = "sync",
+		[DAP_RECORD_CONNECT] = "connect",
+		[DAP_RECORD_CONNECTED] = "end of connect",
+		[DAP_RECORD_SEQUENCE] = "sequence",
+		[DAP_RECORD_QUEUE_ERROR] = "queue error",
+		[DAP_RECORD_DP_READ_NO_VALUE] = "DP read",
+		[DAP_RECORD_AP_READ_NO_VALUE] = "AP read",
+	};
+
+	if (type < ARRAY_SIZE(names) && names[type])
+		return names[type];
+	return "unknown record";
+}
+
+static int dap_replay_load(void)
+{
+	if (dap_replay_buf)
+		return ERROR_OK;
+
+	if (!dap_replay_filename) {
+		LOG_ERROR("no DAP recording, use 'dap_replay file'");
+		return ERROR_FAIL;
+	}
+
+	FILE *f = fopen(dap_replay_filename, "rb");
+	if (!f) {
+		LOG_ERROR("can't open DAP recording %s", dap_replay_filename);
+		return ERROR_FAIL;
+	}
+
+	size_t size = 0, capacity = 0;
+	uint8_t *buf = NULL;
+	for (;;) {
+		if (size == capacity) {
+			capacity = capacity ? 2 * capacity : 64 * 1024;
+			uint8_t *p = realloc(buf, capacity);
+			if (!p) {
+				LOG_ERROR("Out of memory");
+				free(buf);
+				fclose(f);
+				return ERROR_FAIL;
+			}
+			buf = p;
+		}
+		size_t n = fread(buf + size, 1, capacity - size, f);
+		if (n == 0)
+			break;
+		size += n;
+	}
+	fclose(f);
+
+	if (size < DAP_RECORD_MAGIC_SIZE || memcmp(buf, DAP_RECORD_MAGIC, DAP_RECORD_MAGIC_SIZE)) {
+		LOG_ERROR("%s is not a DAP recording", dap_replay_filename);
+		free(buf);
+		return ERROR_FAIL;
+	}
+
+	dap_replay_buf = buf;
+	dap_replay_size = size;
+	dap_replay_pos = DAP_RECORD_MAGIC_SIZE;
+	dap_replay_failed = false;
+	dap_replay_records = 0;
+
+	return ERROR_OK;
+}
+
+/* decodes the record at the current position, without consuming it */
+static bool dap_replay_peek(struct dap_replay_record *rec, size_t *next)
+{
+	if (dap_replay_pos >= dap_replay_size)
+		return false;
+
+	const uint8_t *p = dap_replay_buf + dap_replay_pos;
+	uint8_t type = p[0];
+	unsigned int size = dap_record_size(type);
+
+	if ((size == 0 && type != DAP_RECORD_CONNECT) ||
+			dap_replay_pos + 1 + size > dap_replay_size)
+		return false;
+
+	memset(rec, 0, sizeof(*rec));
+	rec->type = type;
+	p++;
+
+	switch (type) {
+	case DAP_RECORD_AP_READ:
+	case DAP_RECORD_AP_WRITE:
+	case DAP_RECORD_AP_READ_NO_VALUE:
+		rec->ap_num = le_to_h_u64(p);
+		p += 8;
+		/* fall through */
+	case DAP_RECORD_DP_READ:
+	case DAP_RECORD_DP_WRITE:
+	case DAP_RECORD_DP_READ_NO_VALUE:
+		rec->reg = le_to_h_u16(p);
+		rec->value = le_to_h_u32(p + 2);
+		break;
+	case DAP_RECORD_ABORT:
+		rec->value = p[0];
+		break;
+	case DAP_RECORD_RUN:
+	case DAP_RECORD_SYNC:
+		rec->retval = (int32_t)le_to_h_u32(p);
+		rec->flags = p[4];
+		rec->duration_us = le_to_h_u32(p + 13);
+		break;
+	case DAP_RECORD_CONNECTED:
+	case DAP_RECORD_QUEUE_ERROR:
+		rec->retval = (int32_t)le_to_h_u32(p);
+		break;
+	case DAP_RECORD_SEQUENCE:
+		rec->value = p[0];
+		rec->retval = (int32_t)le_to_h_u32(p + 1);
+		break;
+	}
+
+	*next = dap_replay_pos + 1 + size;
+	return true;
+}
+
+static int dap_replay_diverged(const char *expected, const struct dap_replay_record *rec)
+{
+	if (!dap_replay_failed) {
+		if (rec)
+			LOG_ERROR("DAP replay diverged at offset %zu (record %" PRIu64 "): "
+				"%s issued, %s recorded", dap_replay_pos, dap_replay_records,
+				expected, dap_replay_type_name(rec->type));
+		else
+			LOG_ERROR("DAP replay: %s issued after the end of the recording (%" PRIu64
+				" records)", expected, dap_replay_records);
+	}
+
+	dap_replay_failed = true;
+	return ERROR_FAIL;
+}
+
+static int dap_replay_check_reconnect(struct adiv5_dap *dap);
+
+/* a read is also served by a record of the same read without value */
+static bool dap_replay_type_matches(uint8_t type, uint8_t recorded)
+{
+	if (recorded == type)
+		return true;
+
+	return (type == DAP_RECORD_DP_READ && recorded == DAP_RECORD_DP_READ_NO_VALUE)
+		|| (type == DAP_RECORD_AP_READ && recorded == DAP_RECORD_AP_READ_NO_VALUE);
+}
+
+/*
+ * Consumes the next record, which must be of the given type. Runs the
+ * transport did on its own (e.g. to limit the queue size) are skipped.
+ */
+static int dap_replay_next(struct adiv5_dap *dap, uint8_t type, struct dap_replay_record *rec)
+{
+	size_t next;
+
+	if (dap_replay_failed)
+		return ERROR_FAIL;
+
+	for (;;) {
+		if (!dap_replay_peek(rec, &next))
+			return dap_replay_diverged(dap_replay_type_name(type), NULL);
+
+		if (dap_replay_type_matches(type, rec->type))
+			break;
+
+		if (rec->type != DAP_RECORD_RUN || type == DAP_RECORD_SYNC)
+			return dap_replay_diverged(dap_replay_type_name(type), rec);
+
+		/* implicit run, inside a queue operation */
+		dap_replay_pos = next;
+		dap_replay_records++;
+		if (rec->retval != ERROR_OK)
+			return rec->retval;
+	}
+
+	dap_replay_pos = next;
+	dap_replay_records++;
+	return ERROR_OK;
+}
+
+/* a failed queue operation is followed by its result */
+static int dap_replay_queue_result(void)
+{
+	struct dap_replay_record rec;
+	size_t next;
+
+	if (dap_replay_peek(&rec, &next) && rec.type == DAP_RECORD_QUEUE_ERROR) {
+		dap_replay_pos = next;
+		dap_replay_records++;
+		return rec.retval;
+	}
+
+	return ERROR_OK;
+}
+
+static int dap_replay_queue_read(struct adiv5_dap *dap, uint8_t type, uint64_t ap_num,
+		unsigned int reg, uint32_t *data)
+{
+	struct dap_replay_record rec;
+
+	int retval = dap_replay_check_reconnect(dap);
+	if (retval == ERROR_OK)
+		retval = dap_replay_next(dap, type, &rec);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (rec.reg != reg || rec.ap_num != ap_num) {
+		LOG_ERROR("DAP replay: %s of AP 0x%" PRIx64 " reg 0x%x, recorded AP 0x%" PRIx64 " reg 0x%x",
+			dap_replay_type_name(type), ap_num, reg, rec.ap_num, rec.reg);
+		dap_replay_failed = true;
+		return ERROR_FAIL;
+	}
+
+	/* valid once the queue is run, as far as the caller is concerned; a
+	 * read the adapter did not complete leaves the destination alone */
+	if (data && rec.type == type)
+		*data = rec.value;
+
+	return dap_replay_queue_result();
+}
+
+static int dap_replay_queue_write(struct adiv5_dap *dap, uint8_t type, uint64_t ap_num,
+		unsigned int reg, uint32_t data)
+{
+	struct dap_replay_record rec;
+
+	int retval = dap_replay_check_reconnect(dap);
+	if (retval == ERROR_OK)
+		retval = dap_replay_next(dap, type, &rec);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (rec.reg != reg || rec.ap_num != ap_num || rec.value != data) {
+		LOG_ERROR("DAP replay: %s of 0x%08" PRIx32 " to AP 0x%" PRIx64 " reg 0x%x, "
+			"recorded 0x%08" PRIx32 " to AP 0x%" PRIx64 " reg 0x%x",
+			dap_replay_type_name(type), data, ap_num, reg, rec.value, rec.ap_num, rec.reg);
+		dap_replay_failed = true;
+		return ERROR_FAIL;
+	}
+
+	return dap_replay_queue_result();
+}
+
+static int dap_replay_dp_q_read(struct adiv5_dap *dap, unsigned int reg, uint32_t *data)
+{
+	return dap_replay_queue_read(dap, DAP_RECORD_DP_READ, 0, reg, data);
+}
+
+static int dap_replay_dp_q_write(struct adiv5_dap *dap, unsigned int reg, uint32_t data)
+{
+	return dap_replay_queue_write(dap, DAP_RECORD_DP_WRITE, 0, reg, data);
+}
+
+static int dap_replay_ap_q_read(struct adiv5_ap *ap, unsigned int reg, uint32_t *data)
+{
+	return dap_replay_queue_read(ap->dap, DAP_RECORD_AP_READ, ap->ap_num, reg, data);
+}
+
+static int dap_replay_ap_q_write(struct adiv5_ap *ap, unsigned int reg, uint32_t data)
+{
+	return dap_replay_queue_write(ap->dap, DAP_RECORD_AP_WRITE, ap->ap_num, reg, data);
+}
+
+static int dap_replay_ap_q_abort(struct adiv5_dap *dap, uint8_t *ack)
+{
+	struct dap_replay_record rec;
+
+	int retval = dap_replay_next(dap, DAP_RECORD_ABORT, &rec);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (ack)
+		*ack = rec.value;
+
+	return dap_replay_queue_result();
+}
+
+static int dap_replay_run_common(struct adiv5_dap *dap, uint8_t type)
+{
+	struct dap_replay_record rec;
+
+	int retval = dap_replay_check_reconnect(dap);
+	if (retval == ERROR_OK)
+		retval = dap_replay_next(dap, type, &rec);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (dap_replay_latency && rec.duration_us)
+		jtag_sleep(rec.duration_us);
+
+	dap->do_reconnect = rec.flags & DAP_RECORD_FLAG_RECONNECT;
+
+	return rec.retval;
+}
+
+static int dap_replay_run(struct adiv5_dap *dap)
+{
+	return dap_replay_run_common(dap, DAP_RECORD_RUN);
+}
+
+static int dap_replay_sync(struct adiv5_dap *dap)
+{
+	return dap_replay_run_common(dap, DAP_RECORD_SYNC);
+}
+
+static int dap_replay_send_sequence(struct adiv5_dap *dap, enum swd_special_seq seq)
+{
+	struct dap_replay_record rec;
+
+	int retval = dap_replay_next(dap, DAP_RECORD_SEQUENCE, &rec);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (rec.value != seq)
+		LOG_WARNING("DAP replay: sequence %d sent, %" PRIu32 " recorded", seq, rec.value);
+
+	return rec.retval;
+}
+
+/*
+ * Like the SWD and JTAG transports, connecting initializes the DP through
+ * the DAP operations, which replays the transactions recorded then.
+ */
+static int dap_replay_connect(struct adiv5_dap *dap)
+{
+	struct dap_replay_record rec;
+	size_t next;
+
+	int retval = dap_replay_load();
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* a recording started after init has no connect */
+	if (!dap_replay_peek(&rec, &next) || rec.type != DAP_RECORD_CONNECT) {
+		dap->do_reconnect = false;
+		return ERROR_OK;
+	}
+
+	retval = dap_replay_next(dap, DAP_RECORD_CONNECT, &rec);
+	if (retval != ERROR_OK)
+		return retval;
+
+	dap->do_reconnect = false;
+	dap_dp_init(dap);
+
+	retval = dap_replay_next(dap, DAP_RECORD_CONNECTED, &rec);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return rec.retval;
+}
+
+static int dap_replay_check_reconnect(struct adiv5_dap *dap)
+{
+	if (!dap->do_reconnect)
+		return ERROR_OK;
+
+	dap->do_reconnect = false;
+	return dap_dp_init(dap);
+}
+
+static void dap_replay_disconnect(struct adiv5_dap *dap)
+{
+	if (dap_replay_buf)
+		LOG_INFO("DAP replay: %" PRIu64 " records replayed%s, %zu bytes left",
+			dap_replay_records, dap_replay_failed ? " before divergence" : "",
+			dap_replay_size - dap_replay_pos);
+
+	free(dap_replay_buf);
+	dap_replay_buf = NULL;
+}
+
+COMMAND_HANDLER(dap_replay_file_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	free(dap_replay_filename);
+	dap_replay_filename = strdup(CMD_ARGV[0]);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(dap_replay_latency_command)
+{
+	return CALL_COMMAND_HANDLER(handle_command_parse_bool, &dap_replay_latency,
+		"replay of the recorded run durations");
+}
+
+static const struct command_registration dap_replay_subcommand_handlers[] = {
+	{
+		.name = "file",
+		.handler = dap_replay_file_command,
+		.mode = COMMAND_CONFIG,
+		.help = "set the DAP recording to replay",
+		.usage = "filename",
+	},
+	{
+		.name = "latency",
+		.handler = dap_replay_latency_command,
+		.mode = COMMAND_ANY,
+		.help = "wait as long as each recorded run took",
+		.usage = "['on'|'off']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const struct command_registration dap_replay_command_handlers[] = {
+	{
+		.name = "dap_replay",
+		.mode = COMMAND_ANY,
+		.help = "perform dap_replay management",
+		.chain = dap_replay_subcommand_handlers,
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static int dap_replay_init(void)
+{
+	return ERROR_OK;
+}
+
+static int dap_replay_quit(void)
+{
+	free(dap_replay_filename);
+	dap_replay_filename = NULL;
+	return ERROR_OK;
+}
+
+static int dap_replay_reset(int req_trst, int req_srst)
+{
+	return ERROR_OK;
+}
+
+static int dap_replay_speed(int speed)
+{
+	return ERROR_OK;
+}
+
+static int dap_replay_khz(int khz, int *jtag_speed)
+{
+	*jtag_speed = khz;
+	return ERROR_OK;
+}
+
+static int dap_replay_speed_div(int speed, int *khz)
+{
+	*khz = speed;
+	return ERROR_OK;
+}
+
+static const struct dap_ops dap_replay_ops = {
+	.connect = dap_replay_connect,
+	.send_sequence = dap_replay_send_sequence,
+	.queue_dp_read = dap_replay_dp_q_read,
+	.queue_dp_write = dap_replay_dp_q_write,
+	.queue_ap_read = dap_replay_ap_q_read,
+	.queue_ap_write = dap_replay_ap_q_write,
+	.queue_ap_abort = dap_replay_ap_q_abort,
+	.run = dap_replay_run,
+	.sync = dap_replay_sync,
+	.quit = dap_replay_disconnect,
+};
+
+static const char *const dap_replay_transport[] = { "dapdirect_swd", "dapdirect_jtag", NULL };
+
+struct adapter_driver dap_replay_adapter_driver = {
+	.name = "dap_replay",
+	.transports = dap_replay_transport,
+	.commands = dap_replay_command_handlers,
+
+	.init = dap_replay_init,
+	.quit = dap_replay_quit,
+	.reset = dap_replay_reset,
+	.speed = dap_replay_speed,
+	.khz = dap_replay_khz,
+	.speed_div = dap_replay_speed_div,
+
+	.dap_jtag_ops = &dap_replay_ops,
+	.dap_swd_ops = &dap_replay_ops,
+};
@@ -37,6 +37,28 @@
 #define CMD_SCAN_CHAIN		2
 #define CMD_SCAN_CHAIN_FLIP_TMS	3
 #define CMD_STOP_SIMU		4
+#define CMD_BATCH_QUERY		5
+#define CMD_BATCH		6
+
+/*
+ * Batched protocol, negotiated at connect with CMD_BATCH_QUERY: a vpi_cmd
+ * with length = BATCH_VERSION and nb_bits = the largest message the client
+ * sends, answered with the server's version and largest message. Servers
+ * not answering within BATCH_QUERY_TIMEOUT_MS get the per-command protocol.
+ *
+ * A CMD_BATCH message is a header of three little endian u32 (CMD_BATCH,
+ * payload length, operation count) followed by the operations, each made
+ * of a command byte, an u32 bit count and the TDI/TMS bytes. Scans without
+ * BATCH_NO_TDO in their command byte return their TDO bytes, concatenated
+ * in the reply: the same header, the TDO length, then the TDO bytes.
+ */
+#define BATCH_VERSION		1
+#define BATCH_HEADER_SIZE	12
+#define BATCH_OP_HEADER_SIZE	5
+#define BATCH_NO_TDO		0x80
+#define BATCH_MAX_SIZE		(64 * 1024)
+#define BATCH_MIN_SIZE		(BATCH_HEADER_SIZE + BATCH_OP_HEADER_SIZE + XFERT_MAX_SIZE)
+#define BATCH_QUERY_TIMEOUT_MS	1000
 
 /* jtag_vpi server port and address to connect to */
 static int server_port = DEFAULT_SERVER_PORT;
@@ -45,6 +67,36 @@ static char *server_address;
 /* Send CMD_STOP_SIMU to server when OpenOCD exits? */
 static bool stop_sim_on_exit;
 
+/* Negotiate the batched protocol at connect? */
+static bool batch_enabled = true;
+
+/* Batched protocol in use, message being built and its TDO destinations */
+static bool batch_active;
+static uint32_t batch_max_size;
+static uint8_t *batch_buf;
+static size_t batch_len;
+static uint32_t batch_ops;
+static uint8_t *batch_tdo;
+static size_t batch_tdo_len;
+
+struct batch_xfer {
+	uint8_t *bits;
+	size_t offset;
+	unsigned int nb_bytes;
+};
+
+static struct batch_xfer *batch_xfers;
+static size_t batch_nb_xfers, batch_max_xfers;
+
+/* scans waiting for their TDO, completed at the end of the queue */
+struct batch_scan {
+	struct scan_command *cmd;
+	uint8_t *buf;
+};
+
+static struct batch_scan *batch_scans;
+static size_t batch_nb_scans, batch_max_scans;
+
 static int sockfd;
 static struct sockaddr_in serv_addr;
 
@@ -79,54 +131,21 @@ static char *jtag_vpi_cmd_to_str(int cmd_num)
 		return "CMD_SCAN_CHAIN_FLIP_TMS";
 	case CMD_STOP_SIMU:
 		return "CMD_STOP_SIMU";
+	case CMD_BATCH_QUERY:
+		return "CMD_BATCH_QUERY";
+	case CMD_BATCH:
+		return "CMD_BATCH";
 	default:
 		return "<unknown>";
 	}
 }
 
-static int jtag_vpi_send_cmd(struct vpi_cmd *vpi)
+static int jtag_vpi_write(const void *buf, size_t size)
 {
 	int retval;
 
-	/* Optional low-level JTAG debug */
-	if (LOG_LEVEL_IS(LOG_LVL_DEBUG_IO)) {
-		if (vpi->nb_bits > 0) {
-			/* command with a non-empty data payload */
-			char *char_buf = buf_to_hex_str(vpi->buffer_out,
-					(vpi->nb_bits > DEBUG_JTAG_IOZ)
-						? DEBUG_JTAG_IOZ
-						: vpi->nb_bits);
-			LOG_DEBUG_IO("sending JTAG VPI cmd: cmd=%s, "
-					"length=%" PRIu32 ", "
-					"nb_bits=%" PRIu32 ", "
-					"buf_out=0x%s%s",
-					jtag_vpi_cmd_to_str(vpi->cmd),
-					vpi->length,
-					vpi->nb_bits,
-					char_buf,
-					(vpi->nb_bits > DEBUG_JTAG_IOZ) ? "(...)" : "");
-			free(char_buf);
-		} else {
-			/* command without data payload */
-			LOG_DEBUG_IO("sending JTAG VPI cmd: cmd=%s, "
-					"length=%" PRIu32 ", "
-					"nb_bits=%" PRIu32,
-					jtag_vpi_cmd_to_str(vpi->cmd),
-					vpi->length,
-					vpi->nb_bits);
-		}
-	}
-
-	/* Use little endian when transmitting/receiving jtag_vpi cmds.
-	   The choice of little endian goes against usual networking conventions
-	   but is intentional to remain compatible with most older OpenOCD builds
-	   (i.e. builds on little-endian platforms). */
-	h_u32_to_le(vpi->cmd_buf, vpi->cmd);
-	h_u32_to_le(vpi->length_buf, vpi->length);
-	h_u32_to_le(vpi->nb_bits_buf, vpi->nb_bits);
-
 retry_write:
-	retval = write_socket(sockfd, vpi, sizeof(struct vpi_cmd));
+	retval = write_socket(sockfd, buf, size);
 
 	if (retval < 0) {
 		/* Account for the case when socket write is interrupted. */
@@ -144,7 +163,7 @@ retry_write:
 		/* TODO: Clean way how adapter drivers can report fatal errors
 		   to upper layers of OpenOCD and let it perform an orderly shutdown? */
 		exit(-1);
-	} else if (retval < (int)sizeof(struct vpi_cmd)) {
+	} else if (retval < (int)size) {
 		/* This means we could not send all data, which is most likely fatal
 		   for the jtag_vpi connection (the underlying TCP connection likely not
 		   usable anymore) */
@@ -156,12 +175,12 @@ retry_write:
 	return ERROR_OK;
 }
 
-static int jtag_vpi_receive_cmd(struct vpi_cmd *vpi)
+static int jtag_vpi_read(void *buf, size_t size)
 {
-	unsigned bytes_buffered = 0;
-	while (bytes_buffered < sizeof(struct vpi_cmd)) {
-		int bytes_to_receive = sizeof(struct vpi_cmd) - bytes_buffered;
-		int retval = read_socket(sockfd, ((char *)vpi) + bytes_buffered, bytes_to_receive);
+	size_t bytes_buffered = 0;
+	while (bytes_buffered < size) {
+		int bytes_to_receive = size - bytes_buffered;
+		int retval = read_socket(sockfd, ((char *)buf) + bytes_buffered, bytes_to_receive);
 		if (retval < 0) {
 #ifdef _WIN32
 			int wsa_err = WSAGetLastError();
@@ -187,6 +206,55 @@ static int jtag_vpi_receive_cmd(struct vpi_cmd *vpi)
 		bytes_buffered += retval;
 	}
 
+	return ERROR_OK;
+}
+
+static int jtag_vpi_send_cmd(struct vpi_cmd *vpi)
+{
+	/* Optional low-level JTAG debug */
+	if (LOG_LEVEL_IS(LOG_LVL_DEBUG_IO)) {
+		if (vpi->nb_bits > 0) {
+			/* command with a non-empty data payload */
+			char *char_buf = buf_to_hex_str(vpi->buffer_out,
+					(vpi->nb_bits > DEBUG_JTAG_IOZ)
+						? DEBUG_JTAG_IOZ
+						: vpi->nb_bits);
+			LOG_DEBUG_IO("sending JTAG VPI cmd: cmd=%s, "
+					"length=%" PRIu32 ", "
+					"nb_bits=%" PRIu32 ", "
+					"buf_out=0x%s%s",
+					jtag_vpi_cmd_to_str(vpi->cmd),
+					vpi->length,
+					vpi->nb_bits,
+					char_buf,
+					(vpi->nb_bits > DEBUG_JTAG_IOZ) ? "(...)" : "");
+			free(char_buf);
+		} else {
+			/* command without data payload */
+			LOG_DEBUG_IO("sending JTAG VPI cmd: cmd=%s, "
+					"length=%" PRIu32 ", "
+					"nb_bits=%" PRIu32,
+					jtag_vpi_cmd_to_str(vpi->cmd),
+					vpi->length,
+					vpi->nb_bits);
+		}
+	}
+
+	/* Use little endian when transmitting/receiving jtag_vpi cmds.
+	   The choice of little endian goes against usual networking conventions
+	   but is intentional to remain compatible with most older OpenOCD builds
+	   (i.e. builds on little-endian platforms). */
+	h_u32_to_le(vpi->cmd_buf, vpi->cmd);
+	h_u32_to_le(vpi->length_buf, vpi->length);
+	h_u32_to_le(vpi->nb_bits_buf, vpi->nb_bits);
+
+	return jtag_vpi_write(vpi, sizeof(struct vpi_cmd));
+}
+
+static int jtag_vpi_receive_cmd(struct vpi_cmd *vpi)
+{
+	jtag_vpi_read(vpi, sizeof(struct vpi_cmd));
+
 	/* Use little endian when transmitting/receiving jtag_vpi cmds. */
 	vpi->cmd = le_to_h_u32(vpi->cmd_buf);
 	vpi->length = le_to_h_u32(vpi->length_buf);
@@ -195,6 +263,217 @@ static int jtag_vpi_receive_cmd(struct vpi_cmd *vpi)
 	return ERROR_OK;
 }
 
+/**
+ * jtag_vpi_batch_query - negotiate the batched protocol with the server
+ *
+ * Falls back silently to the per-command protocol if the server does not
+ * answer in time, or does not support batches large enough.
+ */
+static int jtag_vpi_batch_query(void)
+{
+	struct vpi_cmd vpi;
+
+	memset(&vpi, 0, sizeof(struct vpi_cmd));
+	vpi.cmd = CMD_BATCH_QUERY;
+	vpi.length = BATCH_VERSION;
+	vpi.nb_bits = BATCH_MAX_SIZE;
+
+	int retval = jtag_vpi_send_cmd(&vpi);
+	if (retval != ERROR_OK)
+		return retval;
+
+	fd_set rfds;
+	struct timeval tv = {
+		.tv_sec = BATCH_QUERY_TIMEOUT_MS / 1000,
+		.tv_usec = (BATCH_QUERY_TIMEOUT_MS % 1000) * 1000,
+	};
+
+	FD_ZERO(&rfds);
+	FD_SET(sockfd, &rfds);
+	if (socket_select(sockfd + 1, &rfds, NULL, NULL, &tv) <= 0) {
+		LOG_INFO("jtag_vpi: server does not support batches, using per-command protocol");
+		return ERROR_OK;
+	}
+
+	retval = jtag_vpi_receive_cmd(&vpi);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (vpi.cmd != CMD_BATCH_QUERY || vpi.length < BATCH_VERSION || vpi.nb_bits < BATCH_MIN_SIZE) {
+		LOG_INFO("jtag_vpi: server batches not usable, using per-command protocol");
+		return ERROR_OK;
+	}
+
+	batch_max_size = MIN(vpi.nb_bits, BATCH_MAX_SIZE);
+	batch_buf = malloc(batch_max_size);
+	batch_tdo = malloc(batch_max_size);
+	if (!batch_buf || !batch_tdo) {
+		LOG_ERROR("Out of memory");
+		free(batch_buf);
+		free(batch_tdo);
+		batch_buf = NULL;
+		batch_tdo = NULL;
+		return ERROR_FAIL;
+	}
+
+	batch_len = BATCH_HEADER_SIZE;
+	batch_active = true;
+	LOG_INFO("jtag_vpi: using batches of up to %" PRIu32 " bytes", batch_max_size);
+
+	return ERROR_OK;
+}
+
+/**
+ * jtag_vpi_batch_flush - send the pending batch and wait for its TDO
+ *
+ * The TDO bytes are copied back to the scan buffers they belong to.
+ */
+static int jtag_vpi_batch_flush(void)
+{
+	uint8_t header[BATCH_HEADER_SIZE];
+
+	if (!batch_ops)
+		return ERROR_OK;
+
+	h_u32_to_le(batch_buf, CMD_BATCH);
+	h_u32_to_le(batch_buf + 4, batch_len - BATCH_HEADER_SIZE);
+	h_u32_to_le(batch_buf + 8, batch_ops);
+
+	LOG_DEBUG_IO("sending JTAG VPI batch: ops=%" PRIu32 ", length=%zu, tdo length=%zu",
+		batch_ops, batch_len - BATCH_HEADER_SIZE, batch_tdo_len);
+
+	int retval = jtag_vpi_write(batch_buf, batch_len);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = jtag_vpi_read(header, sizeof(header));
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (le_to_h_u32(header) != CMD_BATCH || le_to_h_u32(header + 4) != batch_tdo_len) {
+		/* the connection is out of sync */
+		LOG_ERROR("jtag_vpi: unexpected batch reply (cmd=%s, length=%" PRIu32 ", expected %zu)",
+			jtag_vpi_cmd_to_str(le_to_h_u32(header)), le_to_h_u32(header + 4), batch_tdo_len);
+		exit(-1);
+	}
+
+	retval = jtag_vpi_read(batch_tdo, batch_tdo_len);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (size_t i = 0; i < batch_nb_xfers; i++)
+		memcpy(batch_xfers[i].bits, batch_tdo + batch_xfers[i].offset, batch_xfers[i].nb_bytes);
+
+	batch_len = BATCH_HEADER_SIZE;
+	batch_ops = 0;
+	batch_tdo_len = 0;
+	batch_nb_xfers = 0;
+
+	return ERROR_OK;
+}
+
+/**
+ * jtag_vpi_batch_add - add an operation to the pending batch
+ * @param cmd command, possibly with BATCH_NO_TDO
+ * @param bits TDI or TMS bits, NULL for all ones
+ * @param nb_bits number of bits
+ * @param tdo where the TDO bits of a scan go, or NULL
+ */
+static int jtag_vpi_batch_add(uint8_t cmd, const uint8_t *bits, int nb_bits, uint8_t *tdo)
+{
+	unsigned int nb_bytes = DIV_ROUND_UP(nb_bits, 8);
+
+	if (batch_len + BATCH_OP_HEADER_SIZE + nb_bytes > batch_max_size) {
+		int retval = jtag_vpi_batch_flush();
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	if (tdo && batch_nb_xfers == batch_max_xfers) {
+		size_t max = batch_max_xfers ? 2 * batch_max_xfers : 64;
+		struct batch_xfer *xfers = realloc(batch_xfers, max * sizeof(*xfers));
+		if (!xfers) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		batch_xfers = xfers;
+		batch_max_xfers = max;
+	}
+
+	uint8_t *p = batch_buf + batch_len;
+	p[0] = tdo ? cmd : (cmd | BATCH_NO_TDO);
+	h_u32_to_le(p + 1, nb_bits);
+	if (bits)
+		memcpy(p + BATCH_OP_HEADER_SIZE, bits, nb_bytes);
+	else
+		memset(p + BATCH_OP_HEADER_SIZE, 0xff, nb_bytes);
+
+	batch_len += BATCH_OP_HEADER_SIZE + nb_bytes;
+	batch_ops++;
+
+	if (tdo) {
+		batch_xfers[batch_nb_xfers++] = (struct batch_xfer) {
+			.bits = tdo,
+			.offset = batch_tdo_len,
+			.nb_bytes = nb_bytes,
+		};
+		batch_tdo_len += nb_bytes;
+	}
+
+	return ERROR_OK;
+}
+
+/**
+ * jtag_vpi_batch_scan - defer the completion of a scan to the end of the queue
+ */
+static int jtag_vpi_batch_scan(struct scan_command *cmd, uint8_t *buf)
+{
+	if (batch_nb_scans == batch_max_scans) {
+		size_t max = batch_max_scans ? 2 * batch_max_scans : 64;
+		struct batch_scan *scans = realloc(batch_scans, max * sizeof(*scans));
+		if (!scans) {
+			LOG_ERROR("Out of memory");
+			free(buf);
+			return ERROR_FAIL;
+		}
+		batch_scans = scans;
+		batch_max_scans = max;
+	}
+
+	batch_scans[batch_nb_scans++] = (struct batch_scan) {
+		.cmd = cmd,
+		.buf = buf,
+	};
+
+	return ERROR_OK;
+}
+
+/**
+ * jtag_vpi_batch_finish - flush the batch and complete the deferred scans
+ * @param retval result of the queue so far
+ */
+static int jtag_vpi_batch_finish(int retval)
+{
+	int flush_retval = jtag_vpi_batch_flush();
+	if (retval == ERROR_OK)
+		retval = flush_retval;
+
+	for (size_t i = 0; i < batch_nb_scans; i++) {
+		if (retval == ERROR_OK)
+			retval = jtag_read_buffer(batch_scans[i].buf, batch_scans[i].cmd);
+		free(batch_scans[i].buf);
+	}
+	batch_nb_scans = 0;
+
+	/* a failed flush leaves the batch as it was */
+	batch_len = BATCH_HEADER_SIZE;
+	batch_ops = 0;
+	batch_tdo_len = 0;
+	batch_nb_xfers = 0;
+
+	return retval;
+}
+
 /**
  * jtag_vpi_reset - ask to reset the JTAG device
  * @param trst 1 if TRST is to be asserted
@@ -205,6 +484,9 @@ static int jtag_vpi_reset(int trst, int srst)
 	struct vpi_cmd vpi;
 	memset(&vpi, 0, sizeof(struct vpi_cmd));
 
+	if (batch_active)
+		return jtag_vpi_batch_add(CMD_RESET, NULL, 0, NULL);
+
 	vpi.cmd = CMD_RESET;
 	vpi.length = 0;
 	return jtag_vpi_send_cmd(&vpi);
@@ -226,6 +508,9 @@ static int jtag_vpi_tms_seq(const uint8_t *bits, int nb_bits)
 	struct vpi_cmd vpi;
 	int nb_bytes;
 
+	if (batch_active)
+		return jtag_vpi_batch_add(CMD_TMS_SEQ, bits, nb_bits, NULL);
+
 	memset(&vpi, 0, sizeof(struct vpi_cmd));
 	nb_bytes = DIV_ROUND_UP(nb_bits, 8);
 
@@ -294,6 +579,10 @@ static int jtag_vpi_queue_tdi_xfer(uint8_t *bits, int nb_bits, int tap_shift)
 	struct vpi_cmd vpi;
 	int nb_bytes = DIV_ROUND_UP(nb_bits, 8);
 
+	if (batch_active)
+		return jtag_vpi_batch_add(tap_shift ? CMD_SCAN_CHAIN_FLIP_TMS : CMD_SCAN_CHAIN,
+			bits, nb_bits, bits);
+
 	memset(&vpi, 0, sizeof(struct vpi_cmd));
 
 	vpi.cmd = tap_shift ? CMD_SCAN_CHAIN_FLIP_TMS : CMD_SCAN_CHAIN;
@@ -425,12 +714,16 @@ static int jtag_vpi_scan(struct scan_command *cmd)
 			tap_set_state(TAP_DRPAUSE);
 	}
 
-	retval = jtag_read_buffer(buf, cmd);
+	if (batch_active) {
+		/* TDO only known once the batch is sent */
+		retval = jtag_vpi_batch_scan(cmd, buf);
+	} else {
+		retval = jtag_read_buffer(buf, cmd);
+		free(buf);
+	}
 	if (retval != ERROR_OK)
 		return retval;
 
-	free(buf);
-
 	if (cmd->end_state != TAP_DRSHIFT) {
 		retval = jtag_vpi_state_move(cmd->end_state);
 		if (retval != ERROR_OK)
@@ -508,6 +801,7 @@ static int jtag_vpi_execute_queue(void)
 			retval = jtag_vpi_tms(cmd->cmd.tms);
 			break;
 		case JTAG_SLEEP:
+			retval = jtag_vpi_batch_flush();
 			jtag_sleep(cmd->cmd.sleep->us);
 			break;
 		case JTAG_SCAN:
@@ -521,6 +815,9 @@ static int jtag_vpi_execute_queue(void)
 		}
 	}
 
+	if (batch_active)
+		retval = jtag_vpi_batch_finish(retval);
+
 	return retval;
 }
 
@@ -564,6 +861,9 @@ static int jtag_vpi_init(void)
 
 	LOG_INFO("jtag_vpi: Connection to %s : %u successful", server_address, server_port);
 
+	if (batch_enabled)
+		return jtag_vpi_batch_query();
+
 	return ERROR_OK;
 }
 
@@ -588,6 +888,10 @@ static int jtag_vpi_quit(void)
 		log_socket_error("jtag_vpi");
 	}
 	free(server_address);
+	free(batch_buf);
+	free(batch_tdo);
+	free(batch_xfers);
+	free(batch_scans);
 	return ERROR_OK;
 }
 
@@ -630,6 +934,17 @@ COMMAND_HANDLER(jtag_vpi_stop_sim_on_exit_handler)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(jtag_vpi_batch_handler)
+{
+	if (CMD_ARGC != 1) {
+		LOG_ERROR("Command \"jtag_vpi batch\" expects 1 argument (on|off)");
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	COMMAND_PARSE_ON_OFF(CMD_ARGV[0], batch_enabled);
+	return ERROR_OK;
+}
+
 static const struct command_registration jtag_vpi_subcommand_handlers[] = {
 	{
 		.name = "set_port",
@@ -653,6 +968,14 @@ static const struct command_registration jtag_vpi_subcommand_handlers[] = {
 			"before OpenOCD exits (default: off)",
 		.usage = "<on|off>",
 	},
+	{
+		.name = "batch",
+		.handler = &jtag_vpi_batch_handler,
+		.mode = COMMAND_CONFIG,
+		.help = "Configure if the batched protocol is negotiated with the server, "
+			"falling back to one message per command (default: on)",
+		.usage = "<on|off>",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
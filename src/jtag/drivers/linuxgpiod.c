@@ -27,6 +27,15 @@ static int last_swdio;
 static bool last_stored;
 static bool swdio_input;
 
+/* TCK, TMS and TDI requested together, in this order, and written at once */
+static struct gpiod_line_bulk jtag_bulk;
+static bool jtag_bulk_used;
+
+#ifdef HAVE_LIBGPIOD1_FLAGS_BIAS
+/* libgpiod v1.5, with the bias flags, can change the direction of a requested line */
+static bool swdio_set_direction = true;
+#endif
+
 static const struct adapter_gpio_config *adapter_gpio_config;
 
 /*
@@ -62,6 +71,10 @@ static bb_value_t linuxgpiod_read(void)
  *
  * Seeing as this is the only function where the outputs are changed,
  * we can cache the old value to avoid needlessly writing it.
+ *
+ * With the lines requested together, the three are written with one ioctl:
+ * TCK then changes together with TMS and TDI on its falling edge, and alone
+ * on its rising edge, where the target samples them.
  */
 static int linuxgpiod_write(int tck, int tms, int tdi)
 {
@@ -80,6 +93,22 @@ static int linuxgpiod_write(int tck, int tms, int tdi)
 		first_time = 1;
 	}
 
+	if (jtag_bulk_used) {
+		if (tck != last_tck || tms != last_tms || tdi != last_tdi) {
+			int values[] = { tck, tms, tdi };
+
+			retval = gpiod_line_set_value_bulk(&jtag_bulk, values);
+			if (retval < 0)
+				LOG_WARNING("writing tck, tms and tdi failed");
+		}
+
+		last_tdi = tdi;
+		last_tms = tms;
+		last_tck = tck;
+
+		return ERROR_OK;
+	}
+
 	if (tdi != last_tdi) {
 		retval = gpiod_line_set_value(gpiod_line[ADAPTER_GPIO_IDX_TDI], tdi);
 		if (retval < 0)
@@ -119,10 +148,55 @@ static int linuxgpiod_swdio_read(void)
 	return retval;
 }
 
+#ifdef HAVE_LIBGPIOD1_FLAGS_BIAS
+/*
+ * Change the direction of swdio in place, with one ioctl. Needs Linux v5.5,
+ * older kernels get the line released and requested again.
+ */
+static bool linuxgpiod_swdio_set_direction(bool is_output)
+{
+	int retval;
+
+	if (!swdio_set_direction)
+		return false;
+
+	if (is_output) {
+		if (gpiod_line[ADAPTER_GPIO_IDX_SWDIO_DIR]) {
+			retval = gpiod_line_set_value(gpiod_line[ADAPTER_GPIO_IDX_SWDIO_DIR], 1);
+			if (retval < 0)
+				LOG_WARNING("Fail set swdio_dir");
+		}
+		retval = gpiod_line_set_direction_output(gpiod_line[ADAPTER_GPIO_IDX_SWDIO], 1);
+	} else {
+		retval = gpiod_line_set_direction_input(gpiod_line[ADAPTER_GPIO_IDX_SWDIO]);
+		if (retval == 0 && gpiod_line[ADAPTER_GPIO_IDX_SWDIO_DIR]) {
+			if (gpiod_line_set_value(gpiod_line[ADAPTER_GPIO_IDX_SWDIO_DIR], 0) < 0)
+				LOG_WARNING("Fail set swdio_dir");
+		}
+	}
+
+	if (retval < 0) {
+		LOG_DEBUG("linuxgpiod: cannot change swdio direction in place, releasing the line instead");
+		swdio_set_direction = false;
+		return false;
+	}
+
+	return true;
+}
+#endif
+
 static void linuxgpiod_swdio_drive(bool is_output)
 {
 	int retval;
 
+#ifdef HAVE_LIBGPIOD1_FLAGS_BIAS
+	if (linuxgpiod_swdio_set_direction(is_output)) {
+		last_stored = false;
+		swdio_input = !is_output;
+		return;
+	}
+#endif
+
 	/*
 	 * FIXME: change direction requires release and re-require the line
 	 * https://stackoverflow.com/questions/58735140/
@@ -260,10 +334,6 @@ static inline void helper_release(enum adapter_gpio_config_index idx)
 		gpiod_line_release(gpiod_line[idx]);
 		gpiod_line[idx] = NULL;
 	}
-	if (gpiod_chip[idx]) {
-		gpiod_chip_close(gpiod_chip[idx]);
-		gpiod_chip[idx] = NULL;
-	}
 }
 
 static int linuxgpiod_quit(void)
@@ -271,29 +341,26 @@ static int linuxgpiod_quit(void)
 	LOG_DEBUG("linuxgpiod_quit");
 	for (int i = 0; i < ADAPTER_GPIO_IDX_NUM; ++i)
 		helper_release(i);
+	jtag_bulk_used = false;
+
+	/* after all the lines, as a chip may hold several of them */
+	for (int i = 0; i < ADAPTER_GPIO_IDX_NUM; ++i) {
+		if (gpiod_chip[i]) {
+			gpiod_chip_close(gpiod_chip[i]);
+			gpiod_chip[i] = NULL;
+		}
+	}
 
 	return ERROR_OK;
 }
 
-static int helper_get_line(enum adapter_gpio_config_index idx)
+/*
+ * Request configuration of a line, as set by "adapter gpio". Returns the
+ * initial value of an output.
+ */
+static int helper_line_config(enum adapter_gpio_config_index idx, struct gpiod_line_request_config *config)
 {
-	if (!is_gpio_config_valid(idx))
-		return ERROR_OK;
-
-	int dir = GPIOD_LINE_REQUEST_DIRECTION_INPUT, flags = 0, val = 0, retval;
-
-	gpiod_chip[idx] = gpiod_chip_open_by_number(adapter_gpio_config[idx].chip_num);
-	if (!gpiod_chip[idx]) {
-		LOG_ERROR("Cannot open LinuxGPIOD chip %d for %s", adapter_gpio_config[idx].chip_num,
-			adapter_gpio_get_name(idx));
-		return ERROR_JTAG_INIT_FAILED;
-	}
-
-	gpiod_line[idx] = gpiod_chip_get_line(gpiod_chip[idx], adapter_gpio_config[idx].gpio_num);
-	if (!gpiod_line[idx]) {
-		LOG_ERROR("Error get line %s", adapter_gpio_get_name(idx));
-		return ERROR_JTAG_INIT_FAILED;
-	}
+	int dir = GPIOD_LINE_REQUEST_DIRECTION_INPUT, flags = 0, val = 0;
 
 	switch (adapter_gpio_config[idx].init_state) {
 	case ADAPTER_GPIO_INIT_STATE_INPUT:
@@ -322,12 +389,12 @@ static int helper_get_line(enum adapter_gpio_config_index idx)
 
 	switch (adapter_gpio_config[idx].pull) {
 	case ADAPTER_GPIO_PULL_NONE:
-#ifdef GPIOD_LINE_REQUEST_FLAG_BIAS_DISABLE
+#ifdef HAVE_LIBGPIOD1_FLAGS_BIAS
 		flags |= GPIOD_LINE_REQUEST_FLAG_BIAS_DISABLE;
 #endif
 		break;
 	case ADAPTER_GPIO_PULL_UP:
-#ifdef GPIOD_LINE_REQUEST_FLAG_BIAS_PULL_UP
+#ifdef HAVE_LIBGPIOD1_FLAGS_BIAS
 		flags |= GPIOD_LINE_REQUEST_FLAG_BIAS_PULL_UP;
 #else
 		LOG_WARNING("linuxgpiod: ignoring request for pull-up on %s: not supported by gpiod v%s",
@@ -335,7 +402,7 @@ static int helper_get_line(enum adapter_gpio_config_index idx)
 #endif
 		break;
 	case ADAPTER_GPIO_PULL_DOWN:
-#ifdef GPIOD_LINE_REQUEST_FLAG_BIAS_PULL_DOWN
+#ifdef HAVE_LIBGPIOD1_FLAGS_BIAS
 		flags |= GPIOD_LINE_REQUEST_FLAG_BIAS_PULL_DOWN;
 #else
 		LOG_WARNING("linuxgpiod: ignoring request for pull-down on %s: not supported by gpiod v%s",
@@ -347,12 +414,38 @@ static int helper_get_line(enum adapter_gpio_config_index idx)
 	if (adapter_gpio_config[idx].active_low)
 		flags |= GPIOD_LINE_REQUEST_FLAG_ACTIVE_LOW;
 
-	struct gpiod_line_request_config config = {
+	*config = (struct gpiod_line_request_config) {
 		.consumer = "OpenOCD",
 		.request_type = dir,
 		.flags = flags,
 	};
 
+	return val;
+}
+
+static int helper_get_line(enum adapter_gpio_config_index idx)
+{
+	if (!is_gpio_config_valid(idx))
+		return ERROR_OK;
+
+	struct gpiod_line_request_config config;
+	int val, retval;
+
+	gpiod_chip[idx] = gpiod_chip_open_by_number(adapter_gpio_config[idx].chip_num);
+	if (!gpiod_chip[idx]) {
+		LOG_ERROR("Cannot open LinuxGPIOD chip %d for %s", adapter_gpio_config[idx].chip_num,
+			adapter_gpio_get_name(idx));
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	gpiod_line[idx] = gpiod_chip_get_line(gpiod_chip[idx], adapter_gpio_config[idx].gpio_num);
+	if (!gpiod_line[idx]) {
+		LOG_ERROR("Error get line %s", adapter_gpio_get_name(idx));
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	val = helper_line_config(idx, &config);
+
 	retval = gpiod_line_request(gpiod_line[idx], &config, val);
 	if (retval < 0) {
 		LOG_ERROR("Error requesting gpio line %s", adapter_gpio_get_name(idx));
@@ -362,6 +455,68 @@ static int helper_get_line(enum adapter_gpio_config_index idx)
 	return ERROR_OK;
 }
 
+/*
+ * Request TCK, TMS and TDI together, so that linuxgpiod_write() sets them
+ * with one ioctl. This needs the three lines on the same chip, configured
+ * as outputs with the same flags; else they are requested one by one.
+ * A scan bit then takes 3 ioctls instead of 3.5 on average; the effect on
+ * the achievable TCK rate has not been measured.
+ */
+static int helper_get_jtag_bulk(void)
+{
+	static const enum adapter_gpio_config_index idx[] = {
+		ADAPTER_GPIO_IDX_TCK, ADAPTER_GPIO_IDX_TMS, ADAPTER_GPIO_IDX_TDI
+	};
+	const struct adapter_gpio_config *tck = &adapter_gpio_config[ADAPTER_GPIO_IDX_TCK];
+	struct gpiod_line_request_config config;
+	int values[ARRAY_SIZE(idx)];
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(idx); i++) {
+		const struct adapter_gpio_config *gpio = &adapter_gpio_config[idx[i]];
+
+		if (gpio->chip_num != tck->chip_num || gpio->drive != tck->drive ||
+				gpio->pull != tck->pull || gpio->active_low != tck->active_low ||
+				gpio->init_state == ADAPTER_GPIO_INIT_STATE_INPUT)
+			goto one_by_one;
+	}
+
+	gpiod_chip[ADAPTER_GPIO_IDX_TCK] = gpiod_chip_open_by_number(tck->chip_num);
+	if (!gpiod_chip[ADAPTER_GPIO_IDX_TCK]) {
+		LOG_ERROR("Cannot open LinuxGPIOD chip %d for %s", tck->chip_num,
+			adapter_gpio_get_name(ADAPTER_GPIO_IDX_TCK));
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	gpiod_line_bulk_init(&jtag_bulk);
+	for (unsigned int i = 0; i < ARRAY_SIZE(idx); i++) {
+		gpiod_line[idx[i]] = gpiod_chip_get_line(gpiod_chip[ADAPTER_GPIO_IDX_TCK],
+				adapter_gpio_config[idx[i]].gpio_num);
+		if (!gpiod_line[idx[i]]) {
+			LOG_ERROR("Error get line %s", adapter_gpio_get_name(idx[i]));
+			return ERROR_JTAG_INIT_FAILED;
+		}
+		gpiod_line_bulk_add(&jtag_bulk, gpiod_line[idx[i]]);
+		values[i] = helper_line_config(idx[i], &config);
+	}
+
+	if (gpiod_line_request_bulk(&jtag_bulk, &config, values) < 0) {
+		LOG_ERROR("Error requesting gpio lines tck, tms and tdi");
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	jtag_bulk_used = true;
+	LOG_DEBUG("linuxgpiod: tck, tms and tdi written together");
+	return ERROR_OK;
+
+one_by_one:
+	LOG_DEBUG("linuxgpiod: tck, tms and tdi written one by one");
+	if (helper_get_line(ADAPTER_GPIO_IDX_TDI) != ERROR_OK ||
+		helper_get_line(ADAPTER_GPIO_IDX_TCK) != ERROR_OK ||
+		helper_get_line(ADAPTER_GPIO_IDX_TMS) != ERROR_OK)
+		return ERROR_JTAG_INIT_FAILED;
+	return ERROR_OK;
+}
+
 static int linuxgpiod_init(void)
 {
 	LOG_INFO("Linux GPIOD JTAG/SWD bitbang driver");
@@ -381,9 +536,7 @@ static int linuxgpiod_init(void)
 		}
 
 		if (helper_get_line(ADAPTER_GPIO_IDX_TDO) != ERROR_OK ||
-			helper_get_line(ADAPTER_GPIO_IDX_TDI) != ERROR_OK ||
-			helper_get_line(ADAPTER_GPIO_IDX_TCK) != ERROR_OK ||
-			helper_get_line(ADAPTER_GPIO_IDX_TMS) != ERROR_OK ||
+			helper_get_jtag_bulk() != ERROR_OK ||
 			helper_get_line(ADAPTER_GPIO_IDX_TRST) != ERROR_OK)
 				goto out_error;
 	}
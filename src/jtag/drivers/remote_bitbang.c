@@ -16,7 +16,10 @@
 #endif
 #include "helper/system.h"
 #include "helper/replacements.h"
+#include "helper/time_support.h"
 #include <jtag/interface.h>
+#include <jtag/commands.h>
+#include <jtag/swd.h>
 #include "bitbang.h"
 
 /* arbitrary limit on host name length: */
@@ -26,14 +29,79 @@ static char *remote_bitbang_host;
 static char *remote_bitbang_port;
 
 static int remote_bitbang_fd;
-static uint8_t remote_bitbang_send_buf[512];
+static uint8_t remote_bitbang_send_buf[4096];
 static unsigned int remote_bitbang_send_buf_used;
 
 /* Circular buffer. When start == end, the buffer is empty. */
-static char remote_bitbang_recv_buf[256];
+static char remote_bitbang_recv_buf[4096];
 static unsigned int remote_bitbang_recv_buf_start;
 static unsigned int remote_bitbang_recv_buf_end;
 
+/* Binary frames, see doc/manual/jtag/drivers/remote_bitbang.txt */
+#define RB_FRAME_QUERY			'F'
+#define RB_FRAME_START			'X'
+#define RB_FRAME_VERSION		1
+#define RB_FRAME_HEADER_SIZE	5
+#define RB_FRAME_MAX_SIZE		(64 * 1024)
+#define RB_FRAME_QUERY_TIMEOUT_MS	1000
+
+#define RB_OP_SHIFT				0x01
+#define RB_OP_SWD_SEQ			0x02
+#define RB_OP_SWD_XFER			0x03
+
+#define RB_SHIFT_TDO			0x01	/* return TDO */
+#define RB_SHIFT_TDI			0x02	/* TDI bytes follow, else TDI is 0 */
+#define RB_SHIFT_TMS			0x04	/* TMS bytes follow, else TMS is constant */
+#define RB_SHIFT_TMS_HIGH		0x08	/* constant TMS is 1 */
+#define RB_SHIFT_EXIT			0x10	/* TMS is 1 on the last bit */
+
+/* bits per shift operation, so that one fits in a frame with its TMS and TDI */
+#define RB_SHIFT_MAX_BITS		(16 * 1024 * 8)
+
+#define RB_SWD_XFER_SIZE		(1 + 4 + 4)
+#define RB_SWD_RESULT_SIZE		(1 + 4 + 1)
+
+/* Use frames if the server supports them? */
+static bool remote_bitbang_use_frames;
+/* Frames negotiated with the server */
+static bool remote_bitbang_frames;
+
+/* frame being built, and size of its results */
+static uint8_t *remote_bitbang_frame_buf;
+static size_t remote_bitbang_frame_len;
+static size_t remote_bitbang_frame_result_len;
+
+/* replies to the frames sent, processed at the end of the queue */
+static uint8_t *remote_bitbang_frame_rx;
+static size_t remote_bitbang_frame_rx_len;
+static size_t remote_bitbang_frame_rx_size;
+static size_t remote_bitbang_frame_rx_expected;
+
+/* destinations of the results, in the order of the operations */
+struct remote_bitbang_result {
+	uint8_t op;
+	/* RB_OP_SHIFT */
+	uint8_t *tdo;
+	unsigned int nb_bytes;
+	/* RB_OP_SWD_XFER */
+	uint8_t cmd;
+	uint32_t *value;
+};
+
+static struct remote_bitbang_result *remote_bitbang_results;
+static size_t remote_bitbang_nb_results, remote_bitbang_max_results;
+
+/* scans completed once their TDO is received */
+struct remote_bitbang_scan {
+	struct scan_command *cmd;
+	uint8_t *buf;
+};
+
+static struct remote_bitbang_scan *remote_bitbang_scans;
+static size_t remote_bitbang_nb_scans, remote_bitbang_max_scans;
+
+static int queued_retval;
+
 static bool remote_bitbang_recv_buf_full(void)
 {
 	return remote_bitbang_recv_buf_end ==
@@ -160,6 +228,10 @@ static int remote_bitbang_quit(void)
 
 	free(remote_bitbang_host);
 	free(remote_bitbang_port);
+	free(remote_bitbang_frame_buf);
+	free(remote_bitbang_frame_rx);
+	free(remote_bitbang_results);
+	free(remote_bitbang_scans);
 
 	LOG_INFO("remote_bitbang interface quit");
 	return ERROR_OK;
@@ -220,12 +292,728 @@ static int remote_bitbang_blink(int on)
 	return remote_bitbang_queue(c, FLUSH_SEND_BUF);
 }
 
+static int remote_bitbang_swdio_read(void)
+{
+	if (remote_bitbang_fill_buf(NO_BLOCK) != ERROR_OK)
+		return BB_ERROR;
+	assert(!remote_bitbang_recv_buf_full());
+	if (remote_bitbang_queue('c', FLUSH_SEND_BUF) != ERROR_OK)
+		return BB_ERROR;
+	return remote_bitbang_read_sample();
+}
+
+static void remote_bitbang_swdio_drive(bool is_output)
+{
+	char c = is_output ? 'O' : 'o';
+	if (remote_bitbang_queue(c, NO_FLUSH) != ERROR_OK)
+		LOG_ERROR("Error setting direction for swdio");
+}
+
+static int remote_bitbang_swd_write(int swclk, int swdio)
+{
+	char c = 'd' + ((swclk ? 0x2 : 0x0) | (swdio ? 0x1 : 0x0));
+	return remote_bitbang_queue(c, NO_FLUSH);
+}
+
 static struct bitbang_interface remote_bitbang_bitbang = {
 	.buf_size = sizeof(remote_bitbang_recv_buf) - 1,
 	.sample = &remote_bitbang_sample,
 	.read_sample = &remote_bitbang_read_sample,
 	.write = &remote_bitbang_write,
 	.blink = &remote_bitbang_blink,
+	.swdio_read = &remote_bitbang_swdio_read,
+	.swdio_drive = &remote_bitbang_swdio_drive,
+	.swd_write = &remote_bitbang_swd_write,
+};
+
+static bool remote_bitbang_would_block(void)
+{
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+/* Read the frame replies available, without blocking. */
+static int remote_bitbang_frame_drain(void)
+{
+	for (;;) {
+		if (remote_bitbang_frame_rx_size - remote_bitbang_frame_rx_len < 4096) {
+			size_t size = remote_bitbang_frame_rx_size + 64 * 1024;
+			uint8_t *rx = realloc(remote_bitbang_frame_rx, size);
+			if (!rx) {
+				LOG_ERROR("Out of memory");
+				return ERROR_FAIL;
+			}
+			remote_bitbang_frame_rx = rx;
+			remote_bitbang_frame_rx_size = size;
+		}
+
+		ssize_t count = read_socket(remote_bitbang_fd,
+				remote_bitbang_frame_rx + remote_bitbang_frame_rx_len,
+				remote_bitbang_frame_rx_size - remote_bitbang_frame_rx_len);
+		if (count > 0) {
+			remote_bitbang_frame_rx_len += count;
+		} else if (count == 0) {
+			LOG_ERROR("remote_bitbang: connection closed by the server");
+			return ERROR_FAIL;
+		} else if (remote_bitbang_would_block()) {
+			return ERROR_OK;
+		} else {
+			log_socket_error("remote_bitbang_frame_drain");
+			return ERROR_FAIL;
+		}
+	}
+}
+
+/* Wait until the socket is readable, or writable if asked, reading what comes. */
+static int remote_bitbang_frame_wait(bool writable)
+{
+	fd_set rfds, wfds;
+
+	FD_ZERO(&rfds);
+	FD_ZERO(&wfds);
+	FD_SET(remote_bitbang_fd, &rfds);
+	if (writable)
+		FD_SET(remote_bitbang_fd, &wfds);
+
+	if (socket_select(remote_bitbang_fd + 1, &rfds, writable ? &wfds : NULL, NULL, NULL) < 0) {
+		if (errno == EINTR)
+			return ERROR_OK;
+		log_socket_error("remote_bitbang_frame_wait");
+		return ERROR_FAIL;
+	}
+
+	return remote_bitbang_frame_drain();
+}
+
+/*
+ * Send the frame being built. Replies are read meanwhile, so that the
+ * server never blocks on them while we are writing.
+ */
+static int remote_bitbang_frame_send(void)
+{
+	if (remote_bitbang_frame_len == RB_FRAME_HEADER_SIZE)
+		return ERROR_OK;
+
+	/* keep the order with the ASCII requests */
+	if (remote_bitbang_flush() != ERROR_OK)
+		return ERROR_FAIL;
+
+	remote_bitbang_frame_buf[0] = RB_FRAME_START;
+	h_u32_to_le(remote_bitbang_frame_buf + 1, remote_bitbang_frame_len - RB_FRAME_HEADER_SIZE);
+
+	size_t offset = 0;
+	while (offset < remote_bitbang_frame_len) {
+		ssize_t written = write_socket(remote_bitbang_fd, remote_bitbang_frame_buf + offset,
+				remote_bitbang_frame_len - offset);
+		if (written > 0) {
+			offset += written;
+		} else if (written < 0 && remote_bitbang_would_block()) {
+			if (remote_bitbang_frame_wait(true) != ERROR_OK)
+				return ERROR_FAIL;
+		} else {
+			log_socket_error("remote_bitbang_frame_send");
+			return ERROR_FAIL;
+		}
+	}
+
+	remote_bitbang_frame_rx_expected += RB_FRAME_HEADER_SIZE + remote_bitbang_frame_result_len;
+	remote_bitbang_frame_len = RB_FRAME_HEADER_SIZE;
+	remote_bitbang_frame_result_len = 0;
+
+	return ERROR_OK;
+}
+
+/*
+ * Append an operation of size bytes after its opcode, with result_size
+ * bytes of result. Returns where the operation goes, or NULL on error.
+ */
+static uint8_t *remote_bitbang_frame_add(uint8_t op, size_t size, size_t result_size)
+{
+	if (remote_bitbang_frame_len + 1 + size > RB_FRAME_MAX_SIZE ||
+			remote_bitbang_frame_result_len + result_size > RB_FRAME_MAX_SIZE) {
+		if (remote_bitbang_frame_send() != ERROR_OK)
+			return NULL;
+	}
+
+	uint8_t *p = remote_bitbang_frame_buf + remote_bitbang_frame_len;
+	p[0] = op;
+	remote_bitbang_frame_len += 1 + size;
+	remote_bitbang_frame_result_len += result_size;
+
+	return p + 1;
+}
+
+static int remote_bitbang_frame_result(const struct remote_bitbang_result *result)
+{
+	if (remote_bitbang_nb_results == remote_bitbang_max_results) {
+		size_t max = remote_bitbang_max_results ? 2 * remote_bitbang_max_results : 64;
+		struct remote_bitbang_result *results = realloc(remote_bitbang_results,
+				max * sizeof(*results));
+		if (!results) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		remote_bitbang_results = results;
+		remote_bitbang_max_results = max;
+	}
+
+	remote_bitbang_results[remote_bitbang_nb_results++] = *result;
+	return ERROR_OK;
+}
+
+/*
+ * Clock nb_bits JTAG cycles. TMS comes from tms, or is constant as given
+ * by flags; TDI comes from tdi, or is 0. TDO goes to tdo, if not NULL,
+ * once the frame is completed.
+ */
+static int remote_bitbang_frame_shift(unsigned int nb_bits, uint8_t flags,
+		const uint8_t *tms, const uint8_t *tdi, uint8_t *tdo)
+{
+	while (nb_bits) {
+		unsigned int chunk = MIN(nb_bits, RB_SHIFT_MAX_BITS);
+		unsigned int nb_bytes = DIV_ROUND_UP(chunk, 8);
+		size_t size = 4 + 1 + (tms ? nb_bytes : 0) + (tdi ? nb_bytes : 0);
+
+		uint8_t *p = remote_bitbang_frame_add(RB_OP_SHIFT, size, tdo ? nb_bytes : 0);
+		if (!p)
+			return ERROR_FAIL;
+
+		h_u32_to_le(p, chunk);
+		p[4] = (chunk < nb_bits ? (flags & ~RB_SHIFT_EXIT) : flags) |
+			(tdo ? RB_SHIFT_TDO : 0) | (tdi ? RB_SHIFT_TDI : 0) | (tms ? RB_SHIFT_TMS : 0);
+		p += 5;
+
+		if (tms) {
+			memcpy(p, tms, nb_bytes);
+			p += nb_bytes;
+			tms += nb_bytes;
+		}
+		if (tdi) {
+			memcpy(p, tdi, nb_bytes);
+			tdi += nb_bytes;
+		}
+		if (tdo) {
+			struct remote_bitbang_result result = {
+				.op = RB_OP_SHIFT,
+				.tdo = tdo,
+				.nb_bytes = nb_bytes,
+			};
+			if (remote_bitbang_frame_result(&result) != ERROR_OK)
+				return ERROR_FAIL;
+			tdo += nb_bytes;
+		}
+
+		nb_bits -= chunk;
+	}
+
+	return ERROR_OK;
+}
+
+static void remote_bitbang_frame_swd_result(const struct remote_bitbang_result *result,
+		const uint8_t *p)
+{
+	uint8_t ack = p[0];
+	uint32_t data = le_to_h_u32(p + 1);
+	int parity = p[5];
+	bool check_ack = swd_cmd_returns_ack(result->cmd);
+
+	LOG_DEBUG_IO("%s%s %s %s reg %X = %08" PRIx32,
+		check_ack ? "" : "ack ignored ",
+		ack == SWD_ACK_OK ? "OK" : ack == SWD_ACK_WAIT ? "WAIT" : ack == SWD_ACK_FAULT ? "FAULT" : "JUNK",
+		result->cmd & SWD_CMD_APNDP ? "AP" : "DP",
+		result->cmd & SWD_CMD_RNW ? "read" : "write",
+		(result->cmd & SWD_CMD_A32) >> 1,
+		data);
+
+	if (queued_retval != ERROR_OK)
+		return;
+
+	if (check_ack && ack != SWD_ACK_OK) {
+		queued_retval = swd_ack_to_error_code(ack);
+		return;
+	}
+
+	if (result->cmd & SWD_CMD_RNW) {
+		if (parity != parity_u32(data)) {
+			LOG_ERROR("Wrong parity detected");
+			queued_retval = ERROR_FAIL;
+			return;
+		}
+		if (result->value)
+			*result->value = data;
+	}
+}
+
+/*
+ * Send the pending frame, wait for the replies to all the frames sent and
+ * dispatch their results.
+ */
+static int remote_bitbang_frame_complete(void)
+{
+	int retval = remote_bitbang_frame_send();
+
+	while (retval == ERROR_OK && remote_bitbang_frame_rx_len < remote_bitbang_frame_rx_expected)
+		retval = remote_bitbang_frame_wait(false);
+
+	if (retval == ERROR_OK && remote_bitbang_frame_rx_len != remote_bitbang_frame_rx_expected) {
+		LOG_ERROR("remote_bitbang: %zu bytes received for %zu expected",
+			remote_bitbang_frame_rx_len, remote_bitbang_frame_rx_expected);
+		retval = ERROR_FAIL;
+	}
+
+	/* concatenate the results of the replies, in place */
+	const uint8_t *p = remote_bitbang_frame_rx;
+	const uint8_t *end = p + remote_bitbang_frame_rx_len;
+	uint8_t *results = remote_bitbang_frame_rx;
+	while (retval == ERROR_OK && p < end) {
+		uint32_t len = end - p >= RB_FRAME_HEADER_SIZE ? le_to_h_u32(p + 1) : 0;
+		if (end - p < RB_FRAME_HEADER_SIZE || p[0] != RB_FRAME_START ||
+				len > (size_t)(end - p) - RB_FRAME_HEADER_SIZE) {
+			LOG_ERROR("remote_bitbang: malformed frame reply");
+			retval = ERROR_FAIL;
+			break;
+		}
+		memmove(results, p + RB_FRAME_HEADER_SIZE, len);
+		results += len;
+		p += RB_FRAME_HEADER_SIZE + len;
+	}
+
+	p = remote_bitbang_frame_rx;
+	for (size_t i = 0; retval == ERROR_OK && i < remote_bitbang_nb_results; i++) {
+		const struct remote_bitbang_result *result = &remote_bitbang_results[i];
+		size_t size = result->op == RB_OP_SHIFT ? result->nb_bytes : RB_SWD_RESULT_SIZE;
+
+		if ((size_t)(results - p) < size) {
+			LOG_ERROR("remote_bitbang: frame reply too short");
+			retval = ERROR_FAIL;
+			break;
+		}
+
+		if (result->op == RB_OP_SHIFT)
+			memcpy(result->tdo, p, size);
+		else
+			remote_bitbang_frame_swd_result(result, p);
+		p += size;
+	}
+
+	remote_bitbang_frame_rx_len = 0;
+	remote_bitbang_frame_rx_expected = 0;
+	remote_bitbang_nb_results = 0;
+
+	return retval;
+}
+
+/*
+ * Read up to size bytes until the deadline. Returns the number of bytes
+ * received, or -1 once the server closed the connection.
+ */
+static int remote_bitbang_frame_query_read(uint8_t *buf, size_t size, int64_t deadline)
+{
+	size_t received = 0;
+
+	while (received < size) {
+		int64_t left = deadline - timeval_ms();
+		if (left <= 0)
+			break;
+
+		fd_set rfds;
+		struct timeval tv = {
+			.tv_sec = left / 1000,
+			.tv_usec = (left % 1000) * 1000,
+		};
+
+		FD_ZERO(&rfds);
+		FD_SET(remote_bitbang_fd, &rfds);
+		if (socket_select(remote_bitbang_fd + 1, &rfds, NULL, NULL, &tv) <= 0)
+			continue;
+
+		ssize_t count = read_socket(remote_bitbang_fd, buf + received, size - received);
+		if (count > 0) {
+			received += count;
+		} else if (count == 0) {
+			LOG_ERROR("remote_bitbang: connection closed by the server");
+			return -1;
+		}
+	}
+
+	return received;
+}
+
+/*
+ * Offer frames to the server. Without a complete answer in time, the
+ * answer may still be on its way: a read request is sent, and everything
+ * up to its reply is consumed, so that a late answer does not end up in
+ * the ASCII stream as TDO samples. Anything else than the answer and the
+ * sample makes the stream unusable, the connection is closed.
+ */
+static int remote_bitbang_frame_query(void)
+{
+	uint8_t reply[2];
+
+	if (remote_bitbang_queue(RB_FRAME_QUERY, FLUSH_SEND_BUF) != ERROR_OK)
+		return ERROR_FAIL;
+
+	int received = remote_bitbang_frame_query_read(reply, sizeof(reply),
+			timeval_ms() + RB_FRAME_QUERY_TIMEOUT_MS);
+	if (received < 0)
+		goto disconnect;
+
+	if (received > 0 && reply[0] != RB_FRAME_QUERY) {
+		LOG_ERROR("remote_bitbang: unexpected answer 0x%02x to the frame query", reply[0]);
+		goto disconnect;
+	}
+
+	if (received < (int)sizeof(reply)) {
+		if (remote_bitbang_queue('R', FLUSH_SEND_BUF) != ERROR_OK)
+			return ERROR_FAIL;
+
+		int64_t deadline = timeval_ms() + RB_FRAME_QUERY_TIMEOUT_MS;
+		for (;;) {
+			uint8_t c;
+
+			if (remote_bitbang_frame_query_read(&c, 1, deadline) != 1) {
+				LOG_ERROR("remote_bitbang: no answer to the read request");
+				goto disconnect;
+			}
+
+			if (received == 1) {
+				/* version byte of a late answer */
+				reply[received++] = c;
+			} else if (received == 0 && c == RB_FRAME_QUERY) {
+				reply[received++] = c;
+			} else if (c == '0' || c == '1') {
+				break;
+			} else {
+				LOG_ERROR("remote_bitbang: unexpected answer 0x%02x to the frame query", c);
+				goto disconnect;
+			}
+		}
+	}
+
+	if (received < (int)sizeof(reply) || reply[1] < RB_FRAME_VERSION) {
+		LOG_WARNING("remote_bitbang: server does not support frames, using the ASCII protocol");
+		return ERROR_OK;
+	}
+
+	remote_bitbang_frame_buf = malloc(RB_FRAME_MAX_SIZE);
+	if (!remote_bitbang_frame_buf) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	remote_bitbang_frame_len = RB_FRAME_HEADER_SIZE;
+	remote_bitbang_frames = true;
+	LOG_INFO("remote_bitbang: using frames");
+
+	return ERROR_OK;
+
+disconnect:
+	close_socket(remote_bitbang_fd);
+	remote_bitbang_fd = -1;
+	return ERROR_FAIL;
+}
+
+/* JTAG over frames, TCK is left low after each shift */
+
+static int remote_bitbang_frame_state_move(tap_state_t state)
+{
+	uint8_t tms_scan = tap_get_tms_path(tap_get_state(), state);
+	int tms_len = tap_get_tms_path_len(tap_get_state(), state);
+
+	int retval = remote_bitbang_frame_shift(tms_len, 0, &tms_scan, NULL, NULL);
+	if (retval != ERROR_OK)
+		return retval;
+
+	tap_set_state(state);
+	return ERROR_OK;
+}
+
+static int remote_bitbang_frame_path_move(struct pathmove_command *cmd)
+{
+	uint8_t trans[DIV_ROUND_UP(cmd->num_states, 8)];
+
+	memset(trans, 0, sizeof(trans));
+
+	for (int i = 0; i < cmd->num_states; i++) {
+		if (tap_state_transition(tap_get_state(), true) == cmd->path[i]) {
+			buf_set_u32(trans, i, 1, 1);
+		} else if (tap_state_transition(tap_get_state(), false) != cmd->path[i]) {
+			LOG_ERROR("BUG: %s -> %s isn't a valid TAP transition",
+				tap_state_name(tap_get_state()), tap_state_name(cmd->path[i]));
+			return ERROR_FAIL;
+		}
+		tap_set_state(cmd->path[i]);
+	}
+
+	return remote_bitbang_frame_shift(cmd->num_states, 0, trans, NULL, NULL);
+}
+
+static int remote_bitbang_frame_runtest(int num_cycles, tap_state_t state)
+{
+	int retval;
+
+	if (tap_get_state() != TAP_IDLE) {
+		retval = remote_bitbang_frame_state_move(TAP_IDLE);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	retval = remote_bitbang_frame_shift(num_cycles, 0, NULL, NULL, NULL);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (tap_get_state() != state)
+		return remote_bitbang_frame_state_move(state);
+
+	return ERROR_OK;
+}
+
+static int remote_bitbang_frame_scan(struct scan_command *cmd)
+{
+	tap_state_t shift_state = cmd->ir_scan ? TAP_IRSHIFT : TAP_DRSHIFT;
+	uint8_t *buf;
+	int retval;
+
+	if (tap_get_state() != shift_state) {
+		retval = remote_bitbang_frame_state_move(shift_state);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	int scan_size = jtag_build_buffer(cmd, &buf);
+	enum scan_type type = jtag_scan_type(cmd);
+	bool exit_shift = cmd->end_state != shift_state;
+
+	retval = remote_bitbang_frame_shift(scan_size, exit_shift ? RB_SHIFT_EXIT : 0, NULL,
+			type != SCAN_IN ? buf : NULL, type != SCAN_OUT ? buf : NULL);
+	if (retval != ERROR_OK) {
+		free(buf);
+		return retval;
+	}
+
+	/* completed with jtag_read_buffer() once the frames are */
+	if (remote_bitbang_nb_scans == remote_bitbang_max_scans) {
+		size_t max = remote_bitbang_max_scans ? 2 * remote_bitbang_max_scans : 64;
+		struct remote_bitbang_scan *scans = realloc(remote_bitbang_scans, max * sizeof(*scans));
+		if (!scans) {
+			LOG_ERROR("Out of memory");
+			free(buf);
+			return ERROR_FAIL;
+		}
+		remote_bitbang_scans = scans;
+		remote_bitbang_max_scans = max;
+	}
+	remote_bitbang_scans[remote_bitbang_nb_scans++] = (struct remote_bitbang_scan) {
+		.cmd = cmd,
+		.buf = buf,
+	};
+
+	if (exit_shift) {
+		/* from the unstable EXIT1 state, move on to PAUSE */
+		retval = remote_bitbang_frame_shift(1, 0, NULL, NULL, NULL);
+		if (retval != ERROR_OK)
+			return retval;
+		tap_set_state(cmd->ir_scan ? TAP_IRPAUSE : TAP_DRPAUSE);
+
+		if (cmd->end_state != tap_get_state())
+			return remote_bitbang_frame_state_move(cmd->end_state);
+	}
+
+	return ERROR_OK;
+}
+
+/* Complete the frames, then the scans waiting for their TDO. */
+static int remote_bitbang_frame_finish(int retval)
+{
+	int complete_retval = remote_bitbang_frame_complete();
+	if (retval == ERROR_OK && complete_retval != ERROR_OK)
+		retval = complete_retval;
+
+	for (size_t i = 0; i < remote_bitbang_nb_scans; i++) {
+		if (retval == ERROR_OK &&
+				jtag_read_buffer(remote_bitbang_scans[i].buf, remote_bitbang_scans[i].cmd) != ERROR_OK)
+			retval = ERROR_JTAG_QUEUE_FAILED;
+		free(remote_bitbang_scans[i].buf);
+	}
+	remote_bitbang_nb_scans = 0;
+
+	return retval;
+}
+
+static int remote_bitbang_frame_execute_queue(void)
+{
+	int retval = ERROR_OK;
+
+	for (struct jtag_command *cmd = jtag_command_queue; retval == ERROR_OK && cmd; cmd = cmd->next) {
+		switch (cmd->type) {
+		case JTAG_RUNTEST:
+			retval = remote_bitbang_frame_runtest(cmd->cmd.runtest->num_cycles,
+					cmd->cmd.runtest->end_state);
+			break;
+		case JTAG_STABLECLOCKS:
+			retval = remote_bitbang_frame_shift(cmd->cmd.stableclocks->num_cycles,
+					tap_get_state() == TAP_RESET ? RB_SHIFT_TMS_HIGH : 0, NULL, NULL, NULL);
+			break;
+		case JTAG_TLR_RESET:
+			retval = remote_bitbang_frame_state_move(cmd->cmd.statemove->end_state);
+			break;
+		case JTAG_PATHMOVE:
+			retval = remote_bitbang_frame_path_move(cmd->cmd.pathmove);
+			break;
+		case JTAG_TMS:
+			retval = remote_bitbang_frame_shift(cmd->cmd.tms->num_bits, 0,
+					cmd->cmd.tms->bits, NULL, NULL);
+			break;
+		case JTAG_SCAN:
+			retval = remote_bitbang_frame_scan(cmd->cmd.scan);
+			break;
+		case JTAG_SLEEP:
+			retval = remote_bitbang_frame_complete();
+			jtag_sleep(cmd->cmd.sleep->us);
+			break;
+		default:
+			LOG_ERROR("BUG: unknown JTAG command type encountered");
+			retval = ERROR_FAIL;
+			break;
+		}
+	}
+
+	return remote_bitbang_frame_finish(retval);
+}
+
+/* SWD over frames, falling back to the bitbang SWD driver without them */
+
+static int remote_bitbang_swd_init(void)
+{
+	return bitbang_swd.init();
+}
+
+static int remote_bitbang_frame_swd_seq(const uint8_t *bits, unsigned int nb_bits)
+{
+	unsigned int nb_bytes = DIV_ROUND_UP(nb_bits, 8);
+
+	uint8_t *p = remote_bitbang_frame_add(RB_OP_SWD_SEQ, 4 + nb_bytes, 0);
+	if (!p)
+		return ERROR_FAIL;
+
+	h_u32_to_le(p, nb_bits);
+	if (bits)
+		memcpy(p + 4, bits, nb_bytes);
+	else
+		memset(p + 4, 0, nb_bytes);
+
+	return ERROR_OK;
+}
+
+static int remote_bitbang_swd_switch_seq(enum swd_special_seq seq)
+{
+	if (!remote_bitbang_frames)
+		return bitbang_swd.switch_seq(seq);
+
+	switch (seq) {
+	case LINE_RESET:
+		LOG_DEBUG_IO("SWD line reset");
+		return remote_bitbang_frame_swd_seq(swd_seq_line_reset, swd_seq_line_reset_len);
+	case JTAG_TO_SWD:
+		LOG_DEBUG("JTAG-to-SWD");
+		return remote_bitbang_frame_swd_seq(swd_seq_jtag_to_swd, swd_seq_jtag_to_swd_len);
+	case JTAG_TO_DORMANT:
+		LOG_DEBUG("JTAG-to-DORMANT");
+		return remote_bitbang_frame_swd_seq(swd_seq_jtag_to_dormant, swd_seq_jtag_to_dormant_len);
+	case SWD_TO_JTAG:
+		LOG_DEBUG("SWD-to-JTAG");
+		return remote_bitbang_frame_swd_seq(swd_seq_swd_to_jtag, swd_seq_swd_to_jtag_len);
+	case SWD_TO_DORMANT:
+		LOG_DEBUG("SWD-to-DORMANT");
+		return remote_bitbang_frame_swd_seq(swd_seq_swd_to_dormant, swd_seq_swd_to_dormant_len);
+	case DORMANT_TO_SWD:
+		LOG_DEBUG("DORMANT-to-SWD");
+		return remote_bitbang_frame_swd_seq(swd_seq_dormant_to_swd, swd_seq_dormant_to_swd_len);
+	case DORMANT_TO_JTAG:
+		LOG_DEBUG("DORMANT-to-JTAG");
+		return remote_bitbang_frame_swd_seq(swd_seq_dormant_to_jtag, swd_seq_dormant_to_jtag_len);
+	default:
+		LOG_ERROR("Sequence %d not supported", seq);
+		return ERROR_FAIL;
+	}
+}
+
+static void remote_bitbang_frame_swd_xfer(uint8_t cmd, uint32_t *value, uint32_t data,
+		uint32_t ap_delay_clk)
+{
+	if (queued_retval != ERROR_OK) {
+		LOG_DEBUG("Skip SWD transfer because queued_retval=%d", queued_retval);
+		return;
+	}
+
+	/* the server retries transfers answered WAIT, and clocks the AP delay */
+	uint8_t *p = remote_bitbang_frame_add(RB_OP_SWD_XFER, RB_SWD_XFER_SIZE, RB_SWD_RESULT_SIZE);
+	if (!p) {
+		queued_retval = ERROR_FAIL;
+		return;
+	}
+
+	cmd |= SWD_CMD_START | SWD_CMD_PARK;
+	p[0] = cmd;
+	h_u32_to_le(p + 1, data);
+	h_u32_to_le(p + 5, (cmd & SWD_CMD_APNDP) ? ap_delay_clk : 0);
+
+	struct remote_bitbang_result result = {
+		.op = RB_OP_SWD_XFER,
+		.cmd = cmd,
+		.value = value,
+	};
+	if (remote_bitbang_frame_result(&result) != ERROR_OK)
+		queued_retval = ERROR_FAIL;
+}
+
+static void remote_bitbang_swd_read_reg(uint8_t cmd, uint32_t *value, uint32_t ap_delay_clk)
+{
+	assert(cmd & SWD_CMD_RNW);
+
+	if (!remote_bitbang_frames)
+		bitbang_swd.read_reg(cmd, value, ap_delay_clk);
+	else
+		remote_bitbang_frame_swd_xfer(cmd, value, 0, ap_delay_clk);
+}
+
+static void remote_bitbang_swd_write_reg(uint8_t cmd, uint32_t value, uint32_t ap_delay_clk)
+{
+	assert(!(cmd & SWD_CMD_RNW));
+
+	if (!remote_bitbang_frames)
+		bitbang_swd.write_reg(cmd, value, ap_delay_clk);
+	else
+		remote_bitbang_frame_swd_xfer(cmd, NULL, value, ap_delay_clk);
+}
+
+static int remote_bitbang_swd_run_queue(void)
+{
+	if (!remote_bitbang_frames)
+		return bitbang_swd.run();
+
+	/* A transaction must be followed by another transaction or at least 8 idle cycles to
+	 * ensure that data is clocked through the AP. */
+	int retval = remote_bitbang_frame_swd_seq(NULL, 8);
+	if (retval == ERROR_OK)
+		retval = remote_bitbang_frame_complete();
+	if (retval == ERROR_OK)
+		retval = queued_retval;
+
+	queued_retval = ERROR_OK;
+	LOG_DEBUG_IO("SWD queue return value: %02x", retval);
+	return retval;
+}
+
+static const struct swd_driver remote_bitbang_swd = {
+	.init = remote_bitbang_swd_init,
+	.switch_seq = remote_bitbang_swd_switch_seq,
+	.read_reg = remote_bitbang_swd_read_reg,
+	.write_reg = remote_bitbang_swd_write_reg,
+	.run = remote_bitbang_swd_run_queue,
 };
 
 static int remote_bitbang_init_tcp(void)
@@ -324,6 +1112,10 @@ static int remote_bitbang_init(void)
 	socket_nonblock(remote_bitbang_fd);
 
 	LOG_INFO("remote_bitbang driver initialized");
+
+	if (remote_bitbang_use_frames)
+		return remote_bitbang_frame_query();
+
 	return ERROR_OK;
 }
 
@@ -349,6 +1141,15 @@ COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_host_command)
 	return ERROR_COMMAND_SYNTAX_ERROR;
 }
 
+COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_use_frames_command)
+{
+	if (CMD_ARGC == 1) {
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[0], remote_bitbang_use_frames);
+		return ERROR_OK;
+	}
+	return ERROR_COMMAND_SYNTAX_ERROR;
+}
+
 static const struct command_registration remote_bitbang_subcommand_handlers[] = {
 	{
 		.name = "port",
@@ -366,6 +1167,14 @@ static const struct command_registration remote_bitbang_subcommand_handlers[] =
 			"  if port is 0 or unset, this is the name of the unix socket to use.",
 		.usage = "host_name",
 	},
+	{
+		.name = "use_frames",
+		.handler = remote_bitbang_handle_remote_bitbang_use_frames_command,
+		.mode = COMMAND_CONFIG,
+		.help = "Use binary frames carrying whole scans and SWD transfers,\n"
+			"  if the remote process supports them.",
+		.usage = "(on|off)",
+	},
 	COMMAND_REGISTRATION_DONE,
 };
 
@@ -386,6 +1195,9 @@ static int remote_bitbang_execute_queue(void)
 	 * previous transactions */
 	assert(remote_bitbang_send_buf_used == 0);
 
+	if (remote_bitbang_frames)
+		return remote_bitbang_frame_execute_queue();
+
 	/* process the JTAG command queue */
 	int ret = bitbang_execute_queue();
 	if (ret != ERROR_OK)
@@ -399,9 +1211,11 @@ static struct jtag_interface remote_bitbang_interface = {
 	.execute_queue = &remote_bitbang_execute_queue,
 };
 
+static const char * const remote_bitbang_transports[] = { "jtag", "swd", NULL };
+
 struct adapter_driver remote_bitbang_adapter_driver = {
 	.name = "remote_bitbang",
-	.transports = jtag_only,
+	.transports = remote_bitbang_transports,
 	.commands = remote_bitbang_command_handlers,
 
 	.init = &remote_bitbang_init,
@@ -409,4 +1223,5 @@ struct adapter_driver remote_bitbang_adapter_driver = {
 	.reset = &remote_bitbang_reset,
 
 	.jtag_ops = &remote_bitbang_interface,
+	.swd_ops = &remote_bitbang_swd,
 };
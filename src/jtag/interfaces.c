@@ -139,6 +139,9 @@ extern struct adapter_driver stlink_dap_adapter_driver;
 #if BUILD_RSHIM == 1
 extern struct adapter_driver rshim_dap_adapter_driver;
 #endif
+#if BUILD_DAP_REPLAY == 1
+extern struct adapter_driver dap_replay_adapter_driver;
+#endif
 #if BUILD_AM335XGPIO == 1
 extern struct adapter_driver am335xgpio_adapter_driver;
 #endif
@@ -256,6 +259,9 @@ struct adapter_driver *adapter_drivers[] = {
 #if BUILD_RSHIM == 1
 		&rshim_dap_adapter_driver,
 #endif
+#if BUILD_DAP_REPLAY == 1
+		&dap_replay_adapter_driver,
+#endif
 #if BUILD_AM335XGPIO == 1
 		&am335xgpio_adapter_driver,
 #endif
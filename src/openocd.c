@@ -27,6 +27,7 @@
 #include <target/arm_cti.h>
 #include <target/arm_adi_v5.h>
 #include <target/arm_tpiu_swo.h>
+#include <target/profiler.h>
 #include <rtt/rtt.h>
 
 #include <server/server.h>
@@ -256,6 +257,7 @@ static struct command_context *setup_command_handler(Jim_Interp *interp)
 		&cti_register_commands,
 		&dap_register_commands,
 		&arm_tpiu_swo_register_commands,
+		&profiler_register_commands,
 		NULL
 	};
 	for (unsigned i = 0; command_registrants[i]; i++) {
@@ -354,6 +356,7 @@ int openocd_main(int argc, char *argv[])
 	flash_free_all_banks();
 	gdb_service_free();
 	arm_tpiu_swo_cleanup_all();
+	profiler_cleanup();
 	server_free();
 
 	unregister_all_commands(cmd_ctx, NULL);
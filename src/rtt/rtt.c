@@ -64,6 +64,9 @@ int rtt_init(void)
 
 int rtt_exit(void)
 {
+	if (rtt_trace_running())
+		rtt_trace_stop();
+
 	free(rtt.sink_list);
 
 	return ERROR_OK;
@@ -208,6 +211,11 @@ int rtt_register_sink(unsigned int channel_index, rtt_sink_read read,
 {
 	struct rtt_sink_list *tmp;
 
+	if (rtt_trace_uses_channel(channel_index)) {
+		LOG_ERROR("rtt: Channel %u is used by the trace", channel_index);
+		return ERROR_FAIL;
+	}
+
 	if (channel_index >= rtt.sink_list_length) {
 		if (adjust_sink_list(channel_index + 1) != ERROR_OK)
 			return ERROR_FAIL;
@@ -297,6 +305,23 @@ int rtt_write_channel(unsigned int channel_index, const uint8_t *buffer,
 		length, NULL);
 }
 
+int rtt_read_channel(unsigned int channel_index, uint8_t *buffer,
+		size_t *length, bool *pending)
+{
+	if (!rtt.source.read_channel) {
+		LOG_ERROR("rtt: Bulk channel read not supported");
+		return ERROR_NOT_IMPLEMENTED;
+	}
+
+	return rtt.source.read_channel(rtt.target, &rtt.ctrl, channel_index,
+		buffer, length, pending, NULL);
+}
+
+bool rtt_channel_has_sinks(unsigned int channel_index)
+{
+	return channel_index < rtt.sink_list_length && rtt.sink_list[channel_index];
+}
+
 bool rtt_started(void)
 {
 	return rtt.started;
@@ -114,6 +114,9 @@ typedef int (*rtt_source_read)(struct target *target,
 typedef int (*rtt_source_write)(struct target *target,
 		struct rtt_control *ctrl, unsigned int channel,
 		const uint8_t *buffer, size_t *length, void *user_data);
+typedef int (*rtt_source_read_channel)(struct target *target,
+		const struct rtt_control *ctrl, unsigned int channel,
+		uint8_t *buffer, size_t *length, bool *pending, void *user_data);
 
 /** RTT source. */
 struct rtt_source {
@@ -124,6 +127,8 @@ struct rtt_source {
 	rtt_source_stop stop;
 	rtt_source_read read;
 	rtt_source_write write;
+	/** Bulk read of one up-channel, optional. */
+	rtt_source_read_channel read_channel;
 };
 
 /**
@@ -271,6 +276,61 @@ int rtt_unregister_sink(unsigned int channel_index, rtt_sink_read read,
 int rtt_write_channel(unsigned int channel_index, const uint8_t *buffer,
 		size_t *length);
 
+/**
+ * Read from an RTT up-channel, independently of the registered sinks.
+ * @param[in] channel_index Channel index.
+ * @param[out] buffer Buffer for the data read from the channel.
+ * @param[in,out] length Size of the buffer in bytes. On success, the argument
+ *                       gets updated with the number of bytes read.
+ * @param[out] pending Whether data is left in the channel after the read.
+ * @returns ERROR_OK on success, an error code on failure.
+ */
+int rtt_read_channel(unsigned int channel_index, uint8_t *buffer,
+		size_t *length, bool *pending);
+
+/**
+ * Get whether sinks are registered for a channel.
+ * @param[in] channel_index Channel index.
+ * @returns Whether sinks are registered.
+ */
+bool rtt_channel_has_sinks(unsigned int channel_index);
+
+/**
+ * Start the bulk trace of an RTT up-channel to a trace destination.
+ * @param[in] channel_index Channel index.
+ * @param[in] dest Destination, "file://path", "tcp://host:port" or "con:".
+ * @param[in] block_size Size of the trace blocks in bytes.
+ * @param[in] num_blocks Number of trace blocks.
+ * @param[in] poll_period Polling period of the channel in milliseconds.
+ * @returns ERROR_OK on success, an error code on failure.
+ */
+int rtt_trace_start(unsigned int channel_index, const char *dest,
+		uint32_t block_size, unsigned int num_blocks, unsigned int poll_period);
+
+/**
+ * Stop the bulk trace, writing the data already read to the destination.
+ * @returns ERROR_OK on success, an error code on failure.
+ */
+int rtt_trace_stop(void);
+
+/**
+ * Get whether the bulk trace is running.
+ * @returns Whether the bulk trace is running.
+ */
+bool rtt_trace_running(void);
+
+/**
+ * Get whether the bulk trace reads a channel.
+ * @param[in] channel_index Channel index.
+ * @returns Whether the bulk trace reads the channel.
+ */
+bool rtt_trace_uses_channel(unsigned int channel_index);
+
+/**
+ * Print the bulk trace statistics.
+ */
+void rtt_trace_print_stats(void);
+
 extern const struct command_registration rtt_target_command_handlers[];
 
 #endif /* OPENOCD_RTT_RTT_H */
@@ -15,6 +15,10 @@
 
 #define CHANNEL_NAME_SIZE	128
 
+#define TRACE_BLOCK_SIZE	4096
+#define TRACE_NUM_BLOCKS	8
+#define TRACE_POLL_PERIOD	10
+
 COMMAND_HANDLER(handle_rtt_setup_command)
 {
 struct rtt_source source;
@@ -29,6 +33,7 @@ struct rtt_source source;
 	source.read = &target_rtt_read_callback;
 	source.write = &target_rtt_write_callback;
 	source.read_channel_info = &target_rtt_read_channel_info;
+	source.read_channel = &target_rtt_read_channel_callback;
 
 	target_addr_t address;
 	uint32_t size;
@@ -212,6 +217,79 @@ COMMAND_HANDLER(handle_channel_list)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_rtt_trace_start_command)
+{
+	unsigned int channel;
+	uint32_t block_size = TRACE_BLOCK_SIZE;
+	unsigned int num_blocks = TRACE_NUM_BLOCKS;
+	unsigned int poll_period = TRACE_POLL_PERIOD;
+
+	if (CMD_ARGC < 2 || CMD_ARGC > 5)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], channel);
+
+	if (CMD_ARGC > 2)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[2], block_size);
+
+	if (CMD_ARGC > 3)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[3], num_blocks);
+
+	if (CMD_ARGC > 4)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[4], poll_period);
+
+	if (!rtt_configured()) {
+		command_print(CMD, "RTT is not configured");
+		return ERROR_FAIL;
+	}
+
+	return rtt_trace_start(channel, CMD_ARGV[1], block_size, num_blocks,
+		poll_period);
+}
+
+COMMAND_HANDLER(handle_rtt_trace_stop_command)
+{
+	if (CMD_ARGC > 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	return rtt_trace_stop();
+}
+
+COMMAND_HANDLER(handle_rtt_trace_status_command)
+{
+	if (CMD_ARGC > 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	rtt_trace_print_stats();
+
+	return ERROR_OK;
+}
+
+static const struct command_registration rtt_trace_subcommand_handlers[] = {
+	{
+		.name = "start",
+		.handler = handle_rtt_trace_start_command,
+		.mode = COMMAND_EXEC,
+		.help = "start the bulk trace of an up-channel",
+		.usage = "<channel> <destination> [block_size [num_blocks [poll_period]]]"
+	},
+	{
+		.name = "stop",
+		.handler = handle_rtt_trace_stop_command,
+		.mode = COMMAND_EXEC,
+		.help = "stop the bulk trace",
+		.usage = ""
+	},
+	{
+		.name = "status",
+		.handler = handle_rtt_trace_status_command,
+		.mode = COMMAND_EXEC,
+		.help = "show the bulk trace statistics",
+		.usage = ""
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 static const struct command_registration rtt_subcommand_handlers[] = {
 	{
 		.name = "setup",
@@ -255,6 +333,13 @@ static const struct command_registration rtt_subcommand_handlers[] = {
 		.help = "list available channels",
 		.usage = ""
 	},
+	{
+		.name = "trace",
+		.mode = COMMAND_EXEC,
+		.help = "RTT bulk trace commands",
+		.usage = "",
+		.chain = rtt_trace_subcommand_handlers
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -0,0 +1,220 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Bulk trace of an RTT up-channel through the application trace transport.
+ *
+ * The channel is polled with reads of whole trace blocks, as long as the
+ * channel holds data and a block is free. The blocks read are queued and
+ * written to the destination by the data processor, which runs from its
+ * own timer callback and writes one block per run, so that the queued
+ * blocks absorb bursts of trace data. Both callbacks run from the main
+ * loop, reads and writes do not overlap. When all the blocks are in
+ * use the data stays in the channel buffer on the target, and the firmware
+ * sees a full channel instead of the host dropping data.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/log.h>
+#include <helper/time_support.h>
+#include <target/target.h>
+#include <target/apptrace.h>
+
+#include "rtt.h"
+
+static struct {
+	bool running;
+	unsigned int channel;
+	struct apptrace_dest dest;
+	struct apptrace_blocks blocks;
+	struct apptrace_stats stats;
+	uint64_t tot_len;
+	struct duration read_time;
+} trace;
+
+static int rtt_trace_data_processor(void *priv)
+{
+	struct apptrace_block *block = apptrace_ready_block_get(&trace.blocks);
+	struct duration proc_time;
+
+	if (!block)
+		return ERROR_OK;
+
+	duration_start(&proc_time);
+
+	int ret = trace.dest.write(trace.dest.priv, block->data, block->data_len);
+
+	if (ret != ERROR_OK) {
+		LOG_ERROR("rtt: Failed to write %" PRIu32 " bytes of trace data",
+			block->data_len);
+		trace.stats.lost_bytes += block->data_len;
+	} else {
+		trace.tot_len += block->data_len;
+	}
+
+	if (duration_measure(&proc_time) == 0)
+		apptrace_stats_blk_proc(&trace.stats, duration_elapsed(&proc_time));
+
+	return apptrace_block_free(&trace.blocks, block);
+}
+
+static void rtt_trace_cleanup(void);
+
+static int rtt_trace_poll(void *priv)
+{
+	bool pending = true;
+
+	if (!rtt_started())
+		return ERROR_OK;
+
+	while (pending) {
+		struct apptrace_block *block = apptrace_free_block_get(&trace.blocks);
+		struct duration read_time;
+
+		if (!block) {
+			trace.stats.stalls++;
+			break;
+		}
+
+		duration_start(&read_time);
+
+		size_t length = trace.blocks.block_size;
+		int ret = rtt_read_channel(trace.channel, block->data, &length,
+			&pending);
+
+		if (ret != ERROR_OK) {
+			apptrace_block_free(&trace.blocks, block);
+			LOG_ERROR("rtt: Failed to read the trace data, trace stopped");
+			rtt_trace_cleanup();
+			return ret;
+		}
+
+		if (!length) {
+			apptrace_block_free(&trace.blocks, block);
+			break;
+		}
+
+		if (duration_measure(&read_time) == 0)
+			apptrace_stats_blk_read(&trace.stats, duration_elapsed(&read_time));
+
+		block->data_len = length;
+		apptrace_ready_block_put(&trace.blocks, block);
+	}
+
+	return ERROR_OK;
+}
+
+int rtt_trace_start(unsigned int channel_index, const char *dest,
+		uint32_t block_size, unsigned int num_blocks, unsigned int poll_period)
+{
+	int ret;
+
+	if (trace.running) {
+		LOG_ERROR("rtt: Trace is already running");
+		return ERROR_FAIL;
+	}
+
+	if (!block_size || !num_blocks) {
+		LOG_ERROR("rtt: Invalid trace block size or count");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	if (rtt_channel_has_sinks(channel_index)) {
+		LOG_ERROR("rtt: Up-channel %u is already in use", channel_index);
+		return ERROR_FAIL;
+	}
+
+	memset(&trace.dest, 0, sizeof(trace.dest));
+	if (apptrace_dest_init(&trace.dest, &dest, 1) != 1) {
+		LOG_ERROR("rtt: Invalid trace destination '%s'", dest);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	ret = apptrace_blocks_init(&trace.blocks, num_blocks, block_size);
+
+	if (ret != ERROR_OK) {
+		apptrace_dest_cleanup(&trace.dest, 1);
+		return ret;
+	}
+
+	trace.channel = channel_index;
+	trace.tot_len = 0;
+	apptrace_stats_init(&trace.stats);
+	duration_start(&trace.read_time);
+
+	ret = target_register_timer_callback(&rtt_trace_data_processor, 0,
+		TARGET_TIMER_TYPE_PERIODIC, NULL);
+
+	if (ret == ERROR_OK)
+		ret = target_register_timer_callback(&rtt_trace_poll, poll_period,
+			TARGET_TIMER_TYPE_PERIODIC, NULL);
+
+	if (ret != ERROR_OK) {
+		target_unregister_timer_callback(&rtt_trace_data_processor, NULL);
+		apptrace_blocks_cleanup(&trace.blocks);
+		apptrace_dest_cleanup(&trace.dest, 1);
+		return ret;
+	}
+
+	trace.running = true;
+
+	LOG_INFO("rtt: Tracing up-channel %u to %s, %u blocks of %" PRIu32
+		" bytes", channel_index, dest, num_blocks, block_size);
+
+	return ERROR_OK;
+}
+
+/* write the blocks already read, then release the trace resources */
+static void rtt_trace_cleanup(void)
+{
+	target_unregister_timer_callback(&rtt_trace_poll, NULL);
+
+	/* write the blocks already read */
+	while (apptrace_blocks_pending(&trace.blocks))
+		rtt_trace_data_processor(NULL);
+
+	target_unregister_timer_callback(&rtt_trace_data_processor, NULL);
+
+	duration_measure(&trace.read_time);
+	trace.running = false;
+	rtt_trace_print_stats();
+
+	apptrace_blocks_cleanup(&trace.blocks);
+	apptrace_dest_cleanup(&trace.dest, 1);
+}
+
+int rtt_trace_stop(void)
+{
+	if (!trace.running) {
+		LOG_ERROR("rtt: Trace is not running");
+		return ERROR_FAIL;
+	}
+
+	rtt_trace_cleanup();
+
+	return ERROR_OK;
+}
+
+bool rtt_trace_running(void)
+{
+	return trace.running;
+}
+
+bool rtt_trace_uses_channel(unsigned int channel_index)
+{
+	return trace.running && trace.channel == channel_index;
+}
+
+void rtt_trace_print_stats(void)
+{
+	if (trace.running)
+		duration_measure(&trace.read_time);
+
+	LOG_USER("Tracing is %s. Size is %" PRIu64 " bytes @ %f KiB/s",
+		trace.running ? "RUNNING" : "STOPPED",
+		trace.tot_len,
+		duration_kbps(&trace.read_time, trace.tot_len));
+	apptrace_stats_print(&trace.stats);
+}
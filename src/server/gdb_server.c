@@ -57,9 +57,17 @@ enum gdb_output_flag {
 	GDB_OUTPUT_ALL,
 };
 
-struct target_desc_format {
+/* target description and memory map of a target, shared by all connections
+ * and regenerated only when the register or flash layout changes */
+struct gdb_xml_cache {
+	struct target *target;
 	char *tdesc;
 	uint32_t tdesc_length;
+	uint32_t tdesc_hash;
+	char *memory_map;
+	uint32_t memory_map_length;
+	uint32_t memory_map_hash;
+	struct gdb_xml_cache *next;
 };
 
 /* private connection data for GDB */
@@ -89,8 +97,6 @@ struct gdb_connection {
 	bool attached;
 	/* set when extended protocol is used */
 	bool extended_protocol;
-	/* temporarily used for target description support */
-	struct target_desc_format target_desc;
 	/* temporarily used for thread list support */
 	char *thread_list;
 	/* flag to mask the output from gdb_log_callback() */
@@ -107,6 +113,8 @@ static int gdb_breakpoint_override;
 static enum breakpoint_type gdb_breakpoint_override_type;
 
 static int gdb_error(struct connection *connection, int retval);
+
+static struct gdb_xml_cache *gdb_xml_caches;
 static char *gdb_port;
 static char *gdb_port_next;
 
@@ -114,6 +122,8 @@ static void gdb_log_callback(void *priv, const char *file, unsigned line,
 		const char *function, const char *string);
 
 static void gdb_sig_halted(struct connection *connection);
+static void gdb_str_to_target(struct target *target,
+		char *tstr, struct reg *reg);
 
 /* number of gdb connections, mainly to suppress gdb related debugging spam
  * in helper/log.c when no gdb connections are actually active */
@@ -775,19 +785,102 @@ static int gdb_output(struct command_context *context, const char *line)
 	return ERROR_OK;
 }
 
+/* Registers expedited in stop replies when the target does not configure
+ * its own list; names missing on an architecture are skipped. */
+static const char *const gdb_default_expedited_regs[] = {
+	"pc", "sp", "lr", "fp", "xpsr", "cpsr", NULL
+};
+
+static bool gdb_is_expedited_reg(struct target *target, const char *name)
+{
+	const char *list = target->gdb_expedited_regs;
+
+	if (!list) {
+		for (unsigned int i = 0; gdb_default_expedited_regs[i]; i++)
+			if (strcmp(gdb_default_expedited_regs[i], name) == 0)
+				return true;
+		return false;
+	}
+
+	size_t len = strlen(name);
+	while (*list) {
+		list += strspn(list, " ");
+		size_t item_len = strcspn(list, " ");
+		if (item_len == len && strncmp(list, name, len) == 0)
+			return true;
+		list += item_len;
+	}
+
+	return false;
+}
+
+/**
+ * Build the "nn:value;" fields of a T stop reply for the expedited registers.
+ * Only registers already valid in the register cache are sent, so this
+ * never causes any target access; GDB fetches anything missing itself.
+ * @returns an allocated string, possibly empty, or NULL on error
+ */
+static char *gdb_expedited_registers(struct target *target)
+{
+	struct reg **reg_list;
+	int reg_list_size;
+
+	if (target->gdb_expedited_regs && strcmp(target->gdb_expedited_regs, "none") == 0)
+		return strdup("");
+
+	if (target_get_gdb_reg_list_noread(target, &reg_list, &reg_list_size,
+			REG_CLASS_ALL) != ERROR_OK)
+		return strdup("");
+
+	size_t len = 0;
+	for (int i = 0; i < reg_list_size; i++) {
+		struct reg *reg = reg_list[i];
+		if (!reg || !reg->exist || reg->hidden || !reg->valid)
+			continue;
+		if (gdb_is_expedited_reg(target, reg->name))
+			len += 8 + 1 + DIV_ROUND_UP(reg->size, 8) * 2 + 1;
+	}
+
+	char *fields = malloc(len + 1);
+	if (!fields) {
+		free(reg_list);
+		return NULL;
+	}
+
+	char *p = fields;
+	*p = '\0';
+	for (int i = 0; i < reg_list_size; i++) {
+		struct reg *reg = reg_list[i];
+		if (!reg || !reg->exist || reg->hidden || !reg->valid)
+			continue;
+		if (!gdb_is_expedited_reg(target, reg->name))
+			continue;
+		p += sprintf(p, "%" PRIx32 ":", reg->number);
+		gdb_str_to_target(target, p, reg);
+		p += DIV_ROUND_UP(reg->size, 8) * 2;
+		*p++ = ';';
+		*p = '\0';
+	}
+
+	free(reg_list);
+	return fields;
+}
+
 static void gdb_signal_reply(struct target *target, struct connection *connection)
 {
 	struct gdb_connection *gdb_connection = connection->priv;
-	char sig_reply[65];
+	char *sig_reply;
 	char stop_reason[32];
 	char current_thread[25];
+	char *expedited;
 	int sig_reply_len;
 	int signal_var;
 
 	rtos_update_threads(target);
 
 	if (target->debug_reason == DBG_REASON_EXIT) {
-		sig_reply_len = snprintf(sig_reply, sizeof(sig_reply), "W00");
+		sig_reply = strdup("W00");
+		sig_reply_len = 3;
 	} else {
 		struct target *ct;
 		if (target->rtos) {
@@ -833,13 +926,24 @@ static void gdb_signal_reply(struct target *target, struct connection *connectio
 			snprintf(current_thread, sizeof(current_thread), "thread:%" PRIx64 ";",
 					target->rtos->current_thread);
 
-		sig_reply_len = snprintf(sig_reply, sizeof(sig_reply), "T%2.2x%s%s",
-				signal_var, stop_reason, current_thread);
+		/* with an RTOS the register cache holds the values of the core,
+		 * not necessarily the ones of the thread reported to GDB */
+		if (target->rtos)
+			expedited = strdup("");
+		else
+			expedited = gdb_expedited_registers(ct);
+
+		sig_reply = alloc_printf("T%2.2x%s%s%s", signal_var,
+				expedited ? expedited : "", stop_reason, current_thread);
+		sig_reply_len = sig_reply ? strlen(sig_reply) : 0;
+		free(expedited);
 
 		gdb_connection->ctrl_c = false;
 	}
 
-	gdb_put_packet(connection, sig_reply, sig_reply_len);
+	if (sig_reply)
+		gdb_put_packet(connection, sig_reply, sig_reply_len);
+	free(sig_reply);
 	gdb_connection->frontend_state = TARGET_HALTED;
 }
 
@@ -1003,8 +1107,6 @@ static int gdb_new_connection(struct connection *connection)
 	gdb_connection->mem_write_error = false;
 	gdb_connection->attached = true;
 	gdb_connection->extended_protocol = false;
-	gdb_connection->target_desc.tdesc = NULL;
-	gdb_connection->target_desc.tdesc_length = 0;
 	gdb_connection->thread_list = NULL;
 	gdb_connection->output_flag = GDB_OUTPUT_NO;
 
@@ -1259,6 +1361,11 @@ static int gdb_get_registers_packet(struct connection *connection,
 
 	reg_packet_p = reg_packet;
 
+	/* let the target fetch the invalid registers in one go, the loop
+	 * below reads whatever it could not get one register at a time */
+	if (target_read_registers(target, reg_list, reg_list_size) != ERROR_OK)
+		LOG_DEBUG("Batched register read failed, reading registers one by one");
+
 	for (i = 0; i < reg_list_size; i++) {
 		if (!reg_list[i] || reg_list[i]->exist == false || reg_list[i]->hidden)
 			continue;
@@ -1882,6 +1989,47 @@ static int decode_xfer_read(char const *buf, char **annex, int *ofs, unsigned in
 	return ERROR_OK;
 }
 
+static struct gdb_xml_cache *gdb_get_xml_cache(struct target *target)
+{
+	struct gdb_xml_cache *cache;
+
+	for (cache = gdb_xml_caches; cache; cache = cache->next)
+		if (cache->target == target)
+			return cache;
+
+	cache = calloc(1, sizeof(*cache));
+	if (!cache) {
+		LOG_ERROR("Unable to allocate memory");
+		return NULL;
+	}
+
+	cache->target = target;
+	cache->next = gdb_xml_caches;
+	gdb_xml_caches = cache;
+	return cache;
+}
+
+/* FNV-1a, only used to notice layout changes */
+#define GDB_HASH_INIT	0x811c9dc5u
+
+static uint32_t gdb_hash(uint32_t hash, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+
+	while (len--) {
+		hash ^= *p++;
+		hash *= 0x01000193u;
+	}
+	return hash;
+}
+
+static uint32_t gdb_hash_str(uint32_t hash, const char *str)
+{
+	if (!str)
+		str = "";
+	return gdb_hash(hash, str, strlen(str) + 1);
+}
+
 static int compare_bank(const void *a, const void *b)
 {
 	struct flash_bank *b1, *b2;
@@ -1896,51 +2044,25 @@ static int compare_bank(const void *a, const void *b)
 		return -1;
 }
 
-static int gdb_memory_map(struct connection *connection,
-		char const *packet, int packet_size)
+/* Flash banks of a target, sorted by address and probed */
+static int gdb_get_target_flash_banks(struct target *target,
+		struct flash_bank ***banks_out, unsigned int *num_banks)
 {
-	/* We get away with only specifying flash here. Regions that are not
-	 * specified are treated as if we provided no memory map(if not we
-	 * could detect the holes and mark them as RAM).
-	 * Normally we only execute this code once, but no big deal if we
-	 * have to regenerate it a couple of times.
-	 */
-
-	struct target *target = get_target_from_connection(connection);
-	struct flash_bank *p;
-	char *xml = NULL;
-	int size = 0;
-	int pos = 0;
-	int retval = ERROR_OK;
 	struct flash_bank **banks;
-	int offset;
-	int length;
-	char *separator;
-	target_addr_t ram_start = 0;
+	struct flash_bank *p;
 	unsigned int target_flash_banks = 0;
 
-	/* skip command character */
-	packet += 23;
-
-	offset = strtoul(packet, &separator, 16);
-	length = strtoul(separator + 1, &separator, 16);
-
-	xml_printf(&retval, &xml, &pos, &size, "<memory-map>\n");
-
-	/* Sort banks in ascending order.  We need to report non-flash
-	 * memory as ram (or rather read/write) by default for GDB, since
-	 * it has no concept of non-cacheable read/write memory (i/o etc).
-	 */
-	banks = malloc(sizeof(struct flash_bank *)*flash_get_bank_count());
+	banks = malloc(sizeof(struct flash_bank *) * (flash_get_bank_count() + 1));
+	if (!banks)
+		return ERROR_FAIL;
 
 	for (unsigned int i = 0; i < flash_get_bank_count(); i++) {
 		p = get_flash_bank_by_num_noprobe(i);
 		if (p->target != target)
 			continue;
-		retval = get_flash_bank_by_num(i, &p);
+		int retval = get_flash_bank_by_num(i, &p);
 		if (retval != ERROR_OK) {
 			free(banks);
-			gdb_error(connection, retval);
 			return retval;
 		}
 		banks[target_flash_banks++] = p;
@@ -1949,6 +2071,52 @@ static int gdb_memory_map(struct connection *connection,
 	qsort(banks, target_flash_banks, sizeof(struct flash_bank *),
 		compare_bank);
 
+	*banks_out = banks;
+	*num_banks = target_flash_banks;
+	return ERROR_OK;
+}
+
+static uint32_t gdb_flash_layout_hash(struct target *target,
+		struct flash_bank **banks, unsigned int num_banks)
+{
+	uint32_t hash = GDB_HASH_INIT;
+	target_addr_t max = target_address_max(target);
+
+	hash = gdb_hash(hash, &max, sizeof(max));
+	hash = gdb_hash(hash, &num_banks, sizeof(num_banks));
+	for (unsigned int i = 0; i < num_banks; i++) {
+		struct flash_bank *p = banks[i];
+
+		hash = gdb_hash(hash, &p, sizeof(p));
+		hash = gdb_hash(hash, &p->base, sizeof(p->base));
+		hash = gdb_hash(hash, &p->size, sizeof(p->size));
+		hash = gdb_hash(hash, &p->num_sectors, sizeof(p->num_sectors));
+		for (unsigned int j = 0; j < p->num_sectors; j++) {
+			hash = gdb_hash(hash, &p->sectors[j].offset, sizeof(p->sectors[j].offset));
+			hash = gdb_hash(hash, &p->sectors[j].size, sizeof(p->sectors[j].size));
+		}
+	}
+
+	return hash;
+}
+
+static int gdb_generate_memory_map(struct target *target,
+		struct flash_bank **banks, unsigned int target_flash_banks,
+		char **xml_out)
+{
+	struct flash_bank *p;
+	char *xml = NULL;
+	int size = 0;
+	int pos = 0;
+	int retval = ERROR_OK;
+	target_addr_t ram_start = 0;
+
+	xml_printf(&retval, &xml, &pos, &size, "<memory-map>\n");
+
+	/* Banks are sorted in ascending order.  We need to report non-flash
+	 * memory as ram (or rather read/write) by default for GDB, since
+	 * it has no concept of non-cacheable read/write memory (i/o etc).
+	 */
 	for (unsigned int i = 0; i < target_flash_banks; i++) {
 		unsigned sector_size = 0;
 		unsigned group_len = 0;
@@ -2020,26 +2188,89 @@ static int gdb_memory_map(struct connection *connection,
 	/* ELSE a flash chip could be at the very end of the address space, in
 	 * which case ram_start will be precisely 0 */
 
-	free(banks);
-
 	xml_printf(&retval, &xml, &pos, &size, "</memory-map>\n");
 
 	if (retval != ERROR_OK) {
 		free(xml);
-		gdb_error(connection, retval);
 		return retval;
 	}
 
+	*xml_out = xml;
+	return ERROR_OK;
+}
+
+static int gdb_memory_map(struct connection *connection,
+		char const *packet, int packet_size)
+{
+	/* We get away with only specifying flash here. Regions that are not
+	 * specified are treated as if we provided no memory map(if not we
+	 * could detect the holes and mark them as RAM).
+	 * The map is generated once and cached until the flash layout of
+	 * the target changes.
+	 */
+
+	struct target *target = get_target_from_connection(connection);
+	struct gdb_xml_cache *cache;
+	int offset;
+	int length;
+	char *separator;
+
+	/* skip command character */
+	packet += 23;
+
+	offset = strtoul(packet, &separator, 16);
+	length = strtoul(separator + 1, &separator, 16);
+
+	cache = gdb_get_xml_cache(target);
+	if (!cache) {
+		gdb_error(connection, ERROR_FAIL);
+		return ERROR_FAIL;
+	}
+
+	/* GDB reads the map from offset 0 first, that is when we check if
+	 * the cached copy is still up to date */
+	if (!cache->memory_map || offset == 0) {
+		struct flash_bank **banks;
+		unsigned int num_banks;
+		int retval = gdb_get_target_flash_banks(target, &banks, &num_banks);
+		if (retval != ERROR_OK) {
+			gdb_error(connection, retval);
+			return retval;
+		}
+
+		uint32_t hash = gdb_flash_layout_hash(target, banks, num_banks);
+		if (!cache->memory_map || hash != cache->memory_map_hash) {
+			char *xml;
+			retval = gdb_generate_memory_map(target, banks, num_banks, &xml);
+			if (retval != ERROR_OK) {
+				free(banks);
+				gdb_error(connection, retval);
+				return retval;
+			}
+			free(cache->memory_map);
+			cache->memory_map = xml;
+			cache->memory_map_length = strlen(xml);
+			cache->memory_map_hash = hash;
+		}
+		free(banks);
+	}
+
+	int pos = cache->memory_map_length;
+	if (offset > pos)
+		offset = pos;
 	if (offset + length > pos)
 		length = pos - offset;
 
 	char *t = malloc(length + 1);
+	if (!t) {
+		gdb_error(connection, ERROR_FAIL);
+		return ERROR_FAIL;
+	}
 	t[0] = 'l';
-	memcpy(t + 1, xml + offset, length);
+	memcpy(t + 1, cache->memory_map + offset, length);
 	gdb_put_packet(connection, t, length + 1);
 
 	free(t);
-	free(xml);
 	return ERROR_OK;
 }
 
@@ -2543,27 +2774,79 @@ error:
 	return retval;
 }
 
-static int gdb_get_target_description_chunk(struct target *target, struct target_desc_format *target_desc,
+static int gdb_reg_layout_hash(struct target *target, uint32_t *hash_out)
+{
+	struct reg **reg_list = NULL;
+	int reg_list_size;
+	uint32_t hash = GDB_HASH_INIT;
+
+	int retval = smp_reg_list_noread(target, &reg_list, &reg_list_size,
+			REG_CLASS_ALL);
+	if (retval != ERROR_OK)
+		return retval;
+
+	hash = gdb_hash_str(hash, target_get_gdb_arch(target));
+	hash = gdb_hash(hash, &reg_list_size, sizeof(reg_list_size));
+	for (int i = 0; i < reg_list_size; i++) {
+		struct reg *r = reg_list[i];
+
+		hash = gdb_hash(hash, &r, sizeof(r));
+		hash = gdb_hash_str(hash, r->name);
+		hash = gdb_hash(hash, &r->number, sizeof(r->number));
+		hash = gdb_hash(hash, &r->size, sizeof(r->size));
+		hash = gdb_hash(hash, &r->exist, sizeof(r->exist));
+		hash = gdb_hash(hash, &r->hidden, sizeof(r->hidden));
+		hash = gdb_hash(hash, &r->caller_save, sizeof(r->caller_save));
+		hash = gdb_hash(hash, &r->feature, sizeof(r->feature));
+		hash = gdb_hash(hash, &r->reg_data_type, sizeof(r->reg_data_type));
+		hash = gdb_hash_str(hash, r->group);
+	}
+
+	free(reg_list);
+	*hash_out = hash;
+	return ERROR_OK;
+}
+
+static int gdb_get_target_description_chunk(struct target *target,
 		char **chunk, int32_t offset, uint32_t length)
 {
-	if (!target_desc) {
+	struct gdb_xml_cache *cache = gdb_get_xml_cache(target);
+	if (!cache) {
 		LOG_ERROR("Unable to Generate Target Description");
 		return ERROR_FAIL;
 	}
 
-	char *tdesc = target_desc->tdesc;
-	uint32_t tdesc_length = target_desc->tdesc_length;
-
-	if (!tdesc) {
-		int retval = gdb_generate_target_description(target, &tdesc);
+	/* GDB reads the description from offset 0 first, that is when we
+	 * check if the cached copy is still up to date */
+	if (!cache->tdesc || offset == 0) {
+		uint32_t hash;
+		int retval = gdb_reg_layout_hash(target, &hash);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("Unable to Generate Target Description");
 			return ERROR_FAIL;
 		}
 
-		tdesc_length = strlen(tdesc);
+		if (!cache->tdesc || hash != cache->tdesc_hash) {
+			char *tdesc;
+			retval = gdb_generate_target_description(target, &tdesc);
+			if (retval != ERROR_OK) {
+				LOG_ERROR("Unable to Generate Target Description");
+				return ERROR_FAIL;
+			}
+
+			free(cache->tdesc);
+			cache->tdesc = tdesc;
+			cache->tdesc_length = strlen(tdesc);
+			cache->tdesc_hash = hash;
+		}
 	}
 
+	char *tdesc = cache->tdesc;
+	uint32_t tdesc_length = cache->tdesc_length;
+
+	if (offset < 0 || (uint32_t)offset > tdesc_length)
+		offset = tdesc_length;
+
 	char transfer_type;
 
 	if (length < (tdesc_length - offset))
@@ -2584,16 +2867,8 @@ static int gdb_get_target_description_chunk(struct target *target, struct target
 	} else {
 		strncpy((*chunk) + 1, tdesc + offset, tdesc_length - offset);
 		(*chunk)[1 + (tdesc_length - offset)] = '\0';
-
-		/* After gdb-server sends out last chunk, invalidate tdesc. */
-		free(tdesc);
-		tdesc = NULL;
-		tdesc_length = 0;
 	}
 
-	target_desc->tdesc = tdesc;
-	target_desc->tdesc_length = tdesc_length;
-
 	return ERROR_OK;
 }
 
@@ -2920,8 +3195,7 @@ static int gdb_query_packet(struct connection *connection,
 		 * there are *more* chunks to transfer. 'l' for it is the *last*
 		 * chunk of target description.
 		 */
-		retval = gdb_get_target_description_chunk(target, &gdb_connection->target_desc,
-				&xml, offset, length);
+		retval = gdb_get_target_description_chunk(target, &xml, offset, length);
 		if (retval != ERROR_OK) {
 			gdb_error(connection, retval);
 			return retval;
@@ -4108,4 +4382,12 @@ void gdb_service_free(void)
 {
 	free(gdb_port);
 	free(gdb_port_next);
+
+	while (gdb_xml_caches) {
+		struct gdb_xml_cache *next = gdb_xml_caches->next;
+		free(gdb_xml_caches->tdesc);
+		free(gdb_xml_caches->memory_map);
+		free(gdb_xml_caches);
+		gdb_xml_caches = next;
+	}
 }
@@ -34,6 +34,10 @@
 #include <netinet/tcp.h>
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
 static struct service *services;
 
 enum shutdown_reason {
@@ -53,6 +57,30 @@ static int polling_period = 100;
 /* address by name on which to listen for incoming TCP/IP connections */
 static char *bindto_name;
 
+/* descriptors reported readable by the last wait, used by server_fd_ready() */
+static fd_set read_fds;
+
+#ifdef HAVE_SYS_EPOLL_H
+#define SERVER_MAX_EVENTS	32
+
+/* epoll instance, or -1 when the select() backend is used */
+static int server_epfd = -1;
+/* set when the epoll backend cannot watch a descriptor, e.g. a regular file on stdin */
+static bool server_epoll_disabled;
+/* set when a service or connection descriptor has been added or removed */
+static bool server_fds_changed = true;
+
+static int ready_fds[SERVER_MAX_EVENTS];
+static int num_ready_fds;
+#endif
+
+static void server_mark_fds_changed(void)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	server_fds_changed = true;
+#endif
+}
+
 static int add_connection(struct service *service, struct command_context *cmd_ctx)
 {
 	socklen_t address_size;
@@ -149,6 +177,8 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 	if (service->max_connections != CONNECTION_LIMIT_UNLIMITED)
 		service->max_connections--;
 
+	server_mark_fds_changed();
+
 	return ERROR_OK;
 }
 
@@ -177,6 +207,8 @@ static int remove_connection(struct service *service, struct connection *connect
 			if (service->max_connections != CONNECTION_LIMIT_UNLIMITED)
 				service->max_connections++;
 
+			server_mark_fds_changed();
+
 			break;
 		}
 
@@ -333,6 +365,8 @@ int add_service(const struct service_driver *driver, const char *port,
 		;
 	*p = c;
 
+	server_mark_fds_changed();
+
 	return ERROR_OK;
 }
 
@@ -373,6 +407,8 @@ int remove_service(const char *name, const char *port)
 			free(tmp->priv);
 			free_service(tmp);
 
+			server_mark_fds_changed();
+
 			return ERROR_OK;
 		}
 	}
@@ -407,6 +443,8 @@ static int remove_services(void)
 
 	services = NULL;
 
+	server_mark_fds_changed();
+
 	return ERROR_OK;
 }
 
@@ -418,16 +456,163 @@ void server_keep_clients_alive(void)
 				s->keep_client_alive(c);
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+static void server_epoll_close(void)
+{
+	if (server_epfd != -1)
+		close(server_epfd);
+	server_epfd = -1;
+	server_fds_changed = true;
+}
+
+static int server_epoll_watch(int fd)
+{
+	struct epoll_event ev = {
+		.events = EPOLLIN,
+		.data.fd = fd,
+	};
+
+	return epoll_ctl(server_epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+/**
+ * Rebuild the epoll interest list after services or connections have been
+ * added or removed. This happens only on connect/disconnect, every other
+ * iteration of the server loop reuses the kernel side set as is.
+ * @returns false if epoll cannot be used and select() must take over.
+ */
+static bool server_epoll_sync(void)
+{
+	if (server_epoll_disabled)
+		return false;
+
+	if (!server_fds_changed)
+		return true;
+
+	server_epoll_close();
+	server_epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (server_epfd == -1) {
+		LOG_DEBUG("epoll unavailable (%s), using select()", strerror(errno));
+		server_epoll_disabled = true;
+		return false;
+	}
+
+	for (struct service *service = services; service; service = service->next) {
+		if (service->fd != -1 && server_epoll_watch(service->fd) != 0)
+			goto unsupported;
+
+		for (struct connection *c = service->connections; c; c = c->next)
+			if (c->fd >= 0 && server_epoll_watch(c->fd) != 0)
+				goto unsupported;
+	}
+
+	server_fds_changed = false;
+	return true;
+
+unsupported:
+	/* EPERM: regular files (e.g. stdin redirected from a file) cannot be
+	 * watched by epoll, they are always readable for select() */
+	LOG_DEBUG("epoll cannot watch all descriptors (%s), using select()",
+		strerror(errno));
+	server_epoll_close();
+	server_epoll_disabled = true;
+	return false;
+}
+
+static int server_wait_epoll(int timeout_ms)
+{
+	struct epoll_event events[SERVER_MAX_EVENTS];
+
+	num_ready_fds = 0;
+
+	int retval = epoll_wait(server_epfd, events, SERVER_MAX_EVENTS, timeout_ms);
+	if (retval <= 0)
+		return retval;
+
+	/* level triggered: descriptors not served in this round, because
+	 * there were more than SERVER_MAX_EVENTS, are reported again */
+	for (int i = 0; i < retval; i++)
+		ready_fds[num_ready_fds++] = events[i].data.fd;
+
+	return retval;
+}
+#endif
+
+static int server_wait_select(int timeout_ms)
+{
+	int fd_max = 0;
+
+	FD_ZERO(&read_fds);
+
+	/* add service and connection fds to read_fds */
+	for (struct service *service = services; service; service = service->next) {
+		if (service->fd != -1) {
+			/* listen for new connections */
+			FD_SET(service->fd, &read_fds);
+
+			if (service->fd > fd_max)
+				fd_max = service->fd;
+		}
+
+		for (struct connection *c = service->connections; c; c = c->next) {
+			/* check for activity on the connection */
+			FD_SET(c->fd, &read_fds);
+			if (c->fd > fd_max)
+				fd_max = c->fd;
+		}
+	}
+
+	struct timeval tv;
+	tv.tv_sec = 0;
+	tv.tv_usec = timeout_ms * 1000;
+
+	return socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
+}
+
+/**
+ * Wait until a service or connection descriptor is readable or the timeout
+ * expires. Uses epoll where available, select() otherwise.
+ * @returns the number of ready descriptors, 0 on timeout or -1 on error
+ */
+static int server_wait(int timeout_ms)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	num_ready_fds = 0;
+	if (server_epoll_sync())
+		return server_wait_epoll(timeout_ms);
+#endif
+
+	return server_wait_select(timeout_ms);
+}
+
+static void server_clear_ready(void)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	num_ready_fds = 0;
+#endif
+	FD_ZERO(&read_fds);	/* eCos leaves read_fds unchanged in this case!  */
+}
+
+static bool server_fd_ready(int fd)
+{
+#ifdef HAVE_SYS_EPOLL_H
+	if (server_epfd != -1) {
+		for (int i = 0; i < num_ready_fds; i++)
+			if (ready_fds[i] == fd)
+				return true;
+		return false;
+	}
+#endif
+
+	return FD_ISSET(fd, &read_fds);
+}
+
 int server_loop(struct command_context *command_context)
 {
 	struct service *service;
 
 	bool poll_ok = true;
 
-	/* used in select() */
-	fd_set read_fds;
-	int fd_max;
-
 	/* used in accept() */
 	int retval;
 
@@ -440,48 +625,19 @@ int server_loop(struct command_context *command_context)
 
 	while (shutdown_openocd == CONTINUE_MAIN_LOOP) {
 		/* monitor sockets for activity */
-		fd_max = 0;
-		FD_ZERO(&read_fds);
-
-		/* add service and connection fds to read_fds */
-		for (service = services; service; service = service->next) {
-			if (service->fd != -1) {
-				/* listen for new connections */
-				FD_SET(service->fd, &read_fds);
-
-				if (service->fd > fd_max)
-					fd_max = service->fd;
-			}
-
-			if (service->connections) {
-				struct connection *c;
-
-				for (c = service->connections; c; c = c->next) {
-					/* check for activity on the connection */
-					FD_SET(c->fd, &read_fds);
-					if (c->fd > fd_max)
-						fd_max = c->fd;
-				}
-			}
-		}
-
-		struct timeval tv;
-		tv.tv_sec = 0;
 		if (poll_ok) {
 			/* we're just polling this iteration, this is faster on embedded
 			 * hosts */
-			tv.tv_usec = 0;
-			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
+			retval = server_wait(0);
 		} else {
-			/* Timeout socket_select() when a target timer expires or every polling_period */
+			/* Timeout when a target timer expires or every polling_period */
 			int timeout_ms = next_event - timeval_ms();
 			if (timeout_ms < 0)
 				timeout_ms = 0;
 			else if (timeout_ms > polling_period)
 				timeout_ms = polling_period;
-			tv.tv_usec = timeout_ms * 1000;
 			/* Only while we're sleeping we'll let others run */
-			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
+			retval = server_wait(timeout_ms);
 		}
 
 		if (retval == -1) {
@@ -490,7 +646,7 @@ int server_loop(struct command_context *command_context)
 			errno = WSAGetLastError();
 
 			if (errno == WSAEINTR)
-				FD_ZERO(&read_fds);
+				server_clear_ready();
 			else {
 				LOG_ERROR("error during select: %s", strerror(errno));
 				return ERROR_FAIL;
@@ -498,7 +654,7 @@ int server_loop(struct command_context *command_context)
 #else
 
 			if (errno == EINTR)
-				FD_ZERO(&read_fds);
+				server_clear_ready();
 			else {
 				LOG_ERROR("error during select: %s", strerror(errno));
 				return ERROR_FAIL;
@@ -506,17 +662,21 @@ int server_loop(struct command_context *command_context)
 #endif
 		}
 
-		if (retval == 0) {
+		if (retval == 0 || timeval_ms() >= next_event) {
 			/* Execute callbacks of expired timers when
 			 * - there was nothing to do if poll_ok was true
-			 * - socket_select() timed out if poll_ok was false, now one or more
+			 * - server_wait() timed out if poll_ok was false, now one or more
 			 *   timers expired or the polling period elapsed
+			 * - a timer is due while connections keep us busy, so that
+			 *   target polling is not delayed by client traffic
 			 */
 			target_call_timer_callbacks();
 			next_event = target_timer_next_event();
 			process_jim_events(command_context);
+		}
 
-			FD_ZERO(&read_fds);	/* eCos leaves read_fds unchanged in this case!  */
+		if (retval == 0) {
+			server_clear_ready();
 
 			/* We timed out/there was nothing to do, timeout rather than poll next time
 			 **/
@@ -536,7 +696,7 @@ int server_loop(struct command_context *command_context)
 		for (service = services; service; service = service->next) {
 			/* handle new connections on listeners */
 			if ((service->fd != -1)
-				&& (FD_ISSET(service->fd, &read_fds))) {
+				&& server_fd_ready(service->fd)) {
 				if (service->max_connections != 0)
 					add_connection(service, command_context);
 				else {
@@ -560,7 +720,7 @@ int server_loop(struct command_context *command_context)
 				struct connection *c;
 
 				for (c = service->connections; c; ) {
-					if ((c->fd >= 0 && FD_ISSET(c->fd, &read_fds)) || c->input_pending) {
+					if ((c->fd >= 0 && server_fd_ready(c->fd)) || c->input_pending) {
 						retval = service->input(c);
 						if (retval != ERROR_OK) {
 							struct connection *next = c->next;
@@ -591,6 +751,10 @@ int server_loop(struct command_context *command_context)
 #endif
 	}
 
+#ifdef HAVE_SYS_EPOLL_H
+	server_epoll_close();
+#endif
+
 	/* when quit for signal or CTRL-C, run (eventually user implemented) "shutdown" */
 	if (shutdown_openocd == SHUTDOWN_WITH_SIGNAL_CODE)
 		command_run_line(command_context, "shutdown");
@@ -17,6 +17,25 @@
 #define TCL_LINE_INITIAL		(4*1024)
 #define TCL_LINE_MAX			(4*1024*1024)
 
+/* Binary bulk memory frames, see "Tcl RPC server bulk memory access" in
+ * the manual. All fields are little endian. */
+#define TCL_BULK_MAGIC			0x00
+#define TCL_BULK_REQUEST_SIZE	20
+#define TCL_BULK_REPLY_SIZE		16
+#define TCL_BULK_CHUNK			(64*1024)
+#define TCL_BULK_MORE			0x01
+
+#define TCL_BULK_OP_READ		'r'
+#define TCL_BULK_OP_WRITE		'w'
+#define TCL_BULK_OP_FILL		'f'
+#define TCL_BULK_OP_CHECKSUM	'c'
+
+enum tcl_frame_state {
+	TCL_FRAME_NONE,
+	TCL_FRAME_HEADER,
+	TCL_FRAME_PAYLOAD,
+};
+
 struct tcl_connection {
 	int tc_linedrop;
 	int tc_lineoffset;
@@ -26,6 +45,18 @@ struct tcl_connection {
 	enum target_state tc_laststate;
 	bool tc_notify;
 	bool tc_trace;
+	bool tc_bulk;
+	/* binary frame being received */
+	enum tcl_frame_state tc_frame_state;
+	uint8_t tc_frame[TCL_BULK_REQUEST_SIZE];
+	unsigned int tc_frame_fill;
+	uint8_t tc_op;
+	target_addr_t tc_address;
+	uint32_t tc_remaining;
+	uint32_t tc_done;
+	int tc_status;
+	uint8_t *tc_chunk;
+	uint32_t tc_chunk_fill;
 };
 
 static char *tcl_port;
@@ -128,6 +159,229 @@ int tcl_output(struct connection *connection, const void *data, ssize_t len)
 	return ERROR_SERVER_REMOTE_CLOSED;
 }
 
+static int tcl_bulk_reply(struct connection *connection, uint8_t op,
+		uint8_t flags, int status, uint32_t length, uint32_t value)
+{
+	uint8_t reply[TCL_BULK_REPLY_SIZE];
+
+	reply[0] = TCL_BULK_MAGIC;
+	reply[1] = op;
+	reply[2] = flags;
+	reply[3] = 0;
+	h_u32_to_le(reply + 4, (uint32_t)status);
+	h_u32_to_le(reply + 8, length);
+	h_u32_to_le(reply + 12, value);
+
+	return tcl_output(connection, reply, sizeof(reply));
+}
+
+static int tcl_bulk_alloc_chunk(struct tcl_connection *tclc)
+{
+	if (!tclc->tc_chunk)
+		tclc->tc_chunk = malloc(TCL_BULK_CHUNK);
+
+	return tclc->tc_chunk ? ERROR_OK : ERROR_FAIL;
+}
+
+/* stream target memory to the socket, one reply frame per chunk */
+static int tcl_bulk_read(struct connection *connection, struct target *target,
+		target_addr_t address, uint32_t length)
+{
+	struct tcl_connection *tclc = connection->priv;
+	int retval;
+
+	while (length > 0) {
+		uint32_t count = MIN(length, TCL_BULK_CHUNK);
+
+		keep_alive();
+
+		retval = target_read_buffer(target, address, count, tclc->tc_chunk);
+		if (retval != ERROR_OK)
+			return retval;
+
+		retval = tcl_bulk_reply(connection, TCL_BULK_OP_READ, TCL_BULK_MORE,
+				ERROR_OK, count, 0);
+		if (retval == ERROR_OK)
+			retval = tcl_output(connection, tclc->tc_chunk, count);
+		if (retval != ERROR_OK)
+			return retval;
+
+		address += count;
+		length -= count;
+	}
+
+	return ERROR_OK;
+}
+
+static int tcl_bulk_fill(struct connection *connection, struct target *target,
+		target_addr_t address, uint32_t length, uint32_t pattern)
+{
+	struct tcl_connection *tclc = connection->priv;
+	uint32_t count = MIN(length, TCL_BULK_CHUNK);
+
+	for (uint32_t i = 0; i < count; i += 4)
+		h_u32_to_le(tclc->tc_chunk + i, pattern);
+
+	while (length > 0) {
+		count = MIN(length, TCL_BULK_CHUNK);
+
+		keep_alive();
+
+		int retval = target_write_buffer(target, address, count, tclc->tc_chunk);
+		if (retval != ERROR_OK)
+			return retval;
+
+		address += count;
+		length -= count;
+	}
+
+	return ERROR_OK;
+}
+
+/* write the buffered part of a write payload to the target */
+static int tcl_bulk_flush(struct connection *connection)
+{
+	struct tcl_connection *tclc = connection->priv;
+	struct target *target = get_current_target_or_null(connection->cmd_ctx);
+
+	/* after an error the rest of the payload is only drained */
+	if (tclc->tc_status == ERROR_OK && tclc->tc_chunk_fill > 0) {
+		if (!target)
+			tclc->tc_status = ERROR_FAIL;
+		else
+			tclc->tc_status = target_write_buffer(target,
+					tclc->tc_address + tclc->tc_done,
+					tclc->tc_chunk_fill, tclc->tc_chunk);
+		if (tclc->tc_status == ERROR_OK)
+			tclc->tc_done += tclc->tc_chunk_fill;
+	}
+	tclc->tc_chunk_fill = 0;
+
+	if (tclc->tc_remaining > 0)
+		return ERROR_OK;
+
+	tclc->tc_frame_state = TCL_FRAME_NONE;
+	return tcl_bulk_reply(connection, TCL_BULK_OP_WRITE, 0, tclc->tc_status,
+			tclc->tc_done, 0);
+}
+
+/* account for payload bytes just appended to the chunk buffer */
+static int tcl_bulk_payload(struct connection *connection, uint32_t count)
+{
+	struct tcl_connection *tclc = connection->priv;
+
+	tclc->tc_chunk_fill += count;
+	tclc->tc_remaining -= count;
+
+	if (tclc->tc_chunk_fill == TCL_BULK_CHUNK || tclc->tc_remaining == 0)
+		return tcl_bulk_flush(connection);
+
+	return ERROR_OK;
+}
+
+/* run a complete request header */
+static int tcl_bulk_request(struct connection *connection)
+{
+	struct tcl_connection *tclc = connection->priv;
+	struct target *target = get_current_target_or_null(connection->cmd_ctx);
+	uint8_t op = tclc->tc_frame[1];
+	target_addr_t address = le_to_h_u64(tclc->tc_frame + 4);
+	uint32_t length = le_to_h_u32(tclc->tc_frame + 12);
+	uint32_t value = le_to_h_u32(tclc->tc_frame + 16);
+	uint32_t checksum = 0;
+	int retval;
+
+	tclc->tc_frame_state = TCL_FRAME_NONE;
+
+	retval = tcl_bulk_alloc_chunk(tclc);
+	if (retval == ERROR_OK && !target) {
+		LOG_ERROR("tcl bulk access: no current target");
+		retval = ERROR_FAIL;
+	}
+
+	switch (op) {
+	case TCL_BULK_OP_WRITE:
+		tclc->tc_op = op;
+		tclc->tc_address = address;
+		tclc->tc_remaining = length;
+		tclc->tc_done = 0;
+		tclc->tc_status = retval;
+		tclc->tc_chunk_fill = 0;
+		if (length == 0)
+			return tcl_bulk_reply(connection, op, 0, retval, 0, 0);
+		/* without a chunk buffer there is nowhere to put the payload */
+		if (!tclc->tc_chunk)
+			return ERROR_FAIL;
+		tclc->tc_frame_state = TCL_FRAME_PAYLOAD;
+		return ERROR_OK;
+	case TCL_BULK_OP_READ:
+		if (retval == ERROR_OK)
+			retval = tcl_bulk_read(connection, target, address, length);
+		if (retval == ERROR_SERVER_REMOTE_CLOSED)
+			return retval;
+		break;
+	case TCL_BULK_OP_FILL:
+		if (retval == ERROR_OK)
+			retval = tcl_bulk_fill(connection, target, address, length, value);
+		break;
+	case TCL_BULK_OP_CHECKSUM:
+		if (retval == ERROR_OK)
+			retval = target_checksum_memory(target, address, length, &checksum);
+		break;
+	default:
+		LOG_ERROR("tcl bulk access: unknown operation 0x%02x", op);
+		retval = ERROR_COMMAND_SYNTAX_ERROR;
+		break;
+	}
+
+	return tcl_bulk_reply(connection, op, 0, retval, 0, checksum);
+}
+
+/* consume bytes of a binary frame from the input buffer */
+static int tcl_bulk_input(struct connection *connection, const uint8_t *data,
+		size_t len, size_t *consumed)
+{
+	struct tcl_connection *tclc = connection->priv;
+	size_t count;
+
+	if (tclc->tc_frame_state == TCL_FRAME_NONE) {
+		tclc->tc_frame_state = TCL_FRAME_HEADER;
+		tclc->tc_frame_fill = 0;
+	}
+
+	if (tclc->tc_frame_state == TCL_FRAME_HEADER) {
+		count = MIN(len, TCL_BULK_REQUEST_SIZE - tclc->tc_frame_fill);
+		memcpy(tclc->tc_frame + tclc->tc_frame_fill, data, count);
+		tclc->tc_frame_fill += count;
+		*consumed = count;
+		if (tclc->tc_frame_fill < TCL_BULK_REQUEST_SIZE)
+			return ERROR_OK;
+		return tcl_bulk_request(connection);
+	}
+
+	count = MIN(len, MIN(tclc->tc_remaining, TCL_BULK_CHUNK - tclc->tc_chunk_fill));
+	memcpy(tclc->tc_chunk + tclc->tc_chunk_fill, data, count);
+	*consumed = count;
+	return tcl_bulk_payload(connection, count);
+}
+
+/* receive write payload straight into the chunk buffer */
+static int tcl_bulk_input_payload(struct connection *connection)
+{
+	struct tcl_connection *tclc = connection->priv;
+	uint32_t count = MIN(tclc->tc_remaining, TCL_BULK_CHUNK - tclc->tc_chunk_fill);
+	ssize_t rlen;
+
+	rlen = connection_read(connection, tclc->tc_chunk + tclc->tc_chunk_fill, count);
+	if (rlen <= 0) {
+		if (rlen < 0)
+			LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	return tcl_bulk_payload(connection, rlen);
+}
+
 /* connections */
 static int tcl_new_connection(struct connection *connection)
 {
@@ -173,6 +427,13 @@ static int tcl_input(struct connection *connection)
 	char *tc_line_new;
 	int tc_line_size_new;
 
+	tclc = connection->priv;
+	if (!tclc)
+		return ERROR_CONNECTION_REJECTED;
+
+	if (tclc->tc_frame_state == TCL_FRAME_PAYLOAD)
+		return tcl_bulk_input_payload(connection);
+
 	rlen = connection_read(connection, &in, sizeof(in));
 	if (rlen <= 0) {
 		if (rlen < 0)
@@ -180,12 +441,19 @@ static int tcl_input(struct connection *connection)
 		return ERROR_SERVER_REMOTE_CLOSED;
 	}
 
-	tclc = connection->priv;
-	if (!tclc)
-		return ERROR_CONNECTION_REJECTED;
-
 	/* push as much data into the line as possible */
 	for (i = 0; i < rlen; i++) {
+		/* binary frames can only start in place of a new command */
+		if (tclc->tc_frame_state != TCL_FRAME_NONE ||
+				(tclc->tc_bulk && tclc->tc_lineoffset == 0 && in[i] == TCL_BULK_MAGIC)) {
+			size_t consumed;
+			retval = tcl_bulk_input(connection, in + i, rlen - i, &consumed);
+			if (retval != ERROR_OK)
+				return retval;
+			i += consumed - 1;
+			continue;
+		}
+
 		/* buffer the data */
 		tclc->tc_line[tclc->tc_lineoffset] = in[i];
 		if (tclc->tc_lineoffset + 1 < tclc->tc_line_size) {
@@ -253,6 +521,7 @@ static int tcl_closed(struct connection *connection)
 
 	/* cleanup connection context */
 	if (tclc) {
+		free(tclc->tc_chunk);
 		free(tclc->tc_line);
 		free(tclc);
 		connection->priv = NULL;
@@ -323,6 +592,23 @@ COMMAND_HANDLER(handle_tcl_trace_command)
 	}
 }
 
+COMMAND_HANDLER(handle_tcl_bulk_command)
+{
+	struct connection *connection = NULL;
+	struct tcl_connection *tclc = NULL;
+
+	if (CMD_CTX->output_handler_priv)
+		connection = CMD_CTX->output_handler_priv;
+
+	if (connection && !strcmp(connection->service->name, "tcl")) {
+		tclc = connection->priv;
+		return CALL_COMMAND_HANDLER(handle_command_parse_bool, &tclc->tc_bulk, "Binary bulk memory frames ");
+	} else {
+		LOG_ERROR("%s: can only be called from the tcl server", CMD_NAME);
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+}
+
 static const struct command_registration tcl_command_handlers[] = {
 	{
 		.name = "tcl_port",
@@ -347,6 +633,13 @@ static const struct command_registration tcl_command_handlers[] = {
 		.help = "Target trace output",
 		.usage = "[on|off]",
 	},
+	{
+		.name = "tcl_bulk",
+		.handler = handle_tcl_bulk_command,
+		.mode = COMMAND_EXEC,
+		.help = "Accept binary bulk memory frames",
+		.usage = "[on|off]",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -2425,6 +2425,33 @@ static int aarch64_read_cpu_memory(struct target *target,
 	return ERROR_OK;
 }
 
+/*
+ * System MEM-AP configured with "aarch64 memory_ap", or NULL if physical
+ * memory has to be accessed through the CPU.
+ */
+static struct adiv5_ap *aarch64_memory_ap(struct target *target)
+{
+	struct aarch64_common *aarch64 = target_to_aarch64(target);
+	struct adiv5_dap *dap = aarch64->armv8_common.arm.dap;
+
+	if (aarch64->memory_ap_num == DP_APSEL_INVALID)
+		return NULL;
+
+	if (!aarch64->memory_ap) {
+		aarch64->memory_ap = dap_get_ap(dap, aarch64->memory_ap_num);
+		if (!aarch64->memory_ap || mem_ap_init(aarch64->memory_ap) != ERROR_OK) {
+			LOG_WARNING("%s: cannot use MEM-AP 0x%" PRIx64 " for memory access, "
+					"using the CPU", target_name(target), aarch64->memory_ap_num);
+			if (aarch64->memory_ap)
+				dap_put_ap(aarch64->memory_ap);
+			aarch64->memory_ap = NULL;
+			aarch64->memory_ap_num = DP_APSEL_INVALID;
+		}
+	}
+
+	return aarch64->memory_ap;
+}
+
 static int aarch64_read_phys_memory(struct target *target,
 	target_addr_t address, uint32_t size,
 	uint32_t count, uint8_t *buffer)
@@ -2432,10 +2459,22 @@ static int aarch64_read_phys_memory(struct target *target,
 	int retval = ERROR_COMMAND_SYNTAX_ERROR;
 
 	if (count && buffer) {
-		/* read memory through APB-AP */
+		/* disabling the MMU also flushes the data cache */
 		retval = aarch64_mmu_modify(target, 0);
 		if (retval != ERROR_OK)
 			return retval;
+
+		/* read memory through the system MEM-AP, if there is one */
+		struct adiv5_ap *ap = aarch64_memory_ap(target);
+		if (ap) {
+			retval = mem_ap_read_buf(ap, buffer, size, count, address);
+			if (retval == ERROR_OK)
+				return retval;
+			LOG_DEBUG("%s: MEM-AP read failed, retrying through the CPU",
+					target_name(target));
+		}
+
+		/* read memory through APB-AP */
 		retval = aarch64_read_cpu_memory(target, address, size, count, buffer);
 	}
 	return retval;
@@ -2452,6 +2491,10 @@ static int aarch64_read_memory(struct target *target, target_addr_t address,
 	if (retval != ERROR_OK)
 		return retval;
 
+	/* without MMU virtual and physical addresses are the same */
+	if (!mmu_enabled && aarch64_memory_ap(target))
+		return aarch64_read_phys_memory(target, address, size, count, buffer);
+
 	if (mmu_enabled) {
 		/* enable MMU as we could have disabled it for phys access */
 		retval = aarch64_mmu_modify(target, 1);
@@ -2468,10 +2511,27 @@ static int aarch64_write_phys_memory(struct target *target,
 	int retval = ERROR_COMMAND_SYNTAX_ERROR;
 
 	if (count && buffer) {
-		/* write memory through APB-AP */
+		/* disabling the MMU also flushes the data cache */
 		retval = aarch64_mmu_modify(target, 0);
 		if (retval != ERROR_OK)
 			return retval;
+
+		/* write memory through the system MEM-AP, if there is one */
+		struct adiv5_ap *ap = aarch64_memory_ap(target);
+		if (ap) {
+			retval = mem_ap_write_buf(ap, buffer, size, count, address);
+			if (retval == ERROR_OK) {
+				/* the instruction cache may hold stale copies of the range */
+				struct armv8_common *armv8 = target_to_armv8(target);
+				if (armv8->armv8_mmu.armv8_cache.i_cache_enabled)
+					retval = armv8_cache_i_inner_inval_virt(armv8, address, size * count);
+				return retval;
+			}
+			LOG_DEBUG("%s: MEM-AP write failed, retrying through the CPU",
+					target_name(target));
+		}
+
+		/* write memory through APB-AP */
 		return aarch64_write_cpu_memory(target, address, size, count, buffer);
 	}
 
@@ -2489,6 +2549,10 @@ static int aarch64_write_memory(struct target *target, target_addr_t address,
 	if (retval != ERROR_OK)
 		return retval;
 
+	/* without MMU virtual and physical addresses are the same */
+	if (!mmu_enabled && aarch64_memory_ap(target))
+		return aarch64_write_phys_memory(target, address, size, count, buffer);
+
 	if (mmu_enabled) {
 		/* enable MMU as we could have disabled it for phys access */
 		retval = aarch64_mmu_modify(target, 1);
@@ -2712,6 +2776,7 @@ static int aarch64_init_arch_info(struct target *target,
 	/* Setup struct aarch64_common */
 	aarch64->common_magic = AARCH64_COMMON_MAGIC;
 	armv8->arm.dap = dap;
+	aarch64->memory_ap_num = DP_APSEL_INVALID;
 
 	/* register arch-specific functions */
 	armv8->examine_debug_reason = NULL;
@@ -2751,6 +2816,8 @@ static void aarch64_deinit_target(struct target *target)
 
 	if (armv8->debug_ap)
 		dap_put_ap(armv8->debug_ap);
+	if (aarch64->memory_ap)
+		dap_put_ap(aarch64->memory_ap);
 
 	armv8_free_reg_cache(target);
 	free(aarch64->brp_list);
@@ -2952,6 +3019,39 @@ COMMAND_HANDLER(aarch64_mask_interrupts_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(aarch64_memory_ap_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct aarch64_common *aarch64 = target_to_aarch64(target);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		uint64_t ap_num = DP_APSEL_INVALID;
+
+		if (strcmp(CMD_ARGV[0], "off")) {
+			COMMAND_PARSE_NUMBER(u64, CMD_ARGV[0], ap_num);
+			if (!is_ap_num_valid(aarch64->armv8_common.arm.dap, ap_num)) {
+				command_print(CMD, "Invalid AP number");
+				return ERROR_COMMAND_ARGUMENT_INVALID;
+			}
+		}
+
+		if (aarch64->memory_ap)
+			dap_put_ap(aarch64->memory_ap);
+		aarch64->memory_ap = NULL;
+		aarch64->memory_ap_num = ap_num;
+	}
+
+	if (aarch64->memory_ap_num == DP_APSEL_INVALID)
+		command_print(CMD, "off");
+	else
+		command_print(CMD, "0x%" PRIx64, aarch64->memory_ap_num);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(aarch64_mcrmrc_command)
 {
 	bool is_mcr = false;
@@ -3082,6 +3182,14 @@ static const struct command_registration aarch64_exec_command_handlers[] = {
 		.help = "mask aarch64 interrupts during single-step",
 		.usage = "['on'|'off']",
 	},
+	{
+		.name = "memory_ap",
+		.handler = aarch64_memory_ap_command,
+		.mode = COMMAND_ANY,
+		.help = "access physical memory through a system MEM-AP "
+			"instead of the CPU",
+		.usage = "[ap_num|'off']",
+	},
 	{
 		.name = "mcr",
 		.mode = COMMAND_EXEC,
@@ -3141,6 +3249,7 @@ struct target_type aarch64_target = {
 	/* REVISIT allow exporting VFP3 registers ... */
 	.get_gdb_arch = armv8_get_gdb_arch,
 	.get_gdb_reg_list = armv8_get_gdb_reg_list,
+	.read_registers = armv8_dpm_read_registers,
 
 	.read_memory = aarch64_read_memory,
 	.write_memory = aarch64_write_memory,
@@ -58,6 +58,10 @@ struct aarch64_common {
 	struct aarch64_brp *wp_list;
 
 	enum aarch64_isrmasking_mode isrmasking_mode;
+
+	/* System MEM-AP used for physical memory accesses instead of DCC */
+	uint64_t memory_ap_num;
+	struct adiv5_ap *memory_ap;
 };
 
 static inline struct aarch64_common *
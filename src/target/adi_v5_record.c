@@ -0,0 +1,374 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * Recording of the DAP transactions, see adi_v5_record.h.
+ *
+ * The recorder sits between the DAP users and the transport: it replaces
+ * dap->ops with a copy whose operations forward to the transport's ops
+ * and log each call. Operations queued since the last run are kept in
+ * memory until the run, which fills in the read values.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "arm_adi_v5.h"
+#include "adi_v5_record.h"
+#include <helper/log.h>
+#include <helper/replacements.h>
+#include <helper/types.h>
+
+struct dap_record_op {
+	uint8_t type;
+	uint16_t reg;
+	uint64_t ap_num;
+	uint32_t value;
+	/* destination of a read, filled by the run */
+	uint32_t *data;
+	uint8_t *ack;
+};
+
+struct dap_recorder {
+	/* the transport's operations */
+	const struct dap_ops *ops;
+	/* the operations installed in dap->ops */
+	struct dap_ops record_ops;
+
+	char *filename;
+	FILE *file;
+	int64_t start_us;
+
+	struct dap_record_op *queue;
+	size_t queue_len;
+	size_t queue_size;
+
+	uint64_t records;
+};
+
+static int64_t dap_record_time_us(void)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+	return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+static void dap_record_write(struct dap_recorder *rec, uint8_t type, const uint8_t *fields)
+{
+	if (!rec->file)
+		return;
+
+	if (fputc(type, rec->file) == EOF ||
+			fwrite(fields, 1, dap_record_size(type), rec->file) != dap_record_size(type)) {
+		LOG_ERROR("error writing DAP recording %s, recording stopped", rec->filename);
+		fclose(rec->file);
+		rec->file = NULL;
+		return;
+	}
+
+	rec->records++;
+}
+
+static void dap_record_retval(struct dap_recorder *rec, uint8_t type, int retval)
+{
+	uint8_t buf[4];
+
+	h_u32_to_le(buf, retval);
+	dap_record_write(rec, type, buf);
+}
+
+/*
+ * Writes the queued operations, with the values they read if the queue was
+ * run successfully. Otherwise the adapter may have stopped at any of them,
+ * so none of the read values is recorded.
+ */
+static void dap_record_flush(struct dap_recorder *rec, bool run_ok)
+{
+	for (size_t i = 0; i < rec->queue_len; i++) {
+		struct dap_record_op *op = &rec->queue[i];
+		uint8_t buf[16];
+		uint8_t *p = buf;
+
+		if (!run_ok) {
+			if (op->type == DAP_RECORD_DP_READ)
+				op->type = DAP_RECORD_DP_READ_NO_VALUE;
+			else if (op->type == DAP_RECORD_AP_READ)
+				op->type = DAP_RECORD_AP_READ_NO_VALUE;
+			op->ack = NULL;
+		} else if (op->data) {
+			op->value = *op->data;
+		}
+
+		switch (op->type) {
+		case DAP_RECORD_AP_READ:
+		case DAP_RECORD_AP_WRITE:
+		case DAP_RECORD_AP_READ_NO_VALUE:
+			h_u64_to_le(p, op->ap_num);
+			p += 8;
+			/* fall through */
+		case DAP_RECORD_DP_READ:
+		case DAP_RECORD_DP_WRITE:
+		case DAP_RECORD_DP_READ_NO_VALUE:
+			h_u16_to_le(p, op->reg);
+			h_u32_to_le(p + 2, op->value);
+			break;
+		case DAP_RECORD_ABORT:
+			buf[0] = op->ack ? *op->ack : 0;
+			break;
+		}
+
+		dap_record_write(rec, op->type, buf);
+	}
+
+	rec->queue_len = 0;
+}
+
+static int dap_record_queue(struct dap_recorder *rec, uint8_t type, uint64_t ap_num,
+		unsigned int reg, uint32_t value, uint32_t *data, uint8_t *ack)
+{
+	if (rec->queue_len == rec->queue_size) {
+		size_t size = rec->queue_size ? 2 * rec->queue_size : 256;
+		struct dap_record_op *queue = realloc(rec->queue, size * sizeof(*queue));
+
+		if (!queue) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		rec->queue = queue;
+		rec->queue_size = size;
+	}
+
+	rec->queue[rec->queue_len++] = (struct dap_record_op) {
+		.type = type,
+		.reg = reg,
+		.ap_num = ap_num,
+		.value = value,
+		.data = data,
+		.ack = ack,
+	};
+
+	return ERROR_OK;
+}
+
+/* a failed queue operation is recorded right away, with its result */
+static int dap_record_queued(struct dap_recorder *rec, int retval, uint8_t type,
+		uint64_t ap_num, unsigned int reg, uint32_t value, uint32_t *data, uint8_t *ack)
+{
+	int err = dap_record_queue(rec, type, ap_num, reg, value, data, ack);
+
+	if (retval != ERROR_OK) {
+		dap_record_flush(rec, false);
+		dap_record_retval(rec, DAP_RECORD_QUEUE_ERROR, retval);
+	}
+
+	return retval != ERROR_OK ? retval : err;
+}
+
+static int dap_record_connect(struct adiv5_dap *dap)
+{
+	struct dap_recorder *rec = dap->recorder;
+
+	dap_record_flush(rec, false);
+	dap_record_write(rec, DAP_RECORD_CONNECT, NULL);
+
+	int retval = rec->ops->connect(dap);
+
+	dap_record_flush(rec, false);
+	dap_record_retval(rec, DAP_RECORD_CONNECTED, retval);
+	return retval;
+}
+
+static int dap_record_send_sequence(struct adiv5_dap *dap, enum swd_special_seq seq)
+{
+	struct dap_recorder *rec = dap->recorder;
+	uint8_t buf[5];
+
+	dap_record_flush(rec, false);
+
+	int retval = rec->ops->send_sequence(dap, seq);
+
+	buf[0] = seq;
+	h_u32_to_le(buf + 1, retval);
+	dap_record_write(rec, DAP_RECORD_SEQUENCE, buf);
+	return retval;
+}
+
+static int dap_record_queue_dp_read(struct adiv5_dap *dap, unsigned int reg, uint32_t *data)
+{
+	struct dap_recorder *rec = dap->recorder;
+	int retval = rec->ops->queue_dp_read(dap, reg, data);
+
+	return dap_record_queued(rec, retval, DAP_RECORD_DP_READ, 0, reg, 0, data, NULL);
+}
+
+static int dap_record_queue_dp_write(struct adiv5_dap *dap, unsigned int reg, uint32_t data)
+{
+	struct dap_recorder *rec = dap->recorder;
+	int retval = rec->ops->queue_dp_write(dap, reg, data);
+
+	return dap_record_queued(rec, retval, DAP_RECORD_DP_WRITE, 0, reg, data, NULL, NULL);
+}
+
+static int dap_record_queue_ap_read(struct adiv5_ap *ap, unsigned int reg, uint32_t *data)
+{
+	struct dap_recorder *rec = ap->dap->recorder;
+	int retval = rec->ops->queue_ap_read(ap, reg, data);
+
+	return dap_record_queued(rec, retval, DAP_RECORD_AP_READ, ap->ap_num, reg, 0, data, NULL);
+}
+
+static int dap_record_queue_ap_write(struct adiv5_ap *ap, unsigned int reg, uint32_t data)
+{
+	struct dap_recorder *rec = ap->dap->recorder;
+	int retval = rec->ops->queue_ap_write(ap, reg, data);
+
+	return dap_record_queued(rec, retval, DAP_RECORD_AP_WRITE, ap->ap_num, reg, data, NULL, NULL);
+}
+
+static int dap_record_queue_ap_abort(struct adiv5_dap *dap, uint8_t *ack)
+{
+	struct dap_recorder *rec = dap->recorder;
+	int retval = rec->ops->queue_ap_abort(dap, ack);
+
+	return dap_record_queued(rec, retval, DAP_RECORD_ABORT, 0, 0, 0, NULL, ack);
+}
+
+static int dap_record_run_common(struct adiv5_dap *dap, uint8_t type,
+		int (*run)(struct adiv5_dap *dap))
+{
+	struct dap_recorder *rec = dap->recorder;
+	uint8_t buf[17];
+	int64_t start = dap_record_time_us();
+
+	int retval = run(dap);
+
+	int64_t end = dap_record_time_us();
+
+	dap_record_flush(rec, retval == ERROR_OK);
+	h_u32_to_le(buf, retval);
+	buf[4] = dap->do_reconnect ? DAP_RECORD_FLAG_RECONNECT : 0;
+	h_u64_to_le(buf + 5, start - rec->start_us);
+	h_u32_to_le(buf + 13, MIN(end - start, UINT32_MAX));
+	dap_record_write(rec, type, buf);
+
+	return retval;
+}
+
+static int dap_record_run(struct adiv5_dap *dap)
+{
+	return dap_record_run_common(dap, DAP_RECORD_RUN, dap->recorder->ops->run);
+}
+
+static int dap_record_sync(struct adiv5_dap *dap)
+{
+	return dap_record_run_common(dap, DAP_RECORD_SYNC, dap->recorder->ops->sync);
+}
+
+static void dap_record_quit(struct adiv5_dap *dap)
+{
+	const struct dap_ops *ops = dap->recorder->ops;
+
+	dap_record_stop(dap);
+	if (ops->quit)
+		ops->quit(dap);
+}
+
+/**
+ * Installs the recording operations over the transport's ones, if a
+ * recording was requested for @a dap. Called once dap->ops is known.
+ */
+int dap_record_attach(struct adiv5_dap *dap)
+{
+	struct dap_recorder *rec = dap->recorder;
+
+	if (!rec || !dap->ops || dap->ops == &rec->record_ops)
+		return ERROR_OK;
+
+	rec->ops = dap->ops;
+	rec->record_ops = (struct dap_ops) {
+		.connect = rec->ops->connect ? dap_record_connect : NULL,
+		.send_sequence = rec->ops->send_sequence ? dap_record_send_sequence : NULL,
+		.queue_dp_read = dap_record_queue_dp_read,
+		.queue_dp_write = dap_record_queue_dp_write,
+		.queue_ap_read = dap_record_queue_ap_read,
+		.queue_ap_write = dap_record_queue_ap_write,
+		.queue_ap_abort = dap_record_queue_ap_abort,
+		.run = dap_record_run,
+		.sync = rec->ops->sync ? dap_record_sync : NULL,
+		.quit = dap_record_quit,
+	};
+	dap->ops = &rec->record_ops;
+
+	return ERROR_OK;
+}
+
+/**
+ * Starts recording the transactions of @a dap to @a filename. Recording
+ * begins immediately if the DAP is initialized, else when it gets its
+ * transport at init.
+ */
+int dap_record_start(struct adiv5_dap *dap, const char *filename)
+{
+	dap_record_stop(dap);
+
+	struct dap_recorder *rec = calloc(1, sizeof(*rec));
+	if (!rec) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	rec->filename = strdup(filename);
+	rec->file = fopen(filename, "wb");
+	if (!rec->filename || !rec->file) {
+		LOG_ERROR("can't open DAP recording %s", filename);
+		if (rec->file)
+			fclose(rec->file);
+		free(rec->filename);
+		free(rec);
+		return ERROR_FAIL;
+	}
+
+	if (fwrite(DAP_RECORD_MAGIC, 1, DAP_RECORD_MAGIC_SIZE, rec->file) != DAP_RECORD_MAGIC_SIZE) {
+		LOG_ERROR("error writing DAP recording %s", filename);
+		fclose(rec->file);
+		free(rec->filename);
+		free(rec);
+		return ERROR_FAIL;
+	}
+
+	rec->start_us = dap_record_time_us();
+	dap->recorder = rec;
+
+	return dap_record_attach(dap);
+}
+
+/**
+ * Stops the recording of @a dap, if any, and restores the transport's
+ * operations. Queued operations not run yet are written without their
+ * read values.
+ */
+void dap_record_stop(struct adiv5_dap *dap)
+{
+	struct dap_recorder *rec = dap->recorder;
+
+	if (!rec)
+		return;
+
+	if (dap->ops == &rec->record_ops)
+		dap->ops = rec->ops;
+	dap->recorder = NULL;
+
+	dap_record_flush(rec, false);
+
+	if (rec->file) {
+		if (fclose(rec->file) != 0)
+			LOG_ERROR("error writing DAP recording %s", rec->filename);
+		else
+			LOG_INFO("DAP recording %s: %" PRIu64 " records", rec->filename, rec->records);
+	}
+
+	free(rec->queue);
+	free(rec->filename);
+	free(rec);
+}
@@ -0,0 +1,79 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_TARGET_ADI_V5_RECORD_H
+#define OPENOCD_TARGET_ADI_V5_RECORD_H
+
+/**
+ * @file
+ * Recording of the DAP transactions issued through struct dap_ops.
+ *
+ * A recording starts with the 8 bytes of DAP_RECORD_MAGIC, followed by
+ * records made of a type byte and little endian fields. Queued operations
+ * are written when the queue is run, so that read records hold the value
+ * returned by the adapter, and are followed by the RUN record carrying
+ * the result and the timing of the run. The reads of a failed run, or of
+ * a queue that was never run, are written as *_READ_NO_VALUE records, as
+ * the adapter may not have returned a value for them. The "dap_replay"
+ * adapter serves a recording back, without hardware.
+ */
+
+#include <stdint.h>
+
+struct adiv5_dap;
+
+#define DAP_RECORD_MAGIC		"OCDDAPR1"
+#define DAP_RECORD_MAGIC_SIZE	8
+
+enum dap_record_type {
+	DAP_RECORD_DP_READ = 1,		/* u16 reg, u32 value */
+	DAP_RECORD_DP_WRITE,		/* u16 reg, u32 value */
+	DAP_RECORD_AP_READ,			/* u64 ap_num, u16 reg, u32 value */
+	DAP_RECORD_AP_WRITE,		/* u64 ap_num, u16 reg, u32 value */
+	DAP_RECORD_ABORT,			/* u8 ack */
+	DAP_RECORD_RUN,				/* i32 retval, u8 flags, u64 start_us, u32 duration_us */
+	DAP_RECORD_SYNC,			/* same as DAP_RECORD_RUN */
+	DAP_RECORD_CONNECT,			/* no field, connect() started */
+	DAP_RECORD_CONNECTED,		/* i32 retval, connect() returned */
+	DAP_RECORD_SEQUENCE,		/* u8 sequence, i32 retval */
+	DAP_RECORD_QUEUE_ERROR,		/* i32 retval of the preceding queued operation */
+	DAP_RECORD_DP_READ_NO_VALUE,	/* same as DAP_RECORD_DP_READ, value not read */
+	DAP_RECORD_AP_READ_NO_VALUE,	/* same as DAP_RECORD_AP_READ, value not read */
+};
+
+/* RUN and SYNC flags */
+#define DAP_RECORD_FLAG_RECONNECT	1	/* dap->do_reconnect set by the run */
+
+/* size of the fields following the type byte, 0 for unknown types */
+static inline unsigned int dap_record_size(uint8_t type)
+{
+	switch (type) {
+	case DAP_RECORD_DP_READ:
+	case DAP_RECORD_DP_WRITE:
+	case DAP_RECORD_DP_READ_NO_VALUE:
+		return 2 + 4;
+	case DAP_RECORD_AP_READ:
+	case DAP_RECORD_AP_WRITE:
+	case DAP_RECORD_AP_READ_NO_VALUE:
+		return 8 + 2 + 4;
+	case DAP_RECORD_ABORT:
+		return 1;
+	case DAP_RECORD_RUN:
+	case DAP_RECORD_SYNC:
+		return 4 + 1 + 8 + 4;
+	case DAP_RECORD_CONNECT:
+		return 0;
+	case DAP_RECORD_CONNECTED:
+	case DAP_RECORD_QUEUE_ERROR:
+		return 4;
+	case DAP_RECORD_SEQUENCE:
+		return 1 + 4;
+	default:
+		return 0;
+	}
+}
+
+int dap_record_start(struct adiv5_dap *dap, const char *filename);
+int dap_record_attach(struct adiv5_dap *dap);
+void dap_record_stop(struct adiv5_dap *dap);
+
+#endif /* OPENOCD_TARGET_ADI_V5_RECORD_H */
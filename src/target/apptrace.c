@@ -0,0 +1,390 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/***************************************************************************
+ *   Application trace transport, see apptrace.h                           *
+ *   Copyright (C) 2017 Espressif Systems Ltd.                             *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_ARPA_INET_H
+#include <arpa/inet.h>
+#endif
+
+#ifdef HAVE_NETDB_H
+#include <netdb.h>
+#endif
+
+#ifndef _WIN32
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#endif
+
+#include <helper/log.h>
+#include <helper/replacements.h>
+#include <server/server.h>
+#include "apptrace.h"
+
+struct apptrace_dest_file_data {
+	int fout;
+};
+
+struct apptrace_dest_tcp_data {
+	int sockfd;
+};
+
+/*********************************************************************
+*                       Trace destination API
+**********************************************************************/
+
+static int apptrace_file_dest_write(void *priv, uint8_t *data, int size)
+{
+	struct apptrace_dest_file_data *dest_data = (struct apptrace_dest_file_data *)priv;
+
+	int wr_sz = write(dest_data->fout, data, size);
+	if (wr_sz != size) {
+		LOG_ERROR("Failed to write %d bytes to out file (%d)! Written %d.", size, errno, wr_sz);
+		return ERROR_FAIL;
+	}
+	return ERROR_OK;
+}
+
+static int apptrace_file_dest_cleanup(void *priv)
+{
+	struct apptrace_dest_file_data *dest_data = (struct apptrace_dest_file_data *)priv;
+
+	if (dest_data->fout > 0)
+		close(dest_data->fout);
+	free(dest_data);
+	return ERROR_OK;
+}
+
+static int apptrace_file_dest_init(struct apptrace_dest *dest, const char *dest_name)
+{
+	struct apptrace_dest_file_data *dest_data = calloc(1, sizeof(*dest_data));
+	if (!dest_data) {
+		LOG_ERROR("Failed to alloc mem for file dest!");
+		return ERROR_FAIL;
+	}
+
+	LOG_INFO("Open file %s", dest_name);
+	dest_data->fout = open(dest_name, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
+	if (dest_data->fout <= 0) {
+		LOG_ERROR("Failed to open file %s", dest_name);
+		free(dest_data);
+		return ERROR_FAIL;
+	}
+
+	dest->priv = dest_data;
+	dest->write = apptrace_file_dest_write;
+	dest->clean = apptrace_file_dest_cleanup;
+	dest->log_progress = true;
+
+	return ERROR_OK;
+}
+
+static int apptrace_console_dest_write(void *priv, uint8_t *data, int size)
+{
+	LOG_USER_N("%.*s", size, data);
+	return ERROR_OK;
+}
+
+static int apptrace_console_dest_cleanup(void *priv)
+{
+	return ERROR_OK;
+}
+
+static int apptrace_console_dest_init(struct apptrace_dest *dest, const char *dest_name)
+{
+	dest->priv = NULL;
+	dest->write = apptrace_console_dest_write;
+	dest->clean = apptrace_console_dest_cleanup;
+	dest->log_progress = false;
+
+	return ERROR_OK;
+}
+
+static int apptrace_tcp_dest_write(void *priv, uint8_t *data, int size)
+{
+	struct apptrace_dest_tcp_data *dest_data = (struct apptrace_dest_tcp_data *)priv;
+	int wr_sz = write_socket(dest_data->sockfd, data, size);
+	if (wr_sz != size) {
+		LOG_ERROR("Failed to write %u bytes to out socket (%d)! Written %d.", size, errno, wr_sz);
+		return ERROR_FAIL;
+	}
+	return ERROR_OK;
+}
+
+static int apptrace_tcp_dest_cleanup(void *priv)
+{
+	struct apptrace_dest_tcp_data *dest_data = (struct apptrace_dest_tcp_data *)priv;
+
+	if (dest_data->sockfd > 0)
+		close_socket(dest_data->sockfd);
+	free(dest_data);
+	return ERROR_OK;
+}
+
+static int apptrace_tcp_dest_init(struct apptrace_dest *dest, const char *dest_name)
+{
+	const char *port_sep = strchr(dest_name, ':');
+	/* separator not found, or was the first or the last character */
+	if (!port_sep || port_sep == dest_name || port_sep == dest_name + strlen(dest_name) - 1) {
+		LOG_ERROR("apptrace: Invalid connection URI, format should be tcp://host:port");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+	size_t hostname_len = port_sep - dest_name;
+
+	char hostname[64] = { 0 };
+	if (hostname_len >= sizeof(hostname)) {
+		LOG_ERROR("apptrace: Hostname too long");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+	memcpy(hostname, dest_name, hostname_len);
+
+	const char *port_str = port_sep + 1;
+	struct addrinfo *ai;
+	int flags = 0;
+#ifdef AI_NUMERICSERV
+	flags |= AI_NUMERICSERV;
+#endif	/* AI_NUMERICSERV */
+	struct addrinfo hint = {
+		.ai_family = AF_UNSPEC,
+		.ai_socktype = SOCK_STREAM,
+		.ai_protocol = 0,
+		.ai_flags = flags
+	};
+	int res = getaddrinfo(hostname, port_str, &hint, &ai);
+	if (res != 0) {
+		LOG_ERROR("apptrace: Failed to resolve host name: %s", hostname);
+		return ERROR_FAIL;
+	}
+	int sockfd = -1;
+	for (struct addrinfo *ai_it = ai; ai_it; ai_it = ai_it->ai_next) {
+		sockfd = socket(ai_it->ai_family, ai_it->ai_socktype, ai_it->ai_protocol);
+		if (sockfd < 0) {
+			LOG_DEBUG("apptrace: Failed to create socket (%d, %d, %d) (%s)",
+				ai_it->ai_family,
+				ai_it->ai_socktype,
+				ai_it->ai_protocol,
+				strerror(errno));
+			continue;
+		}
+
+		char cur_hostname[NI_MAXHOST];
+		char cur_portname[NI_MAXSERV];
+		res =
+			getnameinfo(ai_it->ai_addr, ai_it->ai_addrlen, cur_hostname,
+			sizeof(cur_hostname),
+			cur_portname, sizeof(cur_portname),
+			NI_NUMERICHOST | NI_NUMERICSERV);
+		if (res != 0)
+			continue;
+
+		LOG_INFO("apptrace: Trying to connect to %s:%s", cur_hostname, cur_portname);
+		if (connect(sockfd, ai_it->ai_addr, ai_it->ai_addrlen) < 0) {
+			close_socket(sockfd);
+			sockfd = -1;
+			LOG_WARNING("apptrace: Connection failed (%s)", strerror(errno));
+			continue;
+		}
+		break;
+	}
+	freeaddrinfo(ai);
+	if (sockfd < 0) {
+		LOG_ERROR("apptrace: Could not connect to %s:%s", hostname, port_str);
+		return ERROR_FAIL;
+	}
+	LOG_INFO("apptrace: Connected!");
+
+	struct apptrace_dest_tcp_data *dest_data = calloc(1, sizeof(struct apptrace_dest_tcp_data));
+	if (!dest_data) {
+		LOG_ERROR("apptrace: Failed to alloc mem for tcp dest!");
+		close_socket(sockfd);
+		return ERROR_FAIL;
+	}
+
+	dest_data->sockfd = sockfd;
+	dest->priv = dest_data;
+	dest->write = apptrace_tcp_dest_write;
+	dest->clean = apptrace_tcp_dest_cleanup;
+	dest->log_progress = true;
+
+	return ERROR_OK;
+}
+
+int apptrace_dest_init(struct apptrace_dest dest[], const char *dest_paths[], unsigned int max_dests)
+{
+	int res;
+	unsigned int i;
+
+	for (i = 0; i < max_dests; i++) {
+		if (strncmp(dest_paths[i], "file://", 7) == 0)
+			res = apptrace_file_dest_init(&dest[i], &dest_paths[i][7]);
+		else if (strncmp(dest_paths[i], "con:", 4) == 0)
+			res = apptrace_console_dest_init(&dest[i], NULL);
+		else if (strncmp(dest_paths[i], "tcp://", 6) == 0)
+			res = apptrace_tcp_dest_init(&dest[i], &dest_paths[i][6]);
+		else
+			break;
+
+		if (res != ERROR_OK) {
+			LOG_ERROR("apptrace: Failed to init trace data destination '%s'!", dest_paths[i]);
+			return 0;
+		}
+	}
+
+	return i;
+}
+
+int apptrace_dest_cleanup(struct apptrace_dest dest[], unsigned int max_dests)
+{
+	for (unsigned int i = 0; i < max_dests; i++) {
+		if (dest[i].clean && dest[i].priv) {
+			int res = dest[i].clean(dest[i].priv);
+			dest[i].priv = NULL;
+			return res;
+		}
+	}
+	return ERROR_OK;
+}
+
+/*********************************************************************
+*                 Trace data blocks management API
+**********************************************************************/
+
+static void apptrace_blocks_list_cleanup(struct list_head *head)
+{
+	struct apptrace_block *cur;
+	struct list_head *tmp, *pos;
+
+	list_for_each_safe(pos, tmp, head) {
+		cur = list_entry(pos, struct apptrace_block, node);
+		if (cur) {
+			list_del(&cur->node);
+			free(cur->data);
+			free(cur);
+		}
+	}
+}
+
+void apptrace_blocks_cleanup(struct apptrace_blocks *pool)
+{
+	apptrace_blocks_list_cleanup(&pool->free_blocks);
+	apptrace_blocks_list_cleanup(&pool->ready_blocks);
+}
+
+int apptrace_blocks_init(struct apptrace_blocks *pool, unsigned int num_blocks, uint32_t block_size)
+{
+	INIT_LIST_HEAD(&pool->ready_blocks);
+	INIT_LIST_HEAD(&pool->free_blocks);
+	pool->block_size = block_size;
+
+	for (unsigned int i = 0; i < num_blocks; i++) {
+		struct apptrace_block *block = calloc(1, sizeof(struct apptrace_block));
+		if (!block) {
+			LOG_ERROR("Failed to alloc trace buffer entry!");
+			apptrace_blocks_cleanup(pool);
+			return ERROR_FAIL;
+		}
+		block->data = malloc(block_size);
+		if (!block->data) {
+			free(block);
+			LOG_ERROR("Failed to alloc trace buffer %" PRIu32 " bytes!", block_size);
+			apptrace_blocks_cleanup(pool);
+			return ERROR_FAIL;
+		}
+		INIT_LIST_HEAD(&block->node);
+		list_add(&block->node, &pool->free_blocks);
+	}
+
+	return ERROR_OK;
+}
+
+struct apptrace_block *apptrace_free_block_get(struct apptrace_blocks *pool)
+{
+	struct apptrace_block *block = NULL;
+
+	if (!list_empty(&pool->free_blocks)) {
+		/*get first */
+		block = list_first_entry(&pool->free_blocks, struct apptrace_block, node);
+		list_del(&block->node);
+	}
+
+	return block;
+}
+
+int apptrace_ready_block_put(struct apptrace_blocks *pool, struct apptrace_block *block)
+{
+	LOG_DEBUG("apptrace_ready_block_put");
+	/* add to ready blocks list, the data processor takes them in order */
+	INIT_LIST_HEAD(&block->node);
+	list_add_tail(&block->node, &pool->ready_blocks);
+
+	return ERROR_OK;
+}
+
+struct apptrace_block *apptrace_ready_block_get(struct apptrace_blocks *pool)
+{
+	struct apptrace_block *block = NULL;
+
+	if (!list_empty(&pool->ready_blocks)) {
+		block = list_first_entry(&pool->ready_blocks, struct apptrace_block, node);
+		/* remove it from ready list */
+		list_del(&block->node);
+	}
+
+	return block;
+}
+
+int apptrace_block_free(struct apptrace_blocks *pool, struct apptrace_block *block)
+{
+	/* add to free blocks list */
+	INIT_LIST_HEAD(&block->node);
+	list_add(&block->node, &pool->free_blocks);
+
+	return ERROR_OK;
+}
+
+/*********************************************************************
+*                       Trace statistics
+**********************************************************************/
+
+void apptrace_stats_init(struct apptrace_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	stats->min_blk_read_time = 1000000.0;
+	stats->min_blk_proc_time = 1000000.0;
+}
+
+void apptrace_stats_blk_read(struct apptrace_stats *stats, float time)
+{
+	if (time > stats->max_blk_read_time)
+		stats->max_blk_read_time = time;
+	if (time < stats->min_blk_read_time)
+		stats->min_blk_read_time = time;
+}
+
+void apptrace_stats_blk_proc(struct apptrace_stats *stats, float time)
+{
+	if (time > stats->max_blk_proc_time)
+		stats->max_blk_proc_time = time;
+	if (time < stats->min_blk_proc_time)
+		stats->min_blk_proc_time = time;
+}
+
+void apptrace_stats_print(const struct apptrace_stats *stats)
+{
+	LOG_USER("Data: blocks incomplete %" PRId32 ", lost bytes: %" PRId32 ", stalls: %" PRId32,
+		stats->incompl_blocks,
+		stats->lost_bytes,
+		stats->stalls);
+	LOG_USER("Block read time [%f..%f] ms",
+		1000 * stats->min_blk_read_time,
+		1000 * stats->max_blk_read_time);
+	LOG_USER("Block proc time [%f..%f] ms",
+		1000 * stats->min_blk_proc_time,
+		1000 * stats->max_blk_proc_time);
+}
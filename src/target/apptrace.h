@@ -0,0 +1,79 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/***************************************************************************
+ *   Application trace transport                                           *
+ *   Copyright (C) 2017-2019 Espressif Systems Ltd.                        *
+ ***************************************************************************/
+
+#ifndef OPENOCD_TARGET_APPTRACE_H
+#define OPENOCD_TARGET_APPTRACE_H
+
+/**
+ * @file
+ * Target independent parts of the application trace, shared by the ESP32
+ * apptrace and the RTT trace: the destinations the trace data is written
+ * to, the pool of blocks carrying the data from the target reader to the
+ * data processor, and the transfer statistics.
+ *
+ * The reader takes a block from the free list, fills it from the target
+ * and queues it on the ready list; the data processor, run from a timer
+ * callback, writes the ready blocks to the destination and returns them
+ * to the free list. When no block is free the reader leaves the data on
+ * the target, which gives back-pressure instead of losing the data.
+ */
+
+#include <helper/list.h>
+#include <helper/time_support.h>
+
+/** Trace data destination, see apptrace_dest_init(). */
+struct apptrace_dest {
+	void *priv;
+	int (*write)(void *priv, uint8_t *data, int size);
+	int (*clean)(void *priv);
+	bool log_progress;
+};
+
+struct apptrace_block {
+	struct list_head node;
+	uint8_t *data;
+	uint32_t data_len;
+};
+
+struct apptrace_blocks {
+	struct list_head free_blocks;
+	struct list_head ready_blocks;
+	uint32_t block_size;
+};
+
+struct apptrace_stats {
+	uint32_t incompl_blocks;
+	uint32_t lost_bytes;
+	/** Reads deferred because no block was free. */
+	uint32_t stalls;
+	float min_blk_read_time;
+	float max_blk_read_time;
+	float min_blk_proc_time;
+	float max_blk_proc_time;
+};
+
+int apptrace_dest_init(struct apptrace_dest dest[], const char *dest_paths[], unsigned int max_dests);
+int apptrace_dest_cleanup(struct apptrace_dest dest[], unsigned int max_dests);
+
+int apptrace_blocks_init(struct apptrace_blocks *pool, unsigned int num_blocks, uint32_t block_size);
+void apptrace_blocks_cleanup(struct apptrace_blocks *pool);
+struct apptrace_block *apptrace_free_block_get(struct apptrace_blocks *pool);
+int apptrace_ready_block_put(struct apptrace_blocks *pool, struct apptrace_block *block);
+struct apptrace_block *apptrace_ready_block_get(struct apptrace_blocks *pool);
+int apptrace_block_free(struct apptrace_blocks *pool, struct apptrace_block *block);
+
+static inline bool apptrace_blocks_pending(struct apptrace_blocks *pool)
+{
+	return !list_empty(&pool->ready_blocks);
+}
+
+void apptrace_stats_init(struct apptrace_stats *stats);
+void apptrace_stats_blk_read(struct apptrace_stats *stats, float time);
+void apptrace_stats_blk_proc(struct apptrace_stats *stats, float time);
+void apptrace_stats_print(const struct apptrace_stats *stats);
+
+#endif	/* OPENOCD_TARGET_APPTRACE_H */
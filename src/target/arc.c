@@ -1698,16 +1698,11 @@ static void arc_reset_actionpoints(struct target *target)
 {
 	struct arc_common *arc = target_to_arc(target);
 	struct arc_actionpoint *ap_list = arc->actionpoints_list;
-	struct breakpoint *next_b;
 	struct watchpoint *next_w;
 
-	while (target->breakpoints) {
-		next_b = target->breakpoints->next;
-		arc_remove_breakpoint(target, target->breakpoints);
-		free(target->breakpoints->orig_instr);
-		free(target->breakpoints);
-		target->breakpoints = next_b;
-	}
+	for (struct breakpoint *b = target->breakpoints; b; b = b->next)
+		arc_remove_breakpoint(target, b);
+	breakpoint_forget_all(target);
 	while (target->watchpoints) {
 		next_w = target->watchpoints->next;
 		arc_remove_watchpoint(target, target->watchpoints);
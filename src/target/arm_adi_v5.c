@@ -65,6 +65,7 @@
 #include "arm.h"
 #include "arm_adi_v5.h"
 #include "arm_coresight.h"
+#include "adi_v5_record.h"
 #include "jtag/swd.h"
 #include "transport/transport.h"
 #include <helper/align.h>
@@ -2782,6 +2783,21 @@ COMMAND_HANDLER(dap_nu_npcx_quirks_command)
 								"Nuvoton NPCX quirks mode");
 }
 
+COMMAND_HANDLER(dap_record_command)
+{
+	struct adiv5_dap *dap = adiv5_get_dap(CMD_DATA);
+
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!strcmp(CMD_ARGV[0], "off")) {
+		dap_record_stop(dap);
+		return ERROR_OK;
+	}
+
+	return dap_record_start(dap, CMD_ARGV[0]);
+}
+
 const struct command_registration dap_instance_commands[] = {
 	{
 		.name = "info",
@@ -2861,5 +2877,12 @@ const struct command_registration dap_instance_commands[] = {
 		.help = "set/get quirks mode for Nuvoton NPCX controllers",
 		.usage = "[enable]",
 	},
+	{
+		.name = "record",
+		.handler = dap_record_command,
+		.mode = COMMAND_ANY,
+		.help = "record the DAP transactions to a file, or stop recording",
+		.usage = "filename|'off'",
+	},
 	COMMAND_REGISTRATION_DONE
 };
@@ -396,6 +396,9 @@ struct adiv5_dap {
 
 	/* ADIv6 only field indicating ROM Table address size */
 	unsigned int asize;
+
+	/* Transaction recorder, see adi_v5_record.h */
+	struct dap_recorder *recorder;
 };
 
 /**
@@ -12,6 +12,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include "target/arm_adi_v5.h"
+#include "target/adi_v5_record.h"
 #include "target/arm.h"
 #include "helper/list.h"
 #include "helper/command.h"
@@ -117,6 +118,10 @@ static int dap_init_all(void)
 		} else
 			dap->ops = &jtag_dp_ops;
 
+		retval = dap_record_attach(dap);
+		if (retval != ERROR_OK)
+			return retval;
+
 		if (dap->adi_version == 0) {
 			LOG_DEBUG("DAP %s configured by default to use ADIv5 protocol", jtag_tap_name(dap->tap));
 			dap->adi_version = 5;
@@ -986,6 +986,203 @@ fail:
 	return retval;
 }
 
+/*
+ * Read the general purpose registers X0..X30 of an Aarch64 core with a
+ * single run of the DAP queue. For every register, the MSR DBGDTR_EL0 is
+ * written to ITR and DSCR, DTRTX and DTRRX are read back, without polling
+ * in between. The DSCR values read are checked afterwards: an instruction
+ * not yet complete when its DSCR was read, an ITR overrun or an error
+ * makes this return ERROR_FAIL with the DCC drained and the sticky errors
+ * cleared, the registers not read being left invalid for the slow path.
+ */
+static int dpmv8_read_gprs_queued(struct arm_dpm *dpm, struct reg **regs,
+	unsigned int count)
+{
+	struct armv8_common *armv8 = dpm->arm->arch_info;
+	uint32_t dscr[ARMV8_R30 + 1];
+	uint32_t lower[ARMV8_R30 + 1];
+	uint32_t higher[ARMV8_R30 + 1];
+	int retval = ERROR_OK;
+
+	for (unsigned int i = 0; i < count && retval == ERROR_OK; i++) {
+		struct arm_reg *arm_reg = regs[i]->arch_info;
+
+		retval = mem_ap_write_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_ITR,
+				ARMV8_MSR_GP(SYSTEM_DBG_DBGDTR_EL0, arm_reg->num));
+		if (retval == ERROR_OK)
+			retval = mem_ap_read_u32(armv8->debug_ap,
+					armv8->debug_base + CPUV8_DBG_DSCR, &dscr[i]);
+		if (retval == ERROR_OK)
+			retval = mem_ap_read_u32(armv8->debug_ap,
+					armv8->debug_base + CPUV8_DBG_DTRTX, &lower[i]);
+		if (retval == ERROR_OK)
+			retval = mem_ap_read_u32(armv8->debug_ap,
+					armv8->debug_base + CPUV8_DBG_DTRRX, &higher[i]);
+	}
+
+	if (retval == ERROR_OK)
+		retval = dap_run(armv8->debug_ap->dap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (unsigned int i = 0; i < count; i++) {
+		struct reg *r = regs[i];
+
+		if ((dscr[i] & (DSCR_ITE | DSCR_DTR_TX_FULL | DSCR_ERR | DSCR_ITO))
+				!= (DSCR_ITE | DSCR_DTR_TX_FULL)) {
+			LOG_DEBUG("queued read of %s failed, dscr 0x%08" PRIx32,
+				r->name, dscr[i]);
+			retval = ERROR_FAIL;
+			break;
+		}
+
+		uint64_t value_64 = lower[i] | (uint64_t)higher[i] << 32;
+
+		buf_set_u64(r->value, 0, 64, value_64);
+		r->valid = true;
+		r->dirty = false;
+		LOG_DEBUG("READ: %s, %16.8llx", r->name, (unsigned long long) value_64);
+
+		dpm->dscr = dscr[i] & ~DSCR_DTR_TX_FULL;
+		dpm->last_el = (dscr[i] >> 8) & 3;
+	}
+
+	if (retval == ERROR_OK)
+		return ERROR_OK;
+
+	/* let the last instruction complete and empty the DCC it may have filled */
+	uint32_t dscr_now;
+	long long then = timeval_ms();
+	do {
+		retval = mem_ap_read_atomic_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DSCR, &dscr_now);
+		if (retval != ERROR_OK)
+			return retval;
+		if (timeval_ms() > then + 1000) {
+			LOG_ERROR("Timeout waiting for DSCR.ITE, dscr = 0x%08" PRIx32, dscr_now);
+			return ERROR_FAIL;
+		}
+	} while ((dscr_now & DSCR_ITE) == 0);
+
+	if (dscr_now & DSCR_DTR_TX_FULL) {
+		mem_ap_read_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DTRTX, &lower[0]);
+		mem_ap_read_u32(armv8->debug_ap,
+				armv8->debug_base + CPUV8_DBG_DTRRX, &higher[0]);
+	}
+
+	/* clear the ITO/TXU/ERR sticky flags */
+	mem_ap_write_u32(armv8->debug_ap,
+			armv8->debug_base + CPUV8_DBG_DRCR, DRCR_CSE);
+
+	retval = dap_run(armv8->debug_ap->dap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	dpm->dscr = dscr_now & ~DSCR_DTR_TX_FULL;
+	dpm->last_el = (dscr_now >> 8) & 3;
+
+	return ERROR_FAIL;
+}
+
+/*
+ * Read the invalid core registers of a list within a single prepare/finish
+ * pair, instead of entering and leaving debug state for every register as
+ * reg->type->get() does. In Aarch64 state the general purpose registers
+ * are read first with one run of the DAP queue, see
+ * dpmv8_read_gprs_queued(); the other registers, and the general purpose
+ * registers left when the queued read fails, are read one at a time.
+ * Entries of the Aarch32 shadow cache are refreshed through the Aarch64
+ * register they map to. Registers of other caches and banked registers
+ * not accessible from the current EL are left for the caller.
+ */
+int armv8_dpm_read_registers(struct target *target, struct reg **reg_list,
+	int reg_count)
+{
+	struct arm *arm = target_to_arm(target);
+	struct arm_dpm *dpm = arm->dpm;
+	struct reg_cache *cache = arm->core_cache;
+	struct reg_cache *cache32 = cache->next;
+	bool prepared = false;
+	int retval = ERROR_OK;
+
+	if (armv8_dpm_get_core_state(dpm) == ARM_STATE_AARCH64) {
+		struct reg *gprs[ARMV8_R30 + 1];
+		unsigned int num_gprs = 0;
+
+		for (int i = 0; i < reg_count; i++) {
+			struct reg *r = reg_list[i];
+
+			if (!r || r < cache->reg_list ||
+					r > cache->reg_list + ARMV8_R30 ||
+					!r->exist || r->valid)
+				continue;
+
+			/* the list may name a register twice */
+			bool queued = false;
+			for (unsigned int j = 0; j < num_gprs; j++)
+				queued |= gprs[j] == r;
+			if (!queued)
+				gprs[num_gprs++] = r;
+		}
+
+		if (num_gprs > 1) {
+			retval = dpm->prepare(dpm);
+			if (retval != ERROR_OK)
+				return retval;
+			prepared = true;
+
+			retval = dpmv8_read_gprs_queued(dpm, gprs, num_gprs);
+			if (retval != ERROR_OK)
+				LOG_DEBUG("queued register read failed, reading one at a time");
+			retval = ERROR_OK;
+		}
+	}
+
+	for (int i = 0; i < reg_count; i++) {
+		struct reg *r = reg_list[i];
+
+		if (!r || !r->exist || r->valid)
+			continue;
+
+		bool is64 = r >= cache->reg_list &&
+			r < cache->reg_list + cache->num_regs;
+		bool is32 = cache32 && r >= cache32->reg_list &&
+			r < cache32->reg_list + cache32->num_regs;
+		if (!is64 && !is32)
+			continue;
+
+		struct arm_reg *arm_reg = r->arch_info;
+		struct reg *r64 = cache->reg_list + arm_reg->num;
+
+		if (!r64->valid) {
+			if (arm_reg->mode != ARM_MODE_ANY &&
+					dpm->last_el != armv8_curel_from_core_mode(arm_reg->mode))
+				continue;
+
+			if (!prepared) {
+				retval = dpm->prepare(dpm);
+				if (retval != ERROR_OK)
+					return retval;
+				prepared = true;
+			}
+
+			retval = dpmv8_read_reg(dpm, r64, arm_reg->num);
+			if (retval != ERROR_OK)
+				break;
+		}
+
+		if (is32)
+			r->valid = r64->valid;
+	}
+
+	if (prepared)
+		/* (void) */ dpm->finish(dpm);
+
+	return retval;
+}
+
 static int armv8_dpm_write_core_reg(struct target *target, struct reg *r,
 	int regnum, enum arm_mode mode, uint8_t *value)
 {
@@ -31,39 +31,97 @@ static const char * const watchpoint_rw_strings[] = {
 /* monotonic counter/id-number for breakpoints and watch points */
 static int bpwp_unique_id;
 
+/*
+ * Breakpoints are kept in target->breakpoints in the order they were
+ * added, and additionally chained by address in target->breakpoint_hash
+ * so that lookups on resume and step don't walk the whole list. New
+ * breakpoints are always linked at target->breakpoints_tail.
+ */
+static unsigned int breakpoint_hash(target_addr_t address)
+{
+	uint32_t a = (uint32_t)(address >> 32) ^ (uint32_t)address;
+
+	/* instructions are at least 2 bytes aligned */
+	return ((a >> 1) * 0x9e3779b1u) >> 26 & (TARGET_BREAKPOINT_HASH_SIZE - 1);
+}
+
+static void breakpoint_link(struct target *target, struct breakpoint **breakpoint_p,
+	struct breakpoint *breakpoint)
+{
+	struct breakpoint **bucket = &target->breakpoint_hash[breakpoint_hash(breakpoint->address)];
+
+	*breakpoint_p = breakpoint;
+	breakpoint->hash_next = *bucket;
+	*bucket = breakpoint;
+
+	if (!breakpoint->next)
+		target->breakpoints_tail = &breakpoint->next;
+}
+
+static void breakpoint_unlink(struct target *target, struct breakpoint **breakpoint_p,
+	struct breakpoint *breakpoint)
+{
+	struct breakpoint **bucket = &target->breakpoint_hash[breakpoint_hash(breakpoint->address)];
+
+	while (*bucket && *bucket != breakpoint)
+		bucket = &(*bucket)->hash_next;
+	if (*bucket)
+		*bucket = breakpoint->hash_next;
+
+	*breakpoint_p = breakpoint->next;
+
+	if (!breakpoint->next)
+		target->breakpoints_tail = breakpoint_p;
+}
+
+/* the tail of the breakpoint list, where the next breakpoint is linked */
+static struct breakpoint **breakpoint_tail(struct target *target)
+{
+	if (!target->breakpoints)
+		return &target->breakpoints;
+
+	return target->breakpoints_tail;
+}
+
+static struct breakpoint *breakpoint_alloc(target_addr_t address, uint32_t asid,
+	uint32_t length, enum breakpoint_type type)
+{
+	struct breakpoint *breakpoint = malloc(sizeof(struct breakpoint));
+
+	breakpoint->address = address;
+	breakpoint->asid = asid;
+	breakpoint->length = length;
+	breakpoint->type = type;
+	breakpoint->is_set = false;
+	breakpoint->orig_instr = malloc(length);
+	breakpoint->next = NULL;
+	breakpoint->hash_next = NULL;
+	breakpoint->unique_id = bpwp_unique_id++;
+
+	return breakpoint;
+}
+
 static int breakpoint_add_internal(struct target *target,
 	target_addr_t address,
 	uint32_t length,
 	enum breakpoint_type type)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
-	struct breakpoint **breakpoint_p = &target->breakpoints;
+	struct breakpoint *breakpoint = breakpoint_find(target, address);
+	struct breakpoint **breakpoint_p = breakpoint_tail(target);
 	const char *reason;
 	int retval;
 
-	while (breakpoint) {
-		if (breakpoint->address == address) {
-			/* FIXME don't assume "same address" means "same
-			 * breakpoint" ... check all the parameters before
-			 * succeeding.
-			 */
-			LOG_ERROR("Duplicate Breakpoint address: " TARGET_ADDR_FMT " (BP %" PRIu32 ")",
-				address, breakpoint->unique_id);
-			return ERROR_TARGET_DUPLICATE_BREAKPOINT;
-		}
-		breakpoint_p = &breakpoint->next;
-		breakpoint = breakpoint->next;
+	if (breakpoint) {
+		/* FIXME don't assume "same address" means "same
+		 * breakpoint" ... check all the parameters before
+		 * succeeding.
+		 */
+		LOG_ERROR("Duplicate Breakpoint address: " TARGET_ADDR_FMT " (BP %" PRIu32 ")",
+			address, breakpoint->unique_id);
+		return ERROR_TARGET_DUPLICATE_BREAKPOINT;
 	}
 
-	(*breakpoint_p) = malloc(sizeof(struct breakpoint));
-	(*breakpoint_p)->address = address;
-	(*breakpoint_p)->asid = 0;
-	(*breakpoint_p)->length = length;
-	(*breakpoint_p)->type = type;
-	(*breakpoint_p)->is_set = false;
-	(*breakpoint_p)->orig_instr = malloc(length);
-	(*breakpoint_p)->next = NULL;
-	(*breakpoint_p)->unique_id = bpwp_unique_id++;
+	breakpoint_link(target, breakpoint_p, breakpoint_alloc(address, 0, length, type));
 
 	retval = target_add_breakpoint(target, *breakpoint_p);
 	switch (retval) {
@@ -79,9 +137,10 @@ static int breakpoint_add_internal(struct target *target,
 			reason = "unknown reason";
 fail:
 			LOG_ERROR("can't add breakpoint: %s", reason);
-			free((*breakpoint_p)->orig_instr);
-			free(*breakpoint_p);
-			*breakpoint_p = NULL;
+			breakpoint = *breakpoint_p;
+			breakpoint_unlink(target, breakpoint_p, breakpoint);
+			free(breakpoint->orig_instr);
+			free(breakpoint);
 			return retval;
 	}
 
@@ -118,21 +177,14 @@ static int context_breakpoint_add_internal(struct target *target,
 		breakpoint = breakpoint->next;
 	}
 
-	(*breakpoint_p) = malloc(sizeof(struct breakpoint));
-	(*breakpoint_p)->address = 0;
-	(*breakpoint_p)->asid = asid;
-	(*breakpoint_p)->length = length;
-	(*breakpoint_p)->type = type;
-	(*breakpoint_p)->is_set = false;
-	(*breakpoint_p)->orig_instr = malloc(length);
-	(*breakpoint_p)->next = NULL;
-	(*breakpoint_p)->unique_id = bpwp_unique_id++;
+	breakpoint_link(target, breakpoint_p, breakpoint_alloc(0, asid, length, type));
 	retval = target_add_context_breakpoint(target, *breakpoint_p);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("could not add breakpoint");
-		free((*breakpoint_p)->orig_instr);
-		free(*breakpoint_p);
-		*breakpoint_p = NULL;
+		breakpoint = *breakpoint_p;
+		breakpoint_unlink(target, breakpoint_p, breakpoint);
+		free(breakpoint->orig_instr);
+		free(breakpoint);
 		return retval;
 	}
 
@@ -150,11 +202,11 @@ static int hybrid_breakpoint_add_internal(struct target *target,
 	uint32_t length,
 	enum breakpoint_type type)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
-	struct breakpoint **breakpoint_p = &target->breakpoints;
+	struct breakpoint *breakpoint = target->breakpoint_hash[breakpoint_hash(address)];
+	struct breakpoint **breakpoint_p = breakpoint_tail(target);
 	int retval;
 
-	while (breakpoint) {
+	for (; breakpoint; breakpoint = breakpoint->hash_next) {
 		if ((breakpoint->asid == asid) && (breakpoint->address == address)) {
 			/* FIXME don't assume "same address" means "same
 			 * breakpoint" ... check all the parameters before
@@ -169,26 +221,16 @@ static int hybrid_breakpoint_add_internal(struct target *target,
 			return ERROR_TARGET_DUPLICATE_BREAKPOINT;
 
 		}
-		breakpoint_p = &breakpoint->next;
-		breakpoint = breakpoint->next;
 	}
-	(*breakpoint_p) = malloc(sizeof(struct breakpoint));
-	(*breakpoint_p)->address = address;
-	(*breakpoint_p)->asid = asid;
-	(*breakpoint_p)->length = length;
-	(*breakpoint_p)->type = type;
-	(*breakpoint_p)->is_set = false;
-	(*breakpoint_p)->orig_instr = malloc(length);
-	(*breakpoint_p)->next = NULL;
-	(*breakpoint_p)->unique_id = bpwp_unique_id++;
-
+	breakpoint_link(target, breakpoint_p, breakpoint_alloc(address, asid, length, type));
 
 	retval = target_add_hybrid_breakpoint(target, *breakpoint_p);
 	if (retval != ERROR_OK) {
 		LOG_ERROR("could not add breakpoint");
-		free((*breakpoint_p)->orig_instr);
-		free(*breakpoint_p);
-		*breakpoint_p = NULL;
+		breakpoint = *breakpoint_p;
+		breakpoint_unlink(target, breakpoint_p, breakpoint);
+		free(breakpoint->orig_instr);
+		free(breakpoint);
 		return retval;
 	}
 	LOG_DEBUG(
@@ -289,20 +331,31 @@ static void breakpoint_free(struct target *target, struct breakpoint *breakpoint
 	retval = target_remove_breakpoint(target, breakpoint);
 
 	LOG_DEBUG("free BPID: %" PRIu32 " --> %d", breakpoint->unique_id, retval);
-	(*breakpoint_p) = breakpoint->next;
+	breakpoint_unlink(target, breakpoint_p, breakpoint);
 	free(breakpoint->orig_instr);
 	free(breakpoint);
 }
 
+void breakpoint_forget_all(struct target *target)
+{
+	while (target->breakpoints) {
+		struct breakpoint *breakpoint = target->breakpoints;
+
+		breakpoint_unlink(target, &target->breakpoints, breakpoint);
+		free(breakpoint->orig_instr);
+		free(breakpoint);
+	}
+}
+
 static int breakpoint_remove_internal(struct target *target, target_addr_t address)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
+	struct breakpoint *breakpoint = breakpoint_find(target, address);
 
-	while (breakpoint) {
-		if ((breakpoint->address == address) ||
-		    (breakpoint->address == 0 && breakpoint->asid == address))
-			break;
-		breakpoint = breakpoint->next;
+	/* context breakpoints are removed by asid */
+	if (!breakpoint) {
+		for (breakpoint = target->breakpoints; breakpoint; breakpoint = breakpoint->next)
+			if (breakpoint->address == 0 && breakpoint->asid == address)
+				break;
 	}
 
 	if (breakpoint) {
@@ -381,12 +434,12 @@ void breakpoint_clear_target(struct target *target)
 
 struct breakpoint *breakpoint_find(struct target *target, target_addr_t address)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
+	struct breakpoint *breakpoint = target->breakpoint_hash[breakpoint_hash(address)];
 
 	while (breakpoint) {
 		if (breakpoint->address == address)
 			return breakpoint;
-		breakpoint = breakpoint->next;
+		breakpoint = breakpoint->hash_next;
 	}
 
 	return NULL;
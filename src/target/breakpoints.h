@@ -32,6 +32,7 @@ struct breakpoint {
 	unsigned int number;
 	uint8_t *orig_instr;
 	struct breakpoint *next;
+	struct breakpoint *hash_next;
 	uint32_t unique_id;
 	int linked_brp;
 };
@@ -57,6 +58,8 @@ int hybrid_breakpoint_add(struct target *target,
 		target_addr_t address, uint32_t asid, uint32_t length, enum breakpoint_type type);
 void breakpoint_remove(struct target *target, target_addr_t address);
 void breakpoint_remove_all(struct target *target);
+/* free the breakpoints of this target only, without removing them from it */
+void breakpoint_forget_all(struct target *target);
 
 struct breakpoint *breakpoint_find(struct target *target, target_addr_t address);
 
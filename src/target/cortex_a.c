@@ -114,6 +114,9 @@ static int cortex_a_prep_memaccess(struct target *target, int phys_access)
 	struct cortex_a_common *cortex_a = target_to_cortex_a(target);
 	int mmu_enabled = 0;
 
+	/* accesses through the core may allocate cache lines again */
+	cortex_a->memory_ap_cache_clean = false;
+
 	if (phys_access == 0) {
 		arm_dpm_modeswitch(&armv7a->dpm, ARM_MODE_SVC);
 		cortex_a_mmu(target, &mmu_enabled);
@@ -995,6 +998,8 @@ static int cortex_a_debug_entry(struct target *target)
 
 	LOG_DEBUG("dscr = 0x%08" PRIx32, cortex_a->cpudbg_dscr);
 
+	cortex_a->memory_ap_cache_clean = false;
+
 	/* REVISIT surely we should not re-read DSCR !! */
 	retval = mem_ap_read_atomic_u32(armv7a->debug_ap,
 			armv7a->debug_base + CPUDBG_DSCR, &dscr);
@@ -2678,6 +2683,81 @@ static int cortex_a_read_cpu_memory(struct target *target,
  * ap number for every access.
  */
 
+/*
+ * System MEM-AP configured with "cortex_a memory_ap", or NULL if physical
+ * memory has to be accessed through the CPU.
+ */
+static struct adiv5_ap *cortex_a_memory_ap(struct target *target)
+{
+	struct cortex_a_common *cortex_a = target_to_cortex_a(target);
+	struct adiv5_dap *dap = cortex_a->armv7a_common.arm.dap;
+
+	if (cortex_a->memory_ap_num == DP_APSEL_INVALID)
+		return NULL;
+
+	if (!cortex_a->memory_ap) {
+		cortex_a->memory_ap = dap_get_ap(dap, cortex_a->memory_ap_num);
+		if (!cortex_a->memory_ap || mem_ap_init(cortex_a->memory_ap) != ERROR_OK) {
+			LOG_WARNING("%s: cannot use MEM-AP 0x%" PRIx64 " for memory access, "
+					"using the CPU", target_name(target), cortex_a->memory_ap_num);
+			if (cortex_a->memory_ap)
+				dap_put_ap(cortex_a->memory_ap);
+			cortex_a->memory_ap = NULL;
+			cortex_a->memory_ap_num = DP_APSEL_INVALID;
+		}
+	}
+
+	return cortex_a->memory_ap;
+}
+
+/*
+ * The MEM-AP bypasses the CPU caches: clean and invalidate the data
+ * caches so that the AP sees, and the CPU later refetches, current data.
+ * The halted core does not allocate cache lines, so this is only needed
+ * once per halt, and again after an access through the core.
+ */
+static struct adiv5_ap *cortex_a_prep_memory_ap(struct target *target)
+{
+	struct cortex_a_common *cortex_a = target_to_cortex_a(target);
+	struct armv7a_common *armv7a = target_to_armv7a(target);
+	struct armv7a_cache_common *cache = &armv7a->armv7a_mmu.armv7a_cache;
+	struct adiv5_ap *ap = cortex_a_memory_ap(target);
+
+	if (ap && !cortex_a->memory_ap_cache_clean && cache->d_u_cache_enabled
+			&& cache->flush_all_data_cache) {
+		if (cache->flush_all_data_cache(target) != ERROR_OK)
+			return NULL;
+		cortex_a->memory_ap_cache_clean = true;
+	}
+
+	return ap;
+}
+
+/*
+ * The instruction cache may hold stale copies of memory written through
+ * the MEM-AP. Invalidate the written range, or the whole cache when the
+ * MMU is on and the virtual address of the range is not known.
+ */
+static int cortex_a_post_memory_ap_write(struct target *target,
+	target_addr_t address, uint32_t size)
+{
+	struct armv7a_common *armv7a = target_to_armv7a(target);
+	int mmu_enabled = 0;
+	int retval;
+
+	if (!armv7a->armv7a_mmu.armv7a_cache.i_cache_enabled)
+		return ERROR_OK;
+
+	retval = cortex_a_mmu(target, &mmu_enabled);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (mmu_enabled)
+		return armv7a_l1_i_cache_inval_all(target);
+
+	return armv7a_l1_i_cache_inval_virt(target, address, size);
+}
+
 static int cortex_a_read_phys_memory(struct target *target,
 	target_addr_t address, uint32_t size,
 	uint32_t count, uint8_t *buffer)
@@ -2690,6 +2770,16 @@ static int cortex_a_read_phys_memory(struct target *target,
 	LOG_DEBUG("Reading memory at real address " TARGET_ADDR_FMT "; size %" PRIu32 "; count %" PRIu32,
 		address, size, count);
 
+	/* read memory through the system MEM-AP, if there is one */
+	struct adiv5_ap *ap = cortex_a_prep_memory_ap(target);
+	if (ap) {
+		retval = mem_ap_read_buf(ap, buffer, size, count, address);
+		if (retval == ERROR_OK)
+			return retval;
+		LOG_DEBUG("%s: MEM-AP read failed, retrying through the CPU",
+				target_name(target));
+	}
+
 	/* read memory through the CPU */
 	cortex_a_prep_memaccess(target, 1);
 	retval = cortex_a_read_cpu_memory(target, address, size, count, buffer);
@@ -2707,6 +2797,12 @@ static int cortex_a_read_memory(struct target *target, target_addr_t address,
 	LOG_DEBUG("Reading memory at address " TARGET_ADDR_FMT "; size %" PRIu32 "; count %" PRIu32,
 		address, size, count);
 
+	/* without MMU virtual and physical addresses are the same */
+	int mmu_enabled = 0;
+	if (cortex_a_memory_ap(target) && cortex_a_mmu(target, &mmu_enabled) == ERROR_OK
+			&& !mmu_enabled)
+		return cortex_a_read_phys_memory(target, address, size, count, buffer);
+
 	cortex_a_prep_memaccess(target, 0);
 	retval = cortex_a_read_cpu_memory(target, address, size, count, buffer);
 	cortex_a_post_memaccess(target, 0);
@@ -2726,6 +2822,16 @@ static int cortex_a_write_phys_memory(struct target *target,
 	LOG_DEBUG("Writing memory to real address " TARGET_ADDR_FMT "; size %" PRIu32 "; count %" PRIu32,
 		address, size, count);
 
+	/* write memory through the system MEM-AP, if there is one */
+	struct adiv5_ap *ap = cortex_a_prep_memory_ap(target);
+	if (ap) {
+		retval = mem_ap_write_buf(ap, buffer, size, count, address);
+		if (retval == ERROR_OK)
+			return cortex_a_post_memory_ap_write(target, address, size * count);
+		LOG_DEBUG("%s: MEM-AP write failed, retrying through the CPU",
+				target_name(target));
+	}
+
 	/* write memory through the CPU */
 	cortex_a_prep_memaccess(target, 1);
 	retval = cortex_a_write_cpu_memory(target, address, size, count, buffer);
@@ -2743,6 +2849,12 @@ static int cortex_a_write_memory(struct target *target, target_addr_t address,
 	LOG_DEBUG("Writing memory at address " TARGET_ADDR_FMT "; size %" PRIu32 "; count %" PRIu32,
 		address, size, count);
 
+	/* without MMU virtual and physical addresses are the same */
+	int mmu_enabled = 0;
+	if (cortex_a_memory_ap(target) && cortex_a_mmu(target, &mmu_enabled) == ERROR_OK
+			&& !mmu_enabled)
+		return cortex_a_write_phys_memory(target, address, size, count, buffer);
+
 	/* memory writes bypass the caches, must flush before writing */
 	armv7a_cache_auto_flush_on_write(target, address, size * count);
 
@@ -3084,6 +3196,7 @@ static int cortex_a_init_arch_info(struct target *target,
 	/* Setup struct cortex_a_common */
 	cortex_a->common_magic = CORTEX_A_COMMON_MAGIC;
 	armv7a->arm.dap = dap;
+	cortex_a->memory_ap_num = DP_APSEL_INVALID;
 
 	/* register arch-specific functions */
 	armv7a->examine_debug_reason = NULL;
@@ -3167,6 +3280,8 @@ static void cortex_a_deinit_target(struct target *target)
 
 	if (armv7a->debug_ap)
 		dap_put_ap(armv7a->debug_ap);
+	if (cortex_a->memory_ap)
+		dap_put_ap(cortex_a->memory_ap);
 
 	free(cortex_a->wrp_list);
 	free(cortex_a->brp_list);
@@ -3295,6 +3410,39 @@ COMMAND_HANDLER(handle_cortex_a_dacrfixup_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_cortex_a_memory_ap_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct cortex_a_common *cortex_a = target_to_cortex_a(target);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		uint64_t ap_num = DP_APSEL_INVALID;
+
+		if (strcmp(CMD_ARGV[0], "off")) {
+			COMMAND_PARSE_NUMBER(u64, CMD_ARGV[0], ap_num);
+			if (!is_ap_num_valid(cortex_a->armv7a_common.arm.dap, ap_num)) {
+				command_print(CMD, "Invalid AP number");
+				return ERROR_COMMAND_ARGUMENT_INVALID;
+			}
+		}
+
+		if (cortex_a->memory_ap)
+			dap_put_ap(cortex_a->memory_ap);
+		cortex_a->memory_ap = NULL;
+		cortex_a->memory_ap_num = ap_num;
+	}
+
+	if (cortex_a->memory_ap_num == DP_APSEL_INVALID)
+		command_print(CMD, "off");
+	else
+		command_print(CMD, "0x%" PRIx64, cortex_a->memory_ap_num);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration cortex_a_exec_command_handlers[] = {
 	{
 		.name = "cache_info",
@@ -3325,6 +3473,14 @@ static const struct command_registration cortex_a_exec_command_handlers[] = {
 			"on memory access",
 		.usage = "['on'|'off']",
 	},
+	{
+		.name = "memory_ap",
+		.handler = handle_cortex_a_memory_ap_command,
+		.mode = COMMAND_ANY,
+		.help = "access physical memory through a system MEM-AP "
+			"instead of the CPU",
+		.usage = "[ap_num|'off']",
+	},
 	{
 		.chain = armv7a_mmu_command_handlers,
 	},
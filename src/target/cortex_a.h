@@ -98,6 +98,12 @@ struct cortex_a_common {
 
 	enum cortex_a_isrmasking_mode isrmasking_mode;
 	enum cortex_a_dacrfixup_mode dacrfixup_mode;
+
+	/* System MEM-AP used for physical memory accesses instead of DCC */
+	uint64_t memory_ap_num;
+	struct adiv5_ap *memory_ap;
+	/* data caches cleaned for the MEM-AP since the core halted */
+	bool memory_ap_cache_clean;
 };
 
 static inline struct cortex_a_common *
@@ -425,6 +425,8 @@ static int cortex_m_write_debug_halt_mask(struct target *target,
 	cortex_m->dcb_dhcsr &= ~((0xFFFFul << 16) | mask_off);
 	/* create new register mask */
 	cortex_m->dcb_dhcsr |= DBGKEY | C_DEBUGEN | mask_on;
+	/* a DHCSR read ahead does not reflect this write */
+	target->poll_sched.prefetched = false;
 
 	return mem_ap_write_atomic_u32(armv7m->debug_ap, DCB_DHCSR, cortex_m->dcb_dhcsr);
 }
@@ -880,11 +882,18 @@ static int cortex_m_poll_one(struct target *target)
 	struct cortex_m_common *cortex_m = target_to_cm(target);
 	struct armv7m_common *armv7m = &cortex_m->armv7m;
 
-	/* Read from Debug Halting Control and Status Register */
-	retval = cortex_m_read_dhcsr_atomic_sticky(target);
-	if (retval != ERROR_OK) {
-		target->state = TARGET_UNKNOWN;
-		return retval;
+	/* Read from Debug Halting Control and Status Register,
+	 * unless the background polling read it ahead already */
+	if (target->poll_sched.prefetched) {
+		target->poll_sched.prefetched = false;
+		cortex_m->dcb_dhcsr = cortex_m->dcb_dhcsr_prefetch;
+		cortex_m_cumulate_dhcsr_sticky(cortex_m, cortex_m->dcb_dhcsr);
+	} else {
+		retval = cortex_m_read_dhcsr_atomic_sticky(target);
+		if (retval != ERROR_OK) {
+			target->state = TARGET_UNKNOWN;
+			return retval;
+		}
 	}
 
 	/* Recover from lockup.  See ARMv7-M architecture spec,
@@ -1068,6 +1077,46 @@ static int cortex_m_poll_smp(struct list_head *smp_targets)
 	return retval;
 }
 
+/*
+ * Queue the DHCSR reads of all the cores behind one DAP and run them
+ * together, instead of one round trip per core in cortex_m_poll_one().
+ */
+static int cortex_m_poll_prefetch(struct target **targets, unsigned int count)
+{
+	bool *queued = calloc(count, sizeof(*queued));
+	if (!queued)
+		return ERROR_FAIL;
+
+	for (unsigned int i = 0; i < count; i++) {
+		struct adiv5_ap *ap = target_to_armv7m(targets[i])->debug_ap;
+		if (queued[i] || !ap)
+			continue;
+
+		struct adiv5_dap *dap = ap->dap;
+		for (unsigned int j = i; j < count; j++) {
+			struct armv7m_common *armv7m = target_to_armv7m(targets[j]);
+			if (!armv7m->debug_ap || armv7m->debug_ap->dap != dap)
+				continue;
+			queued[j] = true;
+			mem_ap_read_u32(armv7m->debug_ap, DCB_DHCSR,
+				&target_to_cm(targets[j])->dcb_dhcsr_prefetch);
+		}
+
+		/* on error, each core reads its DHCSR again by itself */
+		if (dap_run(dap) != ERROR_OK)
+			continue;
+
+		for (unsigned int j = i; j < count; j++) {
+			struct armv7m_common *armv7m = target_to_armv7m(targets[j]);
+			if (armv7m->debug_ap && armv7m->debug_ap->dap == dap)
+				targets[j]->poll_sched.prefetched = true;
+		}
+	}
+
+	free(queued);
+	return ERROR_OK;
+}
+
 static int cortex_m_poll(struct target *target)
 {
 	int retval = cortex_m_poll_one(target);
@@ -1195,16 +1244,81 @@ static int cortex_m_soft_reset_halt(struct target *target)
 	return ERROR_OK;
 }
 
-void cortex_m_enable_breakpoints(struct target *target)
+static int cortex_m_alloc_fp_comparator(struct target *target, struct breakpoint *breakpoint);
+
+/*
+ * Write the FPB comparators of all pending hardware breakpoints in a
+ * single DAP run.
+ */
+static int cortex_m_set_hw_breakpoints_queued(struct target *target)
+{
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+	struct armv7m_common *armv7m = &cortex_m->armv7m;
+	struct cortex_m_fp_comparator *comparator_list = cortex_m->fp_comparator_list;
+	struct breakpoint **queued;
+	unsigned int num = 0;
+	int retval = ERROR_OK;
+
+	queued = calloc(cortex_m->fp_num_code, sizeof(*queued));
+	if (!queued)
+		return ERROR_FAIL;
+
+	for (struct breakpoint *b = target->breakpoints; b; b = b->next) {
+		if (b->is_set || b->type != BKPT_HARD || num >= cortex_m->fp_num_code)
+			continue;
+		if (cortex_m_alloc_fp_comparator(target, b) != ERROR_OK)
+			continue;
+		/* not set until the DAP run succeeded */
+		b->is_set = false;
+		mem_ap_write_u32(armv7m->debug_ap, comparator_list[b->number].fpcr_address,
+				comparator_list[b->number].fpcr_value);
+		queued[num++] = b;
+	}
+
+	if (num) {
+		retval = dap_run(armv7m->debug_ap->dap);
+		if (retval != ERROR_OK)
+			LOG_TARGET_ERROR(target, "Failed to write the FPB comparators");
+
+		for (unsigned int i = 0; i < num; i++) {
+			struct breakpoint *b = queued[i];
+
+			if (retval == ERROR_OK) {
+				b->is_set = true;
+			} else {
+				comparator_list[b->number].used = false;
+				comparator_list[b->number].fpcr_value = 0;
+			}
+		}
+	}
+
+	free(queued);
+
+	return retval;
+}
+
+int cortex_m_enable_breakpoints(struct target *target)
 {
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+	struct armv7m_common *armv7m = &cortex_m->armv7m;
 	struct breakpoint *breakpoint = target->breakpoints;
+	int retval = ERROR_OK;
+
+	/* batch the pending hardware breakpoints if the DAP can be used directly */
+	if (armv7m->debug_ap && cortex_m->fpb_enabled)
+		retval = cortex_m_set_hw_breakpoints_queued(target);
 
 	/* set any pending breakpoints */
 	while (breakpoint) {
-		if (!breakpoint->is_set)
-			cortex_m_set_breakpoint(target, breakpoint);
+		if (!breakpoint->is_set) {
+			int retval2 = cortex_m_set_breakpoint(target, breakpoint);
+			if (retval == ERROR_OK)
+				retval = retval2;
+		}
 		breakpoint = breakpoint->next;
 	}
+
+	return retval;
 }
 
 static int cortex_m_restore_one(struct target *target, bool current,
@@ -1222,7 +1336,9 @@ static int cortex_m_restore_one(struct target *target, bool current,
 
 	if (!debug_execution) {
 		target_free_all_working_areas(target);
-		cortex_m_enable_breakpoints(target);
+		int retval = cortex_m_enable_breakpoints(target);
+		if (retval != ERROR_OK)
+			return retval;
 		cortex_m_enable_watchpoints(target);
 	}
 
@@ -1402,6 +1518,11 @@ static int cortex_m_step(struct target *target, int current,
 	if (target->smp && target->gdb_service)
 		target->gdb_service->target = target;
 
+	/* the core may be left running, install the pending breakpoints */
+	retval = cortex_m_enable_breakpoints(target);
+	if (retval != ERROR_OK)
+		return retval;
+
 	/* current = 1: continue on current pc, otherwise continue at <address> */
 	if (!current) {
 		buf_set_u32(pc->value, 0, 32, address);
@@ -1489,6 +1610,15 @@ static int cortex_m_step(struct target *target, int current,
 						type = BKPT_SOFT;
 					}
 					retval = breakpoint_add(target, pc_value, 2, type);
+					if (retval == ERROR_OK) {
+						/* breakpoints added while halted are deferred */
+						struct breakpoint *tmp_bp = breakpoint_find(target, pc_value);
+						if (tmp_bp && !tmp_bp->is_set) {
+							retval = cortex_m_set_breakpoint(target, tmp_bp);
+							if (retval != ERROR_OK)
+								breakpoint_remove(target, pc_value);
+						}
+					}
 				}
 
 				bool tmp_bp_set = (retval == ERROR_OK);
@@ -1589,6 +1719,8 @@ static int cortex_m_assert_reset(struct target *target)
 
 	enum reset_types jtag_reset_config = jtag_get_reset_config();
 
+	target->poll_sched.prefetched = false;
+
 	if (target_has_event_action(target, TARGET_EVENT_RESET_ASSERT)) {
 		/* allow scripts to override the reset event */
 
@@ -1774,10 +1906,62 @@ static int cortex_m_deassert_reset(struct target *target)
 	return ERROR_OK;
 }
 
+/* Check that a hardware breakpoint can be set at this address */
+static int cortex_m_check_hw_breakpoint(struct target *target, struct breakpoint *breakpoint)
+{
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+
+	if (cortex_m->fp_rev == 0) {
+		if (breakpoint->address > 0x1FFFFFFF) {
+			LOG_TARGET_ERROR(target, "Cortex-M Flash Patch Breakpoint rev.1 "
+					"cannot handle HW breakpoint above address 0x1FFFFFFE");
+			return ERROR_FAIL;
+		}
+	} else if (cortex_m->fp_rev > 1) {
+		LOG_TARGET_ERROR(target, "Unhandled Cortex-M Flash Patch Breakpoint architecture revision");
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+/* Allocate a FPB comparator for a hardware breakpoint, without writing it */
+static int cortex_m_alloc_fp_comparator(struct target *target, struct breakpoint *breakpoint)
+{
+	unsigned int fp_num = 0;
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+	struct cortex_m_fp_comparator *comparator_list = cortex_m->fp_comparator_list;
+	uint32_t fpcr_value;
+
+	while (comparator_list[fp_num].used && (fp_num < cortex_m->fp_num_code))
+		fp_num++;
+	if (fp_num >= cortex_m->fp_num_code) {
+		LOG_TARGET_ERROR(target, "Can not find free FPB Comparator!");
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	int retval = cortex_m_check_hw_breakpoint(target, breakpoint);
+	if (retval != ERROR_OK)
+		return retval;
+
+	fpcr_value = breakpoint->address | 1;
+	if (cortex_m->fp_rev == 0) {
+		uint32_t hilo;
+		hilo = (breakpoint->address & 0x2) ? FPCR_REPLACE_BKPT_HIGH : FPCR_REPLACE_BKPT_LOW;
+		fpcr_value = (fpcr_value & 0x1FFFFFFC) | hilo | 1;
+	}
+
+	breakpoint_hw_set(breakpoint, fp_num);
+	comparator_list[fp_num].used = true;
+	comparator_list[fp_num].fpcr_value = fpcr_value;
+
+	return ERROR_OK;
+}
+
 int cortex_m_set_breakpoint(struct target *target, struct breakpoint *breakpoint)
 {
 	int retval;
-	unsigned int fp_num = 0;
+	unsigned int fp_num;
 	struct cortex_m_common *cortex_m = target_to_cm(target);
 	struct cortex_m_fp_comparator *comparator_list = cortex_m->fp_comparator_list;
 
@@ -1787,30 +1971,10 @@ int cortex_m_set_breakpoint(struct target *target, struct breakpoint *breakpoint
 	}
 
 	if (breakpoint->type == BKPT_HARD) {
-		uint32_t fpcr_value;
-		while (comparator_list[fp_num].used && (fp_num < cortex_m->fp_num_code))
-			fp_num++;
-		if (fp_num >= cortex_m->fp_num_code) {
-			LOG_TARGET_ERROR(target, "Can not find free FPB Comparator!");
-			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-		}
-		breakpoint_hw_set(breakpoint, fp_num);
-		fpcr_value = breakpoint->address | 1;
-		if (cortex_m->fp_rev == 0) {
-			if (breakpoint->address > 0x1FFFFFFF) {
-				LOG_TARGET_ERROR(target, "Cortex-M Flash Patch Breakpoint rev.1 "
-						"cannot handle HW breakpoint above address 0x1FFFFFFE");
-				return ERROR_FAIL;
-			}
-			uint32_t hilo;
-			hilo = (breakpoint->address & 0x2) ? FPCR_REPLACE_BKPT_HIGH : FPCR_REPLACE_BKPT_LOW;
-			fpcr_value = (fpcr_value & 0x1FFFFFFC) | hilo | 1;
-		} else if (cortex_m->fp_rev > 1) {
-			LOG_TARGET_ERROR(target, "Unhandled Cortex-M Flash Patch Breakpoint architecture revision");
-			return ERROR_FAIL;
-		}
-		comparator_list[fp_num].used = true;
-		comparator_list[fp_num].fpcr_value = fpcr_value;
+		retval = cortex_m_alloc_fp_comparator(target, breakpoint);
+		if (retval != ERROR_OK)
+			return retval;
+		fp_num = breakpoint->number;
 		target_write_u32(target, comparator_list[fp_num].fpcr_address,
 			comparator_list[fp_num].fpcr_value);
 		LOG_TARGET_DEBUG(target, "fpc_num %i fpcr_value 0x%" PRIx32 "",
@@ -1915,6 +2079,47 @@ int cortex_m_add_breakpoint(struct target *target, struct breakpoint *breakpoint
 	return cortex_m_set_breakpoint(target, breakpoint);
 }
 
+/*
+ * While the core is halted, only check that a hardware breakpoint can be set
+ * and leave it pending: all the pending FPB comparators are written together
+ * by cortex_m_enable_breakpoints() on the next resume or step. Software
+ * breakpoints are inserted immediately, so that a failed write (e.g. to
+ * flash) is reported to the caller.
+ */
+int cortex_m_add_breakpoint_deferred(struct target *target, struct breakpoint *breakpoint)
+{
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+
+	if (target->state != TARGET_HALTED || breakpoint->type != BKPT_HARD)
+		return cortex_m_add_breakpoint(target, breakpoint);
+
+	if (breakpoint->length == 3) {
+		LOG_TARGET_DEBUG(target, "Using a two byte breakpoint for 32bit Thumb-2 request");
+		breakpoint->length = 2;
+	}
+
+	if ((breakpoint->length != 2)) {
+		LOG_TARGET_INFO(target, "only breakpoints of two bytes length supported");
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	int retval = cortex_m_check_hw_breakpoint(target, breakpoint);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* the new breakpoint is already in the list */
+	unsigned int num_hw = 0;
+	for (struct breakpoint *b = target->breakpoints; b; b = b->next)
+		if (b->type == BKPT_HARD)
+			num_hw++;
+	if (num_hw > cortex_m->fp_num_code) {
+		LOG_TARGET_ERROR(target, "Can not find free FPB Comparator!");
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	return ERROR_OK;
+}
+
 int cortex_m_remove_breakpoint(struct target *target, struct breakpoint *breakpoint)
 {
 	if (!breakpoint->is_set)
@@ -1923,7 +2128,11 @@ int cortex_m_remove_breakpoint(struct target *target, struct breakpoint *breakpo
 	return cortex_m_unset_breakpoint(target, breakpoint);
 }
 
-static int cortex_m_set_watchpoint(struct target *target, struct watchpoint *watchpoint)
+/*
+ * Pick a free DWT comparator for the watchpoint and compute its COMP, MASK
+ * and FUNCTION values, without writing them yet.
+ */
+static int cortex_m_alloc_dwt_comparator(struct target *target, struct watchpoint *watchpoint)
 {
 	unsigned int dwt_num = 0;
 	struct cortex_m_common *cortex_m = target_to_cm(target);
@@ -1947,8 +2156,6 @@ static int cortex_m_set_watchpoint(struct target *target, struct watchpoint *wat
 	watchpoint_set(watchpoint, dwt_num);
 
 	comparator->comp = watchpoint->address;
-	target_write_u32(target, comparator->dwt_comparator_address + 0,
-		comparator->comp);
 
 	if ((cortex_m->dwt_devarch & 0x1FFFFF) != DWT_DEVARCH_ARMV8M) {
 		uint32_t mask = 0, temp;
@@ -1962,8 +2169,6 @@ static int cortex_m_set_watchpoint(struct target *target, struct watchpoint *wat
 		mask--;
 
 		comparator->mask = mask;
-		target_write_u32(target, comparator->dwt_comparator_address + 4,
-			comparator->mask);
 
 		switch (watchpoint->rw) {
 		case WPT_READ:
@@ -1995,9 +2200,6 @@ static int cortex_m_set_watchpoint(struct target *target, struct watchpoint *wat
 				(data_size << 10);
 	}
 
-	target_write_u32(target, comparator->dwt_comparator_address + 8,
-		comparator->function);
-
 	LOG_TARGET_DEBUG(target, "Watchpoint (ID %d) DWT%d 0x%08x 0x%x 0x%05x",
 		watchpoint->unique_id, dwt_num,
 		(unsigned) comparator->comp,
@@ -2006,6 +2208,86 @@ static int cortex_m_set_watchpoint(struct target *target, struct watchpoint *wat
 	return ERROR_OK;
 }
 
+static int cortex_m_set_watchpoint(struct target *target, struct watchpoint *watchpoint)
+{
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+
+	int retval = cortex_m_alloc_dwt_comparator(target, watchpoint);
+	if (retval != ERROR_OK)
+		return retval;
+
+	struct cortex_m_dwt_comparator *comparator = cortex_m->dwt_comparator_list + watchpoint->number;
+
+	target_write_u32(target, comparator->dwt_comparator_address + 0,
+		comparator->comp);
+	/* ARMv8-M has no separate mask register */
+	if ((cortex_m->dwt_devarch & 0x1FFFFF) != DWT_DEVARCH_ARMV8M)
+		target_write_u32(target, comparator->dwt_comparator_address + 4,
+			comparator->mask);
+	target_write_u32(target, comparator->dwt_comparator_address + 8,
+		comparator->function);
+
+	return ERROR_OK;
+}
+
+/*
+ * Write the DWT comparators of all pending watchpoints in a single DAP run,
+ * the way cortex_m_set_hw_breakpoints_queued() does for the FPB.
+ */
+static int cortex_m_set_watchpoints_queued(struct target *target)
+{
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+	struct armv7m_common *armv7m = &cortex_m->armv7m;
+	struct watchpoint **queued;
+	unsigned int num = 0;
+	int retval = ERROR_OK;
+
+	queued = calloc(cortex_m->dwt_num_comp, sizeof(*queued));
+	if (!queued)
+		return ERROR_FAIL;
+
+	for (struct watchpoint *wp = target->watchpoints; wp; wp = wp->next) {
+		if (wp->is_set || num >= cortex_m->dwt_num_comp)
+			continue;
+		if (cortex_m_alloc_dwt_comparator(target, wp) != ERROR_OK)
+			continue;
+
+		struct cortex_m_dwt_comparator *comparator = cortex_m->dwt_comparator_list + wp->number;
+
+		/* not set until the DAP run succeeded */
+		wp->is_set = false;
+		mem_ap_write_u32(armv7m->debug_ap, comparator->dwt_comparator_address + 0,
+				comparator->comp);
+		if ((cortex_m->dwt_devarch & 0x1FFFFF) != DWT_DEVARCH_ARMV8M)
+			mem_ap_write_u32(armv7m->debug_ap, comparator->dwt_comparator_address + 4,
+					comparator->mask);
+		mem_ap_write_u32(armv7m->debug_ap, comparator->dwt_comparator_address + 8,
+				comparator->function);
+		queued[num++] = wp;
+	}
+
+	if (num) {
+		retval = dap_run(armv7m->debug_ap->dap);
+		if (retval != ERROR_OK)
+			LOG_TARGET_ERROR(target, "Failed to write the DWT comparators");
+
+		for (unsigned int i = 0; i < num; i++) {
+			struct watchpoint *wp = queued[i];
+
+			if (retval == ERROR_OK) {
+				wp->is_set = true;
+			} else {
+				cortex_m->dwt_comparator_list[wp->number].used = false;
+				cortex_m->dwt_comparator_list[wp->number].function = 0;
+			}
+		}
+	}
+
+	free(queued);
+
+	return retval;
+}
+
 static int cortex_m_unset_watchpoint(struct target *target, struct watchpoint *watchpoint)
 {
 	struct cortex_m_common *cortex_m = target_to_cm(target);
@@ -2138,8 +2420,13 @@ static int cortex_m_hit_watchpoint(struct target *target, struct watchpoint **hi
 
 void cortex_m_enable_watchpoints(struct target *target)
 {
+	struct armv7m_common *armv7m = target_to_armv7m(target);
 	struct watchpoint *watchpoint = target->watchpoints;
 
+	/* batch the pending watchpoints if the DAP can be used directly */
+	if (armv7m->debug_ap)
+		cortex_m_set_watchpoints_queued(target);
+
 	/* set any pending watchpoints */
 	while (watchpoint) {
 		if (!watchpoint->is_set)
@@ -2201,6 +2488,29 @@ void cortex_m_deinit_target(struct target *target)
 	free(cortex_m);
 }
 
+int cortex_m_sample_pc(struct target *target, uint32_t *samples,
+		uint32_t max_num_samples, uint32_t *num_samples)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	int retval;
+
+	if (armv7m && armv7m->debug_ap) {
+		retval = mem_ap_read_buf_noincr(armv7m->debug_ap, (void *)samples,
+					4, max_num_samples, DWT_PCSR);
+		if (retval == ERROR_OK)
+			*num_samples = max_num_samples;
+		return retval;
+	}
+
+	for (*num_samples = 0; *num_samples < max_num_samples; (*num_samples)++) {
+		retval = target_read_u32(target, DWT_PCSR, &samples[*num_samples]);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return ERROR_OK;
+}
+
 int cortex_m_profiling(struct target *target, uint32_t *samples,
 			      uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds)
 {
@@ -2237,19 +2547,17 @@ int cortex_m_profiling(struct target *target, uint32_t *samples,
 	uint32_t sample_count = 0;
 
 	for (;;) {
+		uint32_t read_count = max_num_samples - sample_count;
 		if (armv7m && armv7m->debug_ap) {
-			uint32_t read_count = max_num_samples - sample_count;
 			if (read_count > 1024)
 				read_count = 1024;
-
-			retval = mem_ap_read_buf_noincr(armv7m->debug_ap,
-						(void *)&samples[sample_count],
-						4, read_count, DWT_PCSR);
-			sample_count += read_count;
 		} else {
-			target_read_u32(target, DWT_PCSR, &samples[sample_count++]);
+			read_count = 1;
 		}
 
+		retval = cortex_m_sample_pc(target, &samples[sample_count], read_count, &read_count);
+		sample_count += read_count;
+
 		if (retval != ERROR_OK) {
 			LOG_TARGET_ERROR(target, "Error while reading PCSR");
 			return retval;
@@ -3069,6 +3377,7 @@ struct target_type cortexm_target = {
 	.name = "cortex_m",
 
 	.poll = cortex_m_poll,
+	.poll_prefetch = cortex_m_poll_prefetch,
 	.arch_state = armv7m_arch_state,
 
 	.target_request_data = cortex_m_target_request_data,
@@ -3093,7 +3402,7 @@ struct target_type cortexm_target = {
 	.start_algorithm = armv7m_start_algorithm,
 	.wait_algorithm = armv7m_wait_algorithm,
 
-	.add_breakpoint = cortex_m_add_breakpoint,
+	.add_breakpoint = cortex_m_add_breakpoint_deferred,
 	.remove_breakpoint = cortex_m_remove_breakpoint,
 	.add_watchpoint = cortex_m_add_watchpoint,
 	.remove_watchpoint = cortex_m_remove_watchpoint,
@@ -3107,4 +3416,5 @@ struct target_type cortexm_target = {
 	.deinit_target = cortex_m_deinit_target,
 
 	.profiling = cortex_m_profiling,
+	.sample_pc = cortex_m_sample_pc,
 };
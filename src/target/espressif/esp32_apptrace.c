@@ -9,19 +9,6 @@
 #include "config.h"
 #endif
 
-#ifdef HAVE_ARPA_INET_H
-#include <arpa/inet.h>
-#endif
-
-#ifdef HAVE_NETDB_H
-#include <netdb.h>
-#endif
-
-#ifndef _WIN32
-#include <netinet/tcp.h>
-#include <sys/ioctl.h>
-#endif
-
 #include <helper/list.h>
 #include <helper/time_support.h>
 #include <target/target.h>
@@ -46,14 +33,6 @@
 #define ESP32_APPTRACE_TGT_STATE_TMO            5000
 #define ESP_APPTRACE_BLOCKS_POOL_SZ             10
 
-struct esp32_apptrace_dest_file_data {
-	int fout;
-};
-
-struct esp32_apptrace_dest_tcp_data {
-	int sockfd;
-};
-
 struct esp32_apptrace_target_state {
 	int running;
 	uint32_t block_id;
@@ -67,324 +46,21 @@ struct esp_apptrace_target2host_hdr {
 #define APPTRACE_BLOCK_SIZE_OFFSET      0
 #define APPTRACE_WR_SIZE_OFFSET         2
 
-struct esp32_apptrace_block {
-	struct list_head node;
-	uint8_t *data;
-	uint32_t data_len;
-};
-
 static int esp32_apptrace_data_processor(void *priv);
 static int esp32_apptrace_get_data_info(struct esp32_apptrace_cmd_ctx *ctx,
 	struct esp32_apptrace_target_state *target_state,
 	uint32_t *fired_target_num);
 static int esp32_apptrace_safe_halt_targets(struct esp32_apptrace_cmd_ctx *ctx,
 	struct esp32_apptrace_target_state *targets);
-static struct esp32_apptrace_block *esp32_apptrace_free_block_get(struct esp32_apptrace_cmd_ctx *ctx);
 static int esp32_apptrace_handle_trace_block(struct esp32_apptrace_cmd_ctx *ctx,
-	struct esp32_apptrace_block *block);
+	struct apptrace_block *block);
 
 static const bool s_time_stats_enable = true;
 
-/*********************************************************************
-*                       Trace destination API
-**********************************************************************/
-
-static int esp32_apptrace_file_dest_write(void *priv, uint8_t *data, int size)
-{
-	struct esp32_apptrace_dest_file_data *dest_data = (struct esp32_apptrace_dest_file_data *)priv;
-
-	int wr_sz = write(dest_data->fout, data, size);
-	if (wr_sz != size) {
-		LOG_ERROR("Failed to write %d bytes to out file (%d)! Written %d.", size, errno, wr_sz);
-		return ERROR_FAIL;
-	}
-	return ERROR_OK;
-}
-
-static int esp32_apptrace_file_dest_cleanup(void *priv)
-{
-	struct esp32_apptrace_dest_file_data *dest_data = (struct esp32_apptrace_dest_file_data *)priv;
-
-	if (dest_data->fout > 0)
-		close(dest_data->fout);
-	free(dest_data);
-	return ERROR_OK;
-}
-
-static int esp32_apptrace_file_dest_init(struct esp32_apptrace_dest *dest, const char *dest_name)
-{
-	struct esp32_apptrace_dest_file_data *dest_data = calloc(1, sizeof(*dest_data));
-	if (!dest_data) {
-		LOG_ERROR("Failed to alloc mem for file dest!");
-		return ERROR_FAIL;
-	}
-
-	LOG_INFO("Open file %s", dest_name);
-	dest_data->fout = open(dest_name, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
-	if (dest_data->fout <= 0) {
-		LOG_ERROR("Failed to open file %s", dest_name);
-		free(dest_data);
-		return ERROR_FAIL;
-	}
-
-	dest->priv = dest_data;
-	dest->write = esp32_apptrace_file_dest_write;
-	dest->clean = esp32_apptrace_file_dest_cleanup;
-	dest->log_progress = true;
-
-	return ERROR_OK;
-}
-
-static int esp32_apptrace_console_dest_write(void *priv, uint8_t *data, int size)
-{
-	LOG_USER_N("%.*s", size, data);
-	return ERROR_OK;
-}
-
-static int esp32_apptrace_console_dest_cleanup(void *priv)
-{
-	return ERROR_OK;
-}
-
-static int esp32_apptrace_console_dest_init(struct esp32_apptrace_dest *dest, const char *dest_name)
-{
-	dest->priv = NULL;
-	dest->write = esp32_apptrace_console_dest_write;
-	dest->clean = esp32_apptrace_console_dest_cleanup;
-	dest->log_progress = false;
-
-	return ERROR_OK;
-}
-
-static int esp32_apptrace_tcp_dest_write(void *priv, uint8_t *data, int size)
-{
-	struct esp32_apptrace_dest_tcp_data *dest_data = (struct esp32_apptrace_dest_tcp_data *)priv;
-	int wr_sz = write_socket(dest_data->sockfd, data, size);
-	if (wr_sz != size) {
-		LOG_ERROR("Failed to write %u bytes to out socket (%d)! Written %d.", size, errno, wr_sz);
-		return ERROR_FAIL;
-	}
-	return ERROR_OK;
-}
-
-static int esp32_apptrace_tcp_dest_cleanup(void *priv)
-{
-	struct esp32_apptrace_dest_tcp_data *dest_data = (struct esp32_apptrace_dest_tcp_data *)priv;
-
-	if (dest_data->sockfd > 0)
-		close_socket(dest_data->sockfd);
-	free(dest_data);
-	return ERROR_OK;
-}
-
-static int esp32_apptrace_tcp_dest_init(struct esp32_apptrace_dest *dest, const char *dest_name)
-{
-	const char *port_sep = strchr(dest_name, ':');
-	/* separator not found, or was the first or the last character */
-	if (!port_sep || port_sep == dest_name || port_sep == dest_name + strlen(dest_name) - 1) {
-		LOG_ERROR("apptrace: Invalid connection URI, format should be tcp://host:port");
-		return ERROR_COMMAND_ARGUMENT_INVALID;
-	}
-	size_t hostname_len = port_sep - dest_name;
-
-	char hostname[64] = { 0 };
-	if (hostname_len >= sizeof(hostname)) {
-		LOG_ERROR("apptrace: Hostname too long");
-		return ERROR_COMMAND_ARGUMENT_INVALID;
-	}
-	memcpy(hostname, dest_name, hostname_len);
-
-	const char *port_str = port_sep + 1;
-	struct addrinfo *ai;
-	int flags = 0;
-#ifdef AI_NUMERICSERV
-	flags |= AI_NUMERICSERV;
-#endif	/* AI_NUMERICSERV */
-	struct addrinfo hint = {
-		.ai_family = AF_UNSPEC,
-		.ai_socktype = SOCK_STREAM,
-		.ai_protocol = 0,
-		.ai_flags = flags
-	};
-	int res = getaddrinfo(hostname, port_str, &hint, &ai);
-	if (res != 0) {
-		LOG_ERROR("apptrace: Failed to resolve host name: %s", hostname);
-		return ERROR_FAIL;
-	}
-	int sockfd = -1;
-	for (struct addrinfo *ai_it = ai; ai_it; ai_it = ai_it->ai_next) {
-		sockfd = socket(ai_it->ai_family, ai_it->ai_socktype, ai_it->ai_protocol);
-		if (sockfd < 0) {
-			LOG_DEBUG("apptrace: Failed to create socket (%d, %d, %d) (%s)",
-				ai_it->ai_family,
-				ai_it->ai_socktype,
-				ai_it->ai_protocol,
-				strerror(errno));
-			continue;
-		}
-
-		char cur_hostname[NI_MAXHOST];
-		char cur_portname[NI_MAXSERV];
-		res =
-			getnameinfo(ai_it->ai_addr, ai_it->ai_addrlen, cur_hostname,
-			sizeof(cur_hostname),
-			cur_portname, sizeof(cur_portname),
-			NI_NUMERICHOST | NI_NUMERICSERV);
-		if (res != 0)
-			continue;
-
-		LOG_INFO("apptrace: Trying to connect to %s:%s", cur_hostname, cur_portname);
-		if (connect(sockfd, ai_it->ai_addr, ai_it->ai_addrlen) < 0) {
-			close_socket(sockfd);
-			sockfd = -1;
-			LOG_WARNING("apptrace: Connection failed (%s)", strerror(errno));
-			continue;
-		}
-		break;
-	}
-	freeaddrinfo(ai);
-	if (sockfd < 0) {
-		LOG_ERROR("apptrace: Could not connect to %s:%s", hostname, port_str);
-		return ERROR_FAIL;
-	}
-	LOG_INFO("apptrace: Connected!");
-
-	struct esp32_apptrace_dest_tcp_data *dest_data = calloc(1, sizeof(struct esp32_apptrace_dest_tcp_data));
-	if (!dest_data) {
-		LOG_ERROR("apptrace: Failed to alloc mem for tcp dest!");
-		close_socket(sockfd);
-		return ERROR_FAIL;
-	}
-
-	dest_data->sockfd = sockfd;
-	dest->priv = dest_data;
-	dest->write = esp32_apptrace_tcp_dest_write;
-	dest->clean = esp32_apptrace_tcp_dest_cleanup;
-	dest->log_progress = true;
-
-	return ERROR_OK;
-}
-
-int esp32_apptrace_dest_init(struct esp32_apptrace_dest dest[], const char *dest_paths[], unsigned int max_dests)
-{
-	int res;
-	unsigned int i;
-
-	for (i = 0; i < max_dests; i++) {
-		if (strncmp(dest_paths[i], "file://", 7) == 0)
-			res = esp32_apptrace_file_dest_init(&dest[i], &dest_paths[i][7]);
-		else if (strncmp(dest_paths[i], "con:", 4) == 0)
-			res = esp32_apptrace_console_dest_init(&dest[i], NULL);
-		else if (strncmp(dest_paths[i], "tcp://", 6) == 0)
-			res = esp32_apptrace_tcp_dest_init(&dest[i], &dest_paths[i][6]);
-		else
-			break;
-
-		if (res != ERROR_OK) {
-			LOG_ERROR("apptrace: Failed to init trace data destination '%s'!", dest_paths[i]);
-			return 0;
-		}
-	}
-
-	return i;
-}
-
-int esp32_apptrace_dest_cleanup(struct esp32_apptrace_dest dest[], unsigned int max_dests)
-{
-	for (unsigned int i = 0; i < max_dests; i++) {
-		if (dest[i].clean && dest[i].priv) {
-			int res = dest[i].clean(dest[i].priv);
-			dest[i].priv = NULL;
-			return res;
-		}
-	}
-	return ERROR_OK;
-}
-
-/*********************************************************************
-*                 Trace data blocks management API
-**********************************************************************/
-static void esp32_apptrace_blocks_pool_cleanup(struct esp32_apptrace_cmd_ctx *ctx)
-{
-	struct esp32_apptrace_block *cur;
-	struct list_head *head = &ctx->free_trace_blocks;
-	struct list_head *tmp, *pos;
-
-	list_for_each_safe(pos, tmp, head) {
-		cur = list_entry(pos, struct esp32_apptrace_block, node);
-		if (cur) {
-			list_del(&cur->node);
-			free(cur->data);
-			free(cur);
-		}
-	}
-
-	head = &ctx->ready_trace_blocks;
-
-	list_for_each_safe(pos, tmp, head) {
-		cur = list_entry(pos, struct esp32_apptrace_block, node);
-		if (cur) {
-			list_del(&cur->node);
-			free(cur->data);
-			free(cur);
-		}
-	}
-}
-
-struct esp32_apptrace_block *esp32_apptrace_free_block_get(struct esp32_apptrace_cmd_ctx *ctx)
-{
-	struct esp32_apptrace_block *block = NULL;
-
-	if (!list_empty(&ctx->free_trace_blocks)) {
-		/*get first */
-		block = list_first_entry(&ctx->free_trace_blocks, struct esp32_apptrace_block, node);
-		list_del(&block->node);
-	}
-
-	return block;
-}
-
-static int esp32_apptrace_ready_block_put(struct esp32_apptrace_cmd_ctx *ctx, struct esp32_apptrace_block *block)
-{
-	LOG_DEBUG("esp32_apptrace_ready_block_put");
-	/* add to ready blocks list */
-	INIT_LIST_HEAD(&block->node);
-	list_add(&block->node, &ctx->ready_trace_blocks);
-
-	return ERROR_OK;
-}
-
-static struct esp32_apptrace_block *esp32_apptrace_ready_block_get(struct esp32_apptrace_cmd_ctx *ctx)
-{
-	struct esp32_apptrace_block *block = NULL;
-
-	if (!list_empty(&ctx->ready_trace_blocks)) {
-		struct list_head *head = &ctx->ready_trace_blocks;
-		struct list_head *tmp, *pos;
-
-		list_for_each_safe(pos, tmp, head) {
-			block = list_entry(pos, struct esp32_apptrace_block, node);
-		}
-		/* remove it from ready list */
-		list_del(&block->node);
-	}
-
-	return block;
-}
-
-static int esp32_apptrace_block_free(struct esp32_apptrace_cmd_ctx *ctx, struct esp32_apptrace_block *block)
-{
-	/* add to free blocks list */
-	INIT_LIST_HEAD(&block->node);
-	list_add(&block->node, &ctx->free_trace_blocks);
-
-	return ERROR_OK;
-}
-
 static int esp32_apptrace_wait_tracing_finished(struct esp32_apptrace_cmd_ctx *ctx)
 {
 	int64_t timeout = timeval_ms() + (LOG_LEVEL_IS(LOG_LVL_DEBUG) ? 70000 : 5000);
-	while (!list_empty(&ctx->ready_trace_blocks)) {
+	while (apptrace_blocks_pending(&ctx->blocks)) {
 		alive_sleep(100);
 		if (timeval_ms() >= timeout) {
 			LOG_ERROR("Failed to wait for pended trace blocks!");
@@ -451,43 +127,27 @@ int esp32_apptrace_cmd_ctx_init(struct esp32_apptrace_cmd_ctx *cmd_ctx, struct c
 	}
 	LOG_INFO("Total trace memory: %" PRIu32 " bytes", cmd_ctx->max_trace_block_sz);
 
-	INIT_LIST_HEAD(&cmd_ctx->ready_trace_blocks);
-	INIT_LIST_HEAD(&cmd_ctx->free_trace_blocks);
-	for (unsigned int i = 0; i < ESP_APPTRACE_BLOCKS_POOL_SZ; i++) {
-		struct esp32_apptrace_block *block = calloc(1, sizeof(struct esp32_apptrace_block));
-		if (!block) {
-			command_print(cmd, "Failed to alloc trace buffer entry!");
-			esp32_apptrace_blocks_pool_cleanup(cmd_ctx);
-			return ERROR_FAIL;
-		}
-		block->data = malloc(cmd_ctx->max_trace_block_sz);
-		if (!block->data) {
-			free(block);
-			command_print(cmd, "Failed to alloc trace buffer %" PRIu32 " bytes!", cmd_ctx->max_trace_block_sz);
-			esp32_apptrace_blocks_pool_cleanup(cmd_ctx);
-			return ERROR_FAIL;
-		}
-		INIT_LIST_HEAD(&block->node);
-		list_add(&block->node, &cmd_ctx->free_trace_blocks);
+	int res = apptrace_blocks_init(&cmd_ctx->blocks, ESP_APPTRACE_BLOCKS_POOL_SZ, cmd_ctx->max_trace_block_sz);
+	if (res != ERROR_OK) {
+		command_print(cmd, "Failed to alloc trace blocks!");
+		return res;
 	}
 
 	cmd_ctx->running = 1;
 	if (cmd_ctx->mode != ESP_APPTRACE_CMD_MODE_SYNC) {
-		int res = target_register_timer_callback(esp32_apptrace_data_processor,
+		res = target_register_timer_callback(esp32_apptrace_data_processor,
 			0,
 			TARGET_TIMER_TYPE_PERIODIC,
 			cmd_ctx);
 		if (res != ERROR_OK) {
 			command_print(cmd, "Failed to start trace data timer callback (%d)!", res);
-			esp32_apptrace_blocks_pool_cleanup(cmd_ctx);
+			apptrace_blocks_cleanup(&cmd_ctx->blocks);
 			return ERROR_FAIL;
 		}
 	}
 
-	if (s_time_stats_enable) {
-		cmd_ctx->stats.min_blk_read_time = 1000000.0;
-		cmd_ctx->stats.min_blk_proc_time = 1000000.0;
-	}
+	if (s_time_stats_enable)
+		apptrace_stats_init(&cmd_ctx->stats);
 	if (duration_start(&cmd_ctx->idle_time) != 0) {
 		command_print(cmd, "Failed to start idle time measurement!");
 		esp32_apptrace_cmd_ctx_cleanup(cmd_ctx);
@@ -499,7 +159,7 @@ int esp32_apptrace_cmd_ctx_init(struct esp32_apptrace_cmd_ctx *cmd_ctx, struct c
 
 int esp32_apptrace_cmd_ctx_cleanup(struct esp32_apptrace_cmd_ctx *cmd_ctx)
 {
-	esp32_apptrace_blocks_pool_cleanup(cmd_ctx);
+	apptrace_blocks_cleanup(&cmd_ctx->blocks);
 	return ERROR_OK;
 }
 
@@ -572,7 +232,7 @@ static int esp32_apptrace_cmd_init(struct esp32_apptrace_cmd_ctx *cmd_ctx,
 	cmd_ctx->cmd_priv = cmd_data;
 
 	/*outfile1 [poll_period [trace_size [stop_tmo [wait4halt [skip_size]]]]] */
-	res = esp32_apptrace_dest_init(&cmd_data->data_dest, argv, 1);
+	res = apptrace_dest_init(&cmd_data->data_dest, argv, 1);
 	if (res != 1) {	/* only one destination needs to be initialized */
 		command_print(cmd, "Wrong args! Needs a trace data destination!");
 		free(cmd_data);
@@ -608,7 +268,7 @@ static int esp32_apptrace_cmd_cleanup(struct esp32_apptrace_cmd_ctx *cmd_ctx)
 {
 	struct esp32_apptrace_cmd_data *cmd_data = cmd_ctx->cmd_priv;
 
-	esp32_apptrace_dest_cleanup(&cmd_data->data_dest, 1);
+	apptrace_dest_cleanup(&cmd_data->data_dest, 1);
 	free(cmd_data);
 	cmd_ctx->cmd_priv = NULL;
 	esp32_apptrace_cmd_ctx_cleanup(cmd_ctx);
@@ -628,17 +288,7 @@ static void esp32_apptrace_print_stats(struct esp32_apptrace_cmd_ctx *ctx)
 		cmd_data ? cmd_data->max_len : 0,
 		duration_kbps(&ctx->read_time, ctx->tot_len),
 		duration_kbps(&ctx->read_time, ctx->raw_tot_len));
-	LOG_USER("Data: blocks incomplete %" PRId32 ", lost bytes: %" PRId32,
-		ctx->stats.incompl_blocks,
-		ctx->stats.lost_bytes);
-	if (s_time_stats_enable) {
-		LOG_USER("Block read time [%f..%f] ms",
-			1000 * ctx->stats.min_blk_read_time,
-			1000 * ctx->stats.max_blk_read_time);
-		LOG_USER("Block proc time [%f..%f] ms",
-			1000 * ctx->stats.min_blk_proc_time,
-			1000 * ctx->stats.max_blk_proc_time);
-	}
+	apptrace_stats_print(&ctx->stats);
 }
 
 static int esp32_apptrace_wait4halt(struct esp32_apptrace_cmd_ctx *ctx, struct target *target)
@@ -914,7 +564,7 @@ static int esp32_apptrace_process_data(struct esp32_apptrace_cmd_ctx *ctx,
 }
 
 static int esp32_apptrace_handle_trace_block(struct esp32_apptrace_cmd_ctx *ctx,
-	struct esp32_apptrace_block *block)
+	struct apptrace_block *block)
 {
 	uint32_t processed = 0;
 	uint32_t hdr_sz = ctx->trace_format.hdr_sz;
@@ -944,7 +594,7 @@ static int esp32_apptrace_data_processor(void *priv)
 	if (!ctx->running)
 		return ERROR_OK;
 
-	struct esp32_apptrace_block *block = esp32_apptrace_ready_block_get(ctx);
+	struct apptrace_block *block = apptrace_ready_block_get(&ctx->blocks);
 	if (!block)
 		return ERROR_OK;
 
@@ -954,7 +604,7 @@ static int esp32_apptrace_data_processor(void *priv)
 		LOG_ERROR("Failed to process trace block %" PRId32 " bytes!", block->data_len);
 		return res;
 	}
-	res = esp32_apptrace_block_free(ctx, block);
+	res = apptrace_block_free(&ctx->blocks, block);
 	if (res != ERROR_OK) {
 		ctx->running = 0;
 		LOG_ERROR("Failed to free ready block!");
@@ -1108,7 +758,7 @@ static int esp32_apptrace_poll(void *priv)
 			return ERROR_FAIL;
 		}
 	}
-	struct esp32_apptrace_block *block = esp32_apptrace_free_block_get(ctx);
+	struct apptrace_block *block = apptrace_free_block_get(&ctx->blocks);
 	if (!block) {
 		ctx->running = 0;
 		LOG_TARGET_ERROR(ctx->cpus[fired_target_num], "Failed to get free block for data!");
@@ -1145,11 +795,7 @@ static int esp32_apptrace_poll(void *priv)
 			return ERROR_FAIL;
 		}
 		/* update stats */
-		float brt = duration_elapsed(&blk_proc_time);
-		if (brt > ctx->stats.max_blk_read_time)
-			ctx->stats.max_blk_read_time = brt;
-		if (brt < ctx->stats.min_blk_read_time)
-			ctx->stats.min_blk_read_time = brt;
+		apptrace_stats_blk_read(&ctx->stats, duration_elapsed(&blk_proc_time));
 
 		if (duration_start(&blk_proc_time) != 0) {
 			ctx->running = 0;
@@ -1175,7 +821,7 @@ static int esp32_apptrace_poll(void *priv)
 			}
 			LOG_TARGET_DEBUG(ctx->cpus[i], "Ack block %" PRId32, ctx->last_blk_id);
 		}
-		res = esp32_apptrace_ready_block_put(ctx, block);
+		res = apptrace_ready_block_put(&ctx->blocks, block);
 		if (res != ERROR_OK) {
 			ctx->running = 0;
 			LOG_TARGET_ERROR(ctx->cpus[fired_target_num], "Failed to put ready block of data!");
@@ -1188,7 +834,7 @@ static int esp32_apptrace_poll(void *priv)
 			LOG_ERROR("Failed to process trace block %" PRId32 " bytes!", block->data_len);
 			return res;
 		}
-		res = esp32_apptrace_block_free(ctx, block);
+		res = apptrace_block_free(&ctx->blocks, block);
 		if (res != ERROR_OK) {
 			ctx->running = 0;
 			LOG_ERROR("Failed to free ready block!");
@@ -1210,11 +856,7 @@ static int esp32_apptrace_poll(void *priv)
 			return ERROR_FAIL;
 		}
 		/* update stats */
-		float bt = duration_elapsed(&blk_proc_time);
-		if (bt > ctx->stats.max_blk_proc_time)
-			ctx->stats.max_blk_proc_time = bt;
-		if (bt < ctx->stats.min_blk_proc_time)
-			ctx->stats.min_blk_proc_time = bt;
+		apptrace_stats_blk_proc(&ctx->stats, duration_elapsed(&blk_proc_time));
 	}
 	return ERROR_OK;
 }
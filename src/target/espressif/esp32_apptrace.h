@@ -11,6 +11,7 @@
 #include <helper/command.h>
 #include <helper/time_support.h>
 #include <target/target.h>
+#include <target/apptrace.h>
 
 #define ESP32_APPTRACE_MAX_CORES_NUM 2
 
@@ -51,28 +52,12 @@ struct esp_apptrace_host2target_hdr {
 	uint16_t block_sz;
 };
 
-struct esp32_apptrace_dest {
-	void *priv;
-	int (*write)(void *priv, uint8_t *data, int size);
-	int (*clean)(void *priv);
-	bool log_progress;
-};
-
 struct esp32_apptrace_format {
 	uint32_t hdr_sz;
 	int (*core_id_get)(struct target *target, uint8_t *hdr_buf);
 	uint32_t (*usr_block_len_get)(struct target *target, uint8_t *hdr_buf, uint32_t *wr_len);
 };
 
-struct esp32_apptrace_cmd_stats {
-	uint32_t incompl_blocks;
-	uint32_t lost_bytes;
-	float min_blk_read_time;
-	float max_blk_read_time;
-	float min_blk_proc_time;
-	float max_blk_proc_time;
-};
-
 struct esp32_apptrace_cmd_ctx {
 	volatile int running;
 	int mode;
@@ -83,8 +68,7 @@ struct esp32_apptrace_cmd_ctx {
 	const struct esp32_apptrace_hw *hw;
 	enum target_state target_state;
 	uint32_t last_blk_id;
-	struct list_head free_trace_blocks;
-	struct list_head ready_trace_blocks;
+	struct apptrace_blocks blocks;
 	uint32_t max_trace_block_sz;
 	struct esp32_apptrace_format trace_format;
 	int (*process_data)(struct esp32_apptrace_cmd_ctx *ctx, unsigned int core_id, uint8_t *data, uint32_t data_len);
@@ -92,7 +76,7 @@ struct esp32_apptrace_cmd_ctx {
 	uint32_t tot_len;
 	uint32_t raw_tot_len;
 	float stop_tmo;
-	struct esp32_apptrace_cmd_stats stats;
+	struct apptrace_stats stats;
 	struct duration read_time;
 	struct duration idle_time;
 	void *cmd_priv;
@@ -101,7 +85,7 @@ struct esp32_apptrace_cmd_ctx {
 };
 
 struct esp32_apptrace_cmd_data {
-	struct esp32_apptrace_dest data_dest;
+	struct apptrace_dest data_dest;
 	uint32_t poll_period;
 	uint32_t max_len;
 	uint32_t skip_len;
@@ -114,8 +98,6 @@ void esp32_apptrace_cmd_args_parse(struct esp32_apptrace_cmd_ctx *cmd_ctx,
 	struct esp32_apptrace_cmd_data *cmd_data,
 	const char **argv,
 	int argc);
-int esp32_apptrace_dest_init(struct esp32_apptrace_dest dest[], const char *dest_paths[], unsigned int max_dests);
-int esp32_apptrace_dest_cleanup(struct esp32_apptrace_dest dest[], unsigned int max_dests);
 int esp_apptrace_usr_block_write(const struct esp32_apptrace_hw *hw, struct target *target,
 	uint32_t block_id,
 	const uint8_t *data,
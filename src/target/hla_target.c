@@ -455,7 +455,9 @@ static int adapter_resume(struct target *target, int current,
 
 	if (!debug_execution) {
 		target_free_all_working_areas(target);
-		cortex_m_enable_breakpoints(target);
+		res = cortex_m_enable_breakpoints(target);
+		if (res != ERROR_OK)
+			return res;
 		cortex_m_enable_watchpoints(target);
 	}
 
@@ -675,4 +677,5 @@ struct target_type hla_target = {
 	.add_watchpoint = cortex_m_add_watchpoint,
 	.remove_watchpoint = cortex_m_remove_watchpoint,
 	.profiling = cortex_m_profiling,
+	.sample_pc = cortex_m_sample_pc,
 };
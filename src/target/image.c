@@ -111,212 +111,261 @@ static int identify_image_type(struct image *image, const char *type_string, con
 	return ERROR_OK;
 }
 
+/* value of a hexadecimal digit, or -1 */
+static inline int image_hex_nibble(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/* decode count bytes from the hexadecimal text of a record */
+static int image_hex_decode(const char *text, size_t len, uint8_t *out, size_t count)
+{
+	if (len < 2 * count)
+		return ERROR_IMAGE_FORMAT_ERROR;
+
+	for (size_t i = 0; i < count; i++) {
+		int hi = image_hex_nibble(text[2 * i]);
+		int lo = image_hex_nibble(text[2 * i + 1]);
+		if (hi < 0 || lo < 0)
+			return ERROR_IMAGE_FORMAT_ERROR;
+		out[i] = (hi << 4) | lo;
+	}
+
+	return ERROR_OK;
+}
+
+/* return the length of the line at *pos and advance *pos to the next one */
+static size_t image_text_line(const char **pos, const char *end)
+{
+	const char *line = *pos;
+	const char *eol = memchr(line, '\n', end - line);
+
+	if (!eol)
+		eol = end;
+	*pos = (eol < end) ? eol + 1 : end;
+
+	return eol - line;
+}
+
+static bool image_text_skip_line(const char *line, size_t len)
+{
+	/* skip comments and blank lines */
+	if (len > 0 && line[0] == '#')
+		return true;
+
+	for (size_t i = 0; i < len; i++)
+		if (!strchr("\t\r ", line[i]))
+			return false;
+
+	return true;
+}
+
+/*
+ * Read the whole text file at once: the records are then decoded from
+ * memory instead of one fgets() and several sscanf() calls per record.
+ */
+static int image_text_read(struct fileio *fileio, char **text, size_t *text_len)
+{
+	size_t filesize;
+	int retval = fileio_size(fileio, &filesize);
+	if (retval != ERROR_OK)
+		return retval;
+
+	*text = malloc(filesize + 1);
+	if (!*text) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	retval = fileio_read(fileio, filesize, *text, text_len);
+	if (retval != ERROR_OK) {
+		free(*text);
+		*text = NULL;
+		return retval;
+	}
+
+	return ERROR_OK;
+}
+
+static void image_text_section_init(struct imagesection *section, uint8_t *data)
+{
+	section->private = data;
+	section->base_address = 0x0;
+	section->size = 0x0;
+	section->flags = 0;
+}
+
+/*
+ * We encountered a nonconsecutive location, create a new section, unless
+ * the current section has zero size, in which case this specifies the
+ * current section's base address.
+ */
+static int image_text_new_section(struct image *image, struct imagesection *section,
+	uint8_t *data, target_addr_t base_address)
+{
+	if (section[image->num_sections].size != 0) {
+		image->num_sections++;
+		if (image->num_sections >= IMAGE_MAX_SECTIONS) {
+			/* too many sections */
+			LOG_ERROR("Too many sections found in image file");
+			return ERROR_IMAGE_FORMAT_ERROR;
+		}
+		image_text_section_init(&section[image->num_sections], data);
+	}
+	section[image->num_sections].base_address = base_address;
+
+	return ERROR_OK;
+}
+
+/* continue parsing after an end-of-file record, in a new section */
+static int image_text_continue(struct image *image, struct imagesection *section,
+	uint8_t *data, const char *line, size_t len)
+{
+	LOG_WARNING("continuing after end-of-file record: %.*s", (int)MIN(len, 40), line);
+
+	if (image->num_sections >= IMAGE_MAX_SECTIONS) {
+		LOG_ERROR("Too many sections found in image file");
+		return ERROR_IMAGE_FORMAT_ERROR;
+	}
+	image_text_section_init(&section[image->num_sections], data);
+
+	return ERROR_OK;
+}
+
+static int image_text_copy_sections(struct image *image, struct imagesection *section)
+{
+	/* copy section information */
+	image->sections = malloc(sizeof(struct imagesection) * image->num_sections);
+	if (!image->sections) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	memcpy(image->sections, section, sizeof(struct imagesection) * image->num_sections);
+
+	return ERROR_OK;
+}
+
 static int image_ihex_buffer_complete_inner(struct image *image,
-	char *lpsz_line,
+	const char *text, size_t text_len,
 	struct imagesection *section)
 {
 	struct image_ihex *ihex = image->type_private;
-	struct fileio *fileio = ihex->fileio;
-	uint32_t full_address;
-	uint32_t cooked_bytes;
+	const char *pos = text;
+	const char *end = text + text_len;
+	uint32_t full_address = 0x0;
+	uint32_t cooked_bytes = 0x0;
 	bool end_rec = false;
+	uint8_t record[5 + 255];
+	int retval;
 
 	/* we can't determine the number of sections that we'll have to create ahead of time,
 	 * so we locally hold them until parsing is finished */
 
-	size_t filesize;
-	int retval;
-	retval = fileio_size(fileio, &filesize);
-	if (retval != ERROR_OK)
-		return retval;
-
-	ihex->buffer = malloc(filesize >> 1);
-	cooked_bytes = 0x0;
+	ihex->buffer = malloc((text_len >> 1) + 1);
+	if (!ihex->buffer) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
 	image->num_sections = 0;
+	image_text_section_init(&section[0], ihex->buffer);
 
-	while (!fileio_feof(fileio)) {
-		full_address = 0x0;
-		section[image->num_sections].private = &ihex->buffer[cooked_bytes];
-		section[image->num_sections].base_address = 0x0;
-		section[image->num_sections].size = 0x0;
-		section[image->num_sections].flags = 0;
-
-		while (fileio_fgets(fileio, 1023, lpsz_line) == ERROR_OK) {
-			uint32_t count;
-			uint32_t address;
-			uint32_t record_type;
-			uint32_t checksum;
-			uint8_t cal_checksum = 0;
-			size_t bytes_read = 0;
-
-			/* skip comments and blank lines */
-			if ((lpsz_line[0] == '#') || (strlen(lpsz_line + strspn(lpsz_line, "\n\t\r ")) == 0))
-				continue;
-
-			if (sscanf(&lpsz_line[bytes_read], ":%2" SCNx32 "%4" SCNx32 "%2" SCNx32, &count,
-				&address, &record_type) != 3)
-				return ERROR_IMAGE_FORMAT_ERROR;
-			bytes_read += 9;
-
-			cal_checksum += (uint8_t)count;
-			cal_checksum += (uint8_t)(address >> 8);
-			cal_checksum += (uint8_t)address;
-			cal_checksum += (uint8_t)record_type;
-
-			if (record_type == 0) {	/* Data Record */
-				if ((full_address & 0xffff) != address) {
-					/* we encountered a nonconsecutive location, create a new section,
-					 * unless the current section has zero size, in which case this specifies
-					 * the current section's base address
-					 */
-					if (section[image->num_sections].size != 0) {
-						image->num_sections++;
-						if (image->num_sections >= IMAGE_MAX_SECTIONS) {
-							/* too many sections */
-							LOG_ERROR("Too many sections found in IHEX file");
-							return ERROR_IMAGE_FORMAT_ERROR;
-						}
-						section[image->num_sections].size = 0x0;
-						section[image->num_sections].flags = 0;
-						section[image->num_sections].private =
-							&ihex->buffer[cooked_bytes];
-					}
-					section[image->num_sections].base_address =
-						(full_address & 0xffff0000) | address;
-					full_address = (full_address & 0xffff0000) | address;
-				}
+	while (pos < end) {
+		const char *line = pos;
+		size_t len = image_text_line(&pos, end);
 
-				while (count-- > 0) {
-					unsigned value;
-					sscanf(&lpsz_line[bytes_read], "%2x", &value);
-					ihex->buffer[cooked_bytes] = (uint8_t)value;
-					cal_checksum += (uint8_t)ihex->buffer[cooked_bytes];
-					bytes_read += 2;
-					cooked_bytes += 1;
-					section[image->num_sections].size += 1;
-					full_address++;
-				}
-			} else if (record_type == 1) {	/* End of File Record */
-				/* finish the current section */
-				image->num_sections++;
-
-				/* copy section information */
-				image->sections = malloc(sizeof(struct imagesection) * image->num_sections);
-				for (unsigned int i = 0; i < image->num_sections; i++) {
-					image->sections[i].private = section[i].private;
-					image->sections[i].base_address = section[i].base_address;
-					image->sections[i].size = section[i].size;
-					image->sections[i].flags = section[i].flags;
-				}
+		if (image_text_skip_line(line, len))
+			continue;
 
-				end_rec = true;
-				break;
-			} else if (record_type == 2) {	/* Linear Address Record */
-				uint16_t upper_address;
-
-				sscanf(&lpsz_line[bytes_read], "%4hx", &upper_address);
-				cal_checksum += (uint8_t)(upper_address >> 8);
-				cal_checksum += (uint8_t)upper_address;
-				bytes_read += 4;
-
-				if ((full_address >> 4) != upper_address) {
-					/* we encountered a nonconsecutive location, create a new section,
-					 * unless the current section has zero size, in which case this specifies
-					 * the current section's base address
-					 */
-					if (section[image->num_sections].size != 0) {
-						image->num_sections++;
-						if (image->num_sections >= IMAGE_MAX_SECTIONS) {
-							/* too many sections */
-							LOG_ERROR("Too many sections found in IHEX file");
-							return ERROR_IMAGE_FORMAT_ERROR;
-						}
-						section[image->num_sections].size = 0x0;
-						section[image->num_sections].flags = 0;
-						section[image->num_sections].private =
-							&ihex->buffer[cooked_bytes];
-					}
-					section[image->num_sections].base_address =
-						(full_address & 0xffff) | (upper_address << 4);
-					full_address = (full_address & 0xffff) | (upper_address << 4);
-				}
-			} else if (record_type == 3) {	/* Start Segment Address Record */
-				uint32_t dummy;
-
-				/* "Start Segment Address Record" will not be supported
-				 * but we must consume it, and do not create an error.  */
-				while (count-- > 0) {
-					sscanf(&lpsz_line[bytes_read], "%2" SCNx32, &dummy);
-					cal_checksum += (uint8_t)dummy;
-					bytes_read += 2;
-				}
-			} else if (record_type == 4) {	/* Extended Linear Address Record */
-				uint16_t upper_address;
-
-				sscanf(&lpsz_line[bytes_read], "%4hx", &upper_address);
-				cal_checksum += (uint8_t)(upper_address >> 8);
-				cal_checksum += (uint8_t)upper_address;
-				bytes_read += 4;
-
-				if ((full_address >> 16) != upper_address) {
-					/* we encountered a nonconsecutive location, create a new section,
-					 * unless the current section has zero size, in which case this specifies
-					 * the current section's base address
-					 */
-					if (section[image->num_sections].size != 0) {
-						image->num_sections++;
-						if (image->num_sections >= IMAGE_MAX_SECTIONS) {
-							/* too many sections */
-							LOG_ERROR("Too many sections found in IHEX file");
-							return ERROR_IMAGE_FORMAT_ERROR;
-						}
-						section[image->num_sections].size = 0x0;
-						section[image->num_sections].flags = 0;
-						section[image->num_sections].private =
-							&ihex->buffer[cooked_bytes];
-					}
-					section[image->num_sections].base_address =
-						(full_address & 0xffff) | (upper_address << 16);
-					full_address = (full_address & 0xffff) | (upper_address << 16);
-				}
-			} else if (record_type == 5) {	/* Start Linear Address Record */
-				uint32_t start_address;
-
-				sscanf(&lpsz_line[bytes_read], "%8" SCNx32, &start_address);
-				cal_checksum += (uint8_t)(start_address >> 24);
-				cal_checksum += (uint8_t)(start_address >> 16);
-				cal_checksum += (uint8_t)(start_address >> 8);
-				cal_checksum += (uint8_t)start_address;
-				bytes_read += 8;
-
-				image->start_address_set = true;
-				image->start_address = be_to_h_u32((uint8_t *)&start_address);
-			} else {
-				LOG_ERROR("unhandled IHEX record type: %i", (int)record_type);
-				return ERROR_IMAGE_FORMAT_ERROR;
-			}
+		if (end_rec) {
+			end_rec = false;
+			full_address = 0x0;
+			retval = image_text_continue(image, section, &ihex->buffer[cooked_bytes], line, len);
+			if (retval != ERROR_OK)
+				return retval;
+		}
 
-			sscanf(&lpsz_line[bytes_read], "%2" SCNx32, &checksum);
+		/* record length, address, type, data and checksum */
+		if (line[0] != ':' || image_hex_decode(line + 1, len - 1, record, 1) != ERROR_OK)
+			return ERROR_IMAGE_FORMAT_ERROR;
+
+		uint32_t count = record[0];
+		if (image_hex_decode(line + 1, len - 1, record, count + 5) != ERROR_OK)
+			return ERROR_IMAGE_FORMAT_ERROR;
+
+		uint8_t cal_checksum = 0;
+		for (uint32_t i = 0; i < count + 5; i++)
+			cal_checksum += record[i];
+		if (cal_checksum != 0) {
+			/* checksum failed */
+			LOG_ERROR("incorrect record checksum found in IHEX file");
+			return ERROR_IMAGE_CHECKSUM;
+		}
 
-			if ((uint8_t)checksum != (uint8_t)(~cal_checksum + 1)) {
-				/* checksum failed */
-				LOG_ERROR("incorrect record checksum found in IHEX file");
-				return ERROR_IMAGE_CHECKSUM;
+		uint32_t address = be_to_h_u16(&record[1]);
+		uint32_t record_type = record[3];
+		const uint8_t *data = &record[4];
+
+		if (record_type == 0) {	/* Data Record */
+			if ((full_address & 0xffff) != address) {
+				full_address = (full_address & 0xffff0000) | address;
+				retval = image_text_new_section(image, section,
+					&ihex->buffer[cooked_bytes], full_address);
+				if (retval != ERROR_OK)
+					return retval;
 			}
 
-			if (end_rec) {
-				end_rec = false;
-				LOG_WARNING("continuing after end-of-file record: %.40s", lpsz_line);
+			memcpy(&ihex->buffer[cooked_bytes], data, count);
+			cooked_bytes += count;
+			section[image->num_sections].size += count;
+			full_address += count;
+		} else if (record_type == 1) {	/* End of File Record */
+			/* finish the current section */
+			image->num_sections++;
+			end_rec = true;
+		} else if (record_type == 2 || record_type == 4) {
+			/* Linear Address Record, Extended Linear Address Record */
+			if (count != 2)
+				return ERROR_IMAGE_FORMAT_ERROR;
+
+			uint32_t upper_address = be_to_h_u16(data);
+			unsigned int shift = record_type == 2 ? 4 : 16;
+
+			if ((full_address >> shift) != upper_address) {
+				full_address = (full_address & 0xffff) | (upper_address << shift);
+				retval = image_text_new_section(image, section,
+					&ihex->buffer[cooked_bytes], full_address);
+				if (retval != ERROR_OK)
+					return retval;
 			}
+		} else if (record_type == 3) {	/* Start Segment Address Record */
+			/* "Start Segment Address Record" will not be supported
+			 * but we must consume it, and do not create an error.  */
+		} else if (record_type == 5) {	/* Start Linear Address Record */
+			if (count != 4)
+				return ERROR_IMAGE_FORMAT_ERROR;
+
+			uint32_t start_address = be_to_h_u32(data);
+
+			image->start_address_set = true;
+			image->start_address = be_to_h_u32((uint8_t *)&start_address);
+		} else {
+			LOG_ERROR("unhandled IHEX record type: %i", (int)record_type);
+			return ERROR_IMAGE_FORMAT_ERROR;
 		}
 	}
 
-	if (end_rec)
-		return ERROR_OK;
-	else {
+	if (!end_rec) {
 		LOG_ERROR("premature end of IHEX file, no matching end-of-file record found");
 		return ERROR_IMAGE_FORMAT_ERROR;
 	}
+
+	return image_text_copy_sections(image, section);
 }
 
 /**
@@ -325,23 +374,25 @@ static int image_ihex_buffer_complete_inner(struct image *image,
  */
 static int image_ihex_buffer_complete(struct image *image)
 {
-	char *lpsz_line = malloc(1023);
-	if (!lpsz_line) {
-		LOG_ERROR("Out of memory");
-		return ERROR_FAIL;
-	}
+	struct image_ihex *ihex = image->type_private;
+	char *text;
+	size_t text_len;
+
+	int retval = image_text_read(ihex->fileio, &text, &text_len);
+	if (retval != ERROR_OK)
+		return retval;
+
 	struct imagesection *section = malloc(sizeof(struct imagesection) * IMAGE_MAX_SECTIONS);
 	if (!section) {
-		free(lpsz_line);
+		free(text);
 		LOG_ERROR("Out of memory");
 		return ERROR_FAIL;
 	}
-	int retval;
 
-	retval = image_ihex_buffer_complete_inner(image, lpsz_line, section);
+	retval = image_ihex_buffer_complete_inner(image, text, text_len, section);
 
 	free(section);
-	free(lpsz_line);
+	free(text);
 
 	return retval;
 }
@@ -758,179 +809,110 @@ static int image_elf_read_section(struct image *image,
 }
 
 static int image_mot_buffer_complete_inner(struct image *image,
-	char *lpsz_line,
+	const char *text, size_t text_len,
 	struct imagesection *section)
 {
 	struct image_mot *mot = image->type_private;
-	struct fileio *fileio = mot->fileio;
-	uint32_t full_address;
-	uint32_t cooked_bytes;
+	const char *pos = text;
+	const char *end = text + text_len;
+	uint32_t full_address = 0x0;
+	uint32_t cooked_bytes = 0x0;
 	bool end_rec = false;
+	uint8_t record[1 + 255];
+	int retval;
 
 	/* we can't determine the number of sections that we'll have to create ahead of time,
 	 * so we locally hold them until parsing is finished */
 
-	int retval;
-	size_t filesize;
-	retval = fileio_size(fileio, &filesize);
-	if (retval != ERROR_OK)
-		return retval;
-
-	mot->buffer = malloc(filesize >> 1);
-	cooked_bytes = 0x0;
+	mot->buffer = malloc((text_len >> 1) + 1);
+	if (!mot->buffer) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
 	image->num_sections = 0;
+	image_text_section_init(&section[0], mot->buffer);
 
-	while (!fileio_feof(fileio)) {
-		full_address = 0x0;
-		section[image->num_sections].private = &mot->buffer[cooked_bytes];
-		section[image->num_sections].base_address = 0x0;
-		section[image->num_sections].size = 0x0;
-		section[image->num_sections].flags = 0;
-
-		while (fileio_fgets(fileio, 1023, lpsz_line) == ERROR_OK) {
-			uint32_t count;
-			uint32_t address;
-			uint32_t record_type;
-			uint32_t checksum;
-			uint8_t cal_checksum = 0;
-			uint32_t bytes_read = 0;
-
-			/* skip comments and blank lines */
-			if ((lpsz_line[0] == '#') || (strlen(lpsz_line + strspn(lpsz_line, "\n\t\r ")) == 0))
-				continue;
-
-			/* get record type and record length */
-			if (sscanf(&lpsz_line[bytes_read], "S%1" SCNx32 "%2" SCNx32, &record_type,
-				&count) != 2)
-				return ERROR_IMAGE_FORMAT_ERROR;
-
-			bytes_read += 4;
-			cal_checksum += (uint8_t)count;
+	while (pos < end) {
+		const char *line = pos;
+		size_t len = image_text_line(&pos, end);
 
-			/* skip checksum byte */
-			count -= 1;
+		if (image_text_skip_line(line, len))
+			continue;
 
-			if (record_type == 0) {
-				/* S0 - starting record (optional) */
-				int value;
+		if (end_rec) {
+			end_rec = false;
+			full_address = 0x0;
+			retval = image_text_continue(image, section, &mot->buffer[cooked_bytes], line, len);
+			if (retval != ERROR_OK)
+				return retval;
+		}
 
-				while (count-- > 0) {
-					sscanf(&lpsz_line[bytes_read], "%2x", &value);
-					cal_checksum += (uint8_t)value;
-					bytes_read += 2;
-				}
-			} else if (record_type >= 1 && record_type <= 3) {
-				switch (record_type) {
-					case 1:
-						/* S1 - 16 bit address data record */
-						sscanf(&lpsz_line[bytes_read], "%4" SCNx32, &address);
-						cal_checksum += (uint8_t)(address >> 8);
-						cal_checksum += (uint8_t)address;
-						bytes_read += 4;
-						count -= 2;
-						break;
-
-					case 2:
-						/* S2 - 24 bit address data record */
-						sscanf(&lpsz_line[bytes_read], "%6" SCNx32, &address);
-						cal_checksum += (uint8_t)(address >> 16);
-						cal_checksum += (uint8_t)(address >> 8);
-						cal_checksum += (uint8_t)address;
-						bytes_read += 6;
-						count -= 3;
-						break;
-
-					case 3:
-						/* S3 - 32 bit address data record */
-						sscanf(&lpsz_line[bytes_read], "%8" SCNx32, &address);
-						cal_checksum += (uint8_t)(address >> 24);
-						cal_checksum += (uint8_t)(address >> 16);
-						cal_checksum += (uint8_t)(address >> 8);
-						cal_checksum += (uint8_t)address;
-						bytes_read += 8;
-						count -= 4;
-						break;
+		/* get record type and record length */
+		if (len < 2 || line[0] != 'S' || image_hex_nibble(line[1]) < 0
+				|| image_hex_decode(line + 2, len - 2, record, 1) != ERROR_OK)
+			return ERROR_IMAGE_FORMAT_ERROR;
+
+		uint32_t record_type = image_hex_nibble(line[1]);
+		uint32_t count = record[0];
+		if (count < 1 || image_hex_decode(line + 2, len - 2, record, count + 1) != ERROR_OK)
+			return ERROR_IMAGE_FORMAT_ERROR;
+
+		/* account for checksum, will always be 0xFF */
+		uint8_t cal_checksum = 0;
+		for (uint32_t i = 0; i < count + 1; i++)
+			cal_checksum += record[i];
+		if (cal_checksum != 0xFF) {
+			/* checksum failed */
+			LOG_ERROR("incorrect record checksum found in S19 file");
+			return ERROR_IMAGE_CHECKSUM;
+		}
 
-				}
+		/* skip checksum byte */
+		count -= 1;
 
-				if (full_address != address) {
-					/* we encountered a nonconsecutive location, create a new section,
-					 * unless the current section has zero size, in which case this specifies
-					 * the current section's base address
-					 */
-					if (section[image->num_sections].size != 0) {
-						image->num_sections++;
-						section[image->num_sections].size = 0x0;
-						section[image->num_sections].flags = 0;
-						section[image->num_sections].private =
-							&mot->buffer[cooked_bytes];
-					}
-					section[image->num_sections].base_address = address;
-					full_address = address;
-				}
-
-				while (count-- > 0) {
-					unsigned value;
-					sscanf(&lpsz_line[bytes_read], "%2x", &value);
-					mot->buffer[cooked_bytes] = (uint8_t)value;
-					cal_checksum += (uint8_t)mot->buffer[cooked_bytes];
-					bytes_read += 2;
-					cooked_bytes += 1;
-					section[image->num_sections].size += 1;
-					full_address++;
-				}
-			} else if (record_type == 5 || record_type == 6) {
-				/* S5 and S6 are the data count records, we ignore them */
-				uint32_t dummy;
-
-				while (count-- > 0) {
-					sscanf(&lpsz_line[bytes_read], "%2" SCNx32, &dummy);
-					cal_checksum += (uint8_t)dummy;
-					bytes_read += 2;
-				}
-			} else if (record_type >= 7 && record_type <= 9) {
-				/* S7, S8, S9 - ending records for 32, 24 and 16bit */
-				image->num_sections++;
-
-				/* copy section information */
-				image->sections = malloc(sizeof(struct imagesection) * image->num_sections);
-				for (unsigned int i = 0; i < image->num_sections; i++) {
-					image->sections[i].private = section[i].private;
-					image->sections[i].base_address = section[i].base_address;
-					image->sections[i].size = section[i].size;
-					image->sections[i].flags = section[i].flags;
-				}
+		if (record_type == 0) {
+			/* S0 - starting record (optional) */
+		} else if (record_type >= 1 && record_type <= 3) {
+			/* S1, S2, S3 - 16, 24 and 32 bit address data records */
+			uint32_t address_len = record_type + 1;
+			uint32_t address = 0;
 
-				end_rec = true;
-				break;
-			} else {
-				LOG_ERROR("unhandled S19 record type: %i", (int)(record_type));
+			if (count < address_len)
 				return ERROR_IMAGE_FORMAT_ERROR;
+			for (uint32_t i = 0; i < address_len; i++)
+				address = (address << 8) | record[1 + i];
+			count -= address_len;
+
+			if (full_address != address) {
+				full_address = address;
+				retval = image_text_new_section(image, section,
+					&mot->buffer[cooked_bytes], full_address);
+				if (retval != ERROR_OK)
+					return retval;
 			}
 
-			/* account for checksum, will always be 0xFF */
-			sscanf(&lpsz_line[bytes_read], "%2" SCNx32, &checksum);
-			cal_checksum += (uint8_t)checksum;
-
-			if (cal_checksum != 0xFF) {
-				/* checksum failed */
-				LOG_ERROR("incorrect record checksum found in S19 file");
-				return ERROR_IMAGE_CHECKSUM;
-			}
-
-			if (end_rec) {
-				end_rec = false;
-				LOG_WARNING("continuing after end-of-file record: %.40s", lpsz_line);
-			}
+			memcpy(&mot->buffer[cooked_bytes], &record[1 + address_len], count);
+			cooked_bytes += count;
+			section[image->num_sections].size += count;
+			full_address += count;
+		} else if (record_type == 5 || record_type == 6) {
+			/* S5 and S6 are the data count records, we ignore them */
+		} else if (record_type >= 7 && record_type <= 9) {
+			/* S7, S8, S9 - ending records for 32, 24 and 16bit */
+			image->num_sections++;
+			end_rec = true;
+		} else {
+			LOG_ERROR("unhandled S19 record type: %i", (int)(record_type));
+			return ERROR_IMAGE_FORMAT_ERROR;
 		}
 	}
 
-	if (end_rec)
-		return ERROR_OK;
-	else {
+	if (!end_rec) {
 		LOG_ERROR("premature end of S19 file, no matching end-of-file record found");
 		return ERROR_IMAGE_FORMAT_ERROR;
 	}
+
+	return image_text_copy_sections(image, section);
 }
 
 /**
@@ -939,23 +921,25 @@ static int image_mot_buffer_complete_inner(struct image *image,
  */
 static int image_mot_buffer_complete(struct image *image)
 {
-	char *lpsz_line = malloc(1023);
-	if (!lpsz_line) {
-		LOG_ERROR("Out of memory");
-		return ERROR_FAIL;
-	}
+	struct image_mot *mot = image->type_private;
+	char *text;
+	size_t text_len;
+
+	int retval = image_text_read(mot->fileio, &text, &text_len);
+	if (retval != ERROR_OK)
+		return retval;
+
 	struct imagesection *section = malloc(sizeof(struct imagesection) * IMAGE_MAX_SECTIONS);
 	if (!section) {
-		free(lpsz_line);
+		free(text);
 		LOG_ERROR("Out of memory");
 		return ERROR_FAIL;
 	}
-	int retval;
 
-	retval = image_mot_buffer_complete_inner(image, lpsz_line, section);
+	retval = image_mot_buffer_complete_inner(image, text, text_len, section);
 
 	free(section);
-	free(lpsz_line);
+	free(text);
 
 	return retval;
 }
@@ -1159,7 +1159,9 @@ static int cortex_m_restore_one(struct target *target, bool current,
 
 	if (!debug_execution) {
 		target_free_all_working_areas(target);
-		cortex_m_enable_breakpoints(target);
+		int retval = cortex_m_enable_breakpoints(target);
+		if (retval != ERROR_OK)
+			return retval;
 		cortex_m_enable_watchpoints(target);
 	}
 
@@ -2360,4 +2362,5 @@ struct target_type km1m0xx_target = {
 	.deinit_target = cortex_m_deinit_target,
 
 	.profiling = cortex_m_profiling,
+	.sample_pc = cortex_m_sample_pc,
 };
@@ -0,0 +1,862 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <helper/fileio.h>
+#include <helper/list.h>
+#include <helper/log.h>
+#include <helper/time_support.h>
+#include <helper/types.h>
+#include <jtag/jtag.h>
+#include <server/server.h>
+
+#include "image.h"
+#include "profiler.h"
+#include "target.h"
+
+/** Number of slots of the PC histogram, must be a power of two */
+#define PROFILER_HIST_BITS		13
+#define PROFILER_HIST_SIZE		(1u << PROFILER_HIST_BITS)
+/** Distinct PCs accepted before the histogram counts new ones as dropped */
+#define PROFILER_HIST_MAX_USED	(PROFILER_HIST_SIZE / 4 * 3)
+
+/** PC samples read from the target at once */
+#define PROFILER_PCSR_BURST		32
+/** Interval between two timer ticks sampling the PC, in ms */
+#define PROFILER_PCSR_PERIOD	10
+/** Time spent sampling on each tick, leaving the rest to the servers, in ms */
+#define PROFILER_PCSR_BUDGET	2
+
+/** Default interval between two streamed snapshots, in ms */
+#define PROFILER_DEFAULT_PERIOD	1000
+
+/** Lines printed by "profiler dump" by default */
+#define PROFILER_DEFAULT_DUMP	20
+
+/** PCSR value while the core is halted or cannot be sampled */
+#define PROFILER_PC_IDLE		0xffffffff
+
+#define PROFILER_SERVICE_NAME	"profiler"
+
+enum profiler_source {
+	PROFILER_SOURCE_PCSR,
+	PROFILER_SOURCE_SWO,
+};
+
+static const char * const profiler_source_names[] = {
+	[PROFILER_SOURCE_PCSR] = "pcsr",
+	[PROFILER_SOURCE_SWO] = "swo",
+};
+
+struct profiler_bin {
+	uint32_t pc;
+	uint32_t count;		/* 0 for an unused slot */
+};
+
+struct profiler_symbol {
+	uint32_t address;
+	uint32_t size;
+	char *name;
+};
+
+struct profiler_connection {
+	struct list_head lh;
+	struct connection *connection;
+};
+
+/* one line of a snapshot, before sorting */
+struct profiler_entry {
+	uint64_t count;
+	uint32_t key;		/* PC, or index in the symbol table */
+};
+
+static struct profiler {
+	struct target *target;
+	enum profiler_source source;
+	bool running;
+
+	/* open addressing hash table from PC to sample count */
+	struct profiler_bin hist[PROFILER_HIST_SIZE];
+	unsigned int used;
+	uint64_t total;
+	uint64_t idle;
+	uint64_t dropped;
+
+	/* sampling time, not counting the time the profiler was stopped */
+	int64_t start_ms;
+	int64_t elapsed_ms;
+
+	/* state of the ITM/DWT packet parser */
+	uint8_t header;
+	unsigned int payload_size;
+	unsigned int payload_left;
+	uint32_t payload;
+
+	/* function symbols, sorted by address */
+	struct profiler_symbol *symbols;
+	unsigned int num_symbols;
+
+	/* snapshot destination: a file, or ':' followed by a TCP port */
+	char *out_filename;
+
+	uint32_t samples[PROFILER_PCSR_BURST];
+} profiler;
+
+static LIST_HEAD(profiler_connections);
+
+static unsigned int profiler_hash(uint32_t pc)
+{
+	/* instructions are at least 2 bytes aligned */
+	return ((pc >> 1) * 0x9e3779b1u) >> (32 - PROFILER_HIST_BITS);
+}
+
+static void profiler_add_sample(uint32_t pc)
+{
+	profiler.total++;
+
+	if (pc == PROFILER_PC_IDLE) {
+		profiler.idle++;
+		return;
+	}
+
+	/* the table is never full, so the probing terminates */
+	for (unsigned int i = profiler_hash(pc); ; i = (i + 1) & (PROFILER_HIST_SIZE - 1)) {
+		struct profiler_bin *bin = &profiler.hist[i];
+
+		if (!bin->count) {
+			if (profiler.used >= PROFILER_HIST_MAX_USED) {
+				profiler.dropped++;
+				return;
+			}
+			bin->pc = pc;
+			bin->count = 1;
+			profiler.used++;
+			return;
+		}
+
+		if (bin->pc == pc) {
+			if (bin->count < UINT32_MAX)
+				bin->count++;
+			return;
+		}
+	}
+}
+
+static void profiler_reset(void)
+{
+	memset(profiler.hist, 0, sizeof(profiler.hist));
+	profiler.used = 0;
+	profiler.total = 0;
+	profiler.idle = 0;
+	profiler.dropped = 0;
+	profiler.elapsed_ms = 0;
+	profiler.start_ms = timeval_ms();
+}
+
+static int64_t profiler_elapsed_ms(void)
+{
+	if (profiler.running)
+		return profiler.elapsed_ms + timeval_ms() - profiler.start_ms;
+	return profiler.elapsed_ms;
+}
+
+/*
+ * Sample source "pcsr": read bursts of samples on every timer tick, as
+ * fast as the adapter allows, while the target is running. Each tick is
+ * bounded in time so that GDB and telnet are still served.
+ */
+static void profiler_stop(void);
+
+static int profiler_pcsr_poll(void *priv)
+{
+	struct target *target = profiler.target;
+	uint32_t num_samples;
+
+	if (!is_jtag_poll_safe() || target->state != TARGET_RUNNING)
+		return ERROR_OK;
+
+	int64_t end = timeval_ms() + PROFILER_PCSR_BUDGET;
+	int retval;
+
+	do {
+		retval = target_sample_pc(target, profiler.samples, PROFILER_PCSR_BURST,
+				&num_samples);
+
+		for (uint32_t i = 0; i < num_samples; i++)
+			profiler_add_sample(profiler.samples[i]);
+	} while (retval == ERROR_OK && timeval_ms() < end);
+
+	if (retval != ERROR_OK) {
+		LOG_ERROR("profiler: cannot sample the PC of %s, stopping", target_name(target));
+		profiler_stop();
+	}
+
+	return ERROR_OK;
+}
+
+/*
+ * Sample source "swo": pick the DWT periodic PC sample packets out of
+ * the ITM/DWT trace stream, see "Debug Trace Interface" in the ARMv7-M
+ * Architecture Reference Manual. The stream must not use the TPIU
+ * formatter.
+ */
+static void profiler_swo_packet(void)
+{
+	/* hardware source packet with discriminator 2 */
+	if ((profiler.header & 0xfc) != 0x14)
+		return;
+
+	if (profiler.payload_size == 4)
+		profiler_add_sample(profiler.payload);
+	else
+		profiler_add_sample(PROFILER_PC_IDLE);	/* core sleeping */
+}
+
+static void profiler_swo_byte(uint8_t byte)
+{
+	if (profiler.payload_left) {
+		if (profiler.header & 0x03) {
+			/* source packet, with a fixed payload size */
+			unsigned int n = profiler.payload_size - profiler.payload_left;
+			profiler.payload |= (uint32_t)byte << (8 * n);
+			if (--profiler.payload_left == 0)
+				profiler_swo_packet();
+		} else if (!(byte & 0x80)) {
+			/* last byte of a protocol packet */
+			profiler.payload_left = 0;
+		}
+		return;
+	}
+
+	profiler.header = byte;
+	profiler.payload = 0;
+
+	if (byte & 0x03) {
+		/* instrumentation or hardware source packet */
+		profiler.payload_size = (byte & 0x03) == 3 ? 4 : byte & 0x03;
+		profiler.payload_left = profiler.payload_size;
+	} else if ((byte & 0x80) && byte != 0x80) {
+		/* timestamp or extension packet with continuation bytes */
+		profiler.payload_left = 1;
+	}
+	/* else synchronization, overflow or single byte packet */
+}
+
+static int profiler_trace_callback(struct target *target, size_t len,
+		uint8_t *data, void *priv)
+{
+	for (size_t i = 0; i < len; i++)
+		profiler_swo_byte(data[i]);
+
+	return ERROR_OK;
+}
+
+/*
+ * Function symbols, for binning the samples by function.
+ */
+static void profiler_free_symbols(void)
+{
+	for (unsigned int i = 0; i < profiler.num_symbols; i++)
+		free(profiler.symbols[i].name);
+	free(profiler.symbols);
+	profiler.symbols = NULL;
+	profiler.num_symbols = 0;
+}
+
+static int profiler_symbol_compare(const void *a, const void *b)
+{
+	const struct profiler_symbol *sa = a;
+	const struct profiler_symbol *sb = b;
+
+	if (sa->address != sb->address)
+		return sa->address < sb->address ? -1 : 1;
+	return 0;
+}
+
+#define elf_u16(elf, be, off) \
+	((be) ? be_to_h_u16((elf) + (off)) : le_to_h_u16((elf) + (off)))
+#define elf_u32(elf, be, off) \
+	((be) ? be_to_h_u32((elf) + (off)) : le_to_h_u32((elf) + (off)))
+
+static int profiler_parse_symbols(const uint8_t *elf, size_t size)
+{
+	if (size < sizeof(Elf32_Ehdr) || memcmp(elf, ELFMAG, SELFMAG)) {
+		LOG_ERROR("profiler: not an ELF file");
+		return ERROR_IMAGE_FORMAT_ERROR;
+	}
+
+	if (elf[EI_CLASS] != ELFCLASS32) {
+		LOG_ERROR("profiler: only 32-bit ELF files are supported");
+		return ERROR_IMAGE_FORMAT_ERROR;
+	}
+
+	bool be = elf[EI_DATA] == ELFDATA2MSB;
+	uint32_t shoff = elf_u32(elf, be, offsetof(Elf32_Ehdr, e_shoff));
+	uint16_t shentsize = elf_u16(elf, be, offsetof(Elf32_Ehdr, e_shentsize));
+	uint16_t shnum = elf_u16(elf, be, offsetof(Elf32_Ehdr, e_shnum));
+
+	if (shentsize < sizeof(Elf32_Shdr) || shoff > size
+			|| (size - shoff) / shentsize < shnum) {
+		LOG_ERROR("profiler: invalid ELF section header table");
+		return ERROR_IMAGE_FORMAT_ERROR;
+	}
+
+	/* find the symbol table and its string table */
+	const uint8_t *symtab = NULL, *strtab = NULL;
+	uint32_t symtab_size = 0, strtab_size = 0, symentsize = 0;
+
+	for (unsigned int i = 0; i < shnum; i++) {
+		const uint8_t *sh = elf + shoff + i * shentsize;
+
+		if (elf_u32(sh, be, offsetof(Elf32_Shdr, sh_type)) != SHT_SYMTAB)
+			continue;
+
+		uint32_t link = elf_u32(sh, be, offsetof(Elf32_Shdr, sh_link));
+		if (link >= shnum)
+			break;
+		const uint8_t *str_sh = elf + shoff + link * shentsize;
+
+		uint32_t off = elf_u32(sh, be, offsetof(Elf32_Shdr, sh_offset));
+		symtab_size = elf_u32(sh, be, offsetof(Elf32_Shdr, sh_size));
+		symentsize = elf_u32(sh, be, offsetof(Elf32_Shdr, sh_entsize));
+		if (off > size || size - off < symtab_size || symentsize < sizeof(Elf32_Sym))
+			break;
+		symtab = elf + off;
+
+		off = elf_u32(str_sh, be, offsetof(Elf32_Shdr, sh_offset));
+		strtab_size = elf_u32(str_sh, be, offsetof(Elf32_Shdr, sh_size));
+		if (off > size || size - off < strtab_size)
+			break;
+		strtab = elf + off;
+		break;
+	}
+
+	if (!symtab || !strtab) {
+		LOG_ERROR("profiler: no valid symbol table in the ELF file");
+		return ERROR_IMAGE_FORMAT_ERROR;
+	}
+
+	unsigned int num_syms = symtab_size / symentsize;
+	profiler.symbols = calloc(num_syms, sizeof(*profiler.symbols));
+	if (!profiler.symbols) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	for (unsigned int i = 0; i < num_syms; i++) {
+		const uint8_t *sym = symtab + i * symentsize;
+		uint8_t info = sym[offsetof(Elf32_Sym, st_info)];
+		uint16_t shndx = elf_u16(sym, be, offsetof(Elf32_Sym, st_shndx));
+		uint32_t name = elf_u32(sym, be, offsetof(Elf32_Sym, st_name));
+
+		if (ELF32_ST_TYPE(info) != STT_FUNC || shndx == SHN_UNDEF || name >= strtab_size)
+			continue;
+
+		struct profiler_symbol *s = &profiler.symbols[profiler.num_symbols];
+		/* clear the Thumb bit of ARM function addresses */
+		s->address = elf_u32(sym, be, offsetof(Elf32_Sym, st_value)) & ~1u;
+		s->size = elf_u32(sym, be, offsetof(Elf32_Sym, st_size));
+		s->name = strndup((const char *)strtab + name, strtab_size - name);
+		if (!s->name) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		profiler.num_symbols++;
+	}
+
+	qsort(profiler.symbols, profiler.num_symbols, sizeof(*profiler.symbols),
+			profiler_symbol_compare);
+
+	return ERROR_OK;
+}
+
+static int profiler_load_symbols(const char *filename)
+{
+	struct fileio *fileio;
+	size_t size, read_bytes;
+
+	profiler_free_symbols();
+
+	int retval = fileio_open(&fileio, filename, FILEIO_READ, FILEIO_BINARY);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = fileio_size(fileio, &size);
+	if (retval != ERROR_OK) {
+		fileio_close(fileio);
+		return retval;
+	}
+
+	uint8_t *elf = malloc(size);
+	if (!elf) {
+		LOG_ERROR("Out of memory");
+		fileio_close(fileio);
+		return ERROR_FAIL;
+	}
+
+	retval = fileio_read(fileio, size, elf, &read_bytes);
+	fileio_close(fileio);
+	if (retval == ERROR_OK && read_bytes != size)
+		retval = ERROR_FILEIO_OPERATION_FAILED;
+
+	if (retval == ERROR_OK)
+		retval = profiler_parse_symbols(elf, size);
+	free(elf);
+
+	if (retval != ERROR_OK)
+		profiler_free_symbols();
+
+	return retval;
+}
+
+/* index of the function containing @a pc, or num_symbols if none */
+static unsigned int profiler_find_symbol(uint32_t pc)
+{
+	unsigned int lo = 0, hi = profiler.num_symbols;
+
+	/* last symbol with an address lower than or equal to pc */
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (profiler.symbols[mid].address <= pc)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == 0)
+		return profiler.num_symbols;
+
+	const struct profiler_symbol *s = &profiler.symbols[lo - 1];
+	/* a symbol without size extends up to the next one */
+	if (s->size && pc - s->address >= s->size)
+		return profiler.num_symbols;
+
+	return lo - 1;
+}
+
+/*
+ * Snapshots
+ */
+static int profiler_entry_compare(const void *a, const void *b)
+{
+	const struct profiler_entry *ea = a;
+	const struct profiler_entry *eb = b;
+
+	if (ea->count != eb->count)
+		return ea->count > eb->count ? -1 : 1;
+	return ea->key < eb->key ? -1 : ea->key > eb->key;
+}
+
+typedef void (*profiler_output_fn)(void *priv, const char *line);
+
+/* output the @a max_lines hottest bins, or all if @a max_lines is 0 */
+static int profiler_snapshot(unsigned int max_lines, profiler_output_fn output, void *priv)
+{
+	bool by_symbol = profiler.num_symbols > 0;
+	unsigned int num_entries = by_symbol ? profiler.num_symbols + 1 : profiler.used;
+	struct profiler_entry *entries = calloc(num_entries ? num_entries : 1, sizeof(*entries));
+	if (!entries) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	if (by_symbol) {
+		for (unsigned int i = 0; i < num_entries; i++)
+			entries[i].key = i;
+		for (unsigned int i = 0; i < PROFILER_HIST_SIZE; i++)
+			if (profiler.hist[i].count)
+				entries[profiler_find_symbol(profiler.hist[i].pc)].count += profiler.hist[i].count;
+	} else {
+		unsigned int n = 0;
+		for (unsigned int i = 0; i < PROFILER_HIST_SIZE; i++) {
+			if (profiler.hist[i].count) {
+				entries[n].key = profiler.hist[i].pc;
+				entries[n].count = profiler.hist[i].count;
+				n++;
+			}
+		}
+	}
+
+	qsort(entries, num_entries, sizeof(*entries), profiler_entry_compare);
+
+	char line[160];
+	snprintf(line, sizeof(line), "# %s (%s): %" PRIu64 " samples in %" PRId64 " ms, %" PRIu64
+			" idle, %" PRIu64 " dropped",
+			profiler.target ? target_name(profiler.target) : "none",
+			profiler_source_names[profiler.source], profiler.total, profiler_elapsed_ms(), profiler.idle, profiler.dropped);
+	output(priv, line);
+
+	for (unsigned int i = 0; i < num_entries && entries[i].count; i++) {
+		if (max_lines && i >= max_lines)
+			break;
+
+		double percent = 100.0 * entries[i].count / profiler.total;
+		if (!by_symbol)
+			snprintf(line, sizeof(line), "%10" PRIu64 " %6.2f%% 0x%08" PRIx32,
+					entries[i].count, percent, entries[i].key);
+		else if (entries[i].key < profiler.num_symbols)
+			snprintf(line, sizeof(line), "%10" PRIu64 " %6.2f%% %s",
+					entries[i].count, percent, profiler.symbols[entries[i].key].name);
+		else
+			snprintf(line, sizeof(line), "%10" PRIu64 " %6.2f%% [unknown]",
+					entries[i].count, percent);
+		output(priv, line);
+	}
+
+	free(entries);
+	return ERROR_OK;
+}
+
+static void profiler_output_file(void *priv, const char *line)
+{
+	FILE *f = priv;
+
+	fprintf(f, "%s\n", line);
+}
+
+static void profiler_output_connections(void *priv, const char *line)
+{
+	struct profiler_connection *c;
+	size_t len = strlen(line);
+
+	list_for_each_entry(c, &profiler_connections, lh) {
+		if (connection_write(c->connection, line, len) != (int)len
+				|| connection_write(c->connection, "\n", 1) != 1)
+			LOG_ERROR("profiler: error writing to connection");
+	}
+}
+
+static int profiler_stream_snapshot(void *priv)
+{
+	if (profiler.out_filename[0] == ':') {
+		if (list_empty(&profiler_connections))
+			return ERROR_OK;
+		profiler_snapshot(0, profiler_output_connections, NULL);
+		profiler_output_connections(NULL, "");
+		return ERROR_OK;
+	}
+
+	/* keep a single, complete snapshot in the file */
+	FILE *f = fopen(profiler.out_filename, "w");
+	if (!f) {
+		LOG_ERROR("profiler: cannot open %s", profiler.out_filename);
+		return ERROR_FAIL;
+	}
+	profiler_snapshot(0, profiler_output_file, f);
+	fclose(f);
+
+	return ERROR_OK;
+}
+
+static int profiler_service_new_connection(struct connection *connection)
+{
+	struct profiler_connection *c = malloc(sizeof(*c));
+	if (!c) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	c->connection = connection;
+	list_add(&c->lh, &profiler_connections);
+	return ERROR_OK;
+}
+
+static int profiler_service_input(struct connection *connection)
+{
+	/* read a dummy buffer to check if the connection is still active */
+	long dummy;
+	int bytes_read = connection_read(connection, &dummy, sizeof(dummy));
+
+	if (bytes_read == 0) {
+		return ERROR_SERVER_REMOTE_CLOSED;
+	} else if (bytes_read == -1) {
+		LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	return ERROR_OK;
+}
+
+static int profiler_service_connection_closed(struct connection *connection)
+{
+	struct profiler_connection *c, *tmp;
+
+	list_for_each_entry_safe(c, tmp, &profiler_connections, lh)
+		if (c->connection == connection) {
+			list_del(&c->lh);
+			free(c);
+			return ERROR_OK;
+		}
+	LOG_ERROR("Failed to find connection to close!");
+	return ERROR_FAIL;
+}
+
+static const struct service_driver profiler_service_driver = {
+	.name = PROFILER_SERVICE_NAME,
+	.new_connection_during_keep_alive_handler = NULL,
+	.new_connection_handler = profiler_service_new_connection,
+	.input_handler = profiler_service_input,
+	.connection_closed_handler = profiler_service_connection_closed,
+	.keep_client_alive_handler = NULL,
+};
+
+static void profiler_stream_off(void)
+{
+	if (!profiler.out_filename)
+		return;
+
+	target_unregister_timer_callback(profiler_stream_snapshot, NULL);
+	if (profiler.out_filename[0] == ':')
+		remove_service(PROFILER_SERVICE_NAME, &profiler.out_filename[1]);
+	free(profiler.out_filename);
+	profiler.out_filename = NULL;
+}
+
+/*
+ * Start and stop
+ */
+static void profiler_stop(void)
+{
+	if (!profiler.running)
+		return;
+
+	if (profiler.source == PROFILER_SOURCE_PCSR)
+		target_unregister_timer_callback(profiler_pcsr_poll, NULL);
+	else
+		target_unregister_trace_callback(profiler_trace_callback, NULL);
+
+	profiler.elapsed_ms += timeval_ms() - profiler.start_ms;
+	profiler.running = false;
+}
+
+void profiler_cleanup(void)
+{
+	profiler_stop();
+	profiler_stream_off();
+	profiler_free_symbols();
+}
+
+COMMAND_HANDLER(handle_profiler_start_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	enum profiler_source source = PROFILER_SOURCE_PCSR;
+	int retval;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		if (!strcmp(CMD_ARGV[0], "swo"))
+			source = PROFILER_SOURCE_SWO;
+		else if (strcmp(CMD_ARGV[0], "pcsr"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+
+	if (profiler.running) {
+		command_print(CMD, "profiler is already running on %s",
+				target_name(profiler.target));
+		return ERROR_FAIL;
+	}
+
+	if (source == PROFILER_SOURCE_PCSR) {
+		uint32_t pc, num_samples;
+
+		/* like "profile", take a zero PCSR as "not implemented" */
+		retval = target_sample_pc(target, &pc, 1, &num_samples);
+		if (retval == ERROR_OK && pc == 0)
+			retval = ERROR_NOT_IMPLEMENTED;
+		if (retval == ERROR_NOT_IMPLEMENTED) {
+			command_print(CMD, "%s does not support PC sampling, try 'swo'",
+					target_name(target));
+			return ERROR_FAIL;
+		}
+		if (retval != ERROR_OK)
+			return retval;
+
+		retval = target_register_timer_callback(profiler_pcsr_poll, PROFILER_PCSR_PERIOD,
+				TARGET_TIMER_TYPE_PERIODIC, NULL);
+	} else {
+		profiler.payload_left = 0;
+		retval = target_register_trace_callback(profiler_trace_callback, NULL);
+	}
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (profiler.target != target) {
+		profiler.target = target;
+		profiler_reset();
+	}
+
+	profiler.source = source;
+	profiler.start_ms = timeval_ms();
+	profiler.running = true;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_profiler_stop_command)
+{
+	if (CMD_ARGC)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	profiler_stop();
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_profiler_reset_command)
+{
+	if (CMD_ARGC)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	profiler_reset();
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_profiler_symbols_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 0) {
+		profiler_free_symbols();
+		return ERROR_OK;
+	}
+
+	int retval = profiler_load_symbols(CMD_ARGV[0]);
+	if (retval != ERROR_OK)
+		return retval;
+
+	command_print(CMD, "loaded %u function symbols from %s",
+			profiler.num_symbols, CMD_ARGV[0]);
+	return ERROR_OK;
+}
+
+static void profiler_output_command(void *priv, const char *line)
+{
+	struct command_invocation *cmd = priv;
+
+	command_print(cmd, "%s", line);
+}
+
+COMMAND_HANDLER(handle_profiler_dump_command)
+{
+	unsigned int max_lines = PROFILER_DEFAULT_DUMP;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], max_lines);
+
+	return profiler_snapshot(max_lines, profiler_output_command, CMD);
+}
+
+COMMAND_HANDLER(handle_profiler_stream_command)
+{
+	unsigned int period_ms = PROFILER_DEFAULT_PERIOD;
+	int retval;
+
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 2) {
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[1], period_ms);
+		if (!period_ms)
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	profiler_stream_off();
+
+	if (!strcmp(CMD_ARGV[0], "off"))
+		return ERROR_OK;
+
+	profiler.out_filename = strdup(CMD_ARGV[0]);
+	if (!profiler.out_filename) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	if (profiler.out_filename[0] == ':') {
+		retval = add_service(&profiler_service_driver, &profiler.out_filename[1],
+				CONNECTION_LIMIT_UNLIMITED, NULL);
+		if (retval != ERROR_OK) {
+			command_print(CMD, "Can't configure profiler TCP port %s",
+					&profiler.out_filename[1]);
+			free(profiler.out_filename);
+			profiler.out_filename = NULL;
+			return retval;
+		}
+	}
+
+	return target_register_timer_callback(profiler_stream_snapshot, period_ms,
+			TARGET_TIMER_TYPE_PERIODIC, NULL);
+}
+
+static const struct command_registration profiler_subcommand_handlers[] = {
+	{
+		.name = "start",
+		.handler = handle_profiler_start_command,
+		.mode = COMMAND_EXEC,
+		.help = "start sampling the PC of the current target in the background",
+		.usage = "['pcsr'|'swo']",
+	},
+	{
+		.name = "stop",
+		.handler = handle_profiler_stop_command,
+		.mode = COMMAND_EXEC,
+		.help = "stop sampling, keeping the collected samples",
+		.usage = "",
+	},
+	{
+		.name = "reset",
+		.handler = handle_profiler_reset_command,
+		.mode = COMMAND_EXEC,
+		.help = "discard the collected samples",
+		.usage = "",
+	},
+	{
+		.name = "symbols",
+		.handler = handle_profiler_symbols_command,
+		.mode = COMMAND_ANY,
+		.help = "bin the samples by the functions of an ELF file, "
+			"or by address without argument",
+		.usage = "[elf_file]",
+	},
+	{
+		.name = "dump",
+		.handler = handle_profiler_dump_command,
+		.mode = COMMAND_EXEC,
+		.help = "print the hottest addresses or functions",
+		.usage = "[num_lines]",
+	},
+	{
+		.name = "stream",
+		.handler = handle_profiler_stream_command,
+		.mode = COMMAND_ANY,
+		.help = "periodically write snapshots to a file or a TCP port",
+		.usage = "(filename|':'port|'off') [period_ms]",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const struct command_registration profiler_command_handlers[] = {
+	{
+		.name = "profiler",
+		.mode = COMMAND_ANY,
+		.help = "continuous PC sampling profiler",
+		.usage = "",
+		.chain = profiler_subcommand_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+int profiler_register_commands(struct command_context *cmd_ctx)
+{
+	return register_commands(cmd_ctx, NULL, profiler_command_handlers);
+}
@@ -0,0 +1,25 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef OPENOCD_TARGET_PROFILER_H
+#define OPENOCD_TARGET_PROFILER_H
+
+#include <helper/command.h>
+
+/**
+ * @file
+ * Continuous PC sampling profiler.
+ *
+ * Unlike the "profile" command, which collects a fixed number of samples
+ * while blocking the command line, the profiler runs in the background
+ * while the target executes. PC samples are read in bursts from the
+ * target (e.g. Cortex-M DWT_PCSR) or decoded from the DWT PC sample
+ * packets of the SWO trace stream, and accumulated into a histogram of
+ * constant size. Snapshots of the histogram, optionally binned by the
+ * functions of an ELF file, can be printed or streamed periodically to
+ * a file or a TCP port.
+ */
+
+int profiler_register_commands(struct command_context *cmd_ctx);
+void profiler_cleanup(void);
+
+#endif /* OPENOCD_TARGET_PROFILER_H */
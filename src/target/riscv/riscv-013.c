@@ -29,6 +29,13 @@
 #include "asm.h"
 #include "batch.h"
 
+/* Bounds of the learned memory access batch size, in scans. */
+#define RISCV_BATCH_SCANS_MIN		32
+#define RISCV_BATCH_SCANS_MAX		1024
+/* Batches without busy responses before the batch size is doubled and the
+ * delays are lowered. */
+#define RISCV_BATCH_CLEAN_RUNS		8
+
 static int riscv013_on_step_or_resume(struct target *target, bool step);
 static int riscv013_step_or_resume_current_hart(struct target *target,
 		bool step, bool use_hasel);
@@ -37,6 +44,9 @@ static void riscv013_clear_abstract_error(struct target *target);
 /* Implementations of the functions in struct riscv_info. */
 static int riscv013_get_register(struct target *target,
 		riscv_reg_t *value, int rid);
+static int riscv013_read_registers(struct target *target,
+		const enum gdb_regno *regnos, riscv_reg_t *values, unsigned int count,
+		unsigned int *done);
 static int riscv013_set_register(struct target *target, int regid, uint64_t value);
 static int riscv013_select_current_hart(struct target *target);
 static int riscv013_halt_prep(struct target *target);
@@ -213,6 +223,22 @@ typedef struct {
 
 	/* DM that provides access to this target. */
 	dm013_info_t *dm;
+
+	/* Number of scans in a memory access batch. Grows while batches run
+	 * without busy responses and shrinks when they don't. */
+	unsigned int batch_scans;
+	/* Smallest delays not yet seen to cause busy responses. The delays are
+	 * lowered towards these after a run of batches without busy. */
+	unsigned int dmi_busy_floor;
+	unsigned int ac_busy_floor;
+	/* Busy responses seen, and the count when the last batch started. */
+	unsigned int busy_count;
+	unsigned int batch_busy_count;
+	unsigned int clean_batches;
+
+	/* Statistics reported by "riscv stats". */
+	uint64_t dmi_scans;
+	double dmi_seconds;
 } riscv013_info_t;
 
 static LIST_HEAD(dm_list);
@@ -450,6 +476,8 @@ static uint32_t dtmcontrol_scan(struct target *target, uint32_t out)
 static void increase_dmi_busy_delay(struct target *target)
 {
 	riscv013_info_t *info = get_info(target);
+	info->dmi_busy_floor = info->dmi_busy_delay + 1;
+	info->busy_count++;
 	info->dmi_busy_delay += info->dmi_busy_delay / 10 + 1;
 	LOG_DEBUG("dtmcs_idle=%d, dmi_busy_delay=%d, ac_busy_delay=%d",
 			info->dtmcs_idle, info->dmi_busy_delay,
@@ -484,9 +512,14 @@ static dmi_status_t dmi_scan(struct target *target, uint32_t *address_in,
 		if (r->reset_delays_wait < 0) {
 			info->dmi_busy_delay = 0;
 			info->ac_busy_delay = 0;
+			info->dmi_busy_floor = 0;
+			info->ac_busy_floor = 0;
 		}
 	}
 
+	struct duration scan_time;
+	duration_start(&scan_time);
+
 	memset(in, 0, num_bytes);
 	memset(out, 0, num_bytes);
 
@@ -524,6 +557,10 @@ static dmi_status_t dmi_scan(struct target *target, uint32_t *address_in,
 		return DMI_STATUS_FAILED;
 	}
 
+	if (duration_measure(&scan_time) == ERROR_OK)
+		info->dmi_seconds += duration_elapsed(&scan_time);
+	info->dmi_scans++;
+
 	if (bscan_tunnel_ir_width != 0) {
 		/* need to right-shift "in" by one bit, because of clock skew between BSCAN TAP and DM TAP */
 		buffer_shr(in, num_bytes, 1);
@@ -709,6 +746,8 @@ static int dmstatus_read(struct target *target, uint32_t *dmstatus,
 static void increase_ac_busy_delay(struct target *target)
 {
 	riscv013_info_t *info = get_info(target);
+	info->ac_busy_floor = info->ac_busy_delay + 1;
+	info->busy_count++;
 	info->ac_busy_delay += info->ac_busy_delay / 10 + 1;
 	LOG_DEBUG("dtmcs_idle=%d, dmi_busy_delay=%d, ac_busy_delay=%d",
 			info->dtmcs_idle, info->dmi_busy_delay,
@@ -1867,6 +1906,31 @@ static unsigned riscv013_data_bits(struct target *target)
 	return 32;
 }
 
+static COMMAND_HELPER(riscv013_print_stats, struct target *target, bool reset)
+{
+	RISCV013_INFO(info);
+
+	/* This output format can be fed directly into TCL's "array set". */
+	riscv_print_info_line(CMD, "dmi", "busy_delay", info->dmi_busy_delay);
+	riscv_print_info_line(CMD, "dmi", "busy_floor", info->dmi_busy_floor);
+	riscv_print_info_line(CMD, "ac", "busy_delay", info->ac_busy_delay);
+	riscv_print_info_line(CMD, "ac", "busy_floor", info->ac_busy_floor);
+	riscv_print_info_line(CMD, "batch", "scans", info->batch_scans);
+	riscv_print_info_line(CMD, "dmi", "busy_count", info->busy_count);
+	command_print(CMD, "%-21s %3" PRIu64, "dmi.scans", info->dmi_scans);
+	command_print(CMD, "%-21s %3" PRIu64, "dmi.scans_per_sec",
+			info->dmi_seconds > 0 ? (uint64_t)(info->dmi_scans / info->dmi_seconds) : 0);
+
+	if (reset) {
+		info->dmi_scans = 0;
+		info->dmi_seconds = 0;
+		info->busy_count = 0;
+		info->batch_busy_count = 0;
+	}
+
+	return 0;
+}
+
 static COMMAND_HELPER(riscv013_print_info, struct target *target)
 {
 	RISCV013_INFO(info);
@@ -2087,6 +2151,39 @@ static int sb_write_address(struct target *target, target_addr_t address,
 				  false, ensure_success);
 }
 
+/* Lower a delay by about an eighth, but not below the learned floor. */
+static unsigned int decrease_delay(unsigned int delay, unsigned int floor)
+{
+	unsigned int step = delay / 8 + 1;
+	return delay > floor + step ? delay - step : MIN(delay, floor);
+}
+
+/*
+ * Settle the outcome of the previous batch before running the next one.
+ * Busy responses are only noticed (and the delays raised) by whatever the
+ * caller does after a batch, so by now we know whether the previous batch
+ * went through cleanly.
+ */
+static void batch_tune(const struct target *target)
+{
+	RISCV013_INFO(info);
+
+	if (info->busy_count != info->batch_busy_count) {
+		info->batch_busy_count = info->busy_count;
+		info->clean_batches = 0;
+		info->batch_scans = MAX(info->batch_scans / 2, RISCV_BATCH_SCANS_MIN);
+		return;
+	}
+
+	if (++info->clean_batches < RISCV_BATCH_CLEAN_RUNS)
+		return;
+
+	info->clean_batches = 0;
+	info->batch_scans = MIN(info->batch_scans * 2, RISCV_BATCH_SCANS_MAX);
+	info->dmi_busy_delay = decrease_delay(info->dmi_busy_delay, info->dmi_busy_floor);
+	info->ac_busy_delay = decrease_delay(info->ac_busy_delay, info->ac_busy_floor);
+}
+
 static int batch_run(const struct target *target, struct riscv_batch *batch)
 {
 	RISCV013_INFO(info);
@@ -2097,9 +2194,23 @@ static int batch_run(const struct target *target, struct riscv_batch *batch)
 			batch->idle_count = 0;
 			info->dmi_busy_delay = 0;
 			info->ac_busy_delay = 0;
+			info->dmi_busy_floor = 0;
+			info->ac_busy_floor = 0;
 		}
 	}
-	return riscv_batch_run(batch);
+
+	batch_tune(target);
+
+	struct duration batch_time;
+	duration_start(&batch_time);
+
+	int result = riscv_batch_run(batch);
+
+	if (duration_measure(&batch_time) == ERROR_OK)
+		info->dmi_seconds += duration_elapsed(&batch_time);
+	info->dmi_scans += batch->used_scans;
+
+	return result;
 }
 
 static int sba_supports_access(struct target *target, unsigned int size_bytes)
@@ -2278,6 +2389,7 @@ static int init_target(struct command_context *cmd_ctx,
 	generic_info->get_register = &riscv013_get_register;
 	generic_info->set_register = &riscv013_set_register;
 	generic_info->get_register_buf = &riscv013_get_register_buf;
+	generic_info->read_registers = &riscv013_read_registers;
 	generic_info->set_register_buf = &riscv013_set_register_buf;
 	generic_info->select_current_hart = &riscv013_select_current_hart;
 	generic_info->is_halted = &riscv013_is_halted;
@@ -2304,6 +2416,7 @@ static int init_target(struct command_context *cmd_ctx,
 	generic_info->hart_count = &riscv013_hart_count;
 	generic_info->data_bits = &riscv013_data_bits;
 	generic_info->print_info = &riscv013_print_info;
+	generic_info->print_stats = &riscv013_print_stats;
 	if (!generic_info->version_specific) {
 		generic_info->version_specific = calloc(1, sizeof(riscv013_info_t));
 		if (!generic_info->version_specific)
@@ -2318,6 +2431,7 @@ static int init_target(struct command_context *cmd_ctx,
 	info->bus_master_read_delay = 0;
 	info->bus_master_write_delay = 0;
 	info->ac_busy_delay = 0;
+	info->batch_scans = RISCV_BATCH_SCANS_MIN;
 
 	/* Assume all these abstract commands are supported until we learn
 	 * otherwise.
@@ -3155,7 +3269,7 @@ static int read_memory_progbuf_inner(struct target *target, target_addr_t addres
 		 * dm_data0 contains[read_addr-size*2]
 		 */
 
-		struct riscv_batch *batch = riscv_batch_alloc(target, 32,
+		struct riscv_batch *batch = riscv_batch_alloc(target, info->batch_scans,
 				info->dmi_busy_delay + info->ac_busy_delay);
 		if (!batch)
 			return ERROR_FAIL;
@@ -3664,7 +3778,7 @@ static int write_memory_bus_v1(struct target *target, target_addr_t address,
 
 		struct riscv_batch *batch = riscv_batch_alloc(
 				target,
-				32,
+				info->batch_scans,
 				info->dmi_busy_delay + info->bus_master_write_delay);
 		if (!batch)
 			return ERROR_FAIL;
@@ -3859,7 +3973,7 @@ static int write_memory_progbuf(struct target *target, target_addr_t address,
 
 		struct riscv_batch *batch = riscv_batch_alloc(
 				target,
-				32,
+				info->batch_scans,
 				info->dmi_busy_delay + info->ac_busy_delay);
 		if (!batch)
 			goto error;
@@ -4091,6 +4205,101 @@ static int riscv013_get_register(struct target *target,
 	return result;
 }
 
+/*
+ * Read GPRs with back-to-back abstract commands queued in a single batch. Each
+ * command is followed by a read of abstractcs, so the results can be trusted
+ * up to the first command that was still busy or failed; the caller reads the
+ * rest one at a time. Busy responses raise the delays for the next batch.
+ */
+static int riscv013_read_registers(struct target *target,
+		const enum gdb_regno *regnos, riscv_reg_t *values, unsigned int count,
+		unsigned int *done)
+{
+	RISCV013_INFO(info);
+
+	*done = 0;
+
+	if (riscv_select_current_hart(target) != ERROR_OK)
+		return ERROR_FAIL;
+
+	unsigned int per_reg = 2 + DIV_ROUND_UP(riscv_xlen(target), 32);
+	struct riscv_batch *batch = riscv_batch_alloc(target, count * per_reg,
+			info->dmi_busy_delay + info->ac_busy_delay);
+	if (!batch)
+		return ERROR_FAIL;
+
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int size = register_size(target, regnos[i]);
+		if (regnos[i] == GDB_REGNO_ZERO || regnos[i] > GDB_REGNO_XPR31 ||
+				(size != 32 && size != 64)) {
+			count = i;
+			break;
+		}
+		riscv_batch_add_dmi_write(batch, DM_COMMAND,
+				access_register_command(target, regnos[i], size,
+					AC_ACCESS_REGISTER_TRANSFER));
+		riscv_batch_add_dmi_read(batch, DM_ABSTRACTCS);
+		if (size > 32)
+			riscv_batch_add_dmi_read(batch, DM_DATA1);
+		riscv_batch_add_dmi_read(batch, DM_DATA0);
+	}
+
+	int result = batch_run(target, batch);
+	if (result != ERROR_OK) {
+		riscv_batch_free(batch);
+		return result;
+	}
+
+	bool dmi_busy = false;
+	bool ac_busy = false;
+	size_t key = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int size = register_size(target, regnos[i]);
+		unsigned int reads = size > 32 ? 3 : 2;
+		riscv_reg_t value = 0;
+
+		for (unsigned int j = 0; j < reads; j++)
+			if (riscv_batch_get_dmi_read_op(batch, key + j) != DMI_STATUS_SUCCESS)
+				dmi_busy = true;
+		if (dmi_busy)
+			break;
+
+		uint32_t abstractcs = riscv_batch_get_dmi_read_data(batch, key);
+		if (get_field(abstractcs, DM_ABSTRACTCS_BUSY) ||
+				get_field(abstractcs, DM_ABSTRACTCS_CMDERR) != CMDERR_NONE) {
+			ac_busy = get_field(abstractcs, DM_ABSTRACTCS_BUSY) ||
+				get_field(abstractcs, DM_ABSTRACTCS_CMDERR) == CMDERR_BUSY;
+			break;
+		}
+
+		if (size > 32)
+			value = ((uint64_t)riscv_batch_get_dmi_read_data(batch, key + 1)) << 32;
+		value |= riscv_batch_get_dmi_read_data(batch, key + reads - 1);
+		key += reads;
+
+		values[i] = value;
+		(*done)++;
+	}
+
+	riscv_batch_free(batch);
+
+	if (*done == count)
+		return ERROR_OK;
+
+	LOG_DEBUG("[%s] batched register read stopped after %u of %u registers "
+			"(dmi_busy=%d, ac_busy=%d)", target_name(target), *done, count,
+			dmi_busy, ac_busy);
+
+	/* increase_dmi_busy_delay() also resets the sticky DMI busy state */
+	if (dmi_busy)
+		increase_dmi_busy_delay(target);
+	if (ac_busy)
+		increase_ac_busy_delay(target);
+	riscv013_clear_abstract_error(target);
+
+	return ERROR_OK;
+}
+
 static int riscv013_set_register(struct target *target, int rid, uint64_t value)
 {
 	riscv013_select_current_hart(target);
@@ -1804,6 +1804,58 @@ static int riscv_get_gdb_reg_list_internal(struct target *target,
 	return ERROR_OK;
 }
 
+static bool gdb_regno_cacheable(enum gdb_regno regno, bool write);
+
+/* Fetch the invalid GPRs of reg_list in one batch, if the debug spec
+ * implementation can do that. Everything else is left to register_get(). */
+static int riscv_read_registers(struct target *target, struct reg **reg_list,
+		int reg_count)
+{
+	RISCV_INFO(r);
+
+	if (!r->read_registers || !target->reg_cache)
+		return ERROR_OK;
+
+	enum gdb_regno regnos[GDB_REGNO_XPR31];
+	riscv_reg_t values[GDB_REGNO_XPR31];
+	struct reg *regs[GDB_REGNO_XPR31];
+	unsigned int count = 0;
+	unsigned int last = riscv_supports_extension(target, 'E') ?
+		GDB_REGNO_XPR15 : GDB_REGNO_XPR31;
+
+	for (int i = 0; i < reg_count; i++) {
+		struct reg *reg = reg_list[i];
+		if (!reg || !reg->exist || reg->valid)
+			continue;
+		if (reg->number == GDB_REGNO_ZERO || reg->number > last)
+			continue;
+		if (reg != &target->reg_cache->reg_list[reg->number])
+			continue;
+		if (count == ARRAY_SIZE(regnos))
+			break;
+		regs[count] = reg;
+		regnos[count] = reg->number;
+		count++;
+	}
+
+	if (count < 2)
+		return ERROR_OK;
+
+	keep_alive();
+
+	unsigned int done = 0;
+	int result = r->read_registers(target, regnos, values, count, &done);
+
+	for (unsigned int i = 0; i < done; i++) {
+		buf_set_u64(regs[i]->value, 0, regs[i]->size, values[i]);
+		regs[i]->valid = gdb_regno_cacheable(regnos[i], false);
+	}
+
+	LOG_DEBUG("[%s] batch read %u of %u registers", target_name(target),
+			done, count);
+	return result;
+}
+
 static int riscv_get_gdb_reg_list_noread(struct target *target,
 		struct reg **reg_list[], int *reg_list_size,
 		enum target_register_class reg_class)
@@ -2863,6 +2915,28 @@ COMMAND_HANDLER(handle_info)
 	return 0;
 }
 
+COMMAND_HANDLER(handle_stats)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	RISCV_INFO(r);
+	bool reset = false;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		reset = true;
+	}
+
+	if (!r->print_stats) {
+		command_print(CMD, "No statistics available for this target.");
+		return ERROR_OK;
+	}
+
+	return CALL_COMMAND_HANDLER(r->print_stats, target, reset);
+}
+
 static const struct command_registration riscv_exec_command_handlers[] = {
 	{
 		.name = "info",
@@ -2871,6 +2945,14 @@ static const struct command_registration riscv_exec_command_handlers[] = {
 		.usage = "",
 		.help = "Displays some information OpenOCD detected about the target."
 	},
+	{
+		.name = "stats",
+		.handler = handle_stats,
+		.mode = COMMAND_EXEC,
+		.usage = "[reset]",
+		.help = "Displays the learned DMI delays and batch size and the "
+			"observed DMI throughput, optionally resetting the counters."
+	},
 	{
 		.name = "set_command_timeout_sec",
 		.handler = riscv_set_command_timeout_sec,
@@ -3098,6 +3180,7 @@ struct target_type riscv_target = {
 	.get_gdb_arch = riscv_get_gdb_arch,
 	.get_gdb_reg_list = riscv_get_gdb_reg_list,
 	.get_gdb_reg_list_noread = riscv_get_gdb_reg_list_noread,
+	.read_registers = riscv_read_registers,
 
 	.add_breakpoint = riscv_add_breakpoint,
 	.remove_breakpoint = riscv_remove_breakpoint,
@@ -142,6 +142,10 @@ struct riscv_info {
 	int (*get_register)(struct target *target, riscv_reg_t *value, int regid);
 	int (*set_register)(struct target *target, int regid, uint64_t value);
 	int (*get_register_buf)(struct target *target, uint8_t *buf, int regno);
+	/* Read several registers in one batch. Reads regnos[0..count) in order
+	 * and sets *done to the number of leading entries read successfully. */
+	int (*read_registers)(struct target *target, const enum gdb_regno *regnos,
+			riscv_reg_t *values, unsigned int count, unsigned int *done);
 	int (*set_register_buf)(struct target *target, int regno,
 			const uint8_t *buf);
 	int (*select_current_hart)(struct target *target);
@@ -187,6 +191,7 @@ struct riscv_info {
 	unsigned (*data_bits)(struct target *target);
 
 	COMMAND_HELPER((*print_info), struct target *target);
+	COMMAND_HELPER((*print_stats), struct target *target, bool reset);
 
 	/* Storage for vector register types. */
 	struct reg_data_type_vector vector_uint8;
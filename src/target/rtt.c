@@ -409,3 +409,50 @@ int target_rtt_read_callback(struct target *target,
 
 	return ERROR_OK;
 }
+
+int target_rtt_read_channel_callback(struct target *target,
+		const struct rtt_control *ctrl, unsigned int channel_index,
+		uint8_t *buffer, size_t *length, bool *pending, void *user_data)
+{
+	int ret;
+	struct rtt_channel channel;
+	uint32_t available;
+
+	*pending = false;
+
+	if (channel_index >= ctrl->num_up_channels) {
+		LOG_ERROR("rtt: Up-channel %u is not available", channel_index);
+		return ERROR_FAIL;
+	}
+
+	ret = read_rtt_channel(target, ctrl, channel_index, RTT_CHANNEL_TYPE_UP,
+		&channel);
+
+	if (ret != ERROR_OK) {
+		LOG_ERROR("rtt: Failed to read up-channel %u description",
+			channel_index);
+		return ret;
+	}
+
+	if (!channel_is_active(&channel) ||
+			channel.size < RTT_CHANNEL_BUFFER_MIN_SIZE) {
+		*length = 0;
+		return ERROR_OK;
+	}
+
+	if (channel.read_pos <= channel.write_pos)
+		available = channel.write_pos - channel.read_pos;
+	else
+		available = channel.size - channel.read_pos + channel.write_pos;
+
+	ret = read_from_channel(target, &channel, buffer, length);
+
+	if (ret != ERROR_OK) {
+		LOG_ERROR("rtt: Failed to read from up-channel %u", channel_index);
+		return ret;
+	}
+
+	*pending = *length < available;
+
+	return ERROR_OK;
+}
@@ -139,6 +139,11 @@ int semihosting_common_init(struct target *target, void *setup,
 	semihosting->sys_errno = -1;
 	semihosting->cmdline = NULL;
 	semihosting->basedir = NULL;
+	semihosting->batch_output = true;
+	semihosting->console_len = 0;
+	semihosting->console_fd = -1;
+	semihosting->console_op = -1;
+	semihosting->console_timer = false;
 
 	/* If possible, update it in setup(). */
 	semihosting->setup_time = clock();
@@ -161,14 +166,14 @@ struct semihosting_tcp_service {
 	int error;
 };
 
-static bool semihosting_is_redirected(struct semihosting *semihosting, int fd)
+static bool semihosting_is_redirected(struct semihosting *semihosting, int op, int fd)
 {
 	if (semihosting->redirect_cfg == SEMIHOSTING_REDIRECT_CFG_NONE)
 		return false;
 
 	bool is_read_op = false;
 
-	switch (semihosting->op) {
+	switch (op) {
 	/* check debug semihosting operations: READC, WRITEC and WRITE0 */
 	case SEMIHOSTING_SYS_READC:
 		is_read_op = true;
@@ -221,7 +226,7 @@ static ssize_t semihosting_redirect_write(struct semihosting *semihosting, void
 
 static ssize_t semihosting_write(struct semihosting *semihosting, int fd, void *buf, int size)
 {
-	if (semihosting_is_redirected(semihosting, fd))
+	if (semihosting_is_redirected(semihosting, semihosting->op, fd))
 		return semihosting_redirect_write(semihosting, buf, size);
 
 	/* default write */
@@ -256,7 +261,7 @@ static ssize_t semihosting_redirect_read(struct semihosting *semihosting, void *
 
 static inline int semihosting_putchar(struct semihosting *semihosting, int fd, int c)
 {
-	if (semihosting_is_redirected(semihosting, fd))
+	if (semihosting_is_redirected(semihosting, semihosting->op, fd))
 		return semihosting_redirect_write(semihosting, &c, 1);
 
 	/* default putchar */
@@ -265,7 +270,7 @@ static inline int semihosting_putchar(struct semihosting *semihosting, int fd, i
 
 static inline ssize_t semihosting_read(struct semihosting *semihosting, int fd, void *buf, int size)
 {
-	if (semihosting_is_redirected(semihosting, fd))
+	if (semihosting_is_redirected(semihosting, semihosting->op, fd))
 		return semihosting_redirect_read(semihosting, buf, size);
 
 	/* default read */
@@ -277,7 +282,7 @@ static inline ssize_t semihosting_read(struct semihosting *semihosting, int fd,
 
 static inline int semihosting_getchar(struct semihosting *semihosting, int fd)
 {
-	if (semihosting_is_redirected(semihosting, fd)) {
+	if (semihosting_is_redirected(semihosting, semihosting->op, fd)) {
 		unsigned char c;
 
 		if (semihosting_redirect_read(semihosting, &c, 1) > 0)
@@ -290,6 +295,124 @@ static inline int semihosting_getchar(struct semihosting *semihosting, int fd)
 	return getchar();
 }
 
+/**
+ * Writes the console output collected by semihosting_console_write().
+ */
+static void semihosting_console_flush(struct semihosting *semihosting)
+{
+	size_t len = semihosting->console_len;
+	int fd = semihosting->console_fd;
+
+	if (!len)
+		return;
+
+	semihosting->console_len = 0;
+
+	if (semihosting_is_redirected(semihosting, semihosting->console_op, fd)) {
+		semihosting_redirect_write(semihosting, semihosting->console_buf, len);
+	} else if (semihosting->console_op == SEMIHOSTING_SYS_WRITE) {
+		for (size_t done = 0; done < len; ) {
+			ssize_t n = write(fd, semihosting->console_buf + done, len - done);
+			if (n <= 0) {
+				LOG_WARNING("semihosting: write of console output failed");
+				break;
+			}
+			done += n;
+		}
+	} else {
+		/* debug channel, as the former putchar() */
+		fwrite(semihosting->console_buf, 1, len, stdout);
+		fflush(stdout);
+	}
+}
+
+static int semihosting_console_timer_callback(void *priv)
+{
+	struct semihosting *semihosting = priv;
+
+	semihosting->console_timer = false;
+	semihosting_console_flush(semihosting);
+
+	return ERROR_OK;
+}
+
+/**
+ * Console output of the current operation, to @a fd or to the debug
+ * channel. The output is collected host side and written on a newline,
+ * when the buffer is full, before any other semihosting operation or
+ * after SEMIHOSTING_CONSOLE_FLUSH_MS.
+ * @returns true if the output was taken, false if the caller must
+ * write it itself.
+ */
+static bool semihosting_console_write(struct semihosting *semihosting, int fd,
+	const uint8_t *buf, size_t size)
+{
+	int op = semihosting->op == SEMIHOSTING_SYS_WRITE ? SEMIHOSTING_SYS_WRITE : SEMIHOSTING_SYS_WRITE0;
+
+	if (!semihosting->batch_output)
+		return false;
+
+	if (semihosting->console_len &&
+			(semihosting->console_fd != fd || semihosting->console_op != op ||
+			 semihosting->console_len + size > SEMIHOSTING_CONSOLE_BUF_SIZE))
+		semihosting_console_flush(semihosting);
+
+	if (size > SEMIHOSTING_CONSOLE_BUF_SIZE)
+		return false;
+
+	memcpy(semihosting->console_buf + semihosting->console_len, buf, size);
+	semihosting->console_len += size;
+	semihosting->console_fd = fd;
+	semihosting->console_op = op;
+
+	if (memchr(buf, '\n', size)) {
+		semihosting_console_flush(semihosting);
+	} else if (semihosting->console_len && !semihosting->console_timer) {
+		if (target_register_timer_callback(semihosting_console_timer_callback,
+				SEMIHOSTING_CONSOLE_FLUSH_MS, TARGET_TIMER_TYPE_ONESHOT,
+				semihosting) == ERROR_OK)
+			semihosting->console_timer = true;
+		else
+			semihosting_console_flush(semihosting);
+	}
+
+	return true;
+}
+
+#define SEMIHOSTING_STRING_CHUNK	64
+#define SEMIHOSTING_STRING_BOUNDARY	1024
+
+/**
+ * Returns the number of bytes to read in the next chunk of a string at
+ * @a addr. A chunk never crosses a SEMIHOSTING_STRING_BOUNDARY boundary,
+ * so that reading past the terminating NUL stays in the memory region
+ * holding the string.
+ */
+static size_t semihosting_string_chunk(uint64_t addr, size_t chunk)
+{
+	return MIN(chunk, SEMIHOSTING_STRING_BOUNDARY - (addr & (SEMIHOSTING_STRING_BOUNDARY - 1)));
+}
+
+/**
+ * Writes the pending console output and frees the semihosting data of
+ * @a target.
+ */
+void semihosting_common_free(struct target *target)
+{
+	struct semihosting *semihosting = target->semihosting;
+
+	if (!semihosting)
+		return;
+
+	if (semihosting->console_timer)
+		target_unregister_timer_callback(semihosting_console_timer_callback, semihosting);
+	semihosting_console_flush(semihosting);
+
+	free(semihosting->basedir);
+	free(semihosting);
+	target->semihosting = NULL;
+}
+
 /**
  * User operation parameter string storage buffer. Contains valid data when the
  * TARGET_EVENT_SEMIHOSTING_USER_CMD_xxxxx event callbacks are running.
@@ -328,6 +451,12 @@ int semihosting_common(struct target *target)
 	LOG_DEBUG("op=0x%x, param=0x%" PRIx64, semihosting->op,
 		semihosting->param);
 
+	/* keep the buffered console output in order with the other operations */
+	if (semihosting->is_fileio || (semihosting->op != SEMIHOSTING_SYS_WRITEC &&
+			semihosting->op != SEMIHOSTING_SYS_WRITE0 &&
+			semihosting->op != SEMIHOSTING_SYS_WRITE))
+		semihosting_console_flush(semihosting);
+
 	switch (semihosting->op) {
 
 		case SEMIHOSTING_SYS_CLOCK:	/* 0x10 */
@@ -1322,8 +1451,15 @@ int semihosting_common(struct target *target)
 							free(buf);
 							return retval;
 						}
-						semihosting->result = semihosting_write(semihosting, fd, buf, len);
-						semihosting->sys_errno = errno;
+						if (fd >= 0 && (fd == semihosting->stdout_fd || fd == semihosting->stderr_fd) &&
+								semihosting_console_write(semihosting, fd, buf, len)) {
+							semihosting->result = len;
+							semihosting->sys_errno = 0;
+						} else {
+							semihosting_console_flush(semihosting);
+							semihosting->result = semihosting_write(semihosting, fd, buf, len);
+							semihosting->sys_errno = errno;
+						}
 						LOG_DEBUG("write(%d, 0x%" PRIx64 ", %zu)=%" PRId64,
 							fd,
 							addr,
@@ -1367,7 +1503,8 @@ int semihosting_common(struct target *target)
 				retval = target_read_memory(target, addr, 1, 1, &c);
 				if (retval != ERROR_OK)
 					return retval;
-				semihosting_putchar(semihosting, semihosting->stdout_fd, c);
+				if (!semihosting_console_write(semihosting, semihosting->stdout_fd, &c, 1))
+					semihosting_putchar(semihosting, semihosting->stdout_fd, c);
 				semihosting->result = 0;
 			}
 			break;
@@ -1385,36 +1522,57 @@ int semihosting_common(struct target *target)
 			 * Return
 			 * None. The RETURN REGISTER is corrupted.
 			 */
-			if (semihosting->is_fileio) {
-				size_t count = 0;
-				uint64_t addr = semihosting->param;
-				for (;; addr++) {
-					unsigned char c;
-					retval = target_read_memory(target, addr, 1, 1, &c);
-					if (retval != ERROR_OK)
-						return retval;
-					if (c == '\0')
-						break;
-					count++;
+		{
+			/* The string is fetched in chunks growing up to the
+			 * SEMIHOSTING_STRING_BOUNDARY, not a byte at a time. A chunk
+			 * may run past the end of the string into memory that cannot
+			 * be read, the string is then read a byte at a time. */
+			uint8_t chunk_buf[SEMIHOSTING_STRING_BOUNDARY];
+			size_t chunk = SEMIHOSTING_STRING_CHUNK;
+			size_t count = 0;
+			uint64_t addr = semihosting->param;
+			bool done = false;
+
+			while (!done) {
+				size_t n = semihosting_string_chunk(addr, chunk);
+				retval = target_read_buffer(target, addr, n, chunk_buf);
+				if (retval != ERROR_OK && n > 1) {
+					LOG_DEBUG("reading the string at 0x%" PRIx64 " a byte at a time", addr);
+					chunk = 1;
+					continue;
+				}
+				if (retval != ERROR_OK)
+					return retval;
+
+				uint8_t *nul = memchr(chunk_buf, '\0', n);
+				if (nul) {
+					n = nul - chunk_buf;
+					done = true;
+				}
+
+				if (!semihosting->is_fileio) {
+					if (!semihosting_console_write(semihosting, semihosting->stdout_fd, chunk_buf, n)) {
+						for (size_t i = 0; i < n; i++)
+							semihosting_putchar(semihosting, semihosting->stdout_fd, chunk_buf[i]);
+					}
 				}
+
+				count += n;
+				addr += n;
+				if (chunk > 1)
+					chunk = MIN(2 * chunk, SEMIHOSTING_STRING_BOUNDARY);
+			}
+
+			if (semihosting->is_fileio) {
 				semihosting->hit_fileio = true;
 				fileio_info->identifier = "write";
 				fileio_info->param_1 = 1;
 				fileio_info->param_2 = semihosting->param;
 				fileio_info->param_3 = count;
 			} else {
-				uint64_t addr = semihosting->param;
-				do {
-					unsigned char c;
-					retval = target_read_memory(target, addr++, 1, 1, &c);
-					if (retval != ERROR_OK)
-						return retval;
-					if (!c)
-						break;
-					semihosting_putchar(semihosting, semihosting->stdout_fd, c);
-				} while (1);
 				semihosting->result = 0;
 			}
+		}
 			break;
 
 		case SEMIHOSTING_USER_CMD_0X100 ... SEMIHOSTING_USER_CMD_0X107:
@@ -1789,6 +1947,7 @@ COMMAND_HANDLER(handle_common_semihosting_command)
 
 		/* FIXME never let that "catch" be dropped! (???) */
 		semihosting->is_active = is_active;
+		semihosting_console_flush(semihosting);
 	}
 
 	command_print(CMD, "semihosting is %s",
@@ -1824,6 +1983,8 @@ COMMAND_HANDLER(handle_common_semihosting_redirect_command)
 	if (CMD_ARGC < 1)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
+	semihosting_console_flush(semihosting);
+
 	if (strcmp(CMD_ARGV[0], "disable") == 0) {
 		cfg = SEMIHOSTING_REDIRECT_CFG_NONE;
 		if (CMD_ARGC > 1)
@@ -1976,6 +2137,37 @@ COMMAND_HANDLER(handle_common_semihosting_resumable_exit_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_common_semihosting_batch_output_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!target) {
+		LOG_ERROR("No target selected");
+		return ERROR_FAIL;
+	}
+
+	struct semihosting *semihosting = target->semihosting;
+	if (!semihosting) {
+		command_print(CMD, "semihosting not supported for current target");
+		return ERROR_FAIL;
+	}
+
+	if (CMD_ARGC > 0) {
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], semihosting->batch_output);
+		if (!semihosting->batch_output)
+			semihosting_console_flush(semihosting);
+	}
+
+	command_print(CMD, "semihosting batched console output is %s",
+		semihosting->batch_output
+		? "enabled" : "disabled");
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_common_semihosting_read_user_param_command)
 {
 	struct target *target = get_current_target(CMD_CTX);
@@ -2074,6 +2266,13 @@ const struct command_registration semihosting_common_handlers[] = {
 		.usage = "['enable'|'disable']",
 		.help = "activate support for semihosting resumable exit",
 	},
+	{
+		.name = "semihosting_batch_output",
+		.handler = handle_common_semihosting_batch_output_command,
+		.mode = COMMAND_EXEC,
+		.usage = "['enable'|'disable']",
+		.help = "collect the semihosting console output and write it by lines",
+	},
 	{
 		.name = "semihosting_read_user_param",
 		.handler = handle_common_semihosting_read_user_param_command,
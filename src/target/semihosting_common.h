@@ -73,6 +73,12 @@ enum semihosting_operation_numbers {
 /** Maximum allowed Tcl command segment length in bytes*/
 #define SEMIHOSTING_MAX_TCL_COMMAND_FIELD_LENGTH (1024 * 1024)
 
+/** Size of the host side buffer batching the console output */
+#define SEMIHOSTING_CONSOLE_BUF_SIZE 4096
+
+/** Delay after which a partial line of console output is written */
+#define SEMIHOSTING_CONSOLE_FLUSH_MS 50
+
 /*
  * Codes used by SEMIHOSTING_SYS_EXIT (formerly
  * SEMIHOSTING_REPORT_EXCEPTION).
@@ -175,6 +181,24 @@ struct semihosting {
 	/** Base directory for semihosting I/O operations. */
 	char *basedir;
 
+	/**
+	 * When set, the console output (WRITEC, WRITE0 and WRITE to the
+	 * ':tt' handles) is collected host side and written line by line,
+	 * instead of one write per call or per character.
+	 */
+	bool batch_output;
+
+	/** Console output not written yet, all for the same handle. */
+	uint8_t console_buf[SEMIHOSTING_CONSOLE_BUF_SIZE];
+	size_t console_len;
+
+	/** Handle and operation of the buffered console output. */
+	int console_fd;
+	int console_op;
+
+	/** A flush of the partial line in console_buf is scheduled. */
+	bool console_timer;
+
 	/**
 	 * Target's extension of semihosting user commands.
 	 * @returns ERROR_NOT_IMPLEMENTED when user command is not handled, otherwise
@@ -189,6 +213,7 @@ struct semihosting {
 int semihosting_common_init(struct target *target, void *setup,
 	void *post_result);
 int semihosting_common(struct target *target);
+void semihosting_common_free(struct target *target);
 
 /* utility functions which may also be used by semihosting extensions (custom vendor-defined syscalls) */
 int semihosting_read_fields(struct target *target, size_t number,
@@ -31,6 +31,8 @@
 #endif
 
 #include <helper/align.h>
+#include <helper/bits.h>
+#include <helper/memscan.h>
 #include <helper/time_support.h>
 #include <jtag/jtag.h>
 #include <flash/nor/core.h>
@@ -162,6 +164,8 @@ static LIST_HEAD(target_trace_callback_list);
 static const int polling_interval = TARGET_DEFAULT_POLLING_INTERVAL;
 static LIST_HEAD(empty_smp_targets);
 
+extern int gdb_actual_connections;
+
 static const struct jim_nvp nvp_assert[] = {
 	{ .name = "assert", NVP_ASSERT },
 	{ .name = "deassert", NVP_DEASSERT },
@@ -554,6 +558,263 @@ struct target *get_current_target_or_null(struct command_context *cmd_ctx)
 		: cmd_ctx->current_target;
 }
 
+/*
+ * Saved content of the whole working area, tracked in words.
+ *
+ * Only the words that are actually modified while an area is allocated,
+ * either written by the host or possibly written by code running on the
+ * target, are marked dirty and restored, in as few transfers as possible.
+ * In lazy mode the original content is only read on first use, is kept
+ * across allocations, and the restore is deferred until no area is left
+ * allocated or the freed memory is accessed.
+ */
+struct working_area_backup {
+	target_addr_t address;
+	unsigned int num_words;
+	uint8_t *data;
+	unsigned long *saved;	/* words whose original content is in data */
+	unsigned long *dirty;	/* saved words that may have been modified since */
+};
+
+static int target_wa_backup_create(struct target *target, target_addr_t address, uint32_t size)
+{
+	struct working_area_backup *b = calloc(1, sizeof(*b));
+	if (!b)
+		return ERROR_FAIL;
+
+	b->address = address;
+	b->num_words = size / 4;
+	b->data = malloc(size);
+	b->saved = calloc(BITS_TO_LONGS(b->num_words), sizeof(unsigned long));
+	b->dirty = calloc(BITS_TO_LONGS(b->num_words), sizeof(unsigned long));
+	if (!b->data || !b->saved || !b->dirty) {
+		free(b->data);
+		free(b->saved);
+		free(b->dirty);
+		free(b);
+		return ERROR_FAIL;
+	}
+
+	target->working_area_backup = b;
+	return ERROR_OK;
+}
+
+static void target_wa_backup_free(struct target *target)
+{
+	struct working_area_backup *b = target->working_area_backup;
+
+	if (!b)
+		return;
+
+	free(b->data);
+	free(b->saved);
+	free(b->dirty);
+	free(b);
+	target->working_area_backup = NULL;
+}
+
+/* first word from i on, up to last, whose bit in map is not value */
+static unsigned int target_wa_backup_run_end(const unsigned long *map, bool value,
+		unsigned int i, unsigned int last)
+{
+	while (i < last && !!test_bit(i, map) == value)
+		i++;
+	return i;
+}
+
+/* read the original content of the words not saved yet */
+static int target_wa_backup_save(struct target *target, unsigned int first, unsigned int last)
+{
+	struct working_area_backup *b = target->working_area_backup;
+	unsigned int i = first;
+
+	while (i < last) {
+		i = target_wa_backup_run_end(b->saved, true, i, last);
+		unsigned int end = target_wa_backup_run_end(b->saved, false, i, last);
+		if (i == end)
+			break;
+
+		int retval = target->type->read_memory(target, b->address + 4 * i,
+				4, end - i, b->data + 4 * i);
+		if (retval != ERROR_OK)
+			return retval;
+
+		for (; i < end; i++)
+			set_bit(i, b->saved);
+	}
+
+	return ERROR_OK;
+}
+
+/* write back the saved content of the dirty words */
+static int target_wa_backup_restore(struct target *target, unsigned int first, unsigned int last)
+{
+	struct working_area_backup *b = target->working_area_backup;
+	unsigned int i = first;
+
+	while (i < last) {
+		i = target_wa_backup_run_end(b->dirty, false, i, last);
+		unsigned int end = target_wa_backup_run_end(b->dirty, true, i, last);
+		if (i == end)
+			break;
+
+		int retval = target->type->write_memory(target, b->address + 4 * i,
+				4, end - i, b->data + 4 * i);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("failed to restore %u bytes of working area at address " TARGET_ADDR_FMT,
+					4 * (end - i), b->address + 4 * i);
+			return retval;
+		}
+
+		for (; i < end; i++)
+			clear_bit(i, b->dirty);
+	}
+
+	return ERROR_OK;
+}
+
+static int target_wa_backup_modify(struct target *target, unsigned int first, unsigned int last)
+{
+	struct working_area_backup *b = target->working_area_backup;
+
+	int retval = target_wa_backup_save(target, first, last);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (unsigned int i = first; i < last; i++)
+		set_bit(i, b->dirty);
+
+	return ERROR_OK;
+}
+
+/* forget the saved content, after the memory was changed on purpose */
+static int target_wa_backup_discard(struct target *target, unsigned int first, unsigned int last)
+{
+	struct working_area_backup *b = target->working_area_backup;
+
+	for (unsigned int i = first; i < last; i++) {
+		clear_bit(i, b->saved);
+		clear_bit(i, b->dirty);
+	}
+
+	return ERROR_OK;
+}
+
+/* restore, then forget the saved content */
+static int target_wa_backup_release(struct target *target, unsigned int first, unsigned int last)
+{
+	int retval = target_wa_backup_restore(target, first, last);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return target_wa_backup_discard(target, first, last);
+}
+
+typedef int (*target_wa_backup_op)(struct target *target, unsigned int first, unsigned int last);
+
+/*
+ * Apply op_alloc to the words of [address, address + size) that belong to
+ * allocated areas, and op_free to the ones that belong to free areas.
+ */
+static int target_wa_backup_apply(struct target *target, target_addr_t address, uint64_t size,
+		target_wa_backup_op op_alloc, target_wa_backup_op op_free)
+{
+	struct working_area_backup *b = target->working_area_backup;
+
+	if (!b)
+		return ERROR_OK;
+
+	for (struct working_area *c = target->working_areas; c; c = c->next) {
+		target_wa_backup_op op = c->free ? op_free : op_alloc;
+		if (!op)
+			continue;
+
+		target_addr_t start = MAX(address, c->address);
+		uint64_t end = MIN(address + size, (uint64_t)c->address + c->size);
+		if (start >= end)
+			continue;
+
+		int retval = op(target, (start - b->address) / 4,
+				DIV_ROUND_UP(end - b->address, 4));
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return ERROR_OK;
+}
+
+/* the host is going to write to the memory */
+static int target_wa_backup_write(struct target *target, target_addr_t address, uint64_t size)
+{
+	return target_wa_backup_apply(target, address, size,
+			target_wa_backup_modify, target_wa_backup_release);
+}
+
+/* the host is going to read the memory */
+static int target_wa_backup_read(struct target *target, target_addr_t address, uint64_t size)
+{
+	return target_wa_backup_apply(target, address, size,
+			NULL, target_wa_backup_restore);
+}
+
+/* code is going to run on the target */
+static int target_wa_backup_run(struct target *target, bool debug_execution)
+{
+	/* helper algorithms and debug execution may modify any allocated
+	 * area, while firmware may modify the free areas too */
+	return target_wa_backup_apply(target, 0, UINT64_MAX,
+			debug_execution ? target_wa_backup_modify : NULL,
+			debug_execution ? NULL : target_wa_backup_release);
+}
+
+/* the working area is at a physical address */
+static bool target_wa_backup_phys(struct target *target)
+{
+	return target->working_area_backup && target->working_area_phys_spec
+		&& target->working_area == target->working_area_phys;
+}
+
+static int handle_target(void *priv);
+static int handle_target_run(Jim_Interp *interp, bool early);
+
+/* interpreter of the background polling, set by target_init() */
+static Jim_Interp *handle_target_interp;
+static bool handle_target_early_pending;
+
+static int handle_target_early(void *priv)
+{
+	handle_target_early_pending = false;
+	return handle_target_run(priv, true);
+}
+
+/*
+ * The background polling runs every polling_interval. While a running
+ * target is due sooner than that, e.g. right after it was resumed, an
+ * extra run is scheduled for it.
+ */
+static void target_poll_schedule(int64_t next)
+{
+	if (handle_target_early_pending || !handle_target_interp)
+		return;
+
+	int64_t delay = next - timeval_ms();
+	if (delay >= polling_interval)
+		return;
+
+	if (target_register_timer_callback(&handle_target_early,
+			MAX(delay, TARGET_MIN_POLLING_INTERVAL), TARGET_TIMER_TYPE_ONESHOT,
+			handle_target_interp) == ERROR_OK)
+		handle_target_early_pending = true;
+}
+
+/* let the background polling look at the target on its next run */
+static void target_poll_soon(struct target *target)
+{
+	target->poll_sched.interval = TARGET_MIN_POLLING_INTERVAL;
+	target->poll_sched.next = 0;
+	target_poll_schedule(0);
+}
+
 int target_poll(struct target *target)
 {
 	int retval;
@@ -599,6 +860,7 @@ int target_halt(struct target *target)
 
 	target->halt_issued = true;
 	target->halt_issued_time = timeval_ms();
+	target_poll_soon(target);
 
 	return ERROR_OK;
 }
@@ -646,6 +908,13 @@ int target_resume(struct target *target, int current, target_addr_t address,
 
 	target_call_event_callbacks(target, TARGET_EVENT_RESUME_START);
 
+	/* an algorithm already marked all the allocated areas */
+	if (!target->running_alg) {
+		retval = target_wa_backup_run(target, debug_execution);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
 	/* note that resume *must* be asynchronous. The CPU can halt before
 	 * we poll. The CPU can even halt at the current PC as a result of
 	 * a software breakpoint being inserted by (a bug?) the application.
@@ -665,6 +934,7 @@ int target_resume(struct target *target, int current, target_addr_t address,
 	if (retval != ERROR_OK)
 		return retval;
 
+	target_poll_soon(target);
 	target_call_event_callbacks(target, TARGET_EVENT_RESUME_END);
 
 	return retval;
@@ -863,6 +1133,10 @@ int target_run_algorithm(struct target *target,
 		goto done;
 	}
 
+	retval = target_wa_backup_run(target, true);
+	if (retval != ERROR_OK)
+		goto done;
+
 	target->running_alg = true;
 	retval = target->type->run_algorithm(target,
 			num_mem_params, mem_params,
@@ -908,6 +1182,10 @@ int target_start_algorithm(struct target *target,
 		goto done;
 	}
 
+	retval = target_wa_backup_run(target, true);
+	if (retval != ERROR_OK)
+		goto done;
+
 	target->running_alg = true;
 	retval = target->type->start_algorithm(target,
 			num_mem_params, mem_params,
@@ -1316,6 +1594,11 @@ int target_read_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support read_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+
+	int retval = target_wa_backup_read(target, address, (uint64_t)size * count);
+	if (retval != ERROR_OK)
+		return retval;
+
 	return target->type->read_memory(target, address, size, count, buffer);
 }
 
@@ -1330,6 +1613,13 @@ int target_read_phys_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support read_phys_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+
+	if (target_wa_backup_phys(target)) {
+		int retval = target_wa_backup_read(target, address, (uint64_t)size * count);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
 	return target->type->read_phys_memory(target, address, size, count, buffer);
 }
 
@@ -1344,6 +1634,11 @@ int target_write_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+
+	int retval = target_wa_backup_write(target, address, (uint64_t)size * count);
+	if (retval != ERROR_OK)
+		return retval;
+
 	return target->type->write_memory(target, address, size, count, buffer);
 }
 
@@ -1358,6 +1653,13 @@ int target_write_phys_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_phys_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+
+	if (target_wa_backup_phys(target)) {
+		int retval = target_wa_backup_write(target, address, (uint64_t)size * count);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
 	return target->type->write_phys_memory(target, address, size, count, buffer);
 }
 
@@ -1469,6 +1771,34 @@ int target_get_gdb_reg_list_noread(struct target *target,
 	return target_get_gdb_reg_list(target, reg_list, reg_list_size, reg_class);
 }
 
+int target_read_registers(struct target *target, struct reg **reg_list,
+		int reg_count)
+{
+	if (!target->type->read_registers || reg_count <= 0)
+		return ERROR_OK;
+
+	if (target->state != TARGET_HALTED)
+		return ERROR_TARGET_NOT_HALTED;
+
+	return target->type->read_registers(target, reg_list, reg_count);
+}
+
+int target_sample_pc(struct target *target, uint32_t *samples,
+		uint32_t max_num_samples, uint32_t *num_samples)
+{
+	*num_samples = 0;
+
+	if (!target->type->sample_pc)
+		return ERROR_NOT_IMPLEMENTED;
+
+	if (!target_was_examined(target)) {
+		LOG_ERROR("Target not examined yet");
+		return ERROR_FAIL;
+	}
+
+	return target->type->sample_pc(target, samples, max_num_samples, num_samples);
+}
+
 bool target_supports_gdb_connection(struct target *target)
 {
 	/*
@@ -1485,10 +1815,15 @@ int target_step(struct target *target,
 
 	target_call_event_callbacks(target, TARGET_EVENT_STEP_START);
 
+	retval = target_wa_backup_run(target, false);
+	if (retval != ERROR_OK)
+		return retval;
+
 	retval = target->type->step(target, current, address, handle_breakpoints);
 	if (retval != ERROR_OK)
 		return retval;
 
+	target_poll_soon(target);
 	target_call_event_callbacks(target, TARGET_EVENT_STEP_END);
 
 	return retval;
@@ -1542,8 +1877,6 @@ static int target_profiling(struct target *target, uint32_t *samples,
 			num_samples, seconds);
 }
 
-static int handle_target(void *priv);
-
 static int target_init_one(struct command_context *cmd_ctx,
 		struct target *target)
 {
@@ -1626,6 +1959,7 @@ static int target_init(struct command_context *cmd_ctx)
 			polling_interval, TARGET_TIMER_TYPE_PERIODIC, cmd_ctx->interp);
 	if (retval != ERROR_OK)
 		return retval;
+	handle_target_interp = cmd_ctx->interp;
 
 	return ERROR_OK;
 }
@@ -1823,7 +2157,8 @@ int target_unregister_timer_callback(int (*callback)(void *priv), void *priv)
 
 	for (struct target_timer_callback *c = target_timer_callbacks;
 	     c; c = c->next) {
-		if ((c->callback == callback) && (c->priv == priv)) {
+		/* skip the entries already removed but not freed yet */
+		if (!c->removed && (c->callback == callback) && (c->priv == priv)) {
 			c->removed = true;
 			return ERROR_OK;
 		}
@@ -1895,7 +2230,9 @@ static int target_call_timer_callback(struct target_timer_callback *cb,
 	if (cb->type == TARGET_TIMER_TYPE_PERIODIC)
 		return target_timer_callback_periodic_restart(cb, now);
 
-	return target_unregister_timer_callback(cb->callback, cb->priv);
+	/* not by callback and priv, the callback may have registered itself again */
+	cb->removed = true;
+	return ERROR_OK;
 }
 
 static int target_call_timer_callbacks_check_time(int checktime)
@@ -1969,7 +2306,7 @@ static void print_wa_layout(struct target *target)
 
 	while (c) {
 		LOG_DEBUG("%c%c " TARGET_ADDR_FMT "-" TARGET_ADDR_FMT " (%" PRIu32 " bytes)",
-			c->backup ? 'b' : ' ', c->free ? ' ' : '*',
+			target->working_area_backup ? 'b' : ' ', c->free ? ' ' : '*',
 			c->address, c->address + c->size - 1, c->size);
 		c = c->next;
 	}
@@ -1991,17 +2328,11 @@ static void target_split_working_area(struct working_area *area, uint32_t size)
 		new_wa->next = area->next;
 		new_wa->size = area->size - size;
 		new_wa->address = area->address + size;
-		new_wa->backup = NULL;
 		new_wa->user = NULL;
 		new_wa->free = true;
 
 		area->next = new_wa;
 		area->size = size;
-
-		/* If backup memory was allocated to this area, it has the wrong size
-		 * now so free it and it will be reallocated if/when needed */
-		free(area->backup);
-		area->backup = NULL;
 	}
 }
 
@@ -2021,13 +2352,7 @@ static void target_merge_working_areas(struct target *target)
 			/* Remove the last */
 			struct working_area *to_be_freed = c->next;
 			c->next = c->next->next;
-			free(to_be_freed->backup);
 			free(to_be_freed);
-
-			/* If backup memory was allocated to the remaining area, it's has
-			 * the wrong size now */
-			free(c->backup);
-			c->backup = NULL;
 		} else {
 			c = c->next;
 		}
@@ -2075,9 +2400,14 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 			new_wa->next = NULL;
 			new_wa->size = ALIGN_DOWN(target->working_area_size, 4); /* 4-byte align */
 			new_wa->address = target->working_area;
-			new_wa->backup = NULL;
 			new_wa->user = NULL;
 			new_wa->free = true;
+
+			if (target->backup_working_area != TARGET_WA_BACKUP_OFF
+					&& target_wa_backup_create(target, new_wa->address, new_wa->size) != ERROR_OK) {
+				free(new_wa);
+				return ERROR_FAIL;
+			}
 		}
 
 		target->working_areas = new_wa;
@@ -2104,14 +2434,14 @@ int target_alloc_working_area_try(struct target *target, uint32_t size, struct w
 	LOG_DEBUG("allocated new working area of %" PRIu32 " bytes at address " TARGET_ADDR_FMT,
 			  size, c->address);
 
-	if (target->backup_working_area) {
-		if (!c->backup) {
-			c->backup = malloc(c->size);
-			if (!c->backup)
-				return ERROR_FAIL;
-		}
+	if (target->backup_working_area == TARGET_WA_BACKUP_ON) {
+		struct working_area_backup *b = target->working_area_backup;
+		unsigned int first = (c->address - b->address) / 4;
+		unsigned int last = first + c->size / 4;
 
-		int retval = target_read_memory(target, c->address, 4, c->size / 4, c->backup);
+		/* take a fresh copy of the area content */
+		target_wa_backup_discard(target, first, last);
+		int retval = target_wa_backup_save(target, first, last);
 		if (retval != ERROR_OK)
 			return retval;
 	}
@@ -2141,16 +2471,21 @@ int target_alloc_working_area(struct target *target, uint32_t size, struct worki
 
 static int target_restore_working_area(struct target *target, struct working_area *area)
 {
-	int retval = ERROR_OK;
+	struct working_area_backup *b = target->working_area_backup;
 
-	if (target->backup_working_area && area->backup) {
-		retval = target_write_memory(target, area->address, 4, area->size / 4, area->backup);
-		if (retval != ERROR_OK)
-			LOG_ERROR("failed to restore %" PRIu32 " bytes of working area at address " TARGET_ADDR_FMT,
-					area->size, area->address);
+	if (!b)
+		return ERROR_OK;
+
+	/* the restore of the free areas is done once all are free */
+	if (target->backup_working_area == TARGET_WA_BACKUP_LAZY) {
+		for (struct working_area *c = target->working_areas; c; c = c->next)
+			if (c != area && !c->free)
+				return ERROR_OK;
+		return target_wa_backup_restore(target, 0, b->num_words);
 	}
 
-	return retval;
+	unsigned int first = (area->address - b->address) / 4;
+	return target_wa_backup_restore(target, first, first + area->size / 4);
 }
 
 /* Restore the area's backup memory, if any, and return the area to the allocation pool */
@@ -2203,8 +2538,6 @@ static void target_free_all_working_areas_restore(struct target *target, int res
 	/* Loop through all areas, restoring the allocated ones and marking them as free */
 	while (c) {
 		if (!c->free) {
-			if (restore)
-				target_restore_working_area(target, c);
 			c->free = true;
 			*c->user = NULL; /* Same as above */
 			c->user = NULL;
@@ -2212,6 +2545,14 @@ static void target_free_all_working_areas_restore(struct target *target, int res
 		c = c->next;
 	}
 
+	/* restore all the modified words, including deferred restores */
+	struct working_area_backup *b = target->working_area_backup;
+	if (b) {
+		if (restore)
+			target_wa_backup_restore(target, 0, b->num_words);
+		target_wa_backup_discard(target, 0, b->num_words);
+	}
+
 	/* Run a merge pass to combine all areas into one */
 	target_merge_working_areas(target);
 
@@ -2225,10 +2566,10 @@ void target_free_all_working_areas(struct target *target)
 	/* Now we have none or only one working area marked as free */
 	if (target->working_areas) {
 		/* Free the last one to allow on-the-fly moving and resizing */
-		free(target->working_areas->backup);
 		free(target->working_areas);
 		target->working_areas = NULL;
 	}
+	target_wa_backup_free(target);
 }
 
 /* Find the largest number of bytes that can be allocated */
@@ -2255,9 +2596,7 @@ static void target_destroy(struct target *target)
 	if (target->type->deinit_target)
 		target->type->deinit_target(target);
 
-	if (target->semihosting)
-		free(target->semihosting->basedir);
-	free(target->semihosting);
+	semihosting_common_free(target);
 
 	jtag_unregister_event_callback(jtag_enable_callback, target);
 
@@ -2288,6 +2627,7 @@ static void target_destroy(struct target *target)
 	rtos_destroy(target);
 
 	free(target->gdb_port_override);
+	free(target->gdb_expedited_regs);
 	free(target->type);
 	free(target->trace_info);
 	free(target->fileio_info);
@@ -2428,6 +2768,10 @@ int target_write_buffer(struct target *target, target_addr_t address, uint32_t s
 		return ERROR_FAIL;
 	}
 
+	int retval = target_wa_backup_write(target, address, size);
+	if (retval != ERROR_OK)
+		return retval;
+
 	return target->type->write_buffer(target, address, size, buffer);
 }
 
@@ -2493,6 +2837,10 @@ int target_read_buffer(struct target *target, target_addr_t address, uint32_t si
 		return ERROR_FAIL;
 	}
 
+	int retval = target_wa_backup_read(target, address, size);
+	if (retval != ERROR_OK)
+		return retval;
+
 	return target->type->read_buffer(target, address, size, buffer);
 }
 
@@ -2974,10 +3322,126 @@ static int sense_handler(void)
 	return ERROR_OK;
 }
 
-/* process target state changes */
+/*
+ * Polling interval after a successful poll: back off exponentially while
+ * the target keeps running, but not beyond the default interval while a
+ * GDB client may be waiting for it to halt.
+ */
+static int target_poll_next_interval(struct target *target)
+{
+	int interval = target->poll_sched.interval;
+
+	if (target->state != TARGET_RUNNING && target->state != TARGET_DEBUG_RUNNING)
+		return polling_interval;
+
+	int max_interval = gdb_actual_connections ? polling_interval : TARGET_MAX_POLLING_INTERVAL;
+	interval = MAX(2 * interval, TARGET_MIN_POLLING_INTERVAL);
+	return MIN(interval, max_interval);
+}
+
+static bool target_poll_due(struct target *target, int64_t now)
+{
+	return now >= target->poll_sched.next;
+}
+
+static bool target_poll_running(struct target *target)
+{
+	return target->state == TARGET_RUNNING || target->state == TARGET_DEBUG_RUNNING;
+}
+
+/*
+ * A target is also polled ahead of time, if less than half of its interval
+ * is left and another target on the same TAP is due, so that the polls of
+ * the cores of one debug port run back to back.
+ */
+static bool target_poll_tap_due(struct target *target, int64_t now)
+{
+	if (now < target->poll_sched.next - target->poll_sched.interval / 2)
+		return false;
+
+	for (struct target *t = all_targets; t; t = t->next) {
+		if (t != target && t->tap == target->tap && target_was_examined(t)
+				&& target_poll_due(t, now))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * A target that is not running is polled on every periodic run, unless it
+ * is backing off after a failed poll, and on an early run only if
+ * target_poll_soon() asked for it. A running target follows its schedule.
+ */
+static bool target_poll_is_due(struct target *target, int64_t now, bool early)
+{
+	if (target->poll_sched.next == 0)
+		return true;
+
+	if (!target_poll_running(target))
+		return !early && (target->backoff.times == 0 || target_poll_due(target, now));
+
+	return target_poll_due(target, now) || target_poll_tap_due(target, now);
+}
+
+static bool target_poll_prefetchable(struct target *target)
+{
+	return target->type->poll_prefetch && target_was_examined(target)
+		&& target->tap->enabled && target->poll_sched.due;
+}
+
+/*
+ * Let each target type read ahead the state of all its due targets at once,
+ * e.g. queue the status reads of all the cores behind one debug port and
+ * run them in a single adapter round trip.
+ */
+static void target_poll_prefetch(void)
+{
+	unsigned int num_targets = 0;
+	for (struct target *target = all_targets; target; target = target->next)
+		num_targets++;
+
+	struct target **targets = malloc(num_targets * sizeof(*targets));
+	if (!targets)
+		return;
+
+	for (struct target *first = all_targets; first; first = first->next) {
+		if (!target_poll_prefetchable(first))
+			continue;
+
+		/* each type once, starting at its first due target */
+		struct target *t;
+		for (t = all_targets; t != first; t = t->next)
+			if (target_poll_prefetchable(t) && t->type->poll_prefetch == first->type->poll_prefetch)
+				break;
+		if (t != first)
+			continue;
+
+		unsigned int count = 0;
+		for (t = first; t; t = t->next)
+			if (target_poll_prefetchable(t) && t->type->poll_prefetch == first->type->poll_prefetch)
+				targets[count++] = t;
+
+		first->type->poll_prefetch(targets, count);
+	}
+
+	free(targets);
+}
+
+static void target_poll_prefetch_discard(void)
+{
+	for (struct target *target = all_targets; target; target = target->next)
+		target->poll_sched.prefetched = false;
+}
+
 static int handle_target(void *priv)
 {
-	Jim_Interp *interp = (Jim_Interp *)priv;
+	return handle_target_run(priv, false);
+}
+
+/* process target state changes */
+static int handle_target_run(Jim_Interp *interp, bool early)
+{
 	int retval = ERROR_OK;
 
 	if (!is_jtag_poll_safe()) {
@@ -2985,10 +3449,15 @@ static int handle_target(void *priv)
 		return ERROR_OK;
 	}
 
+	/* the scheduler runs more often than the power and reset sensing */
+	int64_t now = timeval_ms();
+	static int64_t next_sense;
+
 	/* we do not want to recurse here... */
 	static int recursive;
-	if (!recursive) {
+	if (!recursive && now >= next_sense) {
 		recursive = 1;
+		next_sense = now + polling_interval;
 		sense_handler();
 		/* danger! running these procedures can trigger srst assertions and power dropouts.
 		 * We need to avoid an infinite loop/recursion here and we do that by
@@ -3030,8 +3499,14 @@ static int handle_target(void *priv)
 	}
 
 	/* Poll targets for state changes unless that's globally disabled.
-	 * Skip targets that are currently disabled.
+	 * Skip targets that are currently disabled or not due yet.
 	 */
+	for (struct target *target = all_targets; target; target = target->next)
+		target->poll_sched.due = target_poll_is_due(target, now, early);
+
+	if (is_jtag_poll_safe() && !power_dropout && !srst_asserted)
+		target_poll_prefetch();
+
 	for (struct target *target = all_targets;
 			is_jtag_poll_safe() && target;
 			target = target->next) {
@@ -3042,23 +3517,23 @@ static int handle_target(void *priv)
 		if (!target->tap->enabled)
 			continue;
 
-		if (target->backoff.times > target->backoff.count) {
-			/* do not poll this time as we failed previously */
-			target->backoff.count++;
+		if (!target->poll_sched.due)
 			continue;
-		}
-		target->backoff.count = 0;
 
 		/* only poll target if we've got power and srst isn't asserted */
 		if (!power_dropout && !srst_asserted) {
 			/* polling may fail silently until the target has been examined */
 			retval = target_poll(target);
+			target->poll_sched.prefetched = false;
 			if (retval != ERROR_OK) {
 				/* 100ms polling interval. Increase interval between polling up to 5000ms */
 				if (target->backoff.times * polling_interval < 5000) {
 					target->backoff.times *= 2;
 					target->backoff.times++;
 				}
+				/* do not poll again before the back off time elapsed */
+				target->poll_sched.interval = (target->backoff.times + 1) * polling_interval;
+				target->poll_sched.next = now + target->poll_sched.interval;
 
 				/* Tell GDB to halt the debugger. This allows the user to
 				 * run monitor commands to handle the situation.
@@ -3075,15 +3550,27 @@ static int handle_target(void *priv)
 					target_set_examined(target);
 					LOG_USER("Examination failed, GDB will be halted. Polling again in %dms",
 						 target->backoff.times * polling_interval);
+					target_poll_prefetch_discard();
 					return retval;
 				}
 			}
 
 			/* Since we succeeded, we reset backoff count */
 			target->backoff.times = 0;
+			target->poll_sched.interval = target_poll_next_interval(target);
+			target->poll_sched.next = timeval_ms() + target->poll_sched.interval;
 		}
 	}
 
+	target_poll_prefetch_discard();
+
+	/* run again early if a running target is due before the next periodic run */
+	int64_t next = INT64_MAX;
+	for (struct target *target = all_targets; target; target = target->next)
+		if (target_was_examined(target) && target->tap->enabled && target_poll_running(target))
+			next = MIN(next, target->poll_sched.next);
+	target_poll_schedule(next);
+
 	return retval;
 }
 
@@ -3098,6 +3585,23 @@ COMMAND_HANDLER(handle_reg_command)
 	if (CMD_ARGC == 0) {
 		struct reg_cache *cache = target->reg_cache;
 
+		/* refresh the invalid registers of each cache in one batch so
+		 * that the listing shows their values */
+		if (target->state == TARGET_HALTED) {
+			for (cache = target->reg_cache; cache; cache = cache->next) {
+				if (!cache->num_regs)
+					continue;
+				struct reg **reg_list = malloc(cache->num_regs * sizeof(struct reg *));
+				if (!reg_list)
+					break;
+				for (unsigned int i = 0; i < cache->num_regs; i++)
+					reg_list[i] = &cache->reg_list[i];
+				target_read_registers(target, reg_list, cache->num_regs);
+				free(reg_list);
+			}
+			cache = target->reg_cache;
+		}
+
 		unsigned int count = 0;
 		while (cache) {
 			unsigned i;
@@ -3897,23 +4401,22 @@ static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode ver
 
 				retval = target_read_buffer(target, image.sections[i].base_address, buf_cnt, data);
 				if (retval == ERROR_OK) {
-					uint32_t t;
-					for (t = 0; t < buf_cnt; t++) {
-						if (data[t] != buffer[t]) {
-							command_print(CMD,
-										  "diff %d address 0x%08x. Was 0x%02x instead of 0x%02x",
-										  diffs,
-										  (unsigned)(t + image.sections[i].base_address),
-										  data[t],
-										  buffer[t]);
-							if (diffs++ >= 127) {
-								command_print(CMD, "More than 128 errors, the rest are not printed.");
-								free(data);
-								free(buffer);
-								goto done;
-							}
+					size_t t = 0;
+					while ((t += memscan_first_mismatch(data + t, buffer + t, buf_cnt - t)) < buf_cnt) {
+						command_print(CMD,
+									  "diff %d address 0x%08x. Was 0x%02x instead of 0x%02x",
+									  diffs,
+									  (unsigned)(t + image.sections[i].base_address),
+									  data[t],
+									  buffer[t]);
+						if (diffs++ >= 127) {
+							command_print(CMD, "More than 128 errors, the rest are not printed.");
+							free(data);
+							free(buffer);
+							goto done;
 						}
 						keep_alive();
+						t++;
 					}
 				}
 				free(data);
@@ -5280,6 +5783,7 @@ enum target_cfg_param {
 	TCFG_DEFER_EXAMINE,
 	TCFG_GDB_PORT,
 	TCFG_GDB_MAX_CONNECTIONS,
+	TCFG_GDB_EXPEDITE,
 };
 
 static struct jim_nvp nvp_config_opts[] = {
@@ -5297,6 +5801,7 @@ static struct jim_nvp nvp_config_opts[] = {
 	{ .name = "-defer-examine",    .value = TCFG_DEFER_EXAMINE },
 	{ .name = "-gdb-port",         .value = TCFG_GDB_PORT },
 	{ .name = "-gdb-max-connections",   .value = TCFG_GDB_MAX_CONNECTIONS },
+	{ .name = "-gdb-expedite",     .value = TCFG_GDB_EXPEDITE },
 	{ .name = NULL, .value = -1 }
 };
 
@@ -5483,16 +5988,24 @@ no_params:
 		case TCFG_WORK_AREA_BACKUP:
 			if (goi->isconfigure) {
 				target_free_all_working_areas(target);
-				e = jim_getopt_wide(goi, &w);
-				if (e != JIM_OK)
-					return e;
-				/* make this exactly 1 or 0 */
-				target->backup_working_area = (!!w);
+				if (goi->argc > 0 && !strcmp(Jim_GetString(goi->argv[0], NULL), "lazy")) {
+					jim_getopt_obj(goi, &o);
+					target->backup_working_area = TARGET_WA_BACKUP_LAZY;
+				} else {
+					e = jim_getopt_wide(goi, &w);
+					if (e != JIM_OK)
+						return e;
+					/* make this exactly 1 or 0 */
+					target->backup_working_area = w ? TARGET_WA_BACKUP_ON : TARGET_WA_BACKUP_OFF;
+				}
 			} else {
 				if (goi->argc != 0)
 					goto no_params;
 			}
-			Jim_SetResult(goi->interp, Jim_NewIntObj(goi->interp, target->backup_working_area));
+			if (target->backup_working_area == TARGET_WA_BACKUP_LAZY)
+				Jim_SetResultString(goi->interp, "lazy", -1);
+			else
+				Jim_SetResult(goi->interp, Jim_NewIntObj(goi->interp, target->backup_working_area));
 			/* loop for more e*/
 			break;
 
@@ -5629,6 +6142,22 @@ no_params:
 			}
 			Jim_SetResult(goi->interp, Jim_NewIntObj(goi->interp, target->gdb_max_connections));
 			break;
+
+		case TCFG_GDB_EXPEDITE:
+			if (goi->isconfigure) {
+				const char *s;
+				e = jim_getopt_string(goi, &s, NULL);
+				if (e != JIM_OK)
+					return e;
+				free(target->gdb_expedited_regs);
+				target->gdb_expedited_regs = strdup(s);
+			} else {
+				if (goi->argc != 0)
+					goto no_params;
+			}
+			Jim_SetResultString(goi->interp, target->gdb_expedited_regs ? target->gdb_expedited_regs : "default", -1);
+			/* loop for more */
+			break;
 		}
 	} /* while (goi->argc) */
 
@@ -6231,7 +6760,7 @@ static int target_create(struct jim_getopt_info *goi)
 	target->working_area        = 0x0;
 	target->working_area_size   = 0x0;
 	target->working_areas       = NULL;
-	target->backup_working_area = 0;
+	target->backup_working_area = TARGET_WA_BACKUP_OFF;
 
 	target->state               = TARGET_UNKNOWN;
 	target->debug_reason        = DBG_REASON_UNDEFINED;
@@ -6289,6 +6818,7 @@ static int target_create(struct jim_getopt_info *goi)
 	if (e != JIM_OK) {
 		rtos_destroy(target);
 		free(target->gdb_port_override);
+		free(target->gdb_expedited_regs);
 		free(target->trace_info);
 		free(target->type);
 		free(target);
@@ -6306,6 +6836,7 @@ static int target_create(struct jim_getopt_info *goi)
 		LOG_ERROR("Out of memory");
 		rtos_destroy(target);
 		free(target->gdb_port_override);
+		free(target->gdb_expedited_regs);
 		free(target->trace_info);
 		free(target->type);
 		free(target);
@@ -6319,6 +6850,7 @@ static int target_create(struct jim_getopt_info *goi)
 			free(target->cmd_name);
 			rtos_destroy(target);
 			free(target->gdb_port_override);
+			free(target->gdb_expedited_regs);
 			free(target->trace_info);
 			free(target->type);
 			free(target);
@@ -6360,6 +6892,7 @@ static int target_create(struct jim_getopt_info *goi)
 		free(target->cmd_name);
 		rtos_destroy(target);
 		free(target->gdb_port_override);
+		free(target->gdb_expedited_regs);
 		free(target->trace_info);
 		free(target->type);
 		free(target);
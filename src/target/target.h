@@ -90,11 +90,19 @@ struct working_area {
 	target_addr_t address;
 	uint32_t size;
 	bool free;
-	uint8_t *backup;
 	struct working_area **user;
 	struct working_area *next;
 };
 
+/* how the content of the working area is preserved */
+enum target_wa_backup_mode {
+	TARGET_WA_BACKUP_OFF = 0,	/* not preserved */
+	TARGET_WA_BACKUP_ON = 1,	/* saved on allocation, modified words restored on free */
+	TARGET_WA_BACKUP_LAZY = 2,	/* saved on first use, restored once no area is allocated */
+};
+
+struct working_area_backup;
+
 struct gdb_service {
 	struct target *target;
 	/*  field for smp display  */
@@ -104,10 +112,20 @@ struct gdb_service {
 	int32_t core[2];
 };
 
+/* number of buckets of the breakpoint lookup table, a power of two */
+#define TARGET_BREAKPOINT_HASH_SIZE		64
+
 /* target back off timer */
 struct backoff_timer {
 	int times;
-	int count;
+};
+
+/* background polling schedule of a target */
+struct target_poll_sched {
+	int64_t next;		/* time of the next poll, in ms */
+	int interval;		/* current polling interval, in ms */
+	bool due;		/* poll on the current run of the scheduler */
+	bool prefetched;	/* poll_prefetch() read the state for this run */
 };
 
 /* split target registers into multiple class */
@@ -154,7 +172,8 @@ struct target {
 	bool working_area_phys_spec;		/* physical address specified? */
 	target_addr_t working_area_phys;			/* physical address */
 	uint32_t working_area_size;			/* size in bytes */
-	uint32_t backup_working_area;		/* whether the content of the working area has to be preserved */
+	enum target_wa_backup_mode backup_working_area;	/* whether the content of the working area has to be preserved */
+	struct working_area_backup *working_area_backup;	/* saved content of the working area */
 	struct working_area *working_areas;/* list of allocated working areas */
 	enum target_debug_reason debug_reason;/* reason why the target entered debug state */
 	enum target_endianness endianness;	/* target endianness */
@@ -162,6 +181,8 @@ struct target {
 	enum target_state state;			/* the current backend-state (running, halted, ...) */
 	struct reg_cache *reg_cache;		/* the first register cache of the target (core regs) */
 	struct breakpoint *breakpoints;		/* list of breakpoints */
+	struct breakpoint **breakpoints_tail;	/* next pointer of the last breakpoint */
+	struct breakpoint *breakpoint_hash[TARGET_BREAKPOINT_HASH_SIZE];	/* breakpoints by address */
 	struct watchpoint *watchpoints;		/* list of watchpoints */
 	struct trace *trace_info;			/* generic trace information */
 	struct debug_msg_receiver *dbgmsg;	/* list of debug message receivers */
@@ -189,6 +210,7 @@ struct target {
 	bool rtos_auto_detect;				/* A flag that indicates that the RTOS has been specified as "auto"
 										 * and must be detected when symbols are offered */
 	struct backoff_timer backoff;
+	struct target_poll_sched poll_sched;
 	int smp;							/* Unique non-zero number for each SMP group */
 	struct list_head *smp_targets;		/* list all targets in this smp group/cluster
 										 * The head of the list is shared between the
@@ -210,6 +232,8 @@ struct target {
 
 	int gdb_max_connections;			/* max number of simultaneous gdb connections */
 
+	char *gdb_expedited_regs;			/* registers sent in gdb stop replies, NULL for default */
+
 	/* The semihosting information, extracted from the target. */
 	struct semihosting *semihosting;
 };
@@ -529,6 +553,16 @@ int target_get_gdb_reg_list_noread(struct target *target,
 		struct reg **reg_list[], int *reg_list_size,
 		enum target_register_class reg_class);
 
+/**
+ * Refresh the cached values of the invalid registers in @a reg_list.
+ *
+ * This routine is a wrapper for target->type->read_registers. It is
+ * only an optimization: registers which are still invalid on return
+ * must be read with reg->type->get() as before.
+ */
+int target_read_registers(struct target *target, struct reg **reg_list,
+		int reg_count);
+
 /**
  * Check if @a target allows GDB connections.
  *
@@ -790,6 +824,15 @@ void target_handle_md_output(struct command_invocation *cmd,
 int target_profiling_default(struct target *target, uint32_t *samples, uint32_t
 		max_num_samples, uint32_t *num_samples, uint32_t seconds);
 
+/**
+ * Read up to @a max_num_samples PC samples from a running target without
+ * halting it.
+ *
+ * This routine is a wrapper for target->type->sample_pc.
+ */
+int target_sample_pc(struct target *target, uint32_t *samples,
+		uint32_t max_num_samples, uint32_t *num_samples);
+
 #define ERROR_TARGET_INVALID	(-300)
 #define ERROR_TARGET_INIT_FAILED (-301)
 #define ERROR_TARGET_TIMEOUT	(-302)
@@ -807,5 +850,9 @@ int target_profiling_default(struct target *target, uint32_t *samples, uint32_t
 extern bool get_target_reset_nag(void);
 
 #define TARGET_DEFAULT_POLLING_INTERVAL		100
+/* polling interval right after resume, step or halt request */
+#define TARGET_MIN_POLLING_INTERVAL		10
+/* polling interval of a running target with no GDB attached */
+#define TARGET_MAX_POLLING_INTERVAL		800
 
 #endif /* OPENOCD_TARGET_TARGET_H */
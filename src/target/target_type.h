@@ -32,6 +32,14 @@ struct target_type {
 
 	/* poll current target status */
 	int (*poll)(struct target *target);
+	/**
+	 * Optional. Read ahead the state the next poll() of the @a count
+	 * targets needs, in as few adapter round trips as possible; all of
+	 * them are of this type. Set target->poll_sched.prefetched on each
+	 * target whose state was read. The background polling calls it right
+	 * before polling the targets and discards the state after the run.
+	 */
+	int (*poll_prefetch)(struct target **targets, unsigned int count);
 	/* Invoked only from target_arch_state().
 	 * Issue USER() w/architecture specific status.  */
 	int (*arch_state)(struct target *target);
@@ -106,6 +114,18 @@ struct target_type {
 			struct reg **reg_list[], int *reg_list_size,
 			enum target_register_class reg_class);
 
+	/**
+	 * Refresh the cached values of several registers in one go, e.g. by
+	 * entering debug state once or by queueing all the accesses in a
+	 * single batch.  Registers which are already valid are skipped.
+	 * Registers this callback cannot read are left invalid, the caller
+	 * then reads them one by one through reg->type->get().
+	 * Do @b not call this function directly, use target_read_registers()
+	 * instead.
+	 */
+	int (*read_registers)(struct target *target, struct reg **reg_list,
+			int reg_count);
+
 	/* target memory access
 	* size: 1 = byte (8bit), 2 = half-word (16bit), 4 = word (32bit)
 	* count: number of items of <size>
@@ -300,6 +320,13 @@ struct target_type {
 	int (*profiling)(struct target *target, uint32_t *samples,
 			uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds);
 
+	/* Read a burst of PC samples without halting the target, for
+	 * continuous profiling. Returns ERROR_NOT_IMPLEMENTED if the target
+	 * has no non-intrusive PC sampling.
+	 */
+	int (*sample_pc)(struct target *target, uint32_t *samples,
+			uint32_t max_num_samples, uint32_t *num_samples);
+
 	/* Return the number of address bits this target supports. This will
 	 * typically be 32 for 32-bit targets, and 64 for 64-bit targets. If not
 	 * implemented, it's assumed to be 32. */
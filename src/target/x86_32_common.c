@@ -1272,15 +1272,9 @@ void x86_32_common_reset_breakpoints_watchpoints(struct target *t)
 {
 	struct x86_32_common *x86_32 = target_to_x86_32(t);
 	struct x86_32_dbg_reg *debug_reg_list = x86_32->hw_break_list;
-	struct breakpoint *next_b;
 	struct watchpoint *next_w;
 
-	while (t->breakpoints) {
-		next_b = t->breakpoints->next;
-		free(t->breakpoints->orig_instr);
-		free(t->breakpoints);
-		t->breakpoints = next_b;
-	}
+	breakpoint_forget_all(t);
 
 	while (t->watchpoints) {
 		next_w = t->watchpoints->next;